@@ -59,6 +59,7 @@
 #include "ticks.h"
 #include "commonutil.h"
 #include "crc16.h"
+#include "lz4.h"       // compressed download
 
 
 #ifdef WITH_LCD
@@ -560,6 +561,8 @@ static void SendCapabilities(void) {
     capabilities.compiled_with_zx8211 = false;
 #endif
 
+    capabilities.compressed_download = true;
+
     reply_ng(CMD_CAPABILITIES, PM3_SUCCESS, (uint8_t *)&capabilities, sizeof(capabilities));
 }
 
@@ -758,6 +761,61 @@ void ListenReaderField(uint8_t limit) {
         }
     }
 }
+// Send a BigBuf / emulator memory range as a sequence of LZ4 blocks.
+// Each reply packet is filled up with as much input as compresses into it,
+// sparse sample and trace buffers shrink a lot this way.
+static void DownloadBigBuf_LZ4(const dl_lz4_request_t *req) {
+
+    uint8_t *mem;
+    uint32_t memsize;
+    if (req->memtype == DL_LZ4_MEM_EML) {
+        mem = BigBuf_get_EM_addr();
+        memsize = CARD_MEMORY_SIZE;
+    } else {
+        mem = BigBuf_get_addr();
+        memsize = BigBuf_get_size();
+    }
+
+    uint32_t len = 0;
+    if (req->offset < memsize) {
+        len = MIN(req->len, memsize - req->offset);
+    }
+    mem += req->offset;
+
+    dl_lz4_chunk_t chunk;
+    for (uint32_t i = 0; i < len;) {
+        WDT_HIT();
+
+        int srclen = MIN(len - i, 0xFFFF);
+        int clen = LZ4_compress_destSize((const char *)mem + i, (char *)chunk.data, &srclen, sizeof(chunk.data));
+
+        if (clen <= 0 || srclen <= (int)sizeof(chunk.data)) {
+            // doesn't compress, send it as is
+            srclen = MIN(len - i, sizeof(chunk.data));
+            memcpy(chunk.data, mem + i, srclen);
+            clen = srclen;
+            chunk.flags = DL_LZ4_STORED;
+        } else {
+            chunk.flags = 0;
+        }
+        chunk.offset = i;
+        chunk.rawlen = srclen;
+
+        int result = reply_ng(CMD_DOWNLOADED_BIGBUF_LZ4, PM3_SUCCESS, (uint8_t *)&chunk, offsetof(dl_lz4_chunk_t, data) + clen);
+        if (result != PM3_SUCCESS)
+            Dbprintf("transfer to client failed ::  | bytes between %d - %d (%d) | result: %d", i, i + srclen, srclen, result);
+
+        i += srclen;
+    }
+
+    // Same finish signal as the uncompressed downloads
+    if (req->memtype == DL_LZ4_MEM_EML) {
+        reply_mix(CMD_ACK, 1, 0, 0, 0, 0);
+    } else {
+        reply_mix(CMD_ACK, 1, 0, BigBuf_get_traceLen(), getSamplingConfig(), sizeof(sample_config));
+    }
+}
+
 static void PacketReceived(PacketCommandNG *packet) {
     /*
     if (packet->ng) {
@@ -994,6 +1052,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             T55xx_ChkPwds(packet->data.asBytes[0] & 0xff, true);
             break;
         }
+        case CMD_LF_T55XX_BRUTE: {
+            T55xx_BruteForce(packet->data.asBytes, true);
+            break;
+        }
         case CMD_LF_PCF7931_READ: {
             ReadPCF7931(true);
             break;
@@ -1525,6 +1587,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             MifareChkKeys_file(payload->filename);
             break;
         }
+        case CMD_HF_MIFARE_CHKKEYS_LIST: {
+            MifareChkKeys_list(packet->data.asBytes);
+            break;
+        }
         case CMD_HF_MIFARE_SIMULATE: {
             struct p {
                 uint16_t flags;
@@ -2087,6 +2153,14 @@ static void PacketReceived(PacketCommandNG *packet) {
             LED_B_OFF();
             break;
         }
+        case CMD_DOWNLOAD_BIGBUF_LZ4: {
+            if (packet->length != sizeof(dl_lz4_request_t))
+                break;
+            LED_B_ON();
+            DownloadBigBuf_LZ4((dl_lz4_request_t *)packet->data.asBytes);
+            LED_B_OFF();
+            break;
+        }
         case CMD_READ_MEM: {
             if (packet->length != sizeof(uint32_t))
                 break;
@@ -476,8 +476,6 @@ static void iso18092_setup(uint8_t fpga_minor_mode) {
     felica_nexttransfertime = 2 * DELAY_ARM2AIR_AS_READER;
     iso18092_set_timeout(2120); // 106 * 20ms  maximum start-up time of card
 
-    init_table(CRC_FELICA);
-
     // connect Demodulated Signal to ADC:
     SetAdcMuxFor(GPIO_MUXSEL_HIPKD);
 
@@ -34,6 +34,7 @@
 #include "string.h"
 #include "printf.h"
 #include "lfdemod.h"
+#include "t55xx_block0.h"
 #include "lfsampling.h"
 #include "protocols.h"
 #include "pmflash.h"
@@ -2026,7 +2027,7 @@ bool brute_mem = (flags & 0x0100) >> 8;
 }
 */
 // Read one card block in page [page]
-void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block, uint32_t pwd, uint8_t downlink_mode, bool ledcontrol) {
+static void T55xxReadBlockEx(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block, uint32_t pwd, uint8_t downlink_mode, size_t samples, bool ledcontrol) {
     /*
     flag bits
     xxxx xxxxxxx1 0x0001 PwdMode
@@ -2051,12 +2052,8 @@ void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block,
 
     setDefaultSamplingConfig();
 
-    size_t samples = 12000;
-
     if (ledcontrol) LED_A_ON();
 
-    if (brute_mem) samples = 2048;
-
     //-- Set Read Flag to ensure SendCMD does not add "data" to the packet
     //-- flags |= 0x40;
 
@@ -2093,6 +2090,11 @@ void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block,
     setSamplingConfig(&old_config);
 }
 
+void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block, uint32_t pwd, uint8_t downlink_mode, bool ledcontrol) {
+    size_t samples = (brute_mem) ? 2048 : 12000;
+    T55xxReadBlockEx(page, pwd_mode, brute_mem, block, pwd, downlink_mode, samples, ledcontrol);
+}
+
 
 void T55xx_ChkPwds(uint8_t flags, bool ledcontrol) {
 
@@ -2211,6 +2213,179 @@ OUT:
     BigBuf_free();
 }
 
+//-----------------------------------------------------------------------------
+// T55xx password bruteforce, range or uploaded list.
+// Block 0 is read with every password and demodulated with the expected
+// modulation. Only a plausible and repeating config block counts as a hit,
+// the client gets hits and progress reports, nothing per password.
+//-----------------------------------------------------------------------------
+#define T55XX_BRUTE_MAXERR      10
+
+static t55xx_brute_cfg_t t55_brute_cfg;
+static uint16_t t55_brute_count = 0;
+
+// enough samples for block 0 at the end of the search window plus one repetition
+static size_t T55xx_BruteSamples(uint8_t clk) {
+    size_t samples = (size_t)clk * 140;
+    return MIN(MAX(samples, 2048), MIN(12000, BigBuf_max_traceLen()));
+}
+
+static bool T55xx_BruteDemod(uint8_t *buf, size_t *size) {
+    int clk = t55_brute_cfg.clock;
+    int invert = t55_brute_cfg.inverted;
+    int start = 0;
+
+    computeSignalProperties(buf, *size);
+
+    switch (t55_brute_cfg.modulation) {
+        case DEMOD_ASK:
+            return askdemod_ext(buf, size, &clk, &invert, T55XX_BRUTE_MAXERR, 0, 1, &start) >= 0;
+        case DEMOD_BI:
+        case DEMOD_BIa: {
+            if (askdemod_ext(buf, size, &clk, &invert, T55XX_BRUTE_MAXERR, 0, 0, &start) < 0)
+                return false;
+            int offset = 0;
+            return BiphaseRawDecode(buf, size, &offset, (t55_brute_cfg.modulation == DEMOD_BIa)) >= 0;
+        }
+        case DEMOD_NRZ:
+            return nrzRawDemod(buf, size, &clk, &invert, &start) >= 0;
+        case DEMOD_PSK1:
+        case DEMOD_PSK2:
+        case DEMOD_PSK3: {
+            // skip the first samples to let the antenna settle, psk gets inverted occasionally otherwise
+            if (*size <= 160)
+                return false;
+            *size -= 160;
+            memmove(buf, buf + 160, *size);
+            if (pskRawDemod(buf, size, &clk, &invert) < 0)
+                return false;
+            if (t55_brute_cfg.modulation != DEMOD_PSK1)
+                psk1TOpsk2(buf, *size);
+            return true;
+        }
+        case DEMOD_FSK1:
+        case DEMOD_FSK1a:
+            *size = fskdemod(buf, *size, clk, (t55_brute_cfg.modulation == DEMOD_FSK1), 8, 5, &start);
+            return *size > 0;
+        case DEMOD_FSK:
+        case DEMOD_FSK2:
+        case DEMOD_FSK2a:
+            *size = fskdemod(buf, *size, clk, (t55_brute_cfg.modulation == DEMOD_FSK2a), 10, 8, &start);
+            return *size > 0;
+        default:
+            return false;
+    }
+}
+
+static void T55xx_BruteForce_run(bool ledcontrol) {
+
+    t55xx_brute_result_t result = {0};
+    int retval = PM3_SUCCESS;
+
+    bool use_list = (t55_brute_cfg.flags & T55XX_BRUTE_LIST) == T55XX_BRUTE_LIST;
+    if (use_list && t55_brute_count == 0) {
+        reply_ng(CMD_LF_T55XX_BRUTE, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    // the generic FSK config tests all FSK variants
+    uint8_t mode = t55_brute_cfg.modulation;
+    if (mode >= DEMOD_FSK1 && mode <= DEMOD_FSK2a)
+        mode = DEMOD_FSK;
+
+    uint8_t *buf = BigBuf_get_addr();
+    uint8_t *pwds = BigBuf_get_EM_addr();
+    size_t samples = T55xx_BruteSamples(t55_brute_cfg.clock);
+
+    int oldbg = g_dbglevel;
+    g_dbglevel = DBG_NONE;
+
+    for (uint32_t i = 0; ; i++) {
+
+        if (BUTTON_PRESS() || data_available()) {
+            retval = PM3_EOPABORTED;
+            break;
+        }
+
+        uint32_t pwd = (use_list) ? bytes_to_num(pwds + (i * 4), 4) : t55_brute_cfg.start + i;
+
+        T55xxReadBlockEx(0, true, true, 0, pwd, t55_brute_cfg.downlink_mode, samples, ledcontrol);
+
+        size_t size = samples;
+        t55xx_block0_t b0;
+        result.password = pwd;
+        result.tried = i + 1;
+
+        if (T55xx_BruteDemod(buf, &size) &&
+                t55xx_block0_find(buf, size, mode, t55_brute_cfg.clock, &b0) &&
+                t55xx_block0_repeats(buf, size, &b0)) {
+            result.found = true;
+            result.block0 = b0.block0;
+            break;
+        }
+
+        if ((use_list) ? (i + 1 >= t55_brute_count) : (pwd == t55_brute_cfg.end))
+            break;
+
+        if ((result.tried % T55XX_BRUTE_PROGRESS_INTERVAL) == 0) {
+            WDT_HIT();
+            reply_ng(CMD_LF_T55XX_BRUTE, PM3_SUCCESS, (uint8_t *)&result, sizeof(result));
+        }
+    }
+
+    g_dbglevel = oldbg;
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    if (ledcontrol) LEDsoff();
+
+    result.done = true;
+    reply_ng(CMD_LF_T55XX_BRUTE, retval, (uint8_t *)&result, sizeof(result));
+}
+
+void T55xx_BruteForce(const uint8_t *datain, bool ledcontrol) {
+
+    const t55xx_brute_packet_t *packet = (const t55xx_brute_packet_t *)datain;
+
+    switch (packet->op) {
+        case T55XX_BRUTE_OP_INIT: {
+            if (packet->len < sizeof(t55xx_brute_cfg_t)) {
+                reply_ng(CMD_LF_T55XX_BRUTE, PM3_EINVARG, NULL, 0);
+                return;
+            }
+            memcpy(&t55_brute_cfg, packet->data, sizeof(t55_brute_cfg));
+
+            // the list lives in emulator memory, sampling doesn't touch it
+            t55_brute_count = 0;
+            uint16_t capacity = CARD_MEMORY_SIZE / 4;
+            if (t55_brute_cfg.flags & T55XX_BRUTE_LIST) {
+                t55_brute_count = MIN(t55_brute_cfg.end, capacity);
+                BigBuf_Clear_EM();
+            }
+
+            // tell the client how many passwords fit
+            reply_ng(CMD_LF_T55XX_BRUTE, PM3_SUCCESS, (uint8_t *)&t55_brute_count, sizeof(t55_brute_count));
+            break;
+        }
+        case T55XX_BRUTE_OP_UPLOAD: {
+            if (((uint32_t)packet->offset + packet->len / 4) > t55_brute_count || packet->len > sizeof(packet->data)) {
+                reply_ng(CMD_LF_T55XX_BRUTE, PM3_EOVFLOW, NULL, 0);
+                return;
+            }
+            memcpy(BigBuf_get_EM_addr() + (packet->offset * 4), packet->data, packet->len);
+            reply_ng(CMD_LF_T55XX_BRUTE, PM3_SUCCESS, NULL, 0);
+            break;
+        }
+        case T55XX_BRUTE_OP_RUN: {
+            T55xx_BruteForce_run(ledcontrol);
+            t55_brute_count = 0;
+            break;
+        }
+        default:
+            reply_ng(CMD_LF_T55XX_BRUTE, PM3_EINVARG, NULL, 0);
+            break;
+    }
+}
+
 void T55xxWakeUp(uint32_t pwd, uint8_t flags, bool ledcontrol) {
 
     flags |= 0x01 | 0x40 | 0x20; //Password | Read Call (no data) | reg_read no block
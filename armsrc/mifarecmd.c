@@ -37,6 +37,7 @@
 #include "usb_cdc.h"  // usb_poll_validate_length
 #include "spiffs.h"   // spiffs
 #include "appmain.h"  // print_stack_usage
+#include "mfc_candidates.h"
 
 #ifndef HARDNESTED_AUTHENTICATION_TIMEOUT
 # define HARDNESTED_AUTHENTICATION_TIMEOUT  848     // card times out 1ms after wrong authentication (according to NXP documentation)
@@ -1845,6 +1846,162 @@ void MifareChkKeys_file(uint8_t *fn) {
 #endif
 }
 
+//-----------------------------------------------------------------------------
+// Check a candidate key list (ie from nested attack) uploaded into BigBuf.
+// The whole list is checked on the device, with progress reports on the way.
+//-----------------------------------------------------------------------------
+static uint8_t *cand_list = NULL;
+static uint32_t cand_list_size = 0;
+
+static void MifareChkKeys_list_run(void) {
+
+    mfc_cand_result_t result = {0};
+
+    if (mfc_cand_check(cand_list, cand_list_size) == false) {
+        reply_ng(CMD_HF_MIFARE_CHKKEYS_LIST, PM3_EINIT, NULL, 0);
+        return;
+    }
+
+    const mfc_cand_hdr_t *hdr = (const mfc_cand_hdr_t *)cand_list;
+    result.count = hdr->count;
+
+    struct Crypto1State mpcs = {0, 0};
+    struct Crypto1State *pcs;
+    pcs = &mpcs;
+
+    uint8_t uid[10] = {0x00};
+    uint32_t cuid = 0;
+    uint8_t cascade_levels = 0;
+    bool have_uid = false;
+    uint64_t key = 0;
+    int retval = PM3_SUCCESS;
+
+    LEDsoff();
+    LED_A_ON();
+
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    clear_trace();
+    set_tracing(false);
+
+    int oldbg = g_dbglevel;
+    g_dbglevel = DBG_NONE;
+
+    mfc_cand_iter_t it;
+    mfc_cand_iter_init(&it, cand_list);
+
+    while (mfc_cand_iter_next(&it, &key)) {
+
+        if (BUTTON_PRESS() || data_available()) {
+            retval = PM3_EOPABORTED;
+            break;
+        }
+
+        if (have_uid == false) { // need a full select cycle to get the uid first
+            iso14a_card_select_t card_info;
+            if (!iso14443a_select_card(uid, &card_info, &cuid, true, 0, true)) {
+                mfc_cand_iter_retry(&it); // try same key once again
+                continue;
+            }
+            switch (card_info.uidlen) {
+                case 4 :
+                    cascade_levels = 1;
+                    break;
+                case 7 :
+                    cascade_levels = 2;
+                    break;
+                case 10:
+                    cascade_levels = 3;
+                    break;
+                default:
+                    break;
+            }
+            have_uid = true;
+        } else { // no need for anticollision. We can directly select the card
+            if (!iso14443a_select_card(uid, NULL, NULL, false, cascade_levels, true)) {
+                mfc_cand_iter_retry(&it); // try same key once again
+                continue;
+            }
+        }
+
+        if (mifare_classic_auth(pcs, cuid, hdr->block, hdr->keytype, key, AUTH_FIRST) == 0) {
+            num_to_bytes(key, sizeof(result.key), result.key);
+            result.found = true;
+            result.tried = it.pos;
+            break;
+        }
+
+        result.tried = it.pos;
+        if (mfc_cand_iter_progress(&it)) {
+            WDT_HIT();
+            reply_ng(CMD_HF_MIFARE_CHKKEYS_LIST, PM3_SUCCESS, (uint8_t *)&result, sizeof(result));
+        }
+    }
+
+    result.done = true;
+    reply_ng(CMD_HF_MIFARE_CHKKEYS_LIST, retval, (uint8_t *)&result, sizeof(result));
+
+    crypto1_deinit(pcs);
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+    g_dbglevel = oldbg;
+}
+
+void MifareChkKeys_list(uint8_t *datain) {
+
+    mfc_cand_packet_t *packet = (mfc_cand_packet_t *)datain;
+
+    switch (packet->op) {
+        case MFC_CAND_OP_INIT: {
+            if (packet->len < sizeof(mfc_cand_hdr_t)) {
+                reply_ng(CMD_HF_MIFARE_CHKKEYS_LIST, PM3_EINVARG, NULL, 0);
+                return;
+            }
+
+            // loading the bitstream clears BigBuf, do it before allocating the list
+            FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
+            BigBuf_free();
+
+            mfc_cand_hdr_t hdr;
+            memcpy(&hdr, packet->data, sizeof(hdr));
+
+            // keep some room for the trace
+            uint16_t capacity = mfc_cand_capacity(BigBuf_max_traceLen() - MAX_FRAME_SIZE);
+            hdr.count = MIN(hdr.count, capacity);
+
+            cand_list_size = mfc_cand_size(hdr.count);
+            cand_list = BigBuf_malloc(cand_list_size);
+            if (cand_list == NULL) {
+                cand_list_size = 0;
+                reply_ng(CMD_HF_MIFARE_CHKKEYS_LIST, PM3_EMALLOC, NULL, 0);
+                return;
+            }
+            memcpy(cand_list, &hdr, sizeof(hdr));
+
+            // tell the client how many keys fit
+            reply_ng(CMD_HF_MIFARE_CHKKEYS_LIST, PM3_SUCCESS, (uint8_t *)&hdr.count, sizeof(hdr.count));
+            break;
+        }
+        case MFC_CAND_OP_UPLOAD: {
+            if (cand_list == NULL || mfc_cand_put(cand_list, cand_list_size, packet->offset, packet->data, packet->len) == false) {
+                reply_ng(CMD_HF_MIFARE_CHKKEYS_LIST, PM3_EOVFLOW, NULL, 0);
+                return;
+            }
+            reply_ng(CMD_HF_MIFARE_CHKKEYS_LIST, PM3_SUCCESS, NULL, 0);
+            break;
+        }
+        case MFC_CAND_OP_RUN: {
+            MifareChkKeys_list_run();
+            BigBuf_free();
+            cand_list = NULL;
+            cand_list_size = 0;
+            break;
+        }
+        default:
+            reply_ng(CMD_HF_MIFARE_CHKKEYS_LIST, PM3_EINVARG, NULL, 0);
+            break;
+    }
+}
+
 //-----------------------------------------------------------------------------
 // MIFARE Personalize UID. Only for Mifare Classic EV1 7Byte UID
 //-----------------------------------------------------------------------------
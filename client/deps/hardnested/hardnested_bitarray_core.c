@@ -18,10 +18,13 @@
 
 #include "hardnested_bitarray_core.h"
 #include "hardnested_bf_core.h"
+#include "util_posix.h"       // msclock
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #ifndef __APPLE__
 #include <malloc.h>
 #endif
@@ -136,28 +139,97 @@ typedef void free_bitarray_t(uint32_t *);
 free_bitarray_t free_bitarray_AVX512, free_bitarray_AVX2, free_bitarray_AVX, free_bitarray_SSE2, free_bitarray_MMX, free_bitarray_NOSIMD, free_bitarray_NEON, free_bitarray_dispatch;
 typedef uint32_t bitcount_t(uint32_t);
 bitcount_t bitcount_AVX512, bitcount_AVX2, bitcount_AVX, bitcount_SSE2, bitcount_MMX, bitcount_NOSIMD, bitcount_NEON, bitcount_dispatch;
-typedef uint32_t count_states_t(uint32_t *);
+typedef uint32_t count_states_t(const uint32_t *);
 count_states_t count_states_AVX512, count_states_AVX2, count_states_AVX, count_states_SSE2, count_states_MMX, count_states_NOSIMD, count_states_NEON, count_states_dispatch;
-typedef void bitarray_AND_t(uint32_t[], uint32_t[]);
+typedef void bitarray_AND_t(uint32_t[], const uint32_t[]);
 bitarray_AND_t bitarray_AND_AVX512, bitarray_AND_AVX2, bitarray_AND_AVX, bitarray_AND_SSE2, bitarray_AND_MMX, bitarray_AND_NOSIMD, bitarray_AND_NEON, bitarray_AND_dispatch;
-typedef void bitarray_low20_AND_t(uint32_t *, uint32_t *);
+typedef void bitarray_low20_AND_t(uint32_t *, const uint32_t *);
 bitarray_low20_AND_t bitarray_low20_AND_AVX512, bitarray_low20_AND_AVX2, bitarray_low20_AND_AVX, bitarray_low20_AND_SSE2, bitarray_low20_AND_MMX, bitarray_low20_AND_NOSIMD, bitarray_low20_AND_NEON, bitarray_low20_AND_dispatch;
-typedef uint32_t count_bitarray_AND_t(uint32_t *, uint32_t *);
+typedef uint32_t count_bitarray_AND_t(uint32_t *, const uint32_t *);
 count_bitarray_AND_t count_bitarray_AND_AVX512, count_bitarray_AND_AVX2, count_bitarray_AND_AVX, count_bitarray_AND_SSE2, count_bitarray_AND_MMX, count_bitarray_AND_NOSIMD, count_bitarray_AND_NEON, count_bitarray_AND_dispatch;
-typedef uint32_t count_bitarray_low20_AND_t(uint32_t *, uint32_t *);
+typedef uint32_t count_bitarray_low20_AND_t(uint32_t *, const uint32_t *);
 count_bitarray_low20_AND_t count_bitarray_low20_AND_AVX512, count_bitarray_low20_AND_AVX2, count_bitarray_low20_AND_AVX, count_bitarray_low20_AND_SSE2, count_bitarray_low20_AND_MMX, count_bitarray_low20_AND_NOSIMD, count_bitarray_low20_AND_NEON, count_bitarray_low20_AND_dispatch;
-typedef void bitarray_AND4_t(uint32_t *, uint32_t *, uint32_t *, uint32_t *);
+typedef void bitarray_AND4_t(uint32_t *, const uint32_t *, const uint32_t *, const uint32_t *);
 bitarray_AND4_t bitarray_AND4_AVX512, bitarray_AND4_AVX2, bitarray_AND4_AVX, bitarray_AND4_SSE2, bitarray_AND4_MMX, bitarray_AND4_NOSIMD, bitarray_AND4_NEON, bitarray_AND4_dispatch;
-typedef void bitarray_OR_t(uint32_t[], uint32_t[]);
+typedef void bitarray_OR_t(uint32_t[], const uint32_t[]);
 bitarray_OR_t bitarray_OR_AVX512, bitarray_OR_AVX2, bitarray_OR_AVX, bitarray_OR_SSE2, bitarray_OR_MMX, bitarray_OR_NOSIMD, bitarray_OR_NEON, bitarray_OR_dispatch;
-typedef uint32_t count_bitarray_AND2_t(uint32_t *, uint32_t *);
+typedef uint32_t count_bitarray_AND2_t(const uint32_t *, const uint32_t *);
 count_bitarray_AND2_t count_bitarray_AND2_AVX512, count_bitarray_AND2_AVX2, count_bitarray_AND2_AVX, count_bitarray_AND2_SSE2, count_bitarray_AND2_MMX, count_bitarray_AND2_NOSIMD, count_bitarray_AND2_NEON, count_bitarray_AND2_dispatch;
-typedef uint32_t count_bitarray_AND3_t(uint32_t *, uint32_t *, uint32_t *);
+typedef uint32_t count_bitarray_AND3_t(const uint32_t *, const uint32_t *, const uint32_t *);
 count_bitarray_AND3_t count_bitarray_AND3_AVX512, count_bitarray_AND3_AVX2, count_bitarray_AND3_AVX, count_bitarray_AND3_SSE2, count_bitarray_AND3_MMX, count_bitarray_AND3_NOSIMD, count_bitarray_AND3_NEON, count_bitarray_AND3_dispatch;
-typedef uint32_t count_bitarray_AND4_t(uint32_t *, uint32_t *, uint32_t *, uint32_t *);
+typedef uint32_t count_bitarray_AND4_t(const uint32_t *, const uint32_t *, const uint32_t *, const uint32_t *);
 count_bitarray_AND4_t count_bitarray_AND4_AVX512, count_bitarray_AND4_AVX2, count_bitarray_AND4_AVX, count_bitarray_AND4_SSE2, count_bitarray_AND4_MMX, count_bitarray_AND4_NOSIMD, count_bitarray_AND4_NEON, count_bitarray_AND4_dispatch;
 
 
+// Hand written AVX512 kernels for the count_bitarray_AND* family. The AND of three inputs is a
+// single vpternlog, and VPOPCNTDQ counts 64 bits per lane without leaving the vector unit.
+// VPOPCNTDQ is not part of AVX512F, so it is checked at runtime and the compiler generated
+// code is used as fallback. Loads are unaligned since not all bitarrays come from MALLOC_BITARRAY.
+#if defined (__AVX512F__) && !defined (NOSIMD_BUILD) && \
+    ((defined (__clang__) && __clang_major__ >= 6) || (!defined (__clang__) && __GNUC__ >= 8))
+#include <immintrin.h>
+#define AVX512_VPOPCNTDQ_KERNELS
+#define AVX512_VPOPCNTDQ_TARGET __attribute__((target("avx512f,avx512vpopcntdq")))
+#define TERNLOG_AND3 0x80 // a & b & c
+
+static inline bool has_vpopcntdq(void) {
+    return __builtin_cpu_supports("avx512vpopcntdq");
+}
+
+static AVX512_VPOPCNTDQ_TARGET uint32_t count_states_vpopcntdq(const uint32_t *A) {
+    __m512i count = _mm512_setzero_si512();
+    for (uint32_t i = 0; i < (1 << 19); i += 16) {
+        count = _mm512_add_epi64(count, _mm512_popcnt_epi64(_mm512_loadu_si512(A + i)));
+    }
+    return _mm512_reduce_add_epi64(count);
+}
+
+static AVX512_VPOPCNTDQ_TARGET uint32_t count_bitarray_AND_vpopcntdq(uint32_t *restrict A, const uint32_t *restrict B) {
+    __m512i count = _mm512_setzero_si512();
+    for (uint32_t i = 0; i < (1 << 19); i += 16) {
+        __m512i a = _mm512_and_si512(_mm512_loadu_si512(A + i), _mm512_loadu_si512(B + i));
+        _mm512_storeu_si512(A + i, a);
+        count = _mm512_add_epi64(count, _mm512_popcnt_epi64(a));
+    }
+    return _mm512_reduce_add_epi64(count);
+}
+
+static AVX512_VPOPCNTDQ_TARGET uint32_t count_bitarray_AND2_vpopcntdq(const uint32_t *restrict A, const uint32_t *restrict B) {
+    __m512i count = _mm512_setzero_si512();
+    for (uint32_t i = 0; i < (1 << 19); i += 16) {
+        __m512i ab = _mm512_and_si512(_mm512_loadu_si512(A + i), _mm512_loadu_si512(B + i));
+        count = _mm512_add_epi64(count, _mm512_popcnt_epi64(ab));
+    }
+    return _mm512_reduce_add_epi64(count);
+}
+
+static AVX512_VPOPCNTDQ_TARGET uint32_t count_bitarray_AND3_vpopcntdq(const uint32_t *restrict A, const uint32_t *restrict B, const uint32_t *restrict C) {
+    __m512i count = _mm512_setzero_si512();
+    for (uint32_t i = 0; i < (1 << 19); i += 16) {
+        __m512i abc = _mm512_ternarylogic_epi32(_mm512_loadu_si512(A + i), _mm512_loadu_si512(B + i), _mm512_loadu_si512(C + i), TERNLOG_AND3);
+        count = _mm512_add_epi64(count, _mm512_popcnt_epi64(abc));
+    }
+    return _mm512_reduce_add_epi64(count);
+}
+
+static AVX512_VPOPCNTDQ_TARGET uint32_t count_bitarray_AND4_vpopcntdq(const uint32_t *restrict A, const uint32_t *restrict B, const uint32_t *restrict C, const uint32_t *restrict D) {
+    __m512i count = _mm512_setzero_si512();
+    for (uint32_t i = 0; i < (1 << 19); i += 16) {
+        __m512i abc = _mm512_ternarylogic_epi32(_mm512_loadu_si512(A + i), _mm512_loadu_si512(B + i), _mm512_loadu_si512(C + i), TERNLOG_AND3);
+        count = _mm512_add_epi64(count, _mm512_popcnt_epi64(_mm512_and_si512(abc, _mm512_loadu_si512(D + i))));
+    }
+    return _mm512_reduce_add_epi64(count);
+}
+
+static void bitarray_AND4_ternlog(uint32_t *restrict A, const uint32_t *restrict B, const uint32_t *restrict C, const uint32_t *restrict D) {
+    for (uint32_t i = 0; i < (1 << 19); i += 16) {
+        __m512i bcd = _mm512_ternarylogic_epi32(_mm512_loadu_si512(B + i), _mm512_loadu_si512(C + i), _mm512_loadu_si512(D + i), TERNLOG_AND3);
+        _mm512_storeu_si512(A + i, bcd);
+    }
+}
+#endif
+
+
 inline uint32_t *MALLOC_BITARRAY(uint32_t x) {
 #if defined (_WIN32)
     return __builtin_assume_aligned(_aligned_malloc((x), __BIGGEST_ALIGNMENT__), __BIGGEST_ALIGNMENT__);
@@ -188,7 +260,12 @@ inline uint32_t BITCOUNT(uint32_t a) {
 }
 
 
-inline uint32_t COUNT_STATES(uint32_t *A) {
+inline uint32_t COUNT_STATES(const uint32_t *A) {
+#if defined (AVX512_VPOPCNTDQ_KERNELS)
+    if (has_vpopcntdq()) {
+        return count_states_vpopcntdq(A);
+    }
+#endif
     uint32_t count = 0;
     for (uint32_t i = 0; i < (1 << 19); i++) {
         count += BITCOUNT(A[i]);
@@ -197,7 +274,7 @@ inline uint32_t COUNT_STATES(uint32_t *A) {
 }
 
 
-inline void BITARRAY_AND(uint32_t *restrict A, uint32_t *restrict B) {
+inline void BITARRAY_AND(uint32_t *restrict A, const uint32_t *restrict B) {
     A = __builtin_assume_aligned(A, __BIGGEST_ALIGNMENT__);
     B = __builtin_assume_aligned(B, __BIGGEST_ALIGNMENT__);
     for (uint32_t i = 0; i < (1 << 19); i++) {
@@ -206,9 +283,9 @@ inline void BITARRAY_AND(uint32_t *restrict A, uint32_t *restrict B) {
 }
 
 
-inline void BITARRAY_LOW20_AND(uint32_t *restrict A, uint32_t *restrict B) {
+inline void BITARRAY_LOW20_AND(uint32_t *restrict A, const uint32_t *restrict B) {
     uint16_t *a = (uint16_t *)__builtin_assume_aligned(A, __BIGGEST_ALIGNMENT__);
-    uint16_t *b = (uint16_t *)__builtin_assume_aligned(B, __BIGGEST_ALIGNMENT__);
+    const uint16_t *b = (const uint16_t *)__builtin_assume_aligned(B, __BIGGEST_ALIGNMENT__);
 
     for (uint32_t i = 0; i < (1 << 20); i++) {
         if (!b[i]) {
@@ -218,7 +295,12 @@ inline void BITARRAY_LOW20_AND(uint32_t *restrict A, uint32_t *restrict B) {
 }
 
 
-inline uint32_t COUNT_BITARRAY_AND(uint32_t *restrict A, uint32_t *restrict B) {
+inline uint32_t COUNT_BITARRAY_AND(uint32_t *restrict A, const uint32_t *restrict B) {
+#if defined (AVX512_VPOPCNTDQ_KERNELS)
+    if (has_vpopcntdq()) {
+        return count_bitarray_AND_vpopcntdq(A, B);
+    }
+#endif
     A = __builtin_assume_aligned(A, __BIGGEST_ALIGNMENT__);
     B = __builtin_assume_aligned(B, __BIGGEST_ALIGNMENT__);
     uint32_t count = 0;
@@ -230,9 +312,9 @@ inline uint32_t COUNT_BITARRAY_AND(uint32_t *restrict A, uint32_t *restrict B) {
 }
 
 
-inline uint32_t COUNT_BITARRAY_LOW20_AND(uint32_t *restrict A, uint32_t *restrict B) {
+inline uint32_t COUNT_BITARRAY_LOW20_AND(uint32_t *restrict A, const uint32_t *restrict B) {
     uint16_t *a = (uint16_t *)__builtin_assume_aligned(A, __BIGGEST_ALIGNMENT__);
-    uint16_t *b = (uint16_t *)__builtin_assume_aligned(B, __BIGGEST_ALIGNMENT__);
+    const uint16_t *b = (const uint16_t *)__builtin_assume_aligned(B, __BIGGEST_ALIGNMENT__);
     uint32_t count = 0;
 
     for (uint32_t i = 0; i < (1 << 20); i++) {
@@ -245,7 +327,10 @@ inline uint32_t COUNT_BITARRAY_LOW20_AND(uint32_t *restrict A, uint32_t *restric
 }
 
 
-inline void BITARRAY_AND4(uint32_t *restrict A, uint32_t *restrict B, uint32_t *restrict C, uint32_t *restrict D) {
+inline void BITARRAY_AND4(uint32_t *restrict A, const uint32_t *restrict B, const uint32_t *restrict C, const uint32_t *restrict D) {
+#if defined (AVX512_VPOPCNTDQ_KERNELS)
+    bitarray_AND4_ternlog(A, B, C, D);
+#else
     A = __builtin_assume_aligned(A, __BIGGEST_ALIGNMENT__);
     B = __builtin_assume_aligned(B, __BIGGEST_ALIGNMENT__);
     C = __builtin_assume_aligned(C, __BIGGEST_ALIGNMENT__);
@@ -253,10 +338,11 @@ inline void BITARRAY_AND4(uint32_t *restrict A, uint32_t *restrict B, uint32_t *
     for (uint32_t i = 0; i < (1 << 19); i++) {
         A[i] = B[i] & C[i] & D[i];
     }
+#endif
 }
 
 
-inline void BITARRAY_OR(uint32_t *restrict A, uint32_t *restrict B) {
+inline void BITARRAY_OR(uint32_t *restrict A, const uint32_t *restrict B) {
     A = __builtin_assume_aligned(A, __BIGGEST_ALIGNMENT__);
     B = __builtin_assume_aligned(B, __BIGGEST_ALIGNMENT__);
     for (uint32_t i = 0; i < (1 << 19); i++) {
@@ -265,7 +351,12 @@ inline void BITARRAY_OR(uint32_t *restrict A, uint32_t *restrict B) {
 }
 
 
-inline uint32_t COUNT_BITARRAY_AND2(uint32_t *restrict A, uint32_t *restrict B) {
+inline uint32_t COUNT_BITARRAY_AND2(const uint32_t *restrict A, const uint32_t *restrict B) {
+#if defined (AVX512_VPOPCNTDQ_KERNELS)
+    if (has_vpopcntdq()) {
+        return count_bitarray_AND2_vpopcntdq(A, B);
+    }
+#endif
     A = __builtin_assume_aligned(A, __BIGGEST_ALIGNMENT__);
     B = __builtin_assume_aligned(B, __BIGGEST_ALIGNMENT__);
     uint32_t count = 0;
@@ -276,7 +367,12 @@ inline uint32_t COUNT_BITARRAY_AND2(uint32_t *restrict A, uint32_t *restrict B)
 }
 
 
-inline uint32_t COUNT_BITARRAY_AND3(uint32_t *restrict A, uint32_t *restrict B, uint32_t *restrict C) {
+inline uint32_t COUNT_BITARRAY_AND3(const uint32_t *restrict A, const uint32_t *restrict B, const uint32_t *restrict C) {
+#if defined (AVX512_VPOPCNTDQ_KERNELS)
+    if (has_vpopcntdq()) {
+        return count_bitarray_AND3_vpopcntdq(A, B, C);
+    }
+#endif
     A = __builtin_assume_aligned(A, __BIGGEST_ALIGNMENT__);
     B = __builtin_assume_aligned(B, __BIGGEST_ALIGNMENT__);
     C = __builtin_assume_aligned(C, __BIGGEST_ALIGNMENT__);
@@ -288,7 +384,12 @@ inline uint32_t COUNT_BITARRAY_AND3(uint32_t *restrict A, uint32_t *restrict B,
 }
 
 
-inline uint32_t COUNT_BITARRAY_AND4(uint32_t *restrict A, uint32_t *restrict B, uint32_t *restrict C, uint32_t *restrict D) {
+inline uint32_t COUNT_BITARRAY_AND4(const uint32_t *restrict A, const uint32_t *restrict B, const uint32_t *restrict C, const uint32_t *restrict D) {
+#if defined (AVX512_VPOPCNTDQ_KERNELS)
+    if (has_vpopcntdq()) {
+        return count_bitarray_AND4_vpopcntdq(A, B, C, D);
+    }
+#endif
     A = __builtin_assume_aligned(A, __BIGGEST_ALIGNMENT__);
     B = __builtin_assume_aligned(B, __BIGGEST_ALIGNMENT__);
     C = __builtin_assume_aligned(C, __BIGGEST_ALIGNMENT__);
@@ -388,7 +489,7 @@ uint32_t bitcount_dispatch(uint32_t a) {
     return (*bitcount_function_p)(a);
 }
 
-uint32_t count_states_dispatch(uint32_t *bitarray) {
+uint32_t count_states_dispatch(const uint32_t *bitarray) {
 #if defined(COMPILER_HAS_SIMD_NEON)
     if (arm_has_neon()) count_states_function_p = &count_states_NEON;
     else
@@ -411,7 +512,7 @@ uint32_t count_states_dispatch(uint32_t *bitarray) {
     return (*count_states_function_p)(bitarray);
 }
 
-void bitarray_AND_dispatch(uint32_t *A, uint32_t *B) {
+void bitarray_AND_dispatch(uint32_t *A, const uint32_t *B) {
 #if defined(COMPILER_HAS_SIMD_NEON)
     if (arm_has_neon()) bitarray_AND_function_p = &bitarray_AND_NEON;
     else
@@ -434,7 +535,7 @@ void bitarray_AND_dispatch(uint32_t *A, uint32_t *B) {
     (*bitarray_AND_function_p)(A, B);
 }
 
-void bitarray_low20_AND_dispatch(uint32_t *A, uint32_t *B) {
+void bitarray_low20_AND_dispatch(uint32_t *A, const uint32_t *B) {
 #if defined(COMPILER_HAS_SIMD_NEON)
     if (arm_has_neon()) bitarray_low20_AND_function_p = &bitarray_low20_AND_NEON;
     else
@@ -457,7 +558,7 @@ void bitarray_low20_AND_dispatch(uint32_t *A, uint32_t *B) {
     (*bitarray_low20_AND_function_p)(A, B);
 }
 
-uint32_t count_bitarray_AND_dispatch(uint32_t *A, uint32_t *B) {
+uint32_t count_bitarray_AND_dispatch(uint32_t *A, const uint32_t *B) {
 #if defined(COMPILER_HAS_SIMD_NEON)
     if (arm_has_neon()) count_bitarray_AND_function_p = &count_bitarray_AND_NEON;
     else
@@ -480,7 +581,7 @@ uint32_t count_bitarray_AND_dispatch(uint32_t *A, uint32_t *B) {
     return (*count_bitarray_AND_function_p)(A, B);
 }
 
-uint32_t count_bitarray_low20_AND_dispatch(uint32_t *A, uint32_t *B) {
+uint32_t count_bitarray_low20_AND_dispatch(uint32_t *A, const uint32_t *B) {
 #if defined(COMPILER_HAS_SIMD_NEON)
     if (arm_has_neon()) count_bitarray_low20_AND_function_p = &count_bitarray_low20_AND_NEON;
     else
@@ -503,7 +604,7 @@ uint32_t count_bitarray_low20_AND_dispatch(uint32_t *A, uint32_t *B) {
     return (*count_bitarray_low20_AND_function_p)(A, B);
 }
 
-void bitarray_AND4_dispatch(uint32_t *A, uint32_t *B, uint32_t *C, uint32_t *D) {
+void bitarray_AND4_dispatch(uint32_t *A, const uint32_t *B, const uint32_t *C, const uint32_t *D) {
 #if defined(COMPILER_HAS_SIMD_NEON)
     if (arm_has_neon()) bitarray_AND4_function_p = &bitarray_AND4_NEON;
     else
@@ -526,7 +627,7 @@ void bitarray_AND4_dispatch(uint32_t *A, uint32_t *B, uint32_t *C, uint32_t *D)
     (*bitarray_AND4_function_p)(A, B, C, D);
 }
 
-void bitarray_OR_dispatch(uint32_t *A, uint32_t *B) {
+void bitarray_OR_dispatch(uint32_t *A, const uint32_t *B) {
 #if defined(COMPILER_HAS_SIMD_NEON)
     if (arm_has_neon()) bitarray_OR_function_p = &bitarray_OR_NEON;
     else
@@ -549,7 +650,7 @@ void bitarray_OR_dispatch(uint32_t *A, uint32_t *B) {
     (*bitarray_OR_function_p)(A, B);
 }
 
-uint32_t count_bitarray_AND2_dispatch(uint32_t *A, uint32_t *B) {
+uint32_t count_bitarray_AND2_dispatch(const uint32_t *A, const uint32_t *B) {
 #if defined(COMPILER_HAS_SIMD_NEON)
     if (arm_has_neon()) count_bitarray_AND2_function_p = &count_bitarray_AND2_NEON;
     else
@@ -572,7 +673,7 @@ uint32_t count_bitarray_AND2_dispatch(uint32_t *A, uint32_t *B) {
     return (*count_bitarray_AND2_function_p)(A, B);
 }
 
-uint32_t count_bitarray_AND3_dispatch(uint32_t *A, uint32_t *B, uint32_t *C) {
+uint32_t count_bitarray_AND3_dispatch(const uint32_t *A, const uint32_t *B, const uint32_t *C) {
 #if defined(COMPILER_HAS_SIMD_NEON)
     if (arm_has_neon()) count_bitarray_AND3_function_p = &count_bitarray_AND3_NEON;
     else
@@ -595,7 +696,7 @@ uint32_t count_bitarray_AND3_dispatch(uint32_t *A, uint32_t *B, uint32_t *C) {
     return (*count_bitarray_AND3_function_p)(A, B, C);
 }
 
-uint32_t count_bitarray_AND4_dispatch(uint32_t *A, uint32_t *B, uint32_t *C, uint32_t *D) {
+uint32_t count_bitarray_AND4_dispatch(const uint32_t *A, const uint32_t *B, const uint32_t *C, const uint32_t *D) {
 #if defined(COMPILER_HAS_SIMD_NEON)
     if (arm_has_neon()) count_bitarray_AND4_function_p = &count_bitarray_AND4_NEON;
     else
@@ -634,45 +735,176 @@ uint32_t bitcount(uint32_t a) {
     return (*bitcount_function_p)(a);
 }
 
-uint32_t count_states(uint32_t *A) {
+uint32_t count_states(const uint32_t *A) {
     return (*count_states_function_p)(A);
 }
 
-void bitarray_AND(uint32_t *A, uint32_t *B) {
+void bitarray_AND(uint32_t *A, const uint32_t *B) {
     (*bitarray_AND_function_p)(A, B);
 }
 
-void bitarray_low20_AND(uint32_t *A, uint32_t *B) {
+void bitarray_low20_AND(uint32_t *A, const uint32_t *B) {
     (*bitarray_low20_AND_function_p)(A, B);
 }
 
-uint32_t count_bitarray_AND(uint32_t *A, uint32_t *B) {
+uint32_t count_bitarray_AND(uint32_t *A, const uint32_t *B) {
     return (*count_bitarray_AND_function_p)(A, B);
 }
 
-uint32_t count_bitarray_low20_AND(uint32_t *A, uint32_t *B) {
+uint32_t count_bitarray_low20_AND(uint32_t *A, const uint32_t *B) {
     return (*count_bitarray_low20_AND_function_p)(A, B);
 }
 
-void bitarray_AND4(uint32_t *A, uint32_t *B, uint32_t *C, uint32_t *D) {
+void bitarray_AND4(uint32_t *A, const uint32_t *B, const uint32_t *C, const uint32_t *D) {
     (*bitarray_AND4_function_p)(A, B, C, D);
 }
 
-void bitarray_OR(uint32_t *A, uint32_t *B) {
+void bitarray_OR(uint32_t *A, const uint32_t *B) {
     (*bitarray_OR_function_p)(A, B);
 }
 
-uint32_t count_bitarray_AND2(uint32_t *A, uint32_t *B) {
+uint32_t count_bitarray_AND2(const uint32_t *A, const uint32_t *B) {
     return (*count_bitarray_AND2_function_p)(A, B);
 }
 
-uint32_t count_bitarray_AND3(uint32_t *A, uint32_t *B, uint32_t *C) {
+uint32_t count_bitarray_AND3(const uint32_t *A, const uint32_t *B, const uint32_t *C) {
     return (*count_bitarray_AND3_function_p)(A, B, C);
 }
 
-uint32_t count_bitarray_AND4(uint32_t *A, uint32_t *B, uint32_t *C, uint32_t *D) {
+uint32_t count_bitarray_AND4(const uint32_t *A, const uint32_t *B, const uint32_t *C, const uint32_t *D) {
     return (*count_bitarray_AND4_function_p)(A, B, C, D);
 }
 
+
+///////////////////////////////////////////////77
+// Self check of the bitarray kernels
+
+typedef struct {
+    malloc_bitarray_t *malloc_bitarray;
+    free_bitarray_t *free_bitarray;
+    count_states_t *count_states;
+    count_bitarray_AND_t *count_bitarray_AND;
+    count_bitarray_AND2_t *count_bitarray_AND2;
+    count_bitarray_AND3_t *count_bitarray_AND3;
+    count_bitarray_AND4_t *count_bitarray_AND4;
+    bitarray_AND4_t *bitarray_AND4;
+} bitarray_kernels_t;
+
+static bool get_bitarray_kernels(SIMDExecInstr instr, bitarray_kernels_t *k) {
+    switch (instr) {
+#if defined(COMPILER_HAS_SIMD_AVX512)
+        case SIMD_AVX512:
+            *k = (bitarray_kernels_t) {malloc_bitarray_AVX512, free_bitarray_AVX512, count_states_AVX512, count_bitarray_AND_AVX512, count_bitarray_AND2_AVX512, count_bitarray_AND3_AVX512, count_bitarray_AND4_AVX512, bitarray_AND4_AVX512};
+            return true;
+#endif
+#if defined(COMPILER_HAS_SIMD_X86)
+        case SIMD_AVX2:
+            *k = (bitarray_kernels_t) {malloc_bitarray_AVX2, free_bitarray_AVX2, count_states_AVX2, count_bitarray_AND_AVX2, count_bitarray_AND2_AVX2, count_bitarray_AND3_AVX2, count_bitarray_AND4_AVX2, bitarray_AND4_AVX2};
+            return true;
+        case SIMD_AVX:
+            *k = (bitarray_kernels_t) {malloc_bitarray_AVX, free_bitarray_AVX, count_states_AVX, count_bitarray_AND_AVX, count_bitarray_AND2_AVX, count_bitarray_AND3_AVX, count_bitarray_AND4_AVX, bitarray_AND4_AVX};
+            return true;
+        case SIMD_SSE2:
+            *k = (bitarray_kernels_t) {malloc_bitarray_SSE2, free_bitarray_SSE2, count_states_SSE2, count_bitarray_AND_SSE2, count_bitarray_AND2_SSE2, count_bitarray_AND3_SSE2, count_bitarray_AND4_SSE2, bitarray_AND4_SSE2};
+            return true;
+        case SIMD_MMX:
+            *k = (bitarray_kernels_t) {malloc_bitarray_MMX, free_bitarray_MMX, count_states_MMX, count_bitarray_AND_MMX, count_bitarray_AND2_MMX, count_bitarray_AND3_MMX, count_bitarray_AND4_MMX, bitarray_AND4_MMX};
+            return true;
+#endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+        case SIMD_NEON:
+            *k = (bitarray_kernels_t) {malloc_bitarray_NEON, free_bitarray_NEON, count_states_NEON, count_bitarray_AND_NEON, count_bitarray_AND2_NEON, count_bitarray_AND3_NEON, count_bitarray_AND4_NEON, bitarray_AND4_NEON};
+            return true;
+#endif
+        case SIMD_NONE:
+            *k = (bitarray_kernels_t) {malloc_bitarray_NOSIMD, free_bitarray_NOSIMD, count_states_NOSIMD, count_bitarray_AND_NOSIMD, count_bitarray_AND2_NOSIMD, count_bitarray_AND3_NOSIMD, count_bitarray_AND4_NOSIMD, bitarray_AND4_NOSIMD};
+            return true;
+        case SIMD_AUTO:
+        default:
+            return false;
+    }
+}
+
+// Run the kernels of <instr> on pseudo random bitarrays and compare the results with the generic
+// code. The bitarrays come from the allocator of <instr>, which has the strictest alignment.
+// The AVX512 set includes the VPOPCNTDQ kernels if the CPU has them. <ms> gets the time
+// of 64 count_bitarray_AND4 calls. Returns the name of the first kernel that disagrees, or NULL.
+const char *check_bitarray_kernels(SIMDExecInstr instr, float *ms) {
+    bitarray_kernels_t simd, generic;
+    if (get_bitarray_kernels(instr, &simd) == false || get_bitarray_kernels(SIMD_NONE, &generic) == false) {
+        return "unsupported";
+    }
+
+    const char *failed = NULL;
+    uint32_t *arrays[6];
+    for (int i = 0; i < 6; i++) {
+        arrays[i] = simd.malloc_bitarray(sizeof(uint32_t) * (1 << 19));
+        if (arrays[i] == NULL) {
+            for (int j = 0; j < i; j++) {
+                simd.free_bitarray(arrays[j]);
+            }
+            return "malloc";
+        }
+    }
+    uint32_t *A = arrays[0], *B = arrays[1], *C = arrays[2], *D = arrays[3], *R1 = arrays[4], *R2 = arrays[5];
+
+    // xorshift32, the inputs need not be good random, only different
+    uint32_t x = 0x2545F491;
+    for (uint32_t i = 0; i < (1 << 19); i++) {
+        for (int j = 0; j < 4; j++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            arrays[j][i] = x;
+        }
+    }
+
+    if (simd.count_states(A) != generic.count_states(A)) {
+        failed = "count_states";
+        goto out;
+    }
+    if (simd.count_bitarray_AND2(A, B) != generic.count_bitarray_AND2(A, B)) {
+        failed = "count_bitarray_AND2";
+        goto out;
+    }
+    if (simd.count_bitarray_AND3(A, B, C) != generic.count_bitarray_AND3(A, B, C)) {
+        failed = "count_bitarray_AND3";
+        goto out;
+    }
+    if (simd.count_bitarray_AND4(A, B, C, D) != generic.count_bitarray_AND4(A, B, C, D)) {
+        failed = "count_bitarray_AND4";
+        goto out;
+    }
+
+    memcpy(R1, A, sizeof(uint32_t) * (1 << 19));
+    memcpy(R2, A, sizeof(uint32_t) * (1 << 19));
+    if (simd.count_bitarray_AND(R1, B) != generic.count_bitarray_AND(R2, B)
+            || memcmp(R1, R2, sizeof(uint32_t) * (1 << 19)) != 0) {
+        failed = "count_bitarray_AND";
+        goto out;
+    }
+
+    simd.bitarray_AND4(R1, B, C, D);
+    generic.bitarray_AND4(R2, B, C, D);
+    if (memcmp(R1, R2, sizeof(uint32_t) * (1 << 19)) != 0) {
+        failed = "bitarray_AND4";
+        goto out;
+    }
+
+    if (ms != NULL) {
+        uint64_t start = msclock();
+        for (int i = 0; i < 64; i++) {
+            simd.count_bitarray_AND4(A, B, C, D);
+        }
+        *ms = msclock() - start;
+    }
+
+out:
+    for (int i = 0; i < 6; i++) {
+        simd.free_bitarray(arrays[i]);
+    }
+    return failed;
+}
+
 #endif
 
@@ -51,19 +51,21 @@ THE SOFTWARE.
 #define HARDNESTED_BITARRAY_CORE_H__
 
 #include <stdint.h>
+#include "hardnested_bf_core.h"   // SIMDExecInstr
 
 uint32_t *malloc_bitarray(uint32_t x);
 void free_bitarray(uint32_t *x);
 uint32_t bitcount(uint32_t a);
-uint32_t count_states(uint32_t *A);
-void bitarray_AND(uint32_t *A, uint32_t *B);
-void bitarray_low20_AND(uint32_t *A, uint32_t *B);
-uint32_t count_bitarray_AND(uint32_t *A, uint32_t *B);
-uint32_t count_bitarray_low20_AND(uint32_t *A, uint32_t *B);
-void bitarray_AND4(uint32_t *A, uint32_t *B, uint32_t *C, uint32_t *D);
-void bitarray_OR(uint32_t *A, uint32_t *B);
-uint32_t count_bitarray_AND2(uint32_t *A, uint32_t *B);
-uint32_t count_bitarray_AND3(uint32_t *A, uint32_t *B, uint32_t *C);
-uint32_t count_bitarray_AND4(uint32_t *A, uint32_t *B, uint32_t *C, uint32_t *D);
+uint32_t count_states(const uint32_t *A);
+void bitarray_AND(uint32_t *A, const uint32_t *B);
+void bitarray_low20_AND(uint32_t *A, const uint32_t *B);
+uint32_t count_bitarray_AND(uint32_t *A, const uint32_t *B);
+uint32_t count_bitarray_low20_AND(uint32_t *A, const uint32_t *B);
+void bitarray_AND4(uint32_t *A, const uint32_t *B, const uint32_t *C, const uint32_t *D);
+void bitarray_OR(uint32_t *A, const uint32_t *B);
+uint32_t count_bitarray_AND2(const uint32_t *A, const uint32_t *B);
+uint32_t count_bitarray_AND3(const uint32_t *A, const uint32_t *B, const uint32_t *C);
+uint32_t count_bitarray_AND4(const uint32_t *A, const uint32_t *B, const uint32_t *C, const uint32_t *D);
+const char *check_bitarray_kernels(SIMDExecInstr instr, float *ms);
 
 #endif
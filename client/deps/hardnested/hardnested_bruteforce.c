@@ -68,7 +68,7 @@ THE SOFTWARE.
 #include "fileutils.h"
 #include "pm3_cmd.h"
 
-#define NUM_BRUTE_FORCE_THREADS         (num_CPUs())
+#define NUM_BRUTE_FORCE_THREADS         (hardnested_get_num_threads())
 #define DEFAULT_BRUTE_FORCE_RATE        (120000000.0) // if benchmark doesn't succeed
 #define TEST_BENCH_SIZE                 (6000)        // number of odd and even states for brute force benchmark
 #define TEST_BENCH_FILENAME             "hardnested_bf_bench_data.bin"
@@ -88,7 +88,9 @@ static uint32_t bf_test_nonce[256];
 static uint8_t bf_test_nonce_2nd_byte[256];
 static uint8_t bf_test_nonce_par[256];
 static uint32_t bucket_count = 0;
-static statelist_t *buckets[128];
+static uint32_t next_bucket = 0;
+static statelist_t **buckets = NULL;
+static uint16_t num_threads_override = 0;
 static uint32_t keys_found = 0;
 static uint64_t num_keys_tested;
 static uint64_t found_bs_key = 0;
@@ -117,6 +119,18 @@ inline uint8_t trailing_zeros(uint8_t byte) {
 }
 
 
+// 0 = use all logical CPUs
+void hardnested_set_num_threads(uint16_t num_threads) {
+    num_threads_override = MIN(num_threads, HARDNESTED_MAX_THREADS);
+}
+
+uint16_t hardnested_get_num_threads(void) {
+    if (num_threads_override) {
+        return num_threads_override;
+    }
+    return MIN(num_CPUs(), HARDNESTED_MAX_THREADS);
+}
+
 bool verify_key(uint32_t cuid, noncelist_t *nonces, const uint8_t *best_first_bytes, uint32_t odd, uint32_t even) {
     struct Crypto1State pcs;
     for (uint16_t test_first_byte = 1; test_first_byte < 256; test_first_byte++) {
@@ -158,9 +172,13 @@ crack_states_thread(void *x) {
     } *thread_arg;
 
     thread_arg = (struct arg *)x;
+#if defined (DEBUG_BRUTE_FORCE)
     const int thread_id = thread_arg->thread_ID;
-    uint32_t current_bucket = thread_id;
-    while (current_bucket < bucket_count) {
+#endif
+    // threads pull the next bucket when they are done with the previous one. Buckets are sorted by size,
+    // therefore the big ones are started first and the small ones fill the gaps at the end.
+    uint32_t current_bucket;
+    while ((current_bucket = __atomic_fetch_add(&next_bucket, 1, __ATOMIC_SEQ_CST)) < bucket_count) {
         statelist_t *bucket = buckets[current_bucket];
         if (bucket) {
 #if defined (DEBUG_BRUTE_FORCE)
@@ -188,11 +206,18 @@ crack_states_thread(void *x) {
                 }
             }
         }
-        current_bucket += NUM_BRUTE_FORCE_THREADS;
     }
     return NULL;
 }
 
+static int compare_bucket_size(const void *b1, const void *b2) {
+    const statelist_t *bucket1 = *(statelist_t * const *)b1;
+    const statelist_t *bucket2 = *(statelist_t * const *)b2;
+    uint64_t size1 = (uint64_t)bucket1->len[ODD_STATE] * bucket1->len[EVEN_STATE];
+    uint64_t size2 = (uint64_t)bucket2->len[ODD_STATE] * bucket2->len[EVEN_STATE];
+    return (size1 < size2) - (size1 > size2);
+}
+
 
 void prepare_bf_test_nonces(noncelist_t *nonces, uint8_t best_first_byte) {
     // we do bitsliced brute forcing with best_first_bytes[0] only.
@@ -307,19 +332,34 @@ bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint
     bitslice_test_nonces(nonces_to_bruteforce, bf_test_nonce, bf_test_nonce_par);
 
     // count number of states to go
+    uint32_t num_buckets = 0;
+    for (statelist_t *p = candidates; p != NULL; p = p->next) {
+        num_buckets++;
+    }
+    buckets = (statelist_t **)calloc(num_buckets + 1, sizeof(statelist_t *));
+    if (buckets == NULL) {
+        PrintAndLogEx(ERR, "Out of memory error in brute_force_bs() - buckets");
+        return false;
+    }
+
     bucket_count = 0;
+    next_bucket = 0;
     for (statelist_t *p = candidates; p != NULL; p = p->next) {
         if (p->states[ODD_STATE] != NULL && p->states[EVEN_STATE] != NULL) {
             buckets[bucket_count] = p;
             bucket_count++;
         }
     }
+    qsort(buckets, bucket_count, sizeof(statelist_t *), compare_bucket_size);
 
     uint64_t start_time = msclock();
 
 #if defined(__linux__) ||  defined(__APPLE__)
-    if (NUM_BRUTE_FORCE_THREADS < 0)
+    if (NUM_BRUTE_FORCE_THREADS < 0) {
+        free(buckets);
+        buckets = NULL;
         return false;
+    }
 #endif
 
     pthread_t threads[NUM_BRUTE_FORCE_THREADS];
@@ -347,6 +387,10 @@ bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint
         pthread_join(threads[i], 0);
     }
 
+    free(buckets);
+    buckets = NULL;
+    bucket_count = 0;
+
     uint64_t elapsed_time = msclock() - start_time;
 
     if (bf_rate != NULL)
@@ -433,6 +477,16 @@ static bool read_bench_data(statelist_t *test_candidates) {
 }
 
 
+bool brute_force_benchmark_available(void) {
+    char *path;
+    if (searchFile(&path, RESOURCES_SUBDIR, TEST_BENCH_FILENAME, "", true) != PM3_SUCCESS) {
+        return false;
+    }
+    free(path);
+    return true;
+}
+
+
 float brute_force_benchmark(void) {
     statelist_t test_candidates[NUM_BRUTE_FORCE_THREADS];
 
@@ -447,6 +501,8 @@ float brute_force_benchmark(void) {
 
     if (!read_bench_data(test_candidates)) {
         PrintAndLogEx(NORMAL, "Couldn't read benchmark data. Assuming brute force rate of %1.0f states per second", DEFAULT_BRUTE_FORCE_RATE);
+        free(test_candidates[0].states[ODD_STATE]);
+        free(test_candidates[0].states[EVEN_STATE]);
         return DEFAULT_BRUTE_FORCE_RATE;
     }
 
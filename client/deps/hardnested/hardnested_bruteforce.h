@@ -21,6 +21,7 @@
 #include <stdbool.h>
 
 #define NUM_SUMS 19 // number of possible sum property values
+#define HARDNESTED_MAX_THREADS 128 // upper limit for worker threads in all hardnested phases
 
 typedef struct guess_sum_a8 {
     float prob;
@@ -55,8 +56,11 @@ typedef struct {
 
 void prepare_bf_test_nonces(noncelist_t *nonces, uint8_t best_first_byte);
 bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint32_t num_acquired_nonces, uint64_t maximum_states, noncelist_t *nonces, uint8_t *best_first_bytes, uint64_t *found_key);
+bool brute_force_benchmark_available(void);
 float brute_force_benchmark(void);
 uint8_t trailing_zeros(uint8_t byte);
 bool verify_key(uint32_t cuid, noncelist_t *nonces, const uint8_t *best_first_bytes, uint32_t odd, uint32_t even);
+void hardnested_set_num_threads(uint16_t num_threads);
+uint16_t hardnested_get_num_threads(void);
 
 #endif
@@ -1,8 +1,17 @@
+#include <stdio.h>
 #include "pm3.h"
 
 int main(int argc, char *argv[]) {
     pm3 *p;
     p = pm3_open("/dev/ttyACM0");
     pm3_console(p, "hw status");
+
+    pm3_hf14a_card_t card;
+    if (pm3_hf14a_select(p, false, &card) == 0) {
+        printf("UID:");
+        for (int i = 0; i < card.uidlen; i++)
+            printf(" %02X", card.uid[i]);
+        printf("  SAK: %02X\n", card.sak);
+    }
     pm3_close(p);
 }
@@ -4,3 +4,12 @@ import pm3
 p=pm3.pm3("/dev/ttyACM0")
 p.console("hw status")
 print("Device:", p.name)
+
+card=pm3.hf14a_card_t()
+if p.hf14a_select(False, card) == 0:
+    print("UID:", card.uid[:card.uidlen].hex(), "SAK: %02X" % card.sak)
+
+samples=bytearray(40000)
+res, n = p.lf_read(0, samples)
+if res == 0:
+    print("LF samples:", n)
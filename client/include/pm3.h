@@ -16,11 +16,74 @@
 #ifndef LIBPM3_H
 #define LIBPM3_H
 
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
 typedef struct pm3_device pm3;
 
+// Every device has its own connection. The first pm3_open() sets up the
+// session device, further calls open extra devices and return NULL when
+// they fail. Each call below selects <dev> for the calling thread.
+//
+// Only the structured calls further down can drive several devices at once,
+// one thread per device. Commands run by pm3_console() share the graph, demod
+// and trace buffers of the process, so pm3_console() calls are serialised:
+// a console command on one device waits for the one running on another.
 pm3 *pm3_open(const char *port);
 int pm3_console(pm3 *dev, const char *cmd);
 const char *pm3_name_get(pm3 *dev);
 void pm3_close(pm3 *dev);
 pm3 *pm3_get_current_dev(void);
+
+//-----------------------------------------------------------------------------
+// Structured API
+//
+// Unlike pm3_console() these calls print nothing and hand back their results
+// as data. They return 0 (PM3_SUCCESS) or one of the negative PM3_E* codes
+// from include/pm3_cmd.h, PM3_ENOTTY when no device is connected.
+// Buffers are owned by the caller and filled in place.
+//-----------------------------------------------------------------------------
+
+// same layout as iso14a_card_select_t
+typedef struct {
+    uint8_t uid[10];
+    uint8_t uidlen;
+    uint8_t atqa[2];
+    uint8_t sak;
+    uint8_t ats_len;
+    uint8_t ats[256];
+} pm3_hf14a_card_t;
+
+#define PM3_MF_KEY_A        0
+#define PM3_MF_KEY_B        1
+#define PM3_MF_KEY_LEN      6
+#define PM3_MF_BLOCK_LEN    16
+
+// ISO14443-A anticollision and select. The field stays on if <keep_field> is set,
+// use pm3_hf_drop_field() once done.
+// PM3_ECARDEXCHANGE if no card answered
+int pm3_hf14a_select(pm3 *dev, bool keep_field, pm3_hf14a_card_t *card);
+int pm3_hf_drop_field(pm3 *dev);
+
+// MIFARE Classic block read / write, <key> is PM3_MF_KEY_LEN bytes,
+// <data> at least PM3_MF_BLOCK_LEN bytes.
+// PM3_ESOFT if the card refused the authentication or the operation
+int pm3_mf_read_block(pm3 *dev, uint8_t blockno, uint8_t keytype, const uint8_t *key, size_t keylen, uint8_t *data, size_t datalen);
+int pm3_mf_write_block(pm3 *dev, uint8_t blockno, uint8_t keytype, const uint8_t *key, size_t keylen, const uint8_t *data, size_t datalen);
+
+// Try a list of keys, <keys> holds keyslen / PM3_MF_KEY_LEN keys back to back.
+// <found> gets the index of the first valid key, or -1.
+// PM3_ESOFT if none of them is valid
+int pm3_mf_check_keys(pm3 *dev, uint8_t blockno, uint8_t keytype, const uint8_t *keys, size_t keyslen, int *found);
+
+// Acquire <samples> LF samples (0 = as many as the device holds) with the
+// current `lf config` and copy them to <buf>, one unsigned ADC value per byte.
+// <len> gets the number of samples stored, at most <buflen>.
+int pm3_lf_read(pm3 *dev, uint32_t samples, uint8_t *buf, size_t buflen, size_t *len);
+
+// Download the raw tracelog, in the format `trace save` writes.
+// <len> gets the trace length. If it is larger than <buflen>, PM3_EOVFLOW is
+// returned and <buf> is left alone, a call with buflen 0 sizes the real buffer.
+int pm3_trace_download(pm3 *dev, uint8_t *buf, size_t buflen, size_t *len);
 #endif // LIBPM3_H
@@ -0,0 +1,47 @@
+#!/usr/bin/env python3
+
+# Offline checks of the structured API of the pm3 SWIG module.
+# Run it from the client without a device: script run pm3_api_test.py
+
+import os, sys, unittest
+
+# installed, pm3.py sits in pyscripts. In the source tree it lives in client/src
+sys.path += [os.path.join(path, '..', 'src') for path in sys.path if path.rstrip('/').endswith('pyscripts')]
+import pm3
+
+PM3_ENOTTY = -14
+
+class TestPm3Api(unittest.TestCase):
+    def setUp(self):
+        self.p = pm3.pm3()
+        self.key = bytes(pm3.PM3_MF_KEY_LEN)
+
+    def test_hf14a(self):
+        card = pm3.hf14a_card_t()
+        self.assertEqual(self.p.hf14a_select(False, card), PM3_ENOTTY)
+        self.assertEqual(self.p.hf_drop_field(), PM3_ENOTTY)
+
+    def test_mf(self):
+        data = bytearray(pm3.PM3_MF_BLOCK_LEN)
+        self.assertEqual(self.p.mf_read_block(0, pm3.PM3_MF_KEY_A, self.key, data), PM3_ENOTTY)
+        self.assertEqual(self.p.mf_write_block(1, pm3.PM3_MF_KEY_B, self.key, bytes(pm3.PM3_MF_BLOCK_LEN)), PM3_ENOTTY)
+        self.assertEqual(self.p.mf_check_keys(0, pm3.PM3_MF_KEY_A, self.key * 2)[0], PM3_ENOTTY)
+
+    def test_buffers(self):
+        self.assertEqual(self.p.lf_read(1000, bytearray(1000))[0], PM3_ENOTTY)
+        self.assertEqual(self.p.trace_download(memoryview(bytearray(100)))[0], PM3_ENOTTY)
+
+    def test_readonly_buffers(self):
+        with self.assertRaises((TypeError, BufferError)):
+            self.p.mf_read_block(0, pm3.PM3_MF_KEY_A, self.key, bytes(pm3.PM3_MF_BLOCK_LEN))
+        with self.assertRaises((TypeError, BufferError)):
+            self.p.lf_read(1000, bytes(1000))
+        with self.assertRaises((TypeError, BufferError)):
+            self.p.trace_download(memoryview(bytes(100)))
+
+if __name__ == '__main__':
+    if not hasattr(pm3.pm3, 'hf14a_select'):
+        print("pm3 api offline [ skipped ], the wrapper predates the structured API. Rebuild the client with swig installed")
+        sys.exit(0)
+    result = unittest.main(argv=[sys.argv[0]], exit=False).result
+    print("pm3 api offline [", "ok" if result.wasSuccessful() else "fail", "]")
@@ -55,28 +55,6 @@ static int closeAIDFile(json_t *root) {
     return PM3_SUCCESS;
 }
 
-json_t *AIDSearchInit(bool verbose) {
-    json_t *root = NULL;
-    int res = openAIDFile(&root, verbose);
-    if (res != PM3_SUCCESS)
-        return NULL;
-
-    return root;
-}
-
-json_t *AIDSearchGetElm(json_t *root, size_t elmindx) {
-    json_t *data = json_array_get(root, elmindx);
-    if (!json_is_object(data)) {
-        PrintAndLogEx(ERR, "data [%zu] is not an object\n", elmindx);
-        return NULL;
-    }
-    return data;
-}
-
-int AIDSearchFree(json_t *root) {
-    return closeAIDFile(root);
-}
-
 static const char *jsonStrGet(json_t *data, const char *name) {
     json_t *jstr;
 
@@ -94,15 +72,58 @@ static const char *jsonStrGet(json_t *data, const char *name) {
     return cstr;
 }
 
-static bool aidCompare(const char *aidlarge, const char *aidsmall) {
-    if (strcmp(aidlarge, aidsmall) == 0)
-        return true;
+// aidlist.json is loaded once and shared by all searches, aid_index maps an AID
+// to the first record carrying it
+static json_t *aid_root = NULL;
+static json_t *aid_index = NULL;
+static pthread_mutex_t aid_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static json_t *buildAIDIndex(json_t *root) {
+    json_t *aidindex = json_object();
+    if (aidindex == NULL)
+        return NULL;
+
+    for (size_t elmindx = 0; elmindx < json_array_size(root); elmindx++) {
+        json_t *data = json_array_get(root, elmindx);
+        if (!json_is_object(data))
+            continue;
+        const char *dictaid = jsonStrGet(data, "AID");
+        if (dictaid == NULL)
+            continue;
+        if (json_object_get(aidindex, dictaid) == NULL)
+            json_object_set(aidindex, dictaid, data);
+    }
+    return aidindex;
+}
+
+json_t *AIDSearchInit(bool verbose) {
+    pthread_mutex_lock(&aid_lock);
+    if (aid_root == NULL) {
+        json_t *root = NULL;
+        if (openAIDFile(&root, verbose) == PM3_SUCCESS) {
+            aid_root = root;
+            aid_index = buildAIDIndex(root);
+        } else {
+            json_decref(root);
+        }
+    }
+    // every caller gets its own reference to the shared list
+    json_t *root = json_incref(aid_root);
+    pthread_mutex_unlock(&aid_lock);
+    return root;
+}
 
-    if (strlen(aidlarge) > strlen(aidsmall))
-        if (strncmp(aidlarge, aidsmall, strlen(aidsmall)) == 0)
-            return true;
+json_t *AIDSearchGetElm(json_t *root, size_t elmindx) {
+    json_t *data = json_array_get(root, elmindx);
+    if (!json_is_object(data)) {
+        PrintAndLogEx(ERR, "data [%zu] is not an object\n", elmindx);
+        return NULL;
+    }
+    return data;
+}
 
-    return false;
+int AIDSearchFree(json_t *root) {
+    return closeAIDFile(root);
 }
 
 bool AIDGetFromElm(json_t *data, uint8_t *aid, size_t aidmaxlen, int *aidlen) {
@@ -127,19 +148,17 @@ int PrintAIDDescription(json_t *xroot, char *aid, bool verbose) {
     if (root == NULL)
         goto out;
 
+    if (aid == NULL || aid_index == NULL)
+        goto out;
+
+    // longest AID from the list which is a prefix of the requested one
     json_t *elm = NULL;
-    size_t maxaidlen = 0;
-    for (size_t elmindx = 0; elmindx < json_array_size(root); elmindx++) {
-        json_t *data = AIDSearchGetElm(root, elmindx);
-        if (data == NULL)
-            continue;
-        const char *dictaid = jsonStrGet(data, "AID");
-        if (aidCompare(aid, dictaid)) {  // dictaid may be less length than requested aid
-            if (maxaidlen < strlen(dictaid) && strlen(dictaid) <= strlen(aid)) {
-                maxaidlen = strlen(dictaid);
-                elm = data;
-            }
-        }
+    char prefix[128] = {0};
+    size_t aidlen = MIN(strlen(aid), sizeof(prefix) - 1);
+    memcpy(prefix, aid, aidlen);
+    for (size_t len = aidlen; len > 0 && elm == NULL; len--) {
+        prefix[len] = '\0';
+        elm = json_object_get(aid_index, prefix);
     }
 
     if (elm == NULL)
@@ -18,45 +18,97 @@
 #include "atrs.h"
 #include <string.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include "commonutil.h"   // ARRAYLEN
-#include "ui.h" // PrintAndLogEx
+
+// Index over AtrTable, built once on first use. The exact ATRs are sorted for a
+// binary search, the ones with ".." wildcards grouped by length, in reverse table
+// order since the last wildcard match in the table used to win.
+typedef struct {
+    const char *bytes;
+    uint16_t len;
+    uint16_t idx;
+} atr_index_t;
+
+static atr_index_t atr_exact[ARRAYLEN(AtrTable)];
+static atr_index_t atr_wildcard[ARRAYLEN(AtrTable)];
+static size_t atr_exact_cnt = 0;
+static size_t atr_wildcard_cnt = 0;
+static pthread_once_t atr_index_once = PTHREAD_ONCE_INIT;
+
+// length, then bytes, then table order
+static int atr_exact_cmp(const void *a, const void *b) {
+    const atr_index_t *ea = (const atr_index_t *)a;
+    const atr_index_t *eb = (const atr_index_t *)b;
+    if (ea->len != eb->len)
+        return (ea->len < eb->len) ? -1 : 1;
+    int res = memcmp(ea->bytes, eb->bytes, ea->len);
+    if (res)
+        return res;
+    return (ea->idx < eb->idx) ? -1 : (ea->idx > eb->idx);
+}
+
+// length, then reverse table order
+static int atr_wildcard_cmp(const void *a, const void *b) {
+    const atr_index_t *ea = (const atr_index_t *)a;
+    const atr_index_t *eb = (const atr_index_t *)b;
+    if (ea->len != eb->len)
+        return (ea->len < eb->len) ? -1 : 1;
+    return (ea->idx > eb->idx) ? -1 : (ea->idx < eb->idx);
+}
+
+static void atr_index_build(void) {
+    // skip last element of AtrTable
+    for (size_t i = 0; i < ARRAYLEN(AtrTable) - 1; ++i) {
+        atr_index_t e = { AtrTable[i].bytes, (uint16_t)strlen(AtrTable[i].bytes), (uint16_t)i };
+        if (strstr(AtrTable[i].bytes, "..") != NULL)
+            atr_wildcard[atr_wildcard_cnt++] = e;
+        else
+            atr_exact[atr_exact_cnt++] = e;
+    }
+    qsort(atr_exact, atr_exact_cnt, sizeof(atr_index_t), atr_exact_cmp);
+    qsort(atr_wildcard, atr_wildcard_cnt, sizeof(atr_index_t), atr_wildcard_cmp);
+}
+
+// first entry not ordered before <key>
+static size_t atr_lower_bound(const atr_index_t *arr, size_t cnt, const atr_index_t *key, int (*cmp)(const void *, const void *)) {
+    size_t lo = 0, hi = cnt;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (cmp(&arr[mid], key) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
 
 // get a ATR description based on the atr bytes
 // returns description of the best match
 const char *getAtrInfo(const char *atr_str) {
+    pthread_once(&atr_index_once, atr_index_build);
+
     size_t slen = strlen(atr_str);
-    int match = -1;
-    // skip last element of AtrTable
-    for (int i = 0; i < ARRAYLEN(AtrTable) - 1; ++i) {
-
-        if (strlen(AtrTable[i].bytes) != slen)
-            continue;
-
-        if (strstr(AtrTable[i].bytes, "..") != NULL) {
-            char *tmp_atr = calloc(slen, sizeof(uint8_t));
-            if (tmp_atr == NULL) {
-                PrintAndLogEx(FAILED, "failed to allocate memory");
-                return NULL;
-            }
-
-            for (int j = 0; j < slen; j++) {
-                tmp_atr[j] = AtrTable[i].bytes[j] == '.' ? '.' : atr_str[j];
-            }
-
-            if (strncmp(tmp_atr, AtrTable[i].bytes, slen) == 0) {
-                // record partial match but continue looking for full match
-                match = i;
-            }
-            free(tmp_atr);
-
-        } else {
-            if (strncmp(atr_str, AtrTable[i].bytes, slen) == 0) return AtrTable[i].desc;
-        }
-    }
-    if (match >= 0) {
-        return AtrTable[match].desc;
-    } else {
-        //No match, return default = last element of AtrTable
+    if (slen > UINT16_MAX)
         return AtrTable[ARRAYLEN(AtrTable) - 1].desc;
+
+    // exact match, the first one in the table
+    atr_index_t key = { atr_str, (uint16_t)slen, 0 };
+    size_t i = atr_lower_bound(atr_exact, atr_exact_cnt, &key, atr_exact_cmp);
+    if (i < atr_exact_cnt && atr_exact[i].len == slen && memcmp(atr_exact[i].bytes, atr_str, slen) == 0)
+        return AtrTable[atr_exact[i].idx].desc;
+
+    // otherwise the last wildcard pattern in the table which matches
+    key.idx = UINT16_MAX;
+    for (i = atr_lower_bound(atr_wildcard, atr_wildcard_cnt, &key, atr_wildcard_cmp); i < atr_wildcard_cnt && atr_wildcard[i].len == slen; i++) {
+        const char *p = atr_wildcard[i].bytes;
+        size_t j = 0;
+        while (j < slen && (p[j] == '.' || p[j] == atr_str[j]))
+            j++;
+        if (j == slen)
+            return AtrTable[atr_wildcard[i].idx].desc;
     }
+
+    //No match, return default = last element of AtrTable
+    return AtrTable[ARRAYLEN(AtrTable) - 1].desc;
 }
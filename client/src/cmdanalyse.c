@@ -36,6 +36,8 @@
 #include "cliparser.h"
 #include "generator.h"    // generate nuid
 #include "iso14b.h"       // defines for ETU conversions
+#include "util_posix.h"   // msclock
+#include "util.h"         // g_printAndLog
 
 static int CmdHelp(const char *Cmd);
 
@@ -272,23 +274,92 @@ static int CmdAnalyseLCR(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// MB/s of the crc16 table kernels on <len> byte buffers
+static float crc16_bench_run(CrcType_t ct, const uint8_t *d, size_t len, bool slice, uint16_t *crc) {
+    const uint64_t total = 64 * 1024 * 1024;
+    uint16_t c = 0;
+
+    uint64_t t1 = msclock();
+    for (uint64_t done = 0; done < total; done += len) {
+        if (slice)
+            c = crc16_fast(ct, d, len, c, false);
+        else
+            c = crc16_fast_bytewise(ct, d, len, c, false);
+    }
+    uint64_t t2 = msclock() - t1;
+
+    *crc = c;
+    return (float)total / (1024 * 1024) * 1000 / ((t2) ? t2 : 1);
+}
+
+static int crc16_bench(void) {
+    const struct {
+        CrcType_t ct;
+        const char *name;
+    } types[] = {
+        { CRC_14443_A, "CRC-A" },
+        { CRC_15693,   "X-25" },
+        { CRC_ICLASS,  "iCLASS" },
+        { CRC_CCITT,   "CCITT" },
+        { CRC_FELICA,  "FeliCa" },
+    };
+    const size_t sizes[] = { 16, 64 * 1024 };
+
+    uint8_t *d = calloc(sizes[1], sizeof(uint8_t));
+    if (d == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    for (size_t i = 0; i < sizes[1]; i++)
+        d[i] = (i * 0x9E) ^ (i >> 8);
+
+    PrintAndLogEx(INFO, "CRC16 throughput in MB/s");
+    PrintAndLogEx(INFO, "         |     16 byte frames      |    64 KiB buffers");
+    PrintAndLogEx(INFO, "type     | bytewise   slice-by-8   | bytewise   slice-by-8");
+    PrintAndLogEx(INFO, "---------+-------------------------+-------------------------");
+
+    int res = PM3_SUCCESS;
+    for (size_t i = 0; i < ARRAYLEN(types); i++) {
+        float mbs[4];
+        bool ok = true;
+        for (size_t j = 0; j < ARRAYLEN(sizes); j++) {
+            uint16_t c1, c2;
+            mbs[j * 2] = crc16_bench_run(types[i].ct, d, sizes[j], false, &c1);
+            mbs[j * 2 + 1] = crc16_bench_run(types[i].ct, d, sizes[j], true, &c2);
+            ok &= (c1 == c2);
+        }
+        PrintAndLogEx(INFO, "%-8s | %8.0f   %8.0f     | %8.0f   %8.0f     %s"
+                      , types[i].name
+                      , mbs[0], mbs[1], mbs[2], mbs[3]
+                      , (ok) ? "" : _RED_("mismatch")
+                     );
+        if (ok == false)
+            res = PM3_ESOFT;
+    }
+    free(d);
+    return res;
+}
+
 static int CmdAnalyseCRC(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "analyse crc",
                   "A stub method to test different crc implementations inside the PM3 sourcecode.\n"
                   "Just because you figured out the poly, doesn't mean you get the desired output",
-                  "analyse crc -d 137AF00A0A0D"
+                  "analyse crc -d 137AF00A0A0D\n"
+                  "analyse crc --bench             -> CRC16 table kernels throughput"
                  );
 
     void *argtable[] = {
         arg_param_begin,
-        arg_str1("d", "data", "<hex>", "bytes to calc crc"),
+        arg_str0("d", "data", "<hex>", "bytes to calc crc"),
+        arg_lit0(NULL, "bench", "measure the CRC16 throughput"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     int dlen = 0;
     uint8_t data[1024] = {0x00};
     int res = CLIParamHexToBuf(arg_get_str(ctx, 1), data, sizeof(data), &dlen);
+    bool bench = arg_get_lit(ctx, 2);
     CLIParserFree(ctx);
 
     if (res) {
@@ -296,14 +367,21 @@ static int CmdAnalyseCRC(const char *Cmd) {
         return PM3_EINVARG;
     }
 
+    if (bench) {
+        return crc16_bench();
+    }
+
+    if (dlen == 0) {
+        PrintAndLogEx(FAILED, "Missing data, use `-d`");
+        return PM3_EINVARG;
+    }
+
     PrintAndLogEx(INFO, "\nTests with (%d) | %s", dlen, sprint_hex(data, (size_t)dlen));
 
     // 51  f5  7a  d6
     uint8_t uid[] = {0x51, 0xf5, 0x7a, 0xd6}; //12 34 56
-    init_table(CRC_LEGIC);
     uint8_t legic8 = CRC8Legic(uid, sizeof(uid)) & 0xFF;
     PrintAndLogEx(INFO, "Legic 16 | %X (EF6F expected) [legic8 = %02x]", crc16_legic(data, (size_t)dlen, legic8), legic8);
-    init_table(CRC_FELICA);
     PrintAndLogEx(INFO, "FeliCa | %X ", crc16_xmodem(data, (size_t)dlen));
 
     PrintAndLogEx(INFO, "\nTests of reflection. Current methods in source code");
@@ -380,6 +458,116 @@ static int CmdAnalyseCRC(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+typedef struct {
+    int id;
+    uint32_t lines;
+} log_bench_arg_t;
+
+static void *log_bench_thread(void *arg) {
+    const log_bench_arg_t *a = (const log_bench_arg_t *)arg;
+    for (uint32_t i = 0; i < a->lines; i++) {
+        PrintAndLogEx(SUCCESS, "thread " _YELLOW_("%d") " line %u of %u  " _GREEN_("ok") " :white_check_mark:", a->id, i, a->lines);
+    }
+    return NULL;
+}
+
+// lines/s of PrintAndLogEx with <threads> threads printing <lines> lines in total, into a scratch
+// file instead of the console. <queued> is the rate seen by the printing threads, <written> the
+// one until the last line has been written.
+static int log_bench_run(bool async, uint32_t lines, int threads, float *queued, float *written) {
+
+    pthread_t th[16];
+    log_bench_arg_t args[16];
+
+    bool old_async = GetAsyncPrint();
+    uint8_t old_printAndLog = g_printAndLog;
+    SetAsyncPrint(async);
+    if (PrintAndLogEx_scratch(true, NULL) != PM3_SUCCESS) {
+        SetAsyncPrint(old_async);
+        PrintAndLogEx(WARNING, "Failed to create a scratch file");
+        return PM3_EFILE;
+    }
+    // keep the session log clean
+    g_printAndLog = PRINTANDLOG_PRINT;
+
+    uint64_t t1 = msclock();
+    int started = 0;
+    for (int i = 0; i < threads; i++) {
+        args[i].id = i;
+        args[i].lines = lines / threads + ((uint32_t)i < lines % threads);
+        if (pthread_create(&th[i], NULL, log_bench_thread, &args[i]) != 0)
+            break;
+        started++;
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(th[i], NULL);
+    }
+    uint64_t t2 = msclock();
+    PrintAndLogEx_flush();
+    uint64_t t3 = msclock();
+
+    uint32_t count = 0;
+    PrintAndLogEx_scratch(false, &count);
+    g_printAndLog = old_printAndLog;
+    SetAsyncPrint(old_async);
+
+    uint32_t expected = 0;
+    for (int i = 0; i < started; i++) {
+        expected += args[i].lines;
+    }
+
+    *queued = (float)expected * 1000 / ((t2 - t1) ? (t2 - t1) : 1);
+    *written = (float)expected * 1000 / ((t3 - t1) ? (t3 - t1) : 1);
+
+    // every line must have made it
+    if (started != threads || count != expected) {
+        PrintAndLogEx(FAILED, "%s: %u of %u lines written", (async) ? "async" : "sync", count, expected);
+        return PM3_ESOFT;
+    }
+    return PM3_SUCCESS;
+}
+
+static int CmdAnalyseLog(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "analyse log",
+                  "Benchmark of the client output, prints lines from several threads into a scratch file\n"
+                  "with asynchronous printing on and off and reports the lines per second",
+                  "analyse log\n"
+                  "analyse log -n 100000 -t 4      -> 100000 lines from 4 threads"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_u64_0("n", "lines", "<dec>", "number of lines (def 20000)"),
+        arg_int0("t", "threads", "<dec>", "number of printing threads, 1-16 (def 1)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    uint32_t lines = arg_get_u32_def(ctx, 1, 20000);
+    int threads = arg_get_int_def(ctx, 2, 1);
+    CLIParserFree(ctx);
+
+    if (lines == 0 || threads < 1 || threads > 16) {
+        PrintAndLogEx(FAILED, "Expected lines > 0 and 1-16 threads");
+        return PM3_EINVARG;
+    }
+
+    PrintAndLogEx(INFO, "PrintAndLogEx throughput, %u lines from %d thread%s", lines, threads, (threads > 1) ? "s" : "");
+    PrintAndLogEx(INFO, "mode   | queued lines/s | written lines/s");
+    PrintAndLogEx(INFO, "-------+----------------+----------------");
+
+    const bool modes[] = { false, true };
+    int res = PM3_SUCCESS;
+    for (size_t i = 0; i < ARRAYLEN(modes); i++) {
+        float queued = 0, written = 0;
+        int r = log_bench_run(modes[i], lines, threads, &queued, &written);
+        PrintAndLogEx(INFO, "%-6s | %14.0f | %14.0f", (modes[i]) ? "async" : "sync", queued, written);
+        if (r != PM3_SUCCESS)
+            res = r;
+    }
+    return res;
+}
+
 static int CmdAnalyseCHKSUM(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -1162,6 +1350,7 @@ static command_t CommandTable[] = {
     {"freq",    CmdAnalyseFreq,     AlwaysAvailable, "Calc wave lengths"},
     {"foo",     CmdAnalyseFoo,      AlwaysAvailable, "muxer"},
     {"units",   CmdAnalyseUnits,    AlwaysAvailable, "convert ETU <> US <> SSP_CLK (3.39MHz)"},
+    {"log",     CmdAnalyseLog,      AlwaysAvailable, "Client output throughput"},
     {NULL, NULL, NULL, NULL}
 };
 
@@ -36,12 +36,23 @@
 #include "crypto/asn1utils.h"    // ASN1 decode / print
 #include "cmdflashmemspiffs.h"   // SPIFFS flash memory download
 
-uint8_t g_DemodBuffer[MAX_DEMOD_BUF_LEN];
-size_t g_DemodBufferLen = 0;
-int32_t g_DemodStartIdx = 0;
-int g_DemodClock = 0;
+static demod_buf_t s_demod;
+__thread demod_buf_t *g_demod = &s_demod;
+
+// clock detection results of the graph, see demod_cache_begin()
+static struct {
+    bool active;
+    pthread_mutex_t lock;
+    bool fsk_done;
+    uint8_t fc_high;
+    uint8_t fc_low;
+    uint8_t fsk_clk;
+    int fsk_edge;
+    int psk_clk[2];
+} s_demod_cache = { .lock = PTHREAD_MUTEX_INITIALIZER };
 
 static int CmdHelp(const char *Cmd);
+static void setPlotGrid(uint32_t clk, int offset);
 
 // set the g_DemodBuffer with given array ofq binary (one bit per byte)
 void setDemodBuff(const uint8_t *buff, size_t size, size_t start_idx) {
@@ -56,6 +67,91 @@ void setDemodBuff(const uint8_t *buff, size_t size, size_t start_idx) {
     g_DemodBufferLen = size;
 }
 
+// NULL switches the calling thread back to the global demod buffer
+void demod_buf_use(demod_buf_t *buf) {
+    g_demod = (buf) ? buf : &s_demod;
+}
+
+// copy of the global demod buffer, a private buffer starts from here
+void demod_buf_snapshot(demod_buf_t *buf) {
+    memcpy(buf, &s_demod, sizeof(demod_buf_t));
+    buf->grid = false;
+    buf->markers = false;
+}
+
+// make a private buffer the global one and apply the grid / markers it asked for
+void demod_buf_commit(const demod_buf_t *buf) {
+    memcpy(s_demod.buffer, buf->buffer, buf->len);
+    s_demod.len = buf->len;
+    s_demod.start_idx = buf->start_idx;
+    s_demod.clock = buf->clock;
+
+    if (buf->grid)
+        setPlotGrid(buf->clock, buf->start_idx);
+
+    if (buf->markers) {
+        g_CursorCPos = buf->cursor_c;
+        g_CursorDPos = buf->cursor_d;
+    }
+}
+
+static void setGraphMarkers(uint32_t c, uint32_t d) {
+    if (g_demod != &s_demod) {
+        g_demod->markers = true;
+        g_demod->cursor_c = c;
+        g_demod->cursor_d = d;
+        return;
+    }
+    g_CursorCPos = c;
+    g_CursorDPos = d;
+}
+
+void demod_cache_begin(void) {
+    pthread_mutex_lock(&s_demod_cache.lock);
+    s_demod_cache.active = true;
+    s_demod_cache.fsk_done = false;
+    s_demod_cache.psk_clk[0] = 0;
+    s_demod_cache.psk_clk[1] = 0;
+    pthread_mutex_unlock(&s_demod_cache.lock);
+}
+
+void demod_cache_end(void) {
+    pthread_mutex_lock(&s_demod_cache.lock);
+    s_demod_cache.active = false;
+    pthread_mutex_unlock(&s_demod_cache.lock);
+}
+
+// field clocks and bit clock of a FSK signal, from the cache when possible
+static void fskDetectClocks(const uint8_t *bits, size_t size, uint8_t *fc_high, uint8_t *fc_low, uint8_t *clk, int *first_edge) {
+    pthread_mutex_lock(&s_demod_cache.lock);
+    if (s_demod_cache.active && s_demod_cache.fsk_done) {
+        *fc_high = s_demod_cache.fc_high;
+        *fc_low = s_demod_cache.fc_low;
+        *clk = s_demod_cache.fsk_clk;
+        *first_edge = s_demod_cache.fsk_edge;
+        pthread_mutex_unlock(&s_demod_cache.lock);
+        return;
+    }
+    // only one thread detects, the others wait for the result
+    if (s_demod_cache.active == false)
+        pthread_mutex_unlock(&s_demod_cache.lock);
+
+    uint16_t fcs = countFC(bits, size, true);
+    *fc_high = (fcs >> 8) & 0xFF;
+    *fc_low = fcs & 0xFF;
+    *first_edge = 0;
+    *clk = (fcs) ? detectFSKClk((uint8_t *)bits, size, *fc_high, *fc_low, first_edge) : 0;
+
+    if (s_demod_cache.active) {
+        s_demod_cache.fc_high = *fc_high;
+        s_demod_cache.fc_low = *fc_low;
+        s_demod_cache.fsk_clk = *clk;
+        s_demod_cache.fsk_edge = *first_edge;
+        s_demod_cache.fsk_done = true;
+        pthread_mutex_unlock(&s_demod_cache.lock);
+    }
+}
+
 bool getDemodBuff(uint8_t *buff, size_t *size) {
     if (buff == NULL) return false;
     if (size == NULL) return false;
@@ -101,7 +197,7 @@ static double median_uint8(uint8_t *src, size_t size) {
 }
 */
 // function to compute mean for a series
-static double compute_mean(const int *data, size_t n) {
+static double compute_mean(const int16_t *data, size_t n) {
     double mean = 0.0;
     for (size_t i = 0; i < n; i++)
         mean += data[i];
@@ -110,7 +206,7 @@ static double compute_mean(const int *data, size_t n) {
 }
 
 //  function to compute variance for a series
-static double compute_variance(const int *data, size_t n) {
+static double compute_variance(const int16_t *data, size_t n) {
     double variance = 0.0;
     double mean = compute_mean(data, n);
 
@@ -422,8 +518,7 @@ int ASKDemod_ext(int clk, int invert, int maxErr, size_t maxlen, bool amplify, b
 
     if (st) {
         *stCheck = st;
-        g_CursorCPos = ststart;
-        g_CursorDPos = stend;
+        setGraphMarkers(ststart, stend);
         if (verbose)
             PrintAndLogEx(DEBUG, "Found Sequence Terminator - First one is shown by orange / blue graph markers");
     }
@@ -780,7 +875,7 @@ static int Cmdaskrawdemod(const char *Cmd) {
     return ASKDemod_ext(clk, invert, max_err, max_len, amplify, true, false, 0, &st);
 }
 
-int AutoCorrelate(const int *in, int *out, size_t len, size_t window, bool SaveGrph, bool verbose) {
+int AutoCorrelate(const int16_t *in, int16_t *out, size_t len, size_t window, bool SaveGrph, bool verbose) {
     // sanity check
     if (window > len) window = len;
 
@@ -796,7 +891,12 @@ int AutoCorrelate(const int *in, int *out, size_t len, size_t window, bool SaveG
     // Computed variance
     double variance = compute_variance(in, len);
 
-    int *correl_buf = calloc(MAX_GRAPH_TRACE_LEN, sizeof(int));
+    // correlation values end up in the demod channel
+    if (graph_reserve(GRAPH_DEMOD, len + 1) == false) {
+        return -1;
+    }
+    int16_t *correl_buf = graph_channel(GRAPH_DEMOD);
+    memset(correl_buf, 0, (len + 1) * sizeof(int16_t));
 
     for (size_t i = 0; i < len - window; ++i) {
 
@@ -805,7 +905,7 @@ int AutoCorrelate(const int *in, int *out, size_t len, size_t window, bool SaveG
         }
         autocv = (1.0 / (len - i)) * autocv;
 
-        correl_buf[i] = autocv;
+        correl_buf[i] = GRAPH_CLAMP(autocv);
 
         // Computed autocorrelation value to be returned
         // Autocorrelation is autocovariance divided by variance
@@ -850,7 +950,7 @@ int AutoCorrelate(const int *in, int *out, size_t len, size_t window, bool SaveG
     int retval = correlation;
     if (SaveGrph) {
         //g_GraphTraceLen = g_GraphTraceLen - window;
-        memcpy(out, correl_buf, len * sizeof(int));
+        memcpy(out, correl_buf, len * sizeof(int16_t));
         if (distance > 0) {
             setClockGrid(distance, idx);
             retval = distance;
@@ -862,7 +962,6 @@ int AutoCorrelate(const int *in, int *out, size_t len, size_t window, bool SaveG
         g_DemodBufferLen = 0;
         RepaintGraphWindow();
     }
-    free(correl_buf);
     return retval;
 }
 
@@ -924,6 +1023,10 @@ static int CmdBitsamples(const char *Cmd) {
         return PM3_ETIMEOUT;
     }
 
+    if (graph_reserve(GRAPH_RAW, ARRAYLEN(got) * 8) == false) {
+        return PM3_EMALLOC;
+    }
+
     for (size_t j = 0; j < ARRAYLEN(got); j++) {
         for (uint8_t k = 0; k < 8; k++) {
             if (got[j] & (1 << (7 - k)))
@@ -1006,23 +1109,29 @@ static int CmdUndecimate(const char *Cmd) {
     int factor = arg_get_int_def(ctx, 1, 2);
     CLIParserFree(ctx);
 
-    //We have memory, don't we?
-    int swap[MAX_GRAPH_TRACE_LEN] = {0};
-    uint32_t g_index = 0, s_index = 0;
-    while (g_index < g_GraphTraceLen && s_index + factor < MAX_GRAPH_TRACE_LEN) {
-        int count = 0;
-        for (count = 0; count < factor && s_index + count < MAX_GRAPH_TRACE_LEN; count++) {
-            swap[s_index + count] = (
-                                        (double)(factor - count) / (factor - 1)) * g_GraphBuffer[g_index] +
-                                    ((double)count / factor) * g_GraphBuffer[g_index + 1]
-                                    ;
+    if (factor < 2) {
+        return PM3_SUCCESS;
+    }
+
+    // samples are spread out backwards so the graph can be upsampled in place
+    size_t newlen = g_GraphTraceLen * factor;
+    if (graph_reserve(GRAPH_RAW, newlen) == false) {
+        return PM3_EMALLOC;
+    }
+
+    uint32_t s_index = newlen;
+    for (size_t g_index = g_GraphTraceLen; g_index-- > 0;) {
+        int cur = g_GraphBuffer[g_index];
+        int next = (g_index + 1 < g_GraphTraceLen) ? g_GraphBuffer[g_index + 1] : 0;
+        for (int count = factor - 1; count >= 0; count--) {
+            g_GraphBuffer[--s_index] = GRAPH_CLAMP(
+                                           ((double)(factor - count) / (factor - 1)) * cur +
+                                           ((double)count / factor) * next
+                                       );
         }
-        s_index += count;
-        g_index++;
     }
 
-    memcpy(g_GraphBuffer, swap, s_index * sizeof(int));
-    g_GraphTraceLen = s_index;
+    g_GraphTraceLen = newlen;
     RepaintGraphWindow();
     return PM3_SUCCESS;
 }
@@ -1058,7 +1167,7 @@ static int CmdGraphShiftZero(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
-int AskEdgeDetect(const int *in, int *out, int len, int threshold) {
+int AskEdgeDetect(const int16_t *in, int16_t *out, int len, int threshold) {
     int last = 0;
     for (int i = 1; i < len; i++) {
         if (in[i] - in[i - 1] >= threshold) //large jump up
@@ -1146,7 +1255,7 @@ static int CmdDetectClockRate(const char *Cmd) {
 }
 
 static char *GetFSKType(uint8_t fchigh, uint8_t fclow, uint8_t invert) {
-    static char fType[8];
+    static __thread char fType[8];
     memset(fType, 0x00, 8);
     char *fskType = fType;
 
@@ -1197,13 +1306,15 @@ int FSKrawDemod(uint8_t rfLen, uint8_t invert, uint8_t fchigh, uint8_t fclow, bo
 
     //get field clock lengths
     if (!fchigh || !fclow) {
-        uint16_t fcs = countFC(bits, bitlen, true);
-        if (!fcs) {
+        uint8_t clk = 0;
+        int firstClockEdge = 0; //todo - align grid on graph with this...
+        fskDetectClocks(bits, bitlen, &fchigh, &fclow, &clk, &firstClockEdge);
+        if (!fchigh && !fclow) {
             fchigh = 10;
             fclow = 8;
-        } else {
-            fchigh = (fcs >> 8) & 0x00FF;
-            fclow = fcs & 0x00FF;
+        } else if (!rfLen) {
+            // bit clock was measured with these field clocks already
+            rfLen = clk;
         }
     }
     //get bit clock length
@@ -1296,8 +1407,26 @@ int PSKDemod(int clk, int invert, int maxErr, bool verbose) {
         return PM3_ESOFT;
     }
 
+    // the bit clock search only depends on the graph and the phase we start from
+    bool cache_clk = false;
+    if (clk == 0 && (invert == 0 || invert == 1)) {
+        pthread_mutex_lock(&s_demod_cache.lock);
+        if (s_demod_cache.active) {
+            clk = s_demod_cache.psk_clk[invert];
+            cache_clk = (clk == 0);
+        }
+        pthread_mutex_unlock(&s_demod_cache.lock);
+    }
+
     int startIdx = 0;
     int errCnt = pskRawDemod_ext(bits, &bitlen, &clk, &invert, &startIdx);
+
+    if (cache_clk && clk > 0) {
+        pthread_mutex_lock(&s_demod_cache.lock);
+        if (s_demod_cache.active)
+            s_demod_cache.psk_clk[invert] = clk;
+        pthread_mutex_unlock(&s_demod_cache.lock);
+    }
     if (errCnt > maxErr) {
         if (g_debugMode || verbose) PrintAndLogEx(DEBUG, "DEBUG: (PSKdemod) Too many errors found, clk: %d, invert: %d, numbits: %zu, errCnt: %d", clk, invert, bitlen, errCnt);
         free(bits);
@@ -1563,6 +1692,15 @@ void setClockGrid(uint32_t clk, int offset) {
     else
         PrintAndLogEx(DEBUG, "DEBUG: (setClockGrid) demodoffset %d, clk %d", offset, clk);
 
+    // the plot follows the global demod buffer, applied on demod_buf_commit()
+    if (g_demod != &s_demod) {
+        g_demod->grid = true;
+        return;
+    }
+    setPlotGrid(clk, offset);
+}
+
+static void setPlotGrid(uint32_t clk, int offset) {
     if (offset > clk) offset %= clk;
     if (offset < 0) offset += clk;
 
@@ -1704,13 +1842,18 @@ int CmdHpf(const char *Cmd) {
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     CLIParserFree(ctx);
 
-    uint8_t bits[g_GraphTraceLen];
-    size_t size = getFromGraphBuf(bits);
+    uint8_t *bits = calloc(g_GraphTraceLen, sizeof(uint8_t));
+    if (bits == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    size_t size = getFromGraphBufEx(bits, g_GraphTraceLen);
     removeSignalOffset(bits, size);
     // push it back to graph
     setGraphBuf(bits, size);
     // set signal properties low/high/mean/amplitude and is_noise detection
-    computeSignalProperties(bits, size);
+    computeSignalProperties(bits, MIN(size, MAX_GRAPH_TRACE_LEN));
+    free(bits);
 
     RepaintGraphWindow();
     return PM3_SUCCESS;
@@ -1773,6 +1916,10 @@ int getSamplesEx(uint32_t start, uint32_t end, bool verbose, bool ignore_lf_conf
         bits_per_sample = sc->bits_per_sample;
     }
 
+    if (graph_reserve(GRAPH_RAW, n) == false) {
+        return PM3_EMALLOC;
+    }
+
     if (bits_per_sample < 8) {
 
         if (verbose) PrintAndLogEx(INFO, "Unpacking...");
@@ -1794,7 +1941,7 @@ int getSamplesEx(uint32_t start, uint32_t end, bool verbose, bool ignore_lf_conf
         g_GraphTraceLen = n;
     }
 
-    uint8_t bits[g_GraphTraceLen];
+    uint8_t bits[MIN(g_GraphTraceLen, MAX_GRAPH_TRACE_LEN)];
     size_t size = getFromGraphBuf(bits);
     // set signal properties low/high/mean/amplitude and is_noise detection
     computeSignalProperties(bits, size);
@@ -2021,6 +2168,45 @@ int CmdTuneSamples(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// read a pm3 sample file into the graph, remove the offset and set the signal properties
+int loadSamplesFromFile(const char *path, bool verbose) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        PrintAndLogEx(WARNING, "couldn't open '%s'", path);
+        return PM3_EFILE;
+    }
+
+    g_GraphTraceLen = 0;
+    char line[80];
+    while (fgets(line, sizeof(line), f)) {
+        // graph grows with the file, no more truncated long sniffs
+        if (graph_reserve(GRAPH_RAW, g_GraphTraceLen + 1) == false)
+            break;
+
+        int v = atoi(line);
+        g_GraphBuffer[g_GraphTraceLen] = GRAPH_CLAMP(v);
+        g_GraphTraceLen++;
+    }
+    fclose(f);
+
+    if (verbose) {
+        PrintAndLogEx(SUCCESS, "loaded " _YELLOW_("%zu") " samples", g_GraphTraceLen);
+    }
+
+    uint8_t *bits = calloc(g_GraphTraceLen + 1, sizeof(uint8_t));
+    if (bits == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    size_t size = getFromGraphBufEx(bits, g_GraphTraceLen);
+
+    removeSignalOffset(bits, size);
+    setGraphBuf(bits, size);
+    computeSignalProperties(bits, MIN(size, MAX_GRAPH_TRACE_LEN));
+    free(bits);
+    return PM3_SUCCESS;
+}
+
 static int CmdLoad(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -2048,33 +2234,11 @@ static int CmdLoad(const char *Cmd) {
         }
     }
 
-    FILE *f = fopen(path, "r");
-    if (!f) {
-        PrintAndLogEx(WARNING, "couldn't open '%s'", path);
-        free(path);
-        return PM3_EFILE;
-    }
+    int res = loadSamplesFromFile(path, true);
     free(path);
-
-    g_GraphTraceLen = 0;
-    char line[80];
-    while (fgets(line, sizeof(line), f)) {
-        g_GraphBuffer[g_GraphTraceLen] = atoi(line);
-        g_GraphTraceLen++;
-
-        if (g_GraphTraceLen >= MAX_GRAPH_TRACE_LEN)
-            break;
+    if (res != PM3_SUCCESS) {
+        return res;
     }
-    fclose(f);
-
-    PrintAndLogEx(SUCCESS, "loaded " _YELLOW_("%zu") " samples", g_GraphTraceLen);
-
-    uint8_t bits[g_GraphTraceLen];
-    size_t size = getFromGraphBuf(bits);
-
-    removeSignalOffset(bits, size);
-    setGraphBuf(bits, size);
-    computeSignalProperties(bits, size);
 
     setClockGrid(0, 0);
     g_DemodBufferLen = 0;
@@ -2205,7 +2369,7 @@ int CmdNorm(const char *Cmd) {
         }
     }
 
-    uint8_t bits[g_GraphTraceLen];
+    uint8_t bits[MIN(g_GraphTraceLen, MAX_GRAPH_TRACE_LEN)];
     size_t size = getFromGraphBuf(bits);
     // set signal properties low/high/mean/amplitude and is_noise detection
     computeSignalProperties(bits, size);
@@ -2296,7 +2460,7 @@ static int CmdTimeScale(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
-int directionalThreshold(const int *in, int *out, size_t len, int8_t up, int8_t down) {
+int directionalThreshold(const int16_t *in, int16_t *out, size_t len, int8_t up, int8_t down) {
 
     int lastValue = in[0];
 
@@ -2347,7 +2511,7 @@ static int CmdDirectionalThreshold(const char *Cmd) {
     directionalThreshold(g_GraphBuffer, g_GraphBuffer, g_GraphTraceLen, up, down);
 
     // set signal properties low/high/mean/amplitude and isnoice detection
-    uint8_t bits[g_GraphTraceLen];
+    uint8_t bits[MIN(g_GraphTraceLen, MAX_GRAPH_TRACE_LEN)];
     size_t size = getFromGraphBuf(bits);
     // set signal properties low/high/mean/amplitude and is_noice detection
     computeSignalProperties(bits, size);
@@ -2378,11 +2542,11 @@ static int CmdZerocrossings(const char *Cmd) {
         if (g_GraphBuffer[i] * sign >= 0) {
             // No change in sign, reproduce the previous sample count.
             zc++;
-            g_GraphBuffer[i] = lastZc;
+            g_GraphBuffer[i] = GRAPH_CLAMP(lastZc);
         } else {
             // Change in sign, reset the sample count.
             sign = -sign;
-            g_GraphBuffer[i] = lastZc;
+            g_GraphBuffer[i] = GRAPH_CLAMP(lastZc);
             if (sign > 0) {
                 lastZc = zc;
                 zc = 0;
@@ -2390,7 +2554,7 @@ static int CmdZerocrossings(const char *Cmd) {
         }
     }
 
-    uint8_t bits[g_GraphTraceLen];
+    uint8_t bits[MIN(g_GraphTraceLen, MAX_GRAPH_TRACE_LEN)];
     size_t size = getFromGraphBuf(bits);
     // set signal properties low/high/mean/amplitude and is_noise detection
     computeSignalProperties(bits, size);
@@ -2585,7 +2749,7 @@ static void GetHiLoTone(int *LowTone, int *HighTone, int clk, int LowToneFC, int
 
 //old CmdFSKdemod adapted by marshmellow
 //converts FSK to clear NRZ style wave.  (or demodulates)
-static int FSKToNRZ(int *data, size_t *dataLen, uint8_t clk, uint8_t LowToneFC, uint8_t HighToneFC) {
+static int FSKToNRZ(int16_t *data, size_t *dataLen, uint8_t clk, uint8_t LowToneFC, uint8_t HighToneFC) {
     uint8_t ans = 0;
     if (clk == 0 || LowToneFC == 0 || HighToneFC == 0) {
         int firstClockEdge = 0;
@@ -2606,6 +2770,12 @@ static int FSKToNRZ(int *data, size_t *dataLen, uint8_t clk, uint8_t LowToneFC,
     int HighTone[clk];
     GetHiLoTone(LowTone, HighTone, clk, LowToneFC, HighToneFC);
 
+    // low tone averages go to the demod channel, high tone averages overwrite the samples
+    if (graph_reserve(GRAPH_DEMOD, *dataLen) == false) {
+        return PM3_EMALLOC;
+    }
+    int16_t *low = graph_channel(GRAPH_DEMOD);
+
     // loop through ([all samples] - clk)
     for (size_t i = 0; i < *dataLen - clk; ++i) {
         int lowSum = 0, highSum = 0;
@@ -2619,7 +2789,8 @@ static int FSKToNRZ(int *data, size_t *dataLen, uint8_t clk, uint8_t LowToneFC,
         lowSum = abs(100 * lowSum / clk);
         highSum = abs(100 * highSum / clk);
         // save these back to buffer for later use
-        data[i] = (highSum << 16) | lowSum;
+        low[i] = GRAPH_CLAMP(lowSum);
+        data[i] = GRAPH_CLAMP(highSum);
     }
 
     // now we have the abs( [average sample value per clk] * 100 ) for each tone
@@ -2630,15 +2801,16 @@ static int FSKToNRZ(int *data, size_t *dataLen, uint8_t clk, uint8_t LowToneFC,
 
         // sum a field clock width of abs( [average sample values per clk] * 100) for each tone
         for (size_t j = 0; j < LowToneFC; ++j) {  //10 for fsk2
-            lowTot += (data[i + j] & 0xffff);
+            lowTot += low[i + j];
         }
         for (size_t j = 0; j < HighToneFC; j++) {  //8 for fsk2
-            highTot += (data[i + j] >> 16);
+            highTot += data[i + j];
         }
 
         // subtract the sum of lowTone averages by the sum of highTone averages as it
-        //   and write back the new graph value
-        data[i] = lowTot - highTot;
+        //   and write back the new graph value, scaled down by the field clock to fit a sample.
+        //   CmdNorm rescales the result anyway
+        data[i] = GRAPH_CLAMP((lowTot - highTot) / LowToneFC);
     }
     // update dataLen to what we put back to the data sample buffer
     *dataLen -= (clk + LowToneFC);
@@ -2694,7 +2866,7 @@ static int CmdDataIIR(const char *Cmd) {
 
     iceSimple_Filter(g_GraphBuffer, g_GraphTraceLen, k);
 
-    uint8_t bits[g_GraphTraceLen];
+    uint8_t bits[MIN(g_GraphTraceLen, MAX_GRAPH_TRACE_LEN)];
     size_t size = getFromGraphBuf(bits);
     // set signal properties low/high/mean/amplitude and is_noise detection
     computeSignalProperties(bits, size);
@@ -82,21 +82,49 @@ int printDemodBuff(uint8_t offset, bool strip_leading, bool invert, bool print_h
 void setDemodBuff(const uint8_t *buff, size_t size, size_t start_idx);
 bool getDemodBuff(uint8_t *buff, size_t *size);
 void save_restoreDB(uint8_t saveOpt);// option '1' to save g_DemodBuffer any other to restore
-int AutoCorrelate(const int *in, int *out, size_t len, size_t window, bool SaveGrph, bool verbose);
+int AutoCorrelate(const int16_t *in, int16_t *out, size_t len, size_t window, bool SaveGrph, bool verbose);
 
 int getSamples(uint32_t n, bool verbose);
 int getSamplesEx(uint32_t start, uint32_t end, bool verbose, bool ignore_lf_config);
+int loadSamplesFromFile(const char *path, bool verbose);
 
 void setClockGrid(uint32_t clk, int offset);
-int directionalThreshold(const int *in, int *out, size_t len, int8_t up, int8_t down);
-int AskEdgeDetect(const int *in, int *out, int len, int threshold);
+int directionalThreshold(const int16_t *in, int16_t *out, size_t len, int8_t up, int8_t down);
+int AskEdgeDetect(const int16_t *in, int16_t *out, int len, int threshold);
 
 #define MAX_DEMOD_BUF_LEN (1024*128)
-extern uint8_t g_DemodBuffer[MAX_DEMOD_BUF_LEN];
-extern size_t g_DemodBufferLen;
 
-extern int g_DemodClock;
-extern int32_t g_DemodStartIdx;
+// Output of a demodulation.
+// g_DemodBuffer & co resolve through the calling thread's g_demod, which is the
+// global buffer unless the thread switched to a private one with demod_buf_use().
+// lf search does that to run demodulators in parallel on the same graph.
+typedef struct {
+    uint8_t buffer[MAX_DEMOD_BUF_LEN];
+    size_t len;
+    int32_t start_idx;
+    int clock;
+    // graph grid / markers requested while running on a private buffer
+    bool grid;
+    bool markers;
+    uint32_t cursor_c;
+    uint32_t cursor_d;
+} demod_buf_t;
+
+extern __thread demod_buf_t *g_demod;
+
+#define g_DemodBuffer       (g_demod->buffer)
+#define g_DemodBufferLen    (g_demod->len)
+#define g_DemodClock        (g_demod->clock)
+#define g_DemodStartIdx     (g_demod->start_idx)
+
+void demod_buf_use(demod_buf_t *buf);
+void demod_buf_snapshot(demod_buf_t *buf);
+void demod_buf_commit(const demod_buf_t *buf);
+
+// Clock detection results reused by every demodulator while the graph doesn't
+// change, only between demod_cache_begin() and demod_cache_end().
+void demod_cache_begin(void);
+void demod_cache_end(void);
 
 #ifdef __cplusplus
 }
@@ -67,18 +67,15 @@ static uint8_t iClass_Key_Table[ICLASS_KEYS_MAX][8] = {
     { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }
 };
 
-static int cmp_uint32(const void *a, const void *b) {
-
-    const iclass_prekey_t *x = (const iclass_prekey_t *)a;
-    const iclass_prekey_t *y = (const iclass_prekey_t *)b;
-
-    uint32_t mx = bytes_to_num((uint8_t *)x->mac, 4);
-    uint32_t my = bytes_to_num((uint8_t *)y->mac, 4);
-
-    if (mx < my)
-        return -1;
-    else
-        return mx > my;
+// one pass over the precalculated list, there is a single MAC to match so
+// sorting it first only costs time. <from> continues after a previous hit.
+static const iclass_prekey_t *find_mac(const iclass_prekey_t *list, uint32_t itemcnt, const uint8_t *mac, const iclass_prekey_t *from) {
+    uint32_t i = (from) ? (from - list) + 1 : 0;
+    for (; i < itemcnt; i++) {
+        if (memcmp(list[i].mac, mac, 4) == 0)
+            return &list[i];
+    }
+    return NULL;
 }
 
 bool check_known_default(uint8_t *csn, uint8_t *epurse, uint8_t *rmac, uint8_t *tmac, uint8_t *key) {
@@ -93,17 +90,14 @@ bool check_known_default(uint8_t *csn, uint8_t *epurse, uint8_t *rmac, uint8_t *
     memcpy(ccnr + 8, rmac, 4);
 
     GenerateMacKeyFrom(csn, ccnr, false, false, (uint8_t *)iClass_Key_Table, ICLASS_KEYS_MAX, prekey);
-    qsort(prekey, ICLASS_KEYS_MAX, sizeof(iclass_prekey_t), cmp_uint32);
-
-    iclass_prekey_t lookup;
-    memcpy(lookup.mac, tmac, 4);
 
-    // binsearch
-    iclass_prekey_t *item = (iclass_prekey_t *) bsearch(&lookup, prekey, ICLASS_KEYS_MAX, sizeof(iclass_prekey_t), cmp_uint32);
+    const iclass_prekey_t *item = find_mac(prekey, ICLASS_KEYS_MAX, tmac, NULL);
     if (item != NULL) {
         memcpy(key, item->key, 8);
+        free(prekey);
         return true;
     }
+    free(prekey);
     return false;
 }
 
@@ -3368,22 +3362,13 @@ static int CmdHFiClassLookUp(const char *Cmd) {
     if (use_raw)
         PrintAndLogEx(INFO, "Using " _YELLOW_("raw mode"));
 
-    PrintAndLogEx(INFO, "Sorting...");
-
-    // sort mac list.
-    qsort(prekey, keycount, sizeof(iclass_prekey_t), cmp_uint32);
-
     PrintAndLogEx(SUCCESS, "Searching for " _YELLOW_("%s") " key...", "DEBIT");
-    iclass_prekey_t *item;
-    iclass_prekey_t lookup;
-    memcpy(lookup.mac, MAC_TAG, 4);
 
-    // binsearch
-    item = (iclass_prekey_t *) bsearch(&lookup, prekey, keycount, sizeof(iclass_prekey_t), cmp_uint32);
-
-    if (item != NULL) {
+    // MACs are 32 bits, big dictionaries can hold more than one key matching it
+    const iclass_prekey_t *item = NULL;
+    while ((item = find_mac(prekey, keycount, MAC_TAG, item)) != NULL) {
         PrintAndLogEx(SUCCESS, "Found valid key " _GREEN_("%s"), sprint_hex(item->key, 8));
-        add_key(item->key);
+        add_key((uint8_t *)item->key);
     }
 
     t1 = msclock() - t1;
@@ -3411,7 +3396,21 @@ typedef struct {
 
 static size_t iclass_tc = 1;
 
-static pthread_mutex_t generator_mutex = PTHREAD_MUTEX_INITIALIZER;
+// keys per bitsliced MAC pass
+#define ICLASS_MAC_BLOCK 64
+
+// diversify a block of keys and MAC them with the bitsliced engine
+static void iclass_mac_block(uint8_t *csn, const uint8_t *cc_nr, bool use_raw, bool use_elite, uint8_t *keys, uint32_t n, uint8_t *macs) {
+    uint8_t div_keys[ICLASS_MAC_BLOCK * 8];
+    for (uint32_t i = 0; i < n; i++) {
+        if (use_raw)
+            memcpy(div_keys + i * 8, keys + i * 8, 8);
+        else
+            HFiClassCalcDivKey(csn, keys + i * 8, div_keys + i * 8, use_elite);
+    }
+    doMAC_multi(cc_nr, div_keys, n, macs);
+}
+
 static void *bf_generate_mac(void *thread_arg) {
 
     iclass_thread_arg_t *targ = (iclass_thread_arg_t *)thread_arg;
@@ -3428,21 +3427,16 @@ static void *bf_generate_mac(void *thread_arg) {
     memcpy(csn, targ->csn, sizeof(csn));
     memcpy(cc_nr, targ->cc_nr, sizeof(cc_nr));
 
-    uint8_t key[8] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-    uint8_t div_key[8] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+    uint8_t macs[ICLASS_MAC_BLOCK * 4];
 
-    for (uint32_t i = idx; i < keycnt; i += iclass_tc) {
+    // threads take interleaved blocks of keys
+    for (uint32_t i = idx * ICLASS_MAC_BLOCK; i < keycnt; i += iclass_tc * ICLASS_MAC_BLOCK) {
 
-        memcpy(key, keys + 8 * i, 8);
+        uint32_t n = MIN(ICLASS_MAC_BLOCK, keycnt - i);
+        iclass_mac_block(csn, cc_nr, use_raw, use_elite, keys + 8 * i, n, macs);
 
-        pthread_mutex_lock(&generator_mutex);
-        if (use_raw)
-            memcpy(div_key, key, 8);
-        else
-            HFiClassCalcDivKey(csn, key, div_key, use_elite);
-
-        doMAC(cc_nr, div_key, list[i].mac);
-        pthread_mutex_unlock(&generator_mutex);
+        for (uint32_t j = 0; j < n; j++)
+            memcpy(list[i + j].mac, macs + j * 4, 4);
     }
     return NULL;
 }
@@ -3450,8 +3444,6 @@ static void *bf_generate_mac(void *thread_arg) {
 // precalc diversified keys and their MAC
 void GenerateMacFrom(uint8_t *CSN, uint8_t *CCNR, bool use_raw, bool use_elite, uint8_t *keys, uint32_t keycnt, iclass_premac_t *list) {
 
-    pthread_mutex_init(&generator_mutex, NULL);
-
     iclass_tc = num_CPUs();
     pthread_t threads[iclass_tc];
     iclass_thread_arg_t args[iclass_tc];
@@ -3497,27 +3489,23 @@ static void *bf_generate_mackey(void *thread_arg) {
     memcpy(csn, targ->csn, sizeof(csn));
     memcpy(cc_nr, targ->cc_nr, sizeof(cc_nr));
 
-    uint8_t div_key[8] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-
-    for (uint32_t i = idx; i < keycnt; i += iclass_tc) {
+    uint8_t macs[ICLASS_MAC_BLOCK * 4];
 
-        memcpy(list[i].key, keys + 8 * i, 8);
+    for (uint32_t i = idx * ICLASS_MAC_BLOCK; i < keycnt; i += iclass_tc * ICLASS_MAC_BLOCK) {
 
-        pthread_mutex_lock(&generator_mutex);
-        if (use_raw)
-            memcpy(div_key, list[i].key, 8);
-        else
-            HFiClassCalcDivKey(csn, list[i].key, div_key, use_elite);
+        uint32_t n = MIN(ICLASS_MAC_BLOCK, keycnt - i);
+        iclass_mac_block(csn, cc_nr, use_raw, use_elite, keys + 8 * i, n, macs);
 
-        doMAC(cc_nr, div_key, list[i].mac);
-        pthread_mutex_unlock(&generator_mutex);
+        for (uint32_t j = 0; j < n; j++) {
+            memcpy(list[i + j].key, keys + 8 * (i + j), 8);
+            memcpy(list[i + j].mac, macs + j * 4, 4);
+        }
     }
     return NULL;
 }
 
 void GenerateMacKeyFrom(uint8_t *CSN, uint8_t *CCNR, bool use_raw, bool use_elite, uint8_t *keys, uint32_t keycnt, iclass_prekey_t *list) {
 
-    pthread_mutex_init(&generator_mutex, NULL);
     iclass_tc = num_CPUs();
     pthread_t threads[iclass_tc];
     iclass_thread_arg_t args[iclass_tc];
@@ -35,6 +35,7 @@
 #include "crapto1/crapto1.h"    // prng_successor
 #include "cmdhf14a.h"           // exchange APDU
 #include "crypto/libpcrypto.h"
+#include "mifare/mifaretest.h"
 
 #define MFBLOCK_SIZE 16
 
@@ -1397,6 +1398,9 @@ static int CmdHF14AMfNested(const char *Cmd) { //TODO: single mode broken? can't
             case PM3_EFAILED:
                 PrintAndLogEx(FAILED, "Tag isn't vulnerable to Nested Attack (PRNG is not predictable).\n");
                 break;
+            case PM3_EMALLOC:
+                PrintAndLogEx(ERR, "Out of memory. Key candidates were not checked.\n");
+                break;
             case PM3_ESOFT:
                 PrintAndLogEx(FAILED, "No valid key found");
                 break;
@@ -1476,6 +1480,9 @@ static int CmdHF14AMfNested(const char *Cmd) { //TODO: single mode broken? can't
                         case PM3_EFAILED :
                             PrintAndLogEx(FAILED, "Tag isn't vulnerable to Nested Attack (PRNG is not predictable).\n");
                             break;
+                        case PM3_EMALLOC:
+                            PrintAndLogEx(ERR, "Out of memory. Key candidates were not checked.\n");
+                            break;
                         case PM3_ESOFT:
                             //key not found
                             calibrate = false;
@@ -1843,6 +1850,8 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
                   "hf mf hardnested --blk 0 -a -k FFFFFFFFFFFF --tblk 4 --ta -f nonces.bin -w -s\n"
                   "hf mf hardnested -r\n"
                   "hf mf hardnested -r --tk a0a1a2a3a4a5\n"
+                  "hf mf hardnested -r --threads 16\n"
+                  "hf mf hardnested --simd\n"
                   "hf mf hardnested -t --tk a0a1a2a3a4a5\n"
                   "hf mf hardnested --blk 0 -a -k a0a1a2a3a4a5 --tblk 4 --ta --tk FFFFFFFFFFFF"
                  );
@@ -1863,6 +1872,8 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
         arg_lit0("s",  "slow",           "Slower acquisition (required by some non standard cards)"),
         arg_lit0("t",  "tests",          "Run tests"),
         arg_lit0("w",  "wr",             "Acquire nonces and UID, and write them to file `hf-mf-<UID>-nonces.bin`"),
+        arg_int0(NULL, "threads", "<dec>", "Number of worker threads, 0 = number of logical CPUs (def: 0)"),
+        arg_lit0(NULL, "simd",  "Benchmark brute force speed of all available SIMD instruction sets"),
 
         arg_lit0(NULL, "in", "None (use CPU regular instruction set)"),
 #if defined(COMPILER_HAS_SIMD_X86)
@@ -1923,22 +1934,34 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
     bool slow = arg_get_lit(ctx, 12);
     bool tests = arg_get_lit(ctx, 13);
     bool nonce_file_write = arg_get_lit(ctx, 14);
+    int num_threads = arg_get_int_def(ctx, 15, 0);
+    bool simd_bench = arg_get_lit(ctx, 16);
 
-    bool in = arg_get_lit(ctx, 15);
+    bool in = arg_get_lit(ctx, 17);
 #if defined(COMPILER_HAS_SIMD_X86)
-    bool im = arg_get_lit(ctx, 16);
-    bool is = arg_get_lit(ctx, 17);
-    bool ia = arg_get_lit(ctx, 18);
-    bool i2 = arg_get_lit(ctx, 19);
+    bool im = arg_get_lit(ctx, 18);
+    bool is = arg_get_lit(ctx, 19);
+    bool ia = arg_get_lit(ctx, 20);
+    bool i2 = arg_get_lit(ctx, 21);
 #endif
 #if defined(COMPILER_HAS_SIMD_AVX512)
-    bool i5 = arg_get_lit(ctx, 20);
+    bool i5 = arg_get_lit(ctx, 22);
 #endif
 #if defined(COMPILER_HAS_SIMD_NEON)
-    bool ie = arg_get_lit(ctx, 16);
+    bool ie = arg_get_lit(ctx, 18);
 #endif
     CLIParserFree(ctx);
 
+    if (num_threads < 0 || num_threads > HARDNESTED_MAX_THREADS) {
+        PrintAndLogEx(WARNING, "Number of threads must be between 0 (auto) and %u", HARDNESTED_MAX_THREADS);
+        return PM3_EINVARG;
+    }
+    hardnested_set_num_threads(num_threads);
+
+    if (simd_bench) {
+        return hardnested_simd_benchmark();
+    }
+
     // set SIM instructions
     SetSIMDInstr(SIMD_AUTO);
 
@@ -2640,6 +2663,12 @@ tryNested:
                                 free(fptr);
                                 return PM3_EOPABORTED;
                             }
+                            case PM3_EMALLOC: {
+                                PrintAndLogEx(ERR, "\nOut of memory. Key candidates were not checked.");
+                                free(e_sector);
+                                free(fptr);
+                                return PM3_EMALLOC;
+                            }
                             case PM3_EFAILED: {
                                 PrintAndLogEx(FAILED, "Tag isn't vulnerable to Nested Attack (PRNG is probably not predictable).");
                                 PrintAndLogEx(FAILED, "Nested attack failed --> try hardnested");
@@ -6381,9 +6410,26 @@ static int CmdHF14AMfValue(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int CmdHF14AMfTest(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf mf test",
+                  "Regression tests for key recovery, candidate key lists and key dictionaries",
+                  "hf mf test");
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    CLIParserFree(ctx);
+    MifareClassicTest(true);
+    return PM3_SUCCESS;
+}
+
 static command_t CommandTable[] = {
     {"help",        CmdHelp,                AlwaysAvailable, "This help"},
     {"list",        CmdHF14AMfList,         AlwaysAvailable, "List MIFARE history"},
+    {"test",        CmdHF14AMfTest,         AlwaysAvailable, "Regression tests"},
     {"-----------", CmdHelp,                IfPm3Iso14443a,  "----------------------- " _CYAN_("recovery") " -----------------------"},
     {"darkside",    CmdHF14AMfDarkside,     IfPm3Iso14443a,  "Darkside attack"},
     {"nested",      CmdHF14AMfNested,       IfPm3Iso14443a,  "Nested attack"},
@@ -2003,6 +2003,7 @@ static int CmdHF14ADesBruteApps(const char *Cmd) {
         res = DesfireSelectAIDHexNoFieldOn(&dctx, id);
 
         if (res == PM3_SUCCESS) {
+            PrintAndLogEx_flush();
             printf("\33[2K\r"); // clear current line before printing
             PrintAndLogEx(SUCCESS, "Got new APPID %06X", id);
         }
@@ -5462,6 +5463,7 @@ static int CmdHF14ADesLsApp(const char *Cmd) {
     AppListS AppList = {{0}};
     DesfireFillAppList(&dctx, &PICCInfo, AppList, !nodeep, scanfiles, true);
 
+    PrintAndLogEx_flush();
     printf("\33[2K\r"); // clear current line before printing
     PrintAndLogEx(NORMAL, "");
 
@@ -31,6 +31,12 @@
 #include <math.h>
 #include <time.h> // MingW
 #include <bzlib.h>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #include "commonutil.h"  // ARRAYLEN
 #include "comms.h"
@@ -45,13 +51,14 @@
 #include "hardnested_bitarray_core.h"
 #include "fileutils.h"
 
-#define NUM_CHECK_BITFLIPS_THREADS      (num_CPUs())
-#define NUM_REDUCTION_WORKING_THREADS   (num_CPUs())
+#define NUM_CHECK_BITFLIPS_THREADS      (hardnested_get_num_threads())
 
 #define IGNORE_BITFLIP_THRESHOLD        0.99 // ignore bitflip arrays which have nearly only valid states
 
 #define STATE_FILES_DIRECTORY           "hardnested_tables/"
 #define STATE_FILE_TEMPLATE             "bitflip_%d_%03" PRIx16 "_states.bin.bz2"
+#define TABLES_CACHE_FILENAME           "hardnested_tables.cache"
+#define TABLES_CACHE_MAGIC              "PM3HNTC2"  // bump when the layout or the tables change
 
 #define DEBUG_KEY_ELIMINATION
 // #define DEBUG_REDUCTION
@@ -114,11 +121,54 @@ static void get_SIMD_instruction_set(char *instruction_set) {
     }
 }
 
+// measure the brute force rate of every instruction set this CPU supports. The instruction sets
+// are ordered from best to worst, so everything after the autodetected one is available as well.
+// The bitarray kernels of each set are checked against the generic ones and timed as well.
+int hardnested_simd_benchmark(void) {
+    if (brute_force_benchmark_available() == false) {
+        PrintAndLogEx(ERR, "Benchmark data " _YELLOW_("hardnested_bf_bench_data.bin") " not found, can't benchmark");
+        return PM3_EFILE;
+    }
+
+    SetSIMDInstr(SIMD_AUTO);
+    SIMDExecInstr best = GetSIMDInstrAuto();
+
+    int res = PM3_SUCCESS;
+    PrintAndLogEx(INFO, "Brute force benchmark using " _YELLOW_("%u") " threads", hardnested_get_num_threads());
+    PrintAndLogEx(INFO, "-------------+-----------------------------+------------------------------");
+    PrintAndLogEx(INFO, " SIMD core   | keys/s                      | bitarray kernels");
+    PrintAndLogEx(INFO, "-------------+-----------------------------+------------------------------");
+    for (SIMDExecInstr instr = best; instr <= SIMD_NONE; instr++) {
+        char instr_set[12] = "";
+        SetSIMDInstr(instr);
+        get_SIMD_instruction_set(instr_set);
+        float rate = brute_force_benchmark();
+
+        float ms = 0;
+        const char *failed = check_bitarray_kernels(instr, &ms);
+        if (failed) {
+            PrintAndLogEx(INFO, " %-11s | %6.0f million (2^%1.1f)     | " _RED_("%s mismatch"), instr_set, rate / 1000000, log(rate) / log(2.0), failed);
+            res = PM3_ESOFT;
+        } else {
+            PrintAndLogEx(INFO, " %-11s | %6.0f million (2^%1.1f)     | " _GREEN_("ok") ", AND4 %5.1f us", instr_set, rate / 1000000, log(rate) / log(2.0), ms * 1000 / 64);
+        }
+    }
+    PrintAndLogEx(INFO, "-------------+-----------------------------+------------------------------");
+    if (res == PM3_SUCCESS) {
+        PrintAndLogEx(SUCCESS, "    Bitarray kernels [ %s ]", _GREEN_("ok"));
+    } else {
+        PrintAndLogEx(FAILED, "    Bitarray kernels [ %s ]", _RED_("fail"));
+    }
+
+    SetSIMDInstr(SIMD_AUTO);
+    return res;
+}
+
 static void print_progress_header(void) {
     char progress_text[80];
     char instr_set[12] = "";
     get_SIMD_instruction_set(instr_set);
-    sprintf(progress_text, "Start using " _YELLOW_("%d") " threads and " _YELLOW_("%s") " SIMD core", num_CPUs(), instr_set);
+    sprintf(progress_text, "Start using " _YELLOW_("%d") " threads and " _YELLOW_("%s") " SIMD core", hardnested_get_num_threads(), instr_set);
 
     PrintAndLogEx(INFO, "Hardnested attack starting...");
     PrintAndLogEx(INFO, "---------+---------+---------------------------------------------------------+-----------------+-------");
@@ -130,7 +180,7 @@ static void print_progress_header(void) {
 
 void hardnested_print_progress(uint32_t nonces, const char *activity, float brute_force, uint64_t min_diff_print_time) {
     static uint64_t last_print_time = 0;
-    if (msclock() - last_print_time > min_diff_print_time) {
+    if (msclock() - last_print_time >= min_diff_print_time) {
         last_print_time = msclock();
         uint64_t total_time = msclock() - start_time;
         float brute_force_time = brute_force / brute_force_per_second;
@@ -217,7 +267,7 @@ static inline uint32_t next_state(uint32_t *bitarray, uint32_t state) {
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // bitflip property bitarrays
 
-static uint32_t *bitflip_bitarrays[2][0x400];
+static const uint32_t *bitflip_bitarrays[2][0x400];
 static uint32_t count_bitflip_bitarrays[2][0x400];
 
 static int compare_count_bitflip_bitarrays(const void *b1, const void *b2) {
@@ -247,6 +297,137 @@ static void init_bunzip2(bz_stream *compressed_stream, char *input_buffer, uint3
 
 }
 
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// cache of the uncompressed bitflip tables and partial sum bitarrays
+//
+// Decompressing the bitflip tables and computing the partial sum bitarrays takes several seconds and
+// some hundred MB of heap. The results are stored once, uncompressed, in the user directory and mapped
+// by all following runs. The mapping is read-only and shared between concurrently running clients. The
+// bitflip tables are used from it directly, the partial sum bitarrays are copied to the heap because
+// update_sum_bitarrays() reduces them. The cache records which bitflip tables were found, with their sizes
+// and modification times, and is rebuilt when that changes. Delete it to force that.
+
+#define BITARRAY_SIZE                   (sizeof(uint32_t) * (1 << 19))
+#define TABLES_CACHE_ALIGN              4096
+
+// the bitflip table files a cache was built from
+typedef struct {
+    uint32_t count;
+    uint64_t digest;        // FNV-1a over table, size and mtime of each file
+} tables_cache_source_t;
+
+typedef struct {
+    char magic[8];
+    uint64_t size;
+    tables_cache_source_t source;
+    uint32_t bitflip_count[2][0x400];
+    uint64_t bitflip_offset[2][0x400];           // 0 = no effective table
+    uint64_t part_sum_a0_offset[2][NUM_PART_SUMS];
+    uint64_t part_sum_a8_offset[2][NUM_PART_SUMS];
+} tables_cache_header_t;
+
+static const uint8_t *tables_cache = NULL;
+static size_t tables_cache_size = 0;
+
+static uint64_t tables_cache_align(uint64_t offset) {
+    return (offset + TABLES_CACHE_ALIGN - 1) & ~(uint64_t)(TABLES_CACHE_ALIGN - 1);
+}
+
+static uint64_t fnv1a_64(uint64_t hash, const void *data, size_t len) {
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static void get_tables_cache_source(tables_cache_source_t *source) {
+    char state_files_path[sizeof(STATE_FILES_DIRECTORY) + sizeof(STATE_FILE_TEMPLATE)];
+
+    source->count = 0;
+    source->digest = 0xcbf29ce484222325ULL;
+    for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+        for (uint16_t bitflip = 0x001; bitflip < 0x400; bitflip++) {
+            snprintf(state_files_path, sizeof(state_files_path), STATE_FILES_DIRECTORY STATE_FILE_TEMPLATE, odd_even, bitflip);
+
+            char *path;
+            if (searchFile(&path, RESOURCES_SUBDIR, state_files_path, "", true) != PM3_SUCCESS) {
+                continue;
+            }
+            struct stat st;
+            int res = stat(path, &st);
+            free(path);
+            if (res != 0) {
+                continue;
+            }
+
+            uint64_t record[3] = { (uint64_t)odd_even << 16 | bitflip, (uint64_t)st.st_size, (uint64_t)st.st_mtime };
+            source->digest = fnv1a_64(source->digest, record, sizeof(record));
+            source->count++;
+        }
+    }
+}
+
+static bool map_tables_cache(const tables_cache_source_t *source) {
+#if defined(_WIN32)
+    (void)source;
+    return false;
+#else
+    if (tables_cache != NULL) {
+        return true;
+    }
+
+    char *path;
+    if (searchHomeFilePath(&path, NULL, TABLES_CACHE_FILENAME, false) != PM3_SUCCESS) {
+        return false;
+    }
+
+    int fd = open(path, O_RDONLY);
+    free(path);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(tables_cache_header_t)) {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    const tables_cache_header_t *hdr = (const tables_cache_header_t *)map;
+    if (memcmp(hdr->magic, TABLES_CACHE_MAGIC, sizeof(hdr->magic)) != 0 || hdr->size != (uint64_t)st.st_size
+            || hdr->source.count != source->count || hdr->source.digest != source->digest) {
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    tables_cache = map;
+    tables_cache_size = st.st_size;
+    return true;
+#endif
+}
+
+static void unmap_tables_cache(void) {
+#if !defined(_WIN32)
+    if (tables_cache != NULL) {
+        munmap((void *)tables_cache, tables_cache_size);
+    }
+#endif
+    tables_cache = NULL;
+    tables_cache_size = 0;
+}
+
+static tables_cache_source_t tables_source;
+
+static void write_tables_cache(uint32_t *part_sum_a0[2][NUM_PART_SUMS], uint32_t *part_sum_a8[2][NUM_PART_SUMS]);
+
 static void init_bitflip_bitarrays(void) {
 #if defined (DEBUG_REDUCTION)
     uint8_t line = 0;
@@ -254,6 +435,9 @@ static void init_bitflip_bitarrays(void) {
 
     bz_stream compressed_stream;
 
+    get_tables_cache_source(&tables_source);
+    bool cached = map_tables_cache(&tables_source);
+
     char state_files_path[strlen(get_my_executable_directory()) + strlen(STATE_FILES_DIRECTORY) + strlen(STATE_FILE_TEMPLATE) + 1];
     char state_file_name[strlen(STATE_FILE_TEMPLATE) + 1];
 
@@ -263,6 +447,16 @@ static void init_bitflip_bitarrays(void) {
             bitflip_bitarrays[odd_even][bitflip] = NULL;
             count_bitflip_bitarrays[odd_even][bitflip] = 1 << 24;
 
+            if (cached) {
+                const tables_cache_header_t *hdr = (const tables_cache_header_t *)tables_cache;
+                if (hdr->bitflip_offset[odd_even][bitflip]) {
+                    effective_bitflip[odd_even][num_effective_bitflips[odd_even]++] = bitflip;
+                    bitflip_bitarrays[odd_even][bitflip] = (const uint32_t *)(tables_cache + hdr->bitflip_offset[odd_even][bitflip]);
+                    count_bitflip_bitarrays[odd_even][bitflip] = hdr->bitflip_count[odd_even][bitflip];
+                }
+                continue;
+            }
+
             sprintf(state_file_name, STATE_FILE_TEMPLATE, odd_even, bitflip);
             strcpy(state_files_path, STATE_FILES_DIRECTORY);
             strcat(state_files_path, state_file_name);
@@ -371,16 +565,22 @@ static void init_bitflip_bitarrays(void) {
     }
 #endif
     char progress_text[80];
-    sprintf(progress_text, "Using %d precalculated bitflip state tables", num_all_effective_bitflips);
+    sprintf(progress_text, "Using %d precalculated bitflip state tables%s", num_all_effective_bitflips, cached ? " (cached)" : "");
     hardnested_print_progress(0, progress_text, (float)(1LL << 47), 0);
 }
 
 static void free_bitflip_bitarrays(void) {
+    if (tables_cache != NULL) {
+        // part of the mapping
+        memset(bitflip_bitarrays, 0, sizeof(bitflip_bitarrays));
+        unmap_tables_cache();
+        return;
+    }
     for (int16_t bitflip = 0x3ff; bitflip > 0x000; bitflip--) {
-        free_bitarray(bitflip_bitarrays[ODD_STATE][bitflip]);
+        free_bitarray((uint32_t *)bitflip_bitarrays[ODD_STATE][bitflip]);
     }
     for (int16_t bitflip = 0x3ff; bitflip > 0x000; bitflip--) {
-        free_bitarray(bitflip_bitarrays[EVEN_STATE][bitflip]);
+        free_bitarray((uint32_t *)bitflip_bitarrays[EVEN_STATE][bitflip]);
     }
 }
 
@@ -415,6 +615,24 @@ static uint16_t PartialSumProperty(uint32_t state, odd_even_t odd_even) {
 }
 
 static void init_part_sum_bitarrays(void) {
+    if (tables_cache != NULL) {
+        // update_sum_bitarrays() reduces them, so they are copied out of the read-only mapping
+        const tables_cache_header_t *hdr = (const tables_cache_header_t *)tables_cache;
+        for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+            for (uint16_t part_sum = 0; part_sum < NUM_PART_SUMS; part_sum++) {
+                part_sum_a0_bitarrays[odd_even][part_sum] = (uint32_t *)malloc_bitarray(BITARRAY_SIZE);
+                part_sum_a8_bitarrays[odd_even][part_sum] = (uint32_t *)malloc_bitarray(BITARRAY_SIZE);
+                if (part_sum_a0_bitarrays[odd_even][part_sum] == NULL || part_sum_a8_bitarrays[odd_even][part_sum] == NULL) {
+                    PrintAndLogEx(ERR, "Out of memory error in init_part_sum_bitarrays(). Aborting...\n");
+                    exit(4);
+                }
+                memcpy(part_sum_a0_bitarrays[odd_even][part_sum], tables_cache + hdr->part_sum_a0_offset[odd_even][part_sum], BITARRAY_SIZE);
+                memcpy(part_sum_a8_bitarrays[odd_even][part_sum], tables_cache + hdr->part_sum_a8_offset[odd_even][part_sum], BITARRAY_SIZE);
+            }
+        }
+        return;
+    }
+
     for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
         for (uint16_t part_sum_a0 = 0; part_sum_a0 < NUM_PART_SUMS; part_sum_a0++) {
             part_sum_a0_bitarrays[odd_even][part_sum_a0] = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1 << 19));
@@ -454,6 +672,9 @@ static void init_part_sum_bitarrays(void) {
             }
         }
     }
+
+    // bitflip tables are loaded as well by now. Store both for the next runs.
+    write_tables_cache(part_sum_a0_bitarrays, part_sum_a8_bitarrays);
 }
 
 static void free_part_sum_bitarrays(void) {
@@ -471,6 +692,86 @@ static void free_part_sum_bitarrays(void) {
     }
 }
 
+static void write_tables_cache(uint32_t *part_sum_a0[2][NUM_PART_SUMS], uint32_t *part_sum_a8[2][NUM_PART_SUMS]) {
+#if !defined(_WIN32)
+    // the cache records the tables found. Should more of them show up later, it is rebuilt.
+    if (tables_source.count == 0) {
+        return;
+    }
+
+    tables_cache_header_t *hdr = calloc(1, sizeof(tables_cache_header_t));
+    if (hdr == NULL) {
+        return;
+    }
+    memcpy(hdr->magic, TABLES_CACHE_MAGIC, sizeof(hdr->magic));
+    hdr->source = tables_source;
+
+    uint64_t offset = tables_cache_align(sizeof(tables_cache_header_t));
+    for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+        for (uint16_t bitflip = 0x001; bitflip < 0x400; bitflip++) {
+            if (bitflip_bitarrays[odd_even][bitflip] != NULL) {
+                hdr->bitflip_count[odd_even][bitflip] = count_bitflip_bitarrays[odd_even][bitflip];
+                hdr->bitflip_offset[odd_even][bitflip] = offset;
+                offset += tables_cache_align(BITARRAY_SIZE);
+            }
+        }
+        for (uint16_t part_sum = 0; part_sum < NUM_PART_SUMS; part_sum++) {
+            hdr->part_sum_a0_offset[odd_even][part_sum] = offset;
+            offset += tables_cache_align(BITARRAY_SIZE);
+            hdr->part_sum_a8_offset[odd_even][part_sum] = offset;
+            offset += tables_cache_align(BITARRAY_SIZE);
+        }
+    }
+    hdr->size = offset;
+
+    char *path;
+    if (searchHomeFilePath(&path, NULL, TABLES_CACHE_FILENAME, true) != PM3_SUCCESS) {
+        free(hdr);
+        return;
+    }
+
+    // write to a temporary file and rename, concurrent clients never see a partial cache
+    char tmp_path[strlen(path) + 16];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, (int)getpid());
+
+    FILE *f = fopen(tmp_path, "wb");
+    if (f == NULL) {
+        free(path);
+        free(hdr);
+        return;
+    }
+
+    bool ok = (fwrite(hdr, sizeof(tables_cache_header_t), 1, f) == 1);
+    for (odd_even_t odd_even = EVEN_STATE; ok && odd_even <= ODD_STATE; odd_even++) {
+        for (uint16_t bitflip = 0x001; ok && bitflip < 0x400; bitflip++) {
+            if (hdr->bitflip_offset[odd_even][bitflip]) {
+                ok = (fseek(f, hdr->bitflip_offset[odd_even][bitflip], SEEK_SET) == 0)
+                     && (fwrite(bitflip_bitarrays[odd_even][bitflip], BITARRAY_SIZE, 1, f) == 1);
+            }
+        }
+        for (uint16_t part_sum = 0; ok && part_sum < NUM_PART_SUMS; part_sum++) {
+            ok = (fseek(f, hdr->part_sum_a0_offset[odd_even][part_sum], SEEK_SET) == 0)
+                 && (fwrite(part_sum_a0[odd_even][part_sum], BITARRAY_SIZE, 1, f) == 1)
+                 && (fseek(f, hdr->part_sum_a8_offset[odd_even][part_sum], SEEK_SET) == 0)
+                 && (fwrite(part_sum_a8[odd_even][part_sum], BITARRAY_SIZE, 1, f) == 1);
+        }
+    }
+    ok &= (fclose(f) == 0);
+
+    if (ok && rename(tmp_path, path) == 0) {
+        hardnested_print_progress(0, "Stored uncompressed tables in " _YELLOW_(TABLES_CACHE_FILENAME), (float)(1LL << 47), 0);
+    } else {
+        remove(tmp_path);
+    }
+
+    free(path);
+    free(hdr);
+#else
+    (void)part_sum_a0;
+    (void)part_sum_a8;
+#endif
+}
+
 static void init_sum_bitarrays(void) {
     for (uint16_t sum_a0 = 0; sum_a0 < NUM_SUMS; sum_a0++) {
         for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
@@ -1377,6 +1678,97 @@ static int simulate_acquire_nonces(void) {
     return PM3_SUCCESS;
 }
 
+// Nonce acquisition is pipelined. A producer thread keeps the device busy and streams the
+// received batches into a single producer / single consumer ring, while the main thread
+// analyses whatever has arrived so far. The device therefore never waits for the host to
+// finish applying bitflip and sum properties.
+#define NONCE_RING_SIZE                 64  // batches, must be a power of 2
+
+typedef struct {
+    uint16_t num_sampled_nonces;
+    uint8_t data[PM3_CMD_DATA_SIZE];
+} nonce_batch_t;
+
+static nonce_batch_t nonce_ring[NONCE_RING_SIZE];
+static uint32_t nonce_ring_head = 0;        // only written by producer
+static uint32_t nonce_ring_tail = 0;        // only written by consumer
+static bool nonce_producer_stop = false;    // set by consumer when enough nonces are acquired
+static bool nonce_producer_done = false;    // set by producer when it has left its loop
+static int nonce_producer_status = PM3_SUCCESS;
+static uint64_t nonce_batch_period = 0;     // fastest observed device round trip time (ms)
+
+typedef struct {
+    uint8_t blockNo;
+    uint8_t keyType;
+    uint8_t *key;
+    uint8_t trgBlockNo;
+    uint8_t trgKeyType;
+    bool slow;
+    FILE *fnonces;
+    pm3_device_t *dev;
+} nonce_producer_args_t;
+
+static void *nonce_producer_thread(void *args) {
+    nonce_producer_args_t *a = (nonce_producer_args_t *)args;
+    // threads start on the session device, talk to the one of the command instead
+    UseProxmark(a->dev);
+    int status = PM3_SUCCESS;
+    PacketResponseNG resp;
+
+    uint32_t flags = a->slow ? 0x0002 : 0;
+    uint64_t last_clock = msclock();
+
+    while (__atomic_load_n(&nonce_producer_stop, __ATOMIC_ACQUIRE) == false) {
+
+        clearCommandBuffer();
+        SendCommandMIX(CMD_HF_MIFARE_ACQ_ENCRYPTED_NONCES, a->blockNo + a->keyType * 0x100, a->trgBlockNo + a->trgKeyType * 0x100, flags, a->key, 6);
+
+        if (WaitForResponseTimeout(CMD_ACK, &resp, 3000) == false) {
+            status = 1;
+            break;
+        }
+
+        // error during nested_hard
+        if (resp.oldarg[0]) {
+            status = resp.oldarg[0];
+            break;
+        }
+
+        uint64_t now = msclock();
+        if (nonce_batch_period == 0 || now - last_clock < nonce_batch_period) {
+            __atomic_store_n(&nonce_batch_period, now - last_clock, __ATOMIC_RELEASE);
+        }
+        last_clock = now;
+
+        uint16_t num_sampled_nonces = MIN(resp.oldarg[2], (PM3_CMD_DATA_SIZE / 9) * 2);
+        if (a->fnonces != NULL) {
+            fwrite(resp.data.asBytes, 1, (num_sampled_nonces / 2) * 9, a->fnonces);
+            fflush(a->fnonces);
+        }
+
+        // back pressure: wait for the consumer to free a slot
+        uint32_t head = nonce_ring_head;
+        while (head - __atomic_load_n(&nonce_ring_tail, __ATOMIC_ACQUIRE) >= NONCE_RING_SIZE) {
+            if (__atomic_load_n(&nonce_producer_stop, __ATOMIC_ACQUIRE)) {
+                break;
+            }
+            msleep(1);
+        }
+        if (head - __atomic_load_n(&nonce_ring_tail, __ATOMIC_ACQUIRE) >= NONCE_RING_SIZE) {
+            break;
+        }
+
+        nonce_batch_t *batch = &nonce_ring[head & (NONCE_RING_SIZE - 1)];
+        batch->num_sampled_nonces = num_sampled_nonces;
+        memcpy(batch->data, resp.data.asBytes, (num_sampled_nonces / 2) * 9);
+        __atomic_store_n(&nonce_ring_head, head + 1, __ATOMIC_RELEASE);
+    }
+
+    nonce_producer_status = status;
+    __atomic_store_n(&nonce_producer_done, true, __ATOMIC_RELEASE);
+    return NULL;
+}
+
 static int acquire_nonces(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, bool nonce_file_write, bool slow, char *filename) {
 
     last_sample_clock = msclock();
@@ -1386,8 +1778,6 @@ static int acquire_nonces(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_
     // initial rough estimate. Will be refined.
     sample_period = 2000;
 
-    bool initialize = true;
-    bool field_off = false;
     bool acquisition_completed = false;
     bool reported_suma8 = false;
 
@@ -1399,58 +1789,79 @@ static int acquire_nonces(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_
     uint8_t write_buf[9];
     char progress_text[80];
 
-    do {
-
-        if (field_off) {
-            DropField();
-            break;
-        }
+    // initialize the acquisition on device side
+    clearCommandBuffer();
+    SendCommandMIX(CMD_HF_MIFARE_ACQ_ENCRYPTED_NONCES, blockNo + keyType * 0x100, trgBlockNo + trgKeyType * 0x100, 0x0001 | (slow ? 0x0002 : 0), key, 6);
 
-        uint32_t flags = 0;
-        flags |= initialize ? 0x0001 : 0;
-        flags |= slow ? 0x0002 : 0;
-        flags |= field_off ? 0x0004 : 0;
-        clearCommandBuffer();
-        SendCommandMIX(CMD_HF_MIFARE_ACQ_ENCRYPTED_NONCES, blockNo + keyType * 0x100, trgBlockNo + trgKeyType * 0x100, flags, key, 6);
+    if (WaitForResponseTimeout(CMD_ACK, &resp, 3000) == false) {
+        DropField();
+        return 1;
+    }
 
-        if (initialize) {
+    // error during nested_hard
+    if (resp.oldarg[0]) {
+        DropField();
+        return resp.oldarg[0];
+    }
 
-            if (WaitForResponseTimeout(CMD_ACK, &resp, 3000) == false) {
-                DropField();
-                return 1;
-            }
+    cuid = resp.oldarg[1];
+    if (nonce_file_write) {
 
-            // error during nested_hard
-            if (resp.oldarg[0]) {
-                DropField();
-                return resp.oldarg[0];
-            }
+        if ((fnonces = fopen(filename, "wb")) == NULL) {
+            PrintAndLogEx(WARNING, "Could not create file " _YELLOW_("%s"), filename);
+            DropField();
+            return 3;
+        }
 
-            cuid = resp.oldarg[1];
-            if (nonce_file_write && fnonces == NULL) {
+        snprintf(progress_text, 80, "Writing acquired nonces to binary file " _YELLOW_("%s"), filename);
+        hardnested_print_progress(0, progress_text, (float)(1LL << 47), 0);
+        num_to_bytes(cuid, 4, write_buf);
+        fwrite(write_buf, 1, 4, fnonces);
+        fwrite(&trgBlockNo, 1, 1, fnonces);
+        fwrite(&trgKeyType, 1, 1, fnonces);
+        fflush(fnonces);
+    }
+
+    // start streaming nonces from the device
+    nonce_ring_head = 0;
+    nonce_ring_tail = 0;
+    nonce_producer_stop = false;
+    nonce_producer_done = false;
+    nonce_producer_status = PM3_SUCCESS;
+    nonce_batch_period = 0;
+
+    nonce_producer_args_t producer_args = {
+        .blockNo = blockNo,
+        .keyType = keyType,
+        .key = key,
+        .trgBlockNo = trgBlockNo,
+        .trgKeyType = trgKeyType,
+        .slow = slow,
+        .fnonces = fnonces,
+        .dev = g_device,
+    };
 
-                if ((fnonces = fopen(filename, "wb")) == NULL) {
-                    PrintAndLogEx(WARNING, "Could not create file " _YELLOW_("%s"), filename);
-                    DropField();
-                    return 3;
-                }
+    pthread_t producer;
+    pthread_create(&producer, NULL, nonce_producer_thread, &producer_args);
 
-                snprintf(progress_text, 80, "Writing acquired nonces to binary file " _YELLOW_("%s"), filename);
-                hardnested_print_progress(0, progress_text, (float)(1LL << 47), 0);
-                num_to_bytes(cuid, 4, write_buf);
-                fwrite(write_buf, 1, 4, fnonces);
-                fwrite(&trgBlockNo, 1, 1, fnonces);
-                fwrite(&trgKeyType, 1, 1, fnonces);
-                fflush(fnonces);
+    int res = PM3_SUCCESS;
+    do {
+        // consume everything which arrived while we were busy
+        uint32_t head = __atomic_load_n(&nonce_ring_head, __ATOMIC_ACQUIRE);
+        uint32_t tail = nonce_ring_tail;
+        if (head == tail) {
+            if (__atomic_load_n(&nonce_producer_done, __ATOMIC_ACQUIRE)) {
+                res = nonce_producer_status;
+                break;
             }
+            msleep(1);
+            continue;
         }
 
-        if (initialize == false) {
-
-            uint16_t num_sampled_nonces = resp.oldarg[2];
-            uint8_t *bufp = resp.data.asBytes;
-
-            for (uint16_t i = 0; i < num_sampled_nonces; i += 2) {
+        for (; tail != head; tail++) {
+            nonce_batch_t *batch = &nonce_ring[tail & (NONCE_RING_SIZE - 1)];
+            uint8_t *bufp = batch->data;
+            for (uint16_t i = 0; i < batch->num_sampled_nonces; i += 2) {
                 uint32_t nt_enc1 = bytes_to_num(bufp, 4);
                 uint32_t nt_enc2 = bytes_to_num(bufp + 4, 4);
                 uint8_t par_enc = bytes_to_num(bufp + 8, 1);
@@ -1459,90 +1870,67 @@ static int acquire_nonces(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_
                 num_acquired_nonces += add_nonce(nt_enc1, par_enc >> 4);
                 //PrintAndLogEx(INFO, "Encrypted nonce: %08x, encrypted_parity: %02x\n", nt_enc2, par_enc & 0x0f);
                 num_acquired_nonces += add_nonce(nt_enc2, par_enc & 0x0f);
-
-                if (nonce_file_write) {
-                    fwrite(bufp, 1, 9, fnonces);
-                    fflush(fnonces);
-                }
                 bufp += 9;
             }
-            //total_num_nonces += num_sampled_nonces;
-
-            if (first_byte_num == 256) {
-                if (hardnested_stage == CHECK_1ST_BYTES) {
-                    bool got_match = false;
-                    for (uint8_t i = 0; i < NUM_SUMS; i++) {
-                        if (first_byte_Sum == sums[i]) {
-                            first_byte_Sum = i;
-                            got_match = true;
-                            break;
-                        }
-                    }
-
-                    if (got_match == false) {
-                        PrintAndLogEx(FAILED, "No match for the First_Byte_Sum (%u), is the card a genuine MFC Ev1? ", first_byte_Sum);
-                        return 4;
-                    }
-
-                    hardnested_stage |= CHECK_2ND_BYTES;
-                    apply_sum_a0();
-                }
-                update_nonce_data(true);
-                acquisition_completed = shrink_key_space(&brute_force_depth);
-                if (!reported_suma8) {
-                    char progress_string[80];
-                    sprintf(progress_string, "Apply Sum property. Sum(a0) = %d", sums[first_byte_Sum]);
-                    hardnested_print_progress(num_acquired_nonces, progress_string, brute_force_depth, 0);
-                    reported_suma8 = true;
-                } else {
-                    hardnested_print_progress(num_acquired_nonces, "Apply bit flip properties", brute_force_depth, 0);
-                }
-            } else {
-                update_nonce_data(true);
-                acquisition_completed = shrink_key_space(&brute_force_depth);
-                hardnested_print_progress(num_acquired_nonces, "Apply bit flip properties", brute_force_depth, 0);
-            }
         }
+        __atomic_store_n(&nonce_ring_tail, tail, __ATOMIC_RELEASE);
 
-        if (acquisition_completed) {
-            field_off = true; // switch off field with next SendCommandOLD and then finish
+        // limit the analysis to about one device round trip, then look for new nonces again
+        uint64_t period = __atomic_load_n(&nonce_batch_period, __ATOMIC_ACQUIRE);
+        if (period) {
+            sample_period = period;
         }
+        last_sample_clock = msclock();
 
-        if (initialize == false) {
-
-            if (WaitForResponseTimeout(CMD_ACK, &resp, 3000) == false) {
-                if (nonce_file_write) {
-                    fclose(fnonces);
+        if (first_byte_num == 256) {
+            if (hardnested_stage == CHECK_1ST_BYTES) {
+                bool got_match = false;
+                for (uint8_t i = 0; i < NUM_SUMS; i++) {
+                    if (first_byte_Sum == sums[i]) {
+                        first_byte_Sum = i;
+                        got_match = true;
+                        break;
+                    }
                 }
-                DropField();
-                return 1;
-            }
 
-            // error during nested_hard
-            if (resp.oldarg[0]) {
-                if (nonce_file_write) {
-                    fclose(fnonces);
+                if (got_match == false) {
+                    PrintAndLogEx(FAILED, "No match for the First_Byte_Sum (%u), is the card a genuine MFC Ev1? ", first_byte_Sum);
+                    res = 4;
+                    break;
                 }
-                DropField();
-                return resp.oldarg[0];
+
+                hardnested_stage |= CHECK_2ND_BYTES;
+                apply_sum_a0();
+            }
+            update_nonce_data(true);
+            acquisition_completed = shrink_key_space(&brute_force_depth);
+            if (!reported_suma8) {
+                char progress_string[80];
+                sprintf(progress_string, "Apply Sum property. Sum(a0) = %d", sums[first_byte_Sum]);
+                hardnested_print_progress(num_acquired_nonces, progress_string, brute_force_depth, 0);
+                reported_suma8 = true;
+            } else {
+                hardnested_print_progress(num_acquired_nonces, "Apply bit flip properties", brute_force_depth, 0);
             }
+        } else {
+            update_nonce_data(true);
+            acquisition_completed = shrink_key_space(&brute_force_depth);
+            hardnested_print_progress(num_acquired_nonces, "Apply bit flip properties", brute_force_depth, 0);
         }
 
-        initialize = false;
+    } while (acquisition_completed == false);
 
-        if (msclock() - last_sample_clock < sample_period) {
-            sample_period = msclock() - last_sample_clock;
-        }
-
-        last_sample_clock = msclock();
+    // stop the producer. It finishes the round trip in flight, which is simply discarded.
+    __atomic_store_n(&nonce_producer_stop, true, __ATOMIC_RELEASE);
+    pthread_join(producer, NULL);
 
-    } while (field_off || acquisition_completed == false);
+    DropField();
 
     if (nonce_file_write) {
         fclose(fnonces);
     }
 
-    return PM3_SUCCESS;
+    return res;
 }
 
 static inline bool invariant_holds(uint_fast8_t byte_diff, uint_fast32_t state1, uint_fast32_t state2, uint_fast8_t bit, uint_fast8_t state_bit) {
@@ -1608,45 +1996,38 @@ static inline bool remaining_bits_match(uint_fast8_t num_common_bits, uint_fast8
     return true; // valid state
 }
 
-static pthread_mutex_t statelist_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t book_of_work_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-typedef enum {
-    TO_BE_DONE,
-    WORK_IN_PROGRESS,
-    COMPLETED
-} work_status_t;
+// The states of a cache entry are searched in SL_TASK_CHUNKS sub-ranges. Each sub-range is computed by
+// exactly one task of the work stealing scheduler below, and the sub-lists are only joined after all
+// worker threads have been joined. Therefore no locking is required.
+#define SL_TASK_CHUNKS      16
+#define SL_CHUNK_STATES     ((1 << 24) / SL_TASK_CHUNKS)
 
 static struct sl_cache_entry {
     uint32_t *sl;
     uint32_t len;
-    work_status_t cache_status;
+    uint32_t *chunk_sl[SL_TASK_CHUNKS];
+    uint32_t chunk_len[SL_TASK_CHUNKS];
 } sl_cache[NUM_PART_SUMS][NUM_PART_SUMS][2];
 
 static void init_statelist_cache(void) {
-    pthread_mutex_lock(&statelist_cache_mutex);
     for (uint16_t i = 0; i < NUM_PART_SUMS; i++) {
         for (uint16_t j = 0; j < NUM_PART_SUMS; j++) {
             for (uint16_t k = 0; k < 2; k++) {
-                sl_cache[i][j][k].sl = NULL;
-                sl_cache[i][j][k].len = 0;
-                sl_cache[i][j][k].cache_status = TO_BE_DONE;
+                memset(&sl_cache[i][j][k], 0, sizeof(struct sl_cache_entry));
             }
         }
     }
-    pthread_mutex_unlock(&statelist_cache_mutex);
 }
 
 static void free_statelist_cache(void) {
-    pthread_mutex_lock(&statelist_cache_mutex);
     for (uint16_t i = 0; i < NUM_PART_SUMS; i++) {
         for (uint16_t j = 0; j < NUM_PART_SUMS; j++) {
             for (uint16_t k = 0; k < 2; k++) {
                 free(sl_cache[i][j][k].sl);
+                sl_cache[i][j][k].sl = NULL;
             }
         }
     }
-    pthread_mutex_unlock(&statelist_cache_mutex);
 }
 
 
@@ -1741,45 +2122,79 @@ static void add_cached_states(statelist_t *cands, uint16_t part_sum_a0, uint16_t
 }
 
 
-static void add_matching_states(statelist_t *cands, uint8_t part_sum_a0, uint8_t part_sum_a8, odd_even_t odd_even) {
+// search one sub-range of the states allowed by both partial sums and the bitflip property of the best first byte
+static void add_matching_states_chunk(uint8_t part_sum_a0, uint8_t part_sum_a8, odd_even_t odd_even, uint8_t chunk) {
 
-    const uint32_t worstcase_size = 1 << 20;
+    struct sl_cache_entry *entry = &sl_cache[part_sum_a0 / 2][part_sum_a8 / 2][odd_even];
 
-    cands->states[odd_even] = (uint32_t *)malloc(sizeof(uint32_t) * worstcase_size);
-    if (cands->states[odd_even] == NULL) {
-        PrintAndLogEx(ERR, "Out of memory error in add_matching_states() - statelist.\n");
+    uint32_t *states = (uint32_t *)malloc(sizeof(uint32_t) * SL_CHUNK_STATES);
+    if (states == NULL) {
+        PrintAndLogEx(ERR, "Out of memory error in add_matching_states_chunk() - statelist.\n");
         exit(4);
     }
 
-    uint32_t *cands_bitarray = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * worstcase_size);
-    if (cands_bitarray == NULL) {
-        PrintAndLogEx(ERR, "Out of memory error in add_matching_states() - bitarray.\n");
-        free(cands->states[odd_even]);
-        exit(4);
+    const uint32_t *bitarray_a0 = part_sum_a0_bitarrays[odd_even][part_sum_a0 / 2];
+    const uint32_t *bitarray_a8 = part_sum_a8_bitarrays[odd_even][part_sum_a8 / 2];
+    const uint32_t *bitarray_bitflips = nonces[best_first_bytes[0]].states_bitarray[odd_even];
+
+    uint32_t len = 0;
+    uint32_t first_word = chunk * (SL_CHUNK_STATES >> 5);
+    uint32_t last_word = first_word + (SL_CHUNK_STATES >> 5);
+    for (uint32_t index = first_word; index < last_word; index++) {
+        uint32_t line = bitarray_a0[index] & bitarray_a8[index] & bitarray_bitflips[index];
+        while (line) {
+            uint_fast8_t bit = __builtin_clz(line);
+            uint32_t state = (index << 5) | bit;
+            line &= ~(0x80000000 >> bit);
+            if (all_bitflips_match(best_first_bytes[0], state, odd_even)) {
+                states[len++] = state;
+            }
+        }
     }
 
-    uint32_t *bitarray_a0 = part_sum_a0_bitarrays[odd_even][part_sum_a0 / 2];
-    uint32_t *bitarray_a8 = part_sum_a8_bitarrays[odd_even][part_sum_a8 / 2];
-    uint32_t *bitarray_bitflips = nonces[best_first_bytes[0]].states_bitarray[odd_even];
+    if (len == 0) {
+        free(states);
+        states = NULL;
+    } else {
+        states = realloc(states, sizeof(uint32_t) * len);
+    }
 
-    bitarray_AND4(cands_bitarray, bitarray_a0, bitarray_a8, bitarray_bitflips);
+    entry->chunk_sl[chunk] = states;
+    entry->chunk_len[chunk] = len;
+}
 
-    bitarray_to_list(best_first_bytes[0], cands_bitarray, cands->states[odd_even], &(cands->len[odd_even]), odd_even);
+// concatenate the sub-lists of a cache entry in state order and add the End Of List marker
+static void join_statelist_chunks(struct sl_cache_entry *entry) {
+    uint32_t len = 0;
+    for (uint8_t chunk = 0; chunk < SL_TASK_CHUNKS; chunk++) {
+        len += entry->chunk_len[chunk];
+    }
 
-    if (cands->len[odd_even] == 0) {
-        free(cands->states[odd_even]);
-        cands->states[odd_even] = NULL;
-    } else if (cands->len[odd_even] + 1 < worstcase_size) {
-        cands->states[odd_even] = realloc(cands->states[odd_even], sizeof(uint32_t) * (cands->len[odd_even] + 1));
+    uint32_t *states = NULL;
+    if (len) {
+        states = (uint32_t *)malloc(sizeof(uint32_t) * (len + 1));
+        if (states == NULL) {
+            PrintAndLogEx(ERR, "Out of memory error in join_statelist_chunks() - statelist.\n");
+            exit(4);
+        }
+        uint32_t *p = states;
+        for (uint8_t chunk = 0; chunk < SL_TASK_CHUNKS; chunk++) {
+            if (entry->chunk_len[chunk]) {
+                memcpy(p, entry->chunk_sl[chunk], sizeof(uint32_t) * entry->chunk_len[chunk]);
+                p += entry->chunk_len[chunk];
+            }
+        }
+        *p = 0xffffffff;
     }
-    free_bitarray(cands_bitarray);
 
-    pthread_mutex_lock(&statelist_cache_mutex);
-    sl_cache[part_sum_a0 / 2][part_sum_a8 / 2][odd_even].sl = cands->states[odd_even];
-    sl_cache[part_sum_a0 / 2][part_sum_a8 / 2][odd_even].len = cands->len[odd_even];
-    sl_cache[part_sum_a0 / 2][part_sum_a8 / 2][odd_even].cache_status = COMPLETED;
-    pthread_mutex_unlock(&statelist_cache_mutex);
-    return;
+    for (uint8_t chunk = 0; chunk < SL_TASK_CHUNKS; chunk++) {
+        free(entry->chunk_sl[chunk]);
+        entry->chunk_sl[chunk] = NULL;
+        entry->chunk_len[chunk] = 0;
+    }
+
+    entry->sl = states;
+    entry->len = len;
 }
 
 static statelist_t *add_more_candidates(void) {
@@ -1867,16 +2282,57 @@ static bool TestIfKeyExists(uint64_t key) {
     return false;
 }
 
-static work_status_t book_of_work[NUM_PART_SUMS][NUM_PART_SUMS][NUM_PART_SUMS][NUM_PART_SUMS];
+// Candidate generation is split into independent tasks, one per sub-range of a statelist cache entry. The tasks are
+// distributed over per thread deques. A thread pops tasks from the bottom of its own deque and, when
+// this is empty, steals from the top of the other threads' deques. Both ends of a deque are packed into
+// one 64 bit word which is only modified by compare and swap, so neither owner nor thieves ever block.
+// No tasks are added while the workers are running, therefore a thread terminates as soon as it finds
+// all deques empty.
+typedef struct {
+    uint8_t part_sum_idx_a0;
+    uint8_t part_sum_idx_a8;
+    odd_even_t odd_even;
+    uint8_t chunk;
+} sl_task_t;
+
+typedef struct {
+    sl_task_t *tasks;
+    uint64_t bounds;    // top (steal end) in upper 32 bits, bottom (owner end) in lower 32 bits
+} work_deque_t;
+
+static work_deque_t work_deques[HARDNESTED_MAX_THREADS];
+static uint16_t num_work_deques = 0;
+
+static inline uint64_t deque_bounds(uint32_t top, uint32_t bottom) {
+    return ((uint64_t)top << 32) | bottom;
+}
+
+static bool work_deque_pop(work_deque_t *deque, sl_task_t *task) {
+    uint64_t bounds = __atomic_load_n(&deque->bounds, __ATOMIC_ACQUIRE);
+    for (;;) {
+        uint32_t top = bounds >> 32;
+        uint32_t bottom = bounds & 0xffffffff;
+        if (top >= bottom) {
+            return false;
+        }
+        if (__atomic_compare_exchange_n(&deque->bounds, &bounds, deque_bounds(top, bottom - 1), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            *task = deque->tasks[bottom - 1];
+            return true;
+        }
+    }
+}
 
-static void init_book_of_work(void) {
-    for (uint8_t p = 0; p < NUM_PART_SUMS; p++) {
-        for (uint8_t q = 0; q < NUM_PART_SUMS; q++) {
-            for (uint8_t r = 0; r < NUM_PART_SUMS; r++) {
-                for (uint8_t s = 0; s < NUM_PART_SUMS; s++) {
-                    book_of_work[p][q][r][s] = TO_BE_DONE;
-                }
-            }
+static bool work_deque_steal(work_deque_t *deque, sl_task_t *task) {
+    uint64_t bounds = __atomic_load_n(&deque->bounds, __ATOMIC_ACQUIRE);
+    for (;;) {
+        uint32_t top = bounds >> 32;
+        uint32_t bottom = bounds & 0xffffffff;
+        if (top >= bottom) {
+            return false;
+        }
+        if (__atomic_compare_exchange_n(&deque->bounds, &bounds, deque_bounds(top + 1, bottom), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            *task = deque->tasks[top];
+            return true;
         }
     }
 }
@@ -1888,169 +2344,136 @@ __attribute__((force_align_arg_pointer))
 #endif
 #endif
 *generate_candidates_worker_thread(void *args) {
-    uint16_t *sum_args = (uint16_t *)args;
-    uint16_t sum_a0 = sums[sum_args[0]];
-    uint16_t sum_a8 = sums[sum_args[1]];
-    // uint16_t my_thread_number = sums[2];
+    uint16_t my_thread_number = *(uint16_t *)args;
 
-    bool there_might_be_more_work = true;
-    do {
-        there_might_be_more_work = false;
-        for (uint8_t p = 0; p < NUM_PART_SUMS; p++) {
-            for (uint8_t q = 0; q < NUM_PART_SUMS; q++) {
-                if (2 * p * (16 - 2 * q) + (16 - 2 * p) * 2 * q == sum_a0) {
-                    // PrintAndLogEx(INFO, "Reducing Partial Statelists (p,q) = (%d,%d) with lengths %d, %d",
-                    // p, q, partial_statelist[p].len[ODD_STATE], partial_statelist[q].len[EVEN_STATE]);
-                    for (uint8_t r = 0; r < NUM_PART_SUMS; r++) {
-                        for (uint8_t s = 0; s < NUM_PART_SUMS; s++) {
-                            if (2 * r * (16 - 2 * s) + (16 - 2 * r) * 2 * s == sum_a8) {
-                                pthread_mutex_lock(&book_of_work_mutex);
-                                if (book_of_work[p][q][r][s] != TO_BE_DONE) {  // this has been done or is currently been done by another thread. Look for some other work.
-                                    pthread_mutex_unlock(&book_of_work_mutex);
-                                    continue;
-                                }
-
-                                pthread_mutex_lock(&statelist_cache_mutex);
-                                if (sl_cache[p][r][ODD_STATE].cache_status == WORK_IN_PROGRESS
-                                        || sl_cache[q][s][EVEN_STATE].cache_status == WORK_IN_PROGRESS) { // defer until not blocked by another thread.
-                                    pthread_mutex_unlock(&statelist_cache_mutex);
-                                    pthread_mutex_unlock(&book_of_work_mutex);
-                                    there_might_be_more_work = true;
-                                    continue;
-                                }
+    sl_task_t task;
+    for (;;) {
+        bool have_work = work_deque_pop(&work_deques[my_thread_number], &task);
+        // own deque is empty. Try to steal from the others, starting with our neighbour.
+        for (uint16_t i = 1; i < num_work_deques && have_work == false; i++) {
+            have_work = work_deque_steal(&work_deques[(my_thread_number + i) % num_work_deques], &task);
+        }
+        if (have_work == false) {
+            break;
+        }
+        add_matching_states_chunk(2 * task.part_sum_idx_a0, 2 * task.part_sum_idx_a8, task.odd_even, task.chunk);
+    }
 
-                                // we finally can do some work.
-                                book_of_work[p][q][r][s] = WORK_IN_PROGRESS;
-                                statelist_t *current_candidates = add_more_candidates();
+    return NULL;
+}
 
-                                // Check for cached results and add them first
-                                bool odd_completed = false;
-                                if (sl_cache[p][r][ODD_STATE].cache_status == COMPLETED) {
-                                    add_cached_states(current_candidates, 2 * p, 2 * r, ODD_STATE);
-                                    odd_completed = true;
-                                }
-                                bool even_completed = false;
-                                if (sl_cache[q][s][EVEN_STATE].cache_status == COMPLETED) {
-                                    add_cached_states(current_candidates, 2 * q, 2 * s, EVEN_STATE);
-                                    even_completed = true;
-                                }
+static void run_statelist_tasks(sl_task_t *tasks, uint32_t num_tasks) {
+    if (num_tasks == 0) {
+        return;
+    }
 
-                                bool work_required = true;
+    num_work_deques = MIN(hardnested_get_num_threads(), num_tasks);
 
-                                // if there had been two cached results, there is no more work to do
-                                if (even_completed && odd_completed) {
-                                    work_required = false;
-                                }
+    // hand out contiguous slices. Any imbalance is evened out by stealing.
+    uint32_t start = 0;
+    for (uint16_t i = 0; i < num_work_deques; i++) {
+        uint32_t end = (uint64_t)num_tasks * (i + 1) / num_work_deques;
+        work_deques[i].tasks = tasks + start;
+        work_deques[i].bounds = deque_bounds(0, end - start);
+        start = end;
+    }
 
-                                // if there had been one cached empty result, there is no need to calculate the other part:
-                                if (work_required) {
-                                    if (even_completed && !current_candidates->len[EVEN_STATE]) {
-                                        current_candidates->len[ODD_STATE] = 0;
-                                        current_candidates->states[ODD_STATE] = NULL;
-                                        work_required = false;
-                                    }
-                                    if (odd_completed && !current_candidates->len[ODD_STATE]) {
-                                        current_candidates->len[EVEN_STATE] = 0;
-                                        current_candidates->states[EVEN_STATE] = NULL;
-                                        work_required = false;
-                                    }
-                                }
+    // the calling thread works on deque 0. Should a thread fail to start, its deque is emptied by
+    // the others stealing from it.
+    pthread_t thread_id[num_work_deques];
+    uint16_t thread_number[num_work_deques];
+    uint16_t num_started = 1;
+    thread_number[0] = 0;
+    for (uint16_t i = 1; i < num_work_deques; i++) {
+        thread_number[num_started] = i;
+        if (pthread_create(thread_id + num_started, NULL, generate_candidates_worker_thread, &thread_number[num_started]) != 0) {
+            PrintAndLogEx(WARNING, "Failed to create worker thread, continuing with %u threads", num_started);
+            break;
+        }
+        num_started++;
+    }
 
-                                if (work_required == false) {
-                                    pthread_mutex_unlock(&statelist_cache_mutex);
-                                    pthread_mutex_unlock(&book_of_work_mutex);
-                                } else {
-                                    // we really need to calculate something
-                                    if (even_completed) { // we had one cache hit with non-zero even states
-                                        // PrintAndLogEx(INFO, "Thread #%u: start working on  odd states p=%2d, r=%2d...", my_thread_number, p, r);
-                                        sl_cache[p][r][ODD_STATE].cache_status = WORK_IN_PROGRESS;
-                                        pthread_mutex_unlock(&statelist_cache_mutex);
-                                        pthread_mutex_unlock(&book_of_work_mutex);
-                                        add_matching_states(current_candidates, 2 * p, 2 * r, ODD_STATE);
-                                        work_required = false;
-                                    } else if (odd_completed) { // we had one cache hit with non-zero odd_states
-                                        // PrintAndLogEx(INFO, "Thread #%u: start working on even states q=%2d, s=%2d...", my_thread_number, q, s);
-                                        sl_cache[q][s][EVEN_STATE].cache_status = WORK_IN_PROGRESS;
-                                        pthread_mutex_unlock(&statelist_cache_mutex);
-                                        pthread_mutex_unlock(&book_of_work_mutex);
-                                        add_matching_states(current_candidates, 2 * q, 2 * s, EVEN_STATE);
-                                        work_required = false;
-                                    }
-                                }
+    generate_candidates_worker_thread(&thread_number[0]);
 
-                                if (work_required) { // we had no cached result. Need to calculate both odd and even
-                                    sl_cache[p][r][ODD_STATE].cache_status = WORK_IN_PROGRESS;
-                                    sl_cache[q][s][EVEN_STATE].cache_status = WORK_IN_PROGRESS;
-                                    pthread_mutex_unlock(&statelist_cache_mutex);
-                                    pthread_mutex_unlock(&book_of_work_mutex);
-
-                                    add_matching_states(current_candidates, 2 * p, 2 * r, ODD_STATE);
-                                    if (current_candidates->len[ODD_STATE]) {
-                                        // PrintAndLogEx(INFO, "Thread #%u: start working on even states q=%2d, s=%2d...", my_thread_number, q, s);
-                                        add_matching_states(current_candidates, 2 * q, 2 * s, EVEN_STATE);
-                                    } else { // no need to calculate even states yet
-                                        pthread_mutex_lock(&statelist_cache_mutex);
-                                        sl_cache[q][s][EVEN_STATE].cache_status = TO_BE_DONE;
-                                        pthread_mutex_unlock(&statelist_cache_mutex);
-                                        current_candidates->len[EVEN_STATE] = 0;
-                                        current_candidates->states[EVEN_STATE] = NULL;
-                                    }
-                                }
+    for (uint16_t i = 1; i < num_started; i++) {
+        pthread_join(thread_id[i], NULL);
+    }
 
-                                // update book of work
-                                pthread_mutex_lock(&book_of_work_mutex);
-                                book_of_work[p][q][r][s] = COMPLETED;
-                                pthread_mutex_unlock(&book_of_work_mutex);
-
-                                // if ((uint64_t)current_candidates->len[ODD_STATE] * current_candidates->len[EVEN_STATE]) {
-                                // PrintAndLogEx(INFO, "Candidates for p=%2u, q=%2u, r=%2u, s=%2u: %" PRIu32 " * %" PRIu32 " = %" PRIu64 " (2^%0.1f)\n",
-                                // 2*p, 2*q, 2*r, 2*s, current_candidates->len[ODD_STATE], current_candidates->len[EVEN_STATE],
-                                // (uint64_t)current_candidates->len[ODD_STATE] * current_candidates->len[EVEN_STATE],
-                                // log((uint64_t)current_candidates->len[ODD_STATE] * current_candidates->len[EVEN_STATE])/log(2));
-                                // uint32_t estimated_odd = estimated_num_states_part_sum(best_first_bytes[0], p, r, ODD_STATE);
-                                // uint32_t estimated_even= estimated_num_states_part_sum(best_first_bytes[0], q, s, EVEN_STATE);
-                                // uint64_t estimated_total = (uint64_t)estimated_odd * estimated_even;
-                                // PrintAndLogEx(INFO, "Estimated: %" PRIu32 " * %" PRIu32 " = %" PRIu64 " (2^%0.1f)\n", estimated_odd, estimated_even, estimated_total, log(estimated_total) / log(2));
-                                // if (estimated_odd < current_candidates->len[ODD_STATE] || estimated_even < current_candidates->len[EVEN_STATE]) {
-                                // PrintAndLogEx(INFO, "############################################################################ERROR! ESTIMATED < REAL !!!\n");
-                                // //exit(2);
-                                // }
-                                // }
-                            }
-                        }
-                    }
-                }
-            }
+    for (uint32_t i = 0; i < num_tasks; i++) {
+        if (tasks[i].chunk == 0) {
+            join_statelist_chunks(&sl_cache[tasks[i].part_sum_idx_a0][tasks[i].part_sum_idx_a8][tasks[i].odd_even]);
         }
-    } while (there_might_be_more_work);
-
-    return NULL;
+    }
 }
 
+static inline bool part_sums_match(uint8_t p, uint8_t q, uint16_t sum) {
+    return (2 * p * (16 - 2 * q) + (16 - 2 * p) * 2 * q == sum);
+}
 
 static void generate_candidates(uint8_t sum_a0_idx, uint8_t sum_a8_idx) {
 
-    // create mutexes for accessing the statelist cache and our "book of work"
-    pthread_mutex_init(&statelist_cache_mutex, NULL);
-    pthread_mutex_init(&book_of_work_mutex, NULL);
+    uint16_t sum_a0 = sums[sum_a0_idx];
+    uint16_t sum_a8 = sums[sum_a8_idx];
 
     init_statelist_cache();
-    init_book_of_work();
 
-    // create and run worker threads
-    pthread_t thread_id[NUM_REDUCTION_WORKING_THREADS];
+    sl_task_t tasks[NUM_PART_SUMS * NUM_PART_SUMS * SL_TASK_CHUNKS];
+    uint32_t num_tasks = 0;
 
-    uint16_t sums1[NUM_REDUCTION_WORKING_THREADS][3];
-    for (uint32_t i = 0; i < NUM_REDUCTION_WORKING_THREADS; i++) {
-        sums1[i][0] = sum_a0_idx;
-        sums1[i][1] = sum_a8_idx;
-        sums1[i][2] = i + 1;
-        pthread_create(thread_id + i, NULL, generate_candidates_worker_thread, sums1[i]);
+    // 1st round: all odd statelists which can contribute to Sum(a0) and Sum(a8)
+    for (uint8_t p = 0; p < NUM_PART_SUMS; p++) {
+        for (uint8_t r = 0; r < NUM_PART_SUMS; r++) {
+            bool a0_match = false;
+            bool a8_match = false;
+            for (uint8_t i = 0; i < NUM_PART_SUMS; i++) {
+                a0_match |= part_sums_match(p, i, sum_a0);
+                a8_match |= part_sums_match(r, i, sum_a8);
+            }
+            for (uint8_t chunk = 0; a0_match && a8_match && chunk < SL_TASK_CHUNKS; chunk++) {
+                tasks[num_tasks++] = (sl_task_t) {p, r, ODD_STATE, chunk};
+            }
+        }
     }
+    run_statelist_tasks(tasks, num_tasks);
 
-    // wait for threads to terminate:
-    for (uint32_t i = 0; i < NUM_REDUCTION_WORKING_THREADS; i++) {
-        pthread_join(thread_id[i], NULL);
+    // 2nd round: even statelists, only if at least one matching odd statelist is not empty
+    num_tasks = 0;
+    for (uint8_t q = 0; q < NUM_PART_SUMS; q++) {
+        for (uint8_t s = 0; s < NUM_PART_SUMS; s++) {
+            bool required = false;
+            for (uint8_t p = 0; p < NUM_PART_SUMS && required == false; p++) {
+                for (uint8_t r = 0; r < NUM_PART_SUMS && required == false; r++) {
+                    required = part_sums_match(p, q, sum_a0) && part_sums_match(r, s, sum_a8) && sl_cache[p][r][ODD_STATE].len;
+                }
+            }
+            for (uint8_t chunk = 0; required && chunk < SL_TASK_CHUNKS; chunk++) {
+                tasks[num_tasks++] = (sl_task_t) {q, s, EVEN_STATE, chunk};
+            }
+        }
+    }
+    run_statelist_tasks(tasks, num_tasks);
+
+    // all workers are joined and the cache is final. Link the candidate lists for brute_force_bs()
+    for (uint8_t p = 0; p < NUM_PART_SUMS; p++) {
+        for (uint8_t q = 0; q < NUM_PART_SUMS; q++) {
+            if (part_sums_match(p, q, sum_a0) == false) {
+                continue;
+            }
+            for (uint8_t r = 0; r < NUM_PART_SUMS; r++) {
+                for (uint8_t s = 0; s < NUM_PART_SUMS; s++) {
+                    if (part_sums_match(r, s, sum_a8) == false) {
+                        continue;
+                    }
+                    statelist_t *current_candidates = add_more_candidates();
+
+                    // if one of the lists is empty, there is nothing to brute force
+                    if (sl_cache[p][r][ODD_STATE].len && sl_cache[q][s][EVEN_STATE].len) {
+                        add_cached_states(current_candidates, 2 * p, 2 * r, ODD_STATE);
+                        add_cached_states(current_candidates, 2 * q, 2 * s, EVEN_STATE);
+                    }
+                }
+            }
+        }
     }
 
     maximum_states = 0;
@@ -2194,7 +2617,6 @@ static void init_it_all(void) {
     test_state[0] = 0;
     test_state[1] = 0;
     brute_force_per_second = 0;
-    init_book_of_work();
     real_sum_a8 = 0;
 
     memset(effective_bitflip, 0, sizeof(effective_bitflip));
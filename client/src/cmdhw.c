@@ -954,14 +954,14 @@ static int CmdConnect(const char *Cmd) {
         memcpy(port, g_conn.serial_port_name, sizeof(port));
     }
 
-    if (g_session.pm3_present) {
+    if (g_device->pm3_present) {
         CloseProxmark(g_session.current_device);
     }
 
     // 10 second timeout
     OpenProxmark(&g_session.current_device, port, false, 10, false, baudrate);
 
-    if (g_session.pm3_present && (TestProxmark(g_session.current_device) != PM3_SUCCESS)) {
+    if (g_device->pm3_present && (TestProxmark(g_session.current_device) != PM3_SUCCESS)) {
         PrintAndLogEx(ERR, _RED_("ERROR:") " cannot communicate with the Proxmark3\n");
         CloseProxmark(g_session.current_device);
         return PM3_ENOTTY;
@@ -1081,7 +1081,7 @@ void pm3_version_short(void) {
     PrintAndLogEx(NORMAL, "  [ " _CYAN_("Proxmark3 RFID instrument") " ]");
     PrintAndLogEx(NORMAL, "");
 
-    if (g_session.pm3_present) {
+    if (g_device->pm3_present) {
 
         PacketResponseNG resp;
         clearCommandBuffer();
@@ -1218,7 +1218,7 @@ void pm3_version(bool verbose, bool oneliner) {
     PrintAndLogEx(NORMAL, "  Python SWIG support....... " _YELLOW_("absent"));
 #endif
 
-    if (g_session.pm3_present) {
+    if (g_device->pm3_present) {
         PrintAndLogEx(NORMAL, "\n [ " _YELLOW_("PROXMARK3") " ]");
 
         PacketResponseNG resp;
@@ -65,6 +65,8 @@
 #include "cmdlfzx8211.h"    // for ZX8211 menu
 #include "crc.h"
 #include "pm3_cmd.h"        // for LF_CMDREAD_MAX_EXTRA_SYMBOLS
+#include "fileutils.h"      // for `lf batch`
+#include "util_posix.h"     // msclock
 
 static bool gs_lf_threshold_set = false;
 
@@ -262,7 +264,7 @@ int CmdLFCommandRead(const char *Cmd) {
     bool cm = arg_get_lit(ctx, 10);
     CLIParserFree(ctx);
 
-    if (g_session.pm3_present == false)
+    if (g_device->pm3_present == false)
         return PM3_ENOTTY;
 
 #define PAYLOAD_HEADER_SIZE (12 + (3 * LF_CMDREAD_MAX_EXTRA_SYMBOLS))
@@ -411,13 +413,16 @@ int CmdFlexdemod(const char *Cmd) {
 #endif
     int i, j, start, bit, sum;
 
-    int data[g_GraphTraceLen];
-    memcpy(data, g_GraphBuffer, g_GraphTraceLen);
+    int *data = calloc(g_GraphTraceLen, sizeof(int));
+    if (data == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
 
     size_t size = g_GraphTraceLen;
 
     for (i = 0; i < g_GraphTraceLen; ++i)
-        data[i] = (data[i] < 0) ? -1 : 1;
+        data[i] = (g_GraphBuffer[i] < 0) ? -1 : 1;
 
     for (start = 0; start < size - LONG_WAIT; start++) {
         int first = data[start];
@@ -432,6 +437,7 @@ int CmdFlexdemod(const char *Cmd) {
 
     if (start == size - LONG_WAIT) {
         PrintAndLogEx(WARNING, "nothing to wait for");
+        free(data);
         return PM3_ENODATA;
     }
 
@@ -460,6 +466,7 @@ int CmdFlexdemod(const char *Cmd) {
         if (sum < 0 && bits[bit] != 0) PrintAndLogEx(WARNING, "oops2 at %d", bit);
 
     }
+    free(data);
 
     // iceman,  use g_DemodBuffer?  blue line?
     // HACK writing back to graphbuffer.
@@ -519,7 +526,7 @@ int lf_config_savereset(sample_config *config) {
 }
 
 int lf_getconfig(sample_config *config) {
-    if (!g_session.pm3_present) return PM3_ENOTTY;
+    if (!g_device->pm3_present) return PM3_ENOTTY;
 
     if (config == NULL)
         return PM3_EINVARG;
@@ -537,7 +544,7 @@ int lf_getconfig(sample_config *config) {
 }
 
 int lf_config(sample_config *config) {
-    if (!g_session.pm3_present) return PM3_ENOTTY;
+    if (!g_device->pm3_present) return PM3_ENOTTY;
 
     clearCommandBuffer();
     if (config != NULL)
@@ -592,7 +599,7 @@ int CmdLFConfig(const char *Cmd) {
     int16_t trigg = arg_get_int_def(ctx, 10, -1);
     CLIParserFree(ctx);
 
-    if (g_session.pm3_present == false)
+    if (g_device->pm3_present == false)
         return PM3_ENOTTY;
 
     // if called with no params, just print the device config
@@ -675,7 +682,7 @@ int CmdLFConfig(const char *Cmd) {
 }
 
 int lf_read(bool verbose, uint32_t samples) {
-    if (!g_session.pm3_present) return PM3_ENOTTY;
+    if (!g_device->pm3_present) return PM3_ENOTTY;
 
     struct p {
         uint32_t samples : 31;
@@ -727,7 +734,7 @@ int CmdLFRead(const char *Cmd) {
     bool cm = arg_get_lit(ctx, 3);
     CLIParserFree(ctx);
 
-    if (g_session.pm3_present == false)
+    if (g_device->pm3_present == false)
         return PM3_ENOTTY;
 
     if (cm) {
@@ -741,7 +748,7 @@ int CmdLFRead(const char *Cmd) {
 }
 
 int lf_sniff(bool verbose, uint32_t samples) {
-    if (!g_session.pm3_present) return PM3_ENOTTY;
+    if (!g_device->pm3_present) return PM3_ENOTTY;
 
     struct p {
         uint32_t samples : 31;
@@ -795,7 +802,7 @@ int CmdLFSniff(const char *Cmd) {
     bool cm = arg_get_lit(ctx, 3);
     CLIParserFree(ctx);
 
-    if (g_session.pm3_present == false)
+    if (g_device->pm3_present == false)
         return PM3_ENOTTY;
 
     if (cm) {
@@ -887,7 +894,7 @@ int CmdLFSim(const char *Cmd) {
     uint16_t gap = arg_get_u32_def(ctx, 1, 0);
     CLIParserFree(ctx);
 
-    if (g_session.pm3_present == false) {
+    if (g_device->pm3_present == false) {
         PrintAndLogEx(DEBUG, "DEBUG: no proxmark present");
         return PM3_ENOTTY;
     }
@@ -1420,6 +1427,304 @@ out:
     return retval;
 }
 
+// lf search runs every demodulator on the same graph. Each one works on a
+// private demod buffer and its output is held back, so they can run in
+// parallel while the results are still reported in the order below.
+typedef struct {
+    int (*demod)(bool verbose);
+    const char *name;   // NULL if the demod reports a hit itself
+    const char *modulation;
+} lf_search_item_t;
+
+static const lf_search_item_t lf_search_known[] = {
+    // ask / man
+    { demodEM410x,      "EM410x ID",               "ASK/Manchester" },
+    { demodDestron,     "FDX-A FECAVA Destron ID", "ASK/Manchester" },  // to do before HID
+    { demodGallagher,   "GALLAGHER ID",            "ASK/Manchester" },
+    { demodNoralsy,     "Noralsy ID",              "ASK/Manchester" },
+    { demodPresco,      "Presco ID",               "ASK/Manchester" },
+    { demodSecurakey,   "Securakey ID",            "ASK/Manchester" },
+    { demodViking,      "Viking ID",               "ASK/Manchester" },
+    { demodVisa2k,      "Visa2000 ID",             "ASK/Manchester" },
+    // ask / bi
+    { demodFDXB,        "FDX-B ID",                "ASK/Biphase" },
+    { demodJablotron,   "Jablotron ID",            "ASK/Biphase" },
+    { demodGuard,       "Guardall G-Prox II ID",   "ASK/Biphase" },
+    { demodNedap,       "NEDAP ID",                "ASK/Biphase" },
+    // nrz
+    { demodPac,         "PAC/Stanley ID",          "NRZ" },
+    // fsk
+    { demodHID,         "HID Prox ID",             "FSK" },
+    { demodAWID,        "AWID ID",                 "FSK" },
+    { demodIOProx,      "IO Prox ID",              "FSK" },
+    { demodPyramid,     "Pyramid ID",              "FSK" },
+    { demodParadox,     "Paradox ID",              "FSK" },
+    // psk
+    { demodIdteck,      "Idteck ID",               "PSK" },
+    { demodKeri,        "KERI ID",                 "PSK" },
+    { demodNexWatch,    "NexWatch ID",             "PSK" },
+    { demodIndala,      "Indala ID",               "PSK" },
+    // { demodTI,       "Texas Instrument ID" },
+    // { demodFermax,   "Fermax ID" },
+};
+
+static int lf_search_autocorrelate(bool verbose) {
+    (void) verbose;
+    int ans = AutoCorrelate(g_GraphBuffer, g_GraphBuffer, g_GraphTraceLen, 8000, false, false);
+    if (ans > 0) {
+
+        PrintAndLogEx(INFO, "Possible auto correlation of %d repeating samples", ans);
+
+        if (ans % 8 == 0)
+            PrintAndLogEx(INFO, "Possible %d bytes", (ans / 8));
+    }
+    // never a hit on its own
+    return PM3_ESOFT;
+}
+
+static int lf_search_unknown_fsk(bool verbose) {
+    if (GetFskClock("", false) == 0)
+        return PM3_ESOFT;
+
+    if (FSKrawDemod(0, 0, 0, 0, verbose) != PM3_SUCCESS)
+        return PM3_ESOFT;
+
+    PrintAndLogEx(INFO, "Unknown FSK Modulated Tag found!");
+    return PM3_SUCCESS;
+}
+
+static int lf_search_unknown_ask(bool verbose) {
+    bool st = true;
+    if (ASKDemod_ext(0, 0, 0, 0, false, verbose, false, 1, &st) != PM3_SUCCESS)
+        return PM3_ESOFT;
+
+    PrintAndLogEx(INFO, "Unknown ASK Modulated and Manchester encoded Tag found!");
+    PrintAndLogEx(INFO, "if it does not look right it could instead be ASK/Biphase - try " _YELLOW_("'data rawdemod --ab'"));
+    return PM3_SUCCESS;
+}
+
+// same as `data rawdemod --p1`
+static int lf_search_unknown_psk(bool verbose) {
+    if (PSKDemod(0, 0, 100, verbose) != PM3_SUCCESS) {
+        if (g_debugMode) PrintAndLogEx(ERR, "Error demoding: %d", PM3_ESOFT);
+        return PM3_ESOFT;
+    }
+    PrintAndLogEx(SUCCESS, _YELLOW_("PSK1") " demoded bitstream");
+    PrintAndLogEx(INFO, "----------------------");
+    printDemodBuff(0, false, false, false);
+
+    PrintAndLogEx(INFO, "Possible unknown PSK1 Modulated Tag found above!");
+    PrintAndLogEx(INFO, "    Could also be PSK2 - try " _YELLOW_("'data rawdemod --p2'"));
+    PrintAndLogEx(INFO, "    Could also be PSK3 - [currently not supported]");
+    PrintAndLogEx(INFO, "    Could also be  NRZ - try " _YELLOW_("'data rawdemod --nr"));
+    return PM3_SUCCESS;
+}
+
+static const lf_search_item_t lf_search_unknown[] = {
+    { lf_search_autocorrelate,  NULL },
+    { lf_search_unknown_fsk,    NULL },
+    { lf_search_unknown_ask,    NULL },
+    { lf_search_unknown_psk,    NULL },
+};
+
+typedef struct {
+    const lf_search_item_t *item;
+    int res;
+    bool done;
+    demod_buf_t *demod;
+    print_capture_t out;
+} lf_search_job_t;
+
+typedef struct {
+    lf_search_job_t *jobs;
+    size_t count;
+    size_t next;
+    bool stop;
+    const demod_buf_t *snapshot;
+    signal_t signal;
+    pm3_device_t *dev;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} lf_search_sweep_t;
+
+// Demodulators only read the graph while the sweep runs. Do the in place
+// conversions the first demodulators would have done up front.
+static void lf_search_prepare(void) {
+    // em410x / hid simulation etc uses 0/1 as signal data
+    if (isGraphBitstream()) {
+        convertGraphFromBitstream();
+    }
+
+    // getFromGraphBuf() clips the graph to 8 bit samples
+    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN, sizeof(uint8_t));
+    if (bits != NULL) {
+        getFromGraphBuf(bits);
+        free(bits);
+    }
+}
+
+static void *lf_search_worker(void *arg) {
+    lf_search_sweep_t *sw = (lf_search_sweep_t *)arg;
+    // demodulators run as part of the command, on its device
+    UseProxmark(sw->dev);
+
+    for (;;) {
+        pthread_mutex_lock(&sw->lock);
+        if (sw->stop || sw->next >= sw->count) {
+            pthread_mutex_unlock(&sw->lock);
+            break;
+        }
+        lf_search_job_t *job = &sw->jobs[sw->next++];
+        pthread_mutex_unlock(&sw->lock);
+
+        job->res = PM3_EMALLOC;
+        job->demod = calloc(1, sizeof(demod_buf_t));
+        if (job->demod != NULL) {
+            memcpy(job->demod, sw->snapshot, sizeof(demod_buf_t));
+            // signal properties are per thread too
+            *getSignalProperties() = sw->signal;
+
+            demod_buf_use(job->demod);
+            PrintAndLogEx_capture(&job->out);
+            job->res = job->item->demod(true);
+            PrintAndLogEx_capture(NULL);
+            demod_buf_use(NULL);
+        }
+
+        pthread_mutex_lock(&sw->lock);
+        job->done = true;
+        pthread_cond_broadcast(&sw->cond);
+        pthread_mutex_unlock(&sw->lock);
+    }
+    return NULL;
+}
+
+static bool lf_search_report(const lf_search_item_t *item, int res, bool search_cont, int *found) {
+    if (res != PM3_SUCCESS)
+        return false;
+
+    if (item->name)
+        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("%s") " found!", item->name);
+
+    (*found)++;
+    return (search_cont == false);
+}
+
+static bool lf_search_serial(const lf_search_item_t *items, size_t count, bool search_cont, int *found) {
+    for (size_t i = 0; i < count; i++) {
+        if (lf_search_report(&items[i], items[i].demod(true), search_cont, found))
+            return true;
+    }
+    return false;
+}
+
+static bool lf_search_parallel(const lf_search_item_t *items, size_t count, int nthreads, bool search_cont, int *found) {
+
+    lf_search_sweep_t sw = {
+        .count = count,
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .cond = PTHREAD_COND_INITIALIZER,
+    };
+
+    sw.jobs = calloc(count, sizeof(lf_search_job_t));
+    demod_buf_t *snapshot = calloc(1, sizeof(demod_buf_t));
+    pthread_t *threads = calloc(nthreads, sizeof(pthread_t));
+    if (sw.jobs == NULL || snapshot == NULL || threads == NULL) {
+        free(sw.jobs);
+        free(snapshot);
+        free(threads);
+        return lf_search_serial(items, count, search_cont, found);
+    }
+
+    demod_buf_snapshot(snapshot);
+    sw.snapshot = snapshot;
+    sw.signal = *getSignalProperties();
+    sw.dev = g_device;
+    for (size_t i = 0; i < count; i++)
+        sw.jobs[i].item = &items[i];
+
+    int started = 0;
+    for (; started < nthreads; started++) {
+        if (pthread_create(&threads[started], NULL, lf_search_worker, &sw) != 0)
+            break;
+    }
+
+    if (started == 0) {
+        free(threads);
+        free(snapshot);
+        free(sw.jobs);
+        return lf_search_serial(items, count, search_cont, found);
+    }
+
+    // report in table order, a hit without -c cancels the jobs not started yet
+    bool stop = false;
+    size_t last = 0;
+    for (size_t i = 0; i < count && stop == false; i++) {
+        pthread_mutex_lock(&sw.lock);
+        while (sw.jobs[i].done == false)
+            pthread_cond_wait(&sw.cond, &sw.lock);
+        pthread_mutex_unlock(&sw.lock);
+
+        PrintAndLogEx_replay(&sw.jobs[i].out);
+        last = i;
+
+        stop = lf_search_report(&items[i], sw.jobs[i].res, search_cont, found);
+        if (stop) {
+            pthread_mutex_lock(&sw.lock);
+            sw.stop = true;
+            pthread_mutex_unlock(&sw.lock);
+        }
+    }
+
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    // leave the demod buffer like running them one after the other would,
+    // with the result of the last reported demodulator that changed it
+    for (size_t i = last + 1; i-- > 0;) {
+        const demod_buf_t *d = sw.jobs[i].demod;
+        if (d == NULL)
+            continue;
+
+        if (d->len != snapshot->len || d->start_idx != snapshot->start_idx || d->clock != snapshot->clock ||
+                d->grid || d->markers || memcmp(d->buffer, snapshot->buffer, d->len) != 0) {
+            demod_buf_commit(d);
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        // jobs which finished after the search stopped are not reported
+        PrintAndLogEx_capture_free(&sw.jobs[i].out);
+        free(sw.jobs[i].demod);
+    }
+
+    pthread_mutex_destroy(&sw.lock);
+    pthread_cond_destroy(&sw.cond);
+    free(threads);
+    free(snapshot);
+    free(sw.jobs);
+    return stop;
+}
+
+// runs the demodulators, returns true when the search should stop
+static bool lf_search_sweep(const lf_search_item_t *items, size_t count, int nthreads, bool search_cont, int *found) {
+
+    if (nthreads > (int)count)
+        nthreads = count;
+
+    demod_cache_begin();
+
+    bool stop;
+    if (nthreads > 1)
+        stop = lf_search_parallel(items, count, nthreads, search_cont, found);
+    else
+        stop = lf_search_serial(items, count, search_cont, found);
+
+    demod_cache_end();
+    return stop;
+}
+
 int CmdLFfind(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -1436,15 +1741,17 @@ int CmdLFfind(const char *Cmd) {
         arg_lit0("1", NULL, "Use data from Graphbuffer to search"),
         arg_lit0("c", NULL, "Continue searching even after a first hit"),
         arg_lit0("u", NULL, "Search for unknown tags. If not set, reads only known tags"),
+        arg_int0(NULL, "threads", "<dec>", "Number of demodulator threads (def: number of logical CPUs)"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     bool use_gb = arg_get_lit(ctx, 1);
     bool search_cont = arg_get_lit(ctx, 2);
     bool search_unk = arg_get_lit(ctx, 3);
+    int nthreads = arg_get_int_def(ctx, 4, num_CPUs());
     CLIParserFree(ctx);
     int found = 0;
-    bool is_online = (g_session.pm3_present && (use_gb == false));
+    bool is_online = (g_device->pm3_present && (use_gb == false));
     if (is_online)
         lf_read(false, 30000);
 
@@ -1529,275 +1836,320 @@ int CmdLFfind(const char *Cmd) {
 
     int retval = PM3_SUCCESS;
 
-    // ask / man
-    if (demodEM410x(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("EM410x ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodDestron(true) == PM3_SUCCESS) { // to do before HID
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("FDX-A FECAVA Destron ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodGallagher(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("GALLAGHER ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodNoralsy(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Noralsy ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodPresco(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Presco ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodSecurakey(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Securakey ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodViking(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Viking ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodVisa2k(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Visa2000 ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
+    lf_search_prepare();
 
-    // ask / bi
-    if (demodFDXB(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("FDX-B ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodJablotron(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Jablotron ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
-    }
-    if (demodGuard(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Guardall G-Prox II ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
+    if (lf_search_sweep(lf_search_known, ARRAYLEN(lf_search_known), nthreads, search_cont, &found))
+        goto out;
+
+    if (found == 0) {
+        PrintAndLogEx(FAILED, _RED_("No known 125/134 kHz tags found!"));
     }
-    if (demodNedap(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("NEDAP ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
+
+    if (search_unk) {
+        //test unknown tag formats (raw mode)
+        PrintAndLogEx(INFO, "\nChecking for unknown tags:\n");
+
+        if (lf_search_sweep(lf_search_unknown, ARRAYLEN(lf_search_unknown), nthreads, search_cont, &found))
             goto out;
+
+        if (found == 0) {
+            PrintAndLogEx(FAILED, _RED_("No data found!"));
         }
     }
 
-    // nrz
-    if (demodPac(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("PAC/Stanley ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
+    if (found == 0) {
+        retval = PM3_ESOFT;
     }
 
-    // fsk
-    if (demodHID(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("HID Prox ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
+out:
+    // identify chipset
+    if (CheckChipType(is_online) == false) {
+        PrintAndLogEx(DEBUG, "Automatic chip type detection " _RED_("failed"));
     }
-    if (demodAWID(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("AWID ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
+    return retval;
+}
+
+// lf batch runs the known tag demodulators over a directory of traces.
+// Every worker thread has its own graph and demod buffer, results are
+// written in file name order.
+typedef struct {
+    const char *path;
+    char *json;
+    size_t samples;
+    bool hit;
+    bool error;
+    bool done;
+} lf_batch_job_t;
+
+typedef struct {
+    lf_batch_job_t *jobs;
+    size_t count;
+    size_t next;
+    pm3_device_t *dev;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} lf_batch_t;
+
+typedef struct {
+    lf_batch_t *batch;
+    graph_t graph;
+    demod_buf_t demod;
+} lf_batch_worker_t;
+
+static void lf_batch_analyse(lf_batch_job_t *job) {
+    uint64_t t1 = msclock();
+
+    // demodulators are chatty, keep them off the console
+    print_capture_t out = {0};
+    PrintAndLogEx_capture(&out);
+
+    // a demodulator may hand out bits past the ones it decoded,
+    // start every trace from a clean buffer to keep the results reproducible
+    memset(g_demod, 0, sizeof(demod_buf_t));
+
+    json_t *root = json_object();
+    json_object_set_new(root, "file", json_string(job->path));
+
+    if (loadSamplesFromFile(job->path, false) != PM3_SUCCESS) {
+        json_object_set_new(root, "error", json_string("failed to load file"));
+        job->error = true;
+        goto out;
     }
-    if (demodIOProx(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("IO Prox ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
+
+    job->samples = g_GraphTraceLen;
+    json_object_set_new(root, "samples", json_integer(g_GraphTraceLen));
+    json_object_set_new(root, "noise", json_boolean(getSignalProperties()->isnoise));
+
+    const lf_search_item_t *hit = NULL;
+    if (g_GraphTraceLen >= 2000) {
+        lf_search_prepare();
+        for (size_t i = 0; i < ARRAYLEN(lf_search_known); i++) {
+            if (lf_search_known[i].demod(false) == PM3_SUCCESS) {
+                hit = &lf_search_known[i];
+                break;
+            }
         }
     }
-    if (demodPyramid(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Pyramid ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
+
+    if (hit) {
+        job->hit = true;
+        json_object_set_new(root, "tag", json_string(hit->name));
+        json_object_set_new(root, "modulation", json_string(hit->modulation));
+        json_object_set_new(root, "clock", json_integer(g_DemodClock));
+        json_object_set_new(root, "bits", json_integer(g_DemodBufferLen));
+
+        size_t hexlen = g_DemodBufferLen / 4 + 16;
+        char *hex = calloc(hexlen, sizeof(char));
+        if (hex) {
+            binarraytohex(hex, hexlen, (const char *)g_DemodBuffer, g_DemodBufferLen);
+            json_object_set_new(root, "raw", json_string(hex));
+            free(hex);
         }
+    } else {
+        json_object_set_new(root, "tag", json_null());
     }
-    if (demodParadox(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Paradox ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
+
+out:
+    PrintAndLogEx_capture(NULL);
+    PrintAndLogEx_capture_free(&out);
+
+    json_object_set_new(root, "ms", json_integer(msclock() - t1));
+    job->json = json_dumps(root, JSON_COMPACT | JSON_PRESERVE_ORDER);
+    json_decref(root);
+}
+
+static void *lf_batch_worker(void *arg) {
+    lf_batch_worker_t *w = (lf_batch_worker_t *)arg;
+    lf_batch_t *b = w->batch;
+
+    UseProxmark(b->dev);
+    graph_use(&w->graph);
+    demod_buf_use(&w->demod);
+
+    for (;;) {
+        pthread_mutex_lock(&b->lock);
+        if (b->next >= b->count) {
+            pthread_mutex_unlock(&b->lock);
+            break;
         }
+        lf_batch_job_t *job = &b->jobs[b->next++];
+        pthread_mutex_unlock(&b->lock);
+
+        lf_batch_analyse(job);
+
+        pthread_mutex_lock(&b->lock);
+        job->done = true;
+        pthread_cond_broadcast(&b->cond);
+        pthread_mutex_unlock(&b->lock);
     }
 
-    // psk
-    if (demodIdteck(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Idteck ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
+    graph_free();
+    graph_use(NULL);
+    demod_buf_use(NULL);
+    return NULL;
+}
+
+static int CmdLFBatch(const char *Cmd) {
+
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "lf batch",
+                  "Offline search for known tags in every .pm3 trace of a directory.\n"
+                  "Writes one JSON line per trace: file, samples, tag, modulation, clock, raw demodulated bits, time taken.\n"
+                  "The traces are analysed in parallel, the graph and demod buffer are left untouched.",
+                  "lf batch -d traces/\n"
+                  "lf batch -d /captures --threads 4 -f results.jsonl"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str1("d", "dir", "<path>", "Directory with .pm3 traces"),
+        arg_str0("f", "file", "<fn>", "Write the JSON lines to file instead of the console"),
+        arg_int0(NULL, "threads", "<dec>", "Number of worker threads (def: number of logical CPUs)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    int dlen = 0;
+    char dir[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)dir, FILE_PATH_SIZE, &dlen);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 2), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    int nthreads = arg_get_int_def(ctx, 3, num_CPUs());
+    CLIParserFree(ctx);
+
+    if (nthreads < 1)
+        nthreads = 1;
+
+    char **files = NULL;
+    size_t count = 0;
+    int res = listFilesBySuffix(dir, ".pm3", &files, &count);
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(ERR, "couldn't read directory " _YELLOW_("%s"), dir);
+        return res;
     }
-    if (demodKeri(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("KERI ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
+
+    if (count == 0) {
+        PrintAndLogEx(WARNING, "no .pm3 traces found in " _YELLOW_("%s"), dir);
+        free(files);
+        return PM3_EFILE;
     }
-    if (demodNexWatch(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("NexWatch ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
+
+    FILE *f = NULL;
+    if (fnlen) {
+        f = fopen(filename, "w");
+        if (f == NULL) {
+            PrintAndLogEx(ERR, "couldn't create " _YELLOW_("%s"), filename);
+            for (size_t i = 0; i < count; i++)
+                free(files[i]);
+            free(files);
+            return PM3_EFILE;
         }
     }
-    if (demodIndala(true) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Indala ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
+
+    if (nthreads > (int)count)
+        nthreads = count;
+
+    lf_batch_t b = {
+        .count = count,
+        .dev = g_device,
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .cond = PTHREAD_COND_INITIALIZER,
+    };
+
+    b.jobs = calloc(count, sizeof(lf_batch_job_t));
+    lf_batch_worker_t *workers = calloc(nthreads, sizeof(lf_batch_worker_t));
+    pthread_t *threads = calloc(nthreads, sizeof(pthread_t));
+    if (b.jobs == NULL || workers == NULL || threads == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        res = PM3_EMALLOC;
+        goto out;
     }
-    /*
-    if (demodTI() == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Texas Instrument ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
-            goto out;
-        }
+
+    for (size_t i = 0; i < count; i++)
+        b.jobs[i].path = files[i];
+
+    PrintAndLogEx(INFO, "Analysing " _YELLOW_("%zu") " traces with " _YELLOW_("%d") " threads...", count, nthreads);
+
+    uint64_t t1 = msclock();
+
+    int started = 0;
+    for (; started < nthreads; started++) {
+        workers[started].batch = &b;
+        if (pthread_create(&threads[started], NULL, lf_batch_worker, &workers[started]) != 0)
+            break;
     }
-    if (demodFermax() == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Fermax ID") " found!");
-        if (search_cont) {
-            found++;
-        } else {
+
+    // no thread at all, do it from here
+    if (started == 0) {
+        lf_batch_worker_t *w = calloc(1, sizeof(lf_batch_worker_t));
+        if (w == NULL) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            res = PM3_EMALLOC;
             goto out;
         }
-    }
-    */
-    if (found == 0) {
-        PrintAndLogEx(FAILED, _RED_("No known 125/134 kHz tags found!"));
+        w->batch = &b;
+        lf_batch_worker(w);
+        free(w);
     }
 
-    if (search_unk) {
-        //test unknown tag formats (raw mode)
-        PrintAndLogEx(INFO, "\nChecking for unknown tags:\n");
-        int ans = AutoCorrelate(g_GraphBuffer, g_GraphBuffer, g_GraphTraceLen, 8000, false, false);
-        if (ans > 0) {
-
-            PrintAndLogEx(INFO, "Possible auto correlation of %d repeating samples", ans);
+    size_t hits = 0, errors = 0, samples = 0;
+    for (size_t i = 0; i < count; i++) {
+        pthread_mutex_lock(&b.lock);
+        while (b.jobs[i].done == false)
+            pthread_cond_wait(&b.cond, &b.lock);
+        pthread_mutex_unlock(&b.lock);
 
-            if (ans % 8 == 0)
-                PrintAndLogEx(INFO, "Possible %d bytes", (ans / 8));
+        lf_batch_job_t *job = &b.jobs[i];
+        if (job->json) {
+            if (f)
+                fprintf(f, "%s\n", job->json);
+            else
+                PrintAndLogEx(NORMAL, "%s", job->json);
         }
+        free(job->json);
+        job->json = NULL;
 
-        //fsk
-        if (GetFskClock("", false)) {
-            if (FSKrawDemod(0, 0, 0, 0, true) == PM3_SUCCESS) {
-                PrintAndLogEx(INFO, "Unknown FSK Modulated Tag found!");
-                if (search_cont) {
-                    found++;
-                } else {
-                    goto out;
-                }
-            }
-        }
+        hits += job->hit;
+        errors += job->error;
+        samples += job->samples;
+    }
 
-        bool st = true;
-        if (ASKDemod_ext(0, 0, 0, 0, false, true, false, 1, &st) == PM3_SUCCESS) {
-            PrintAndLogEx(INFO, "Unknown ASK Modulated and Manchester encoded Tag found!");
-            PrintAndLogEx(INFO, "if it does not look right it could instead be ASK/Biphase - try " _YELLOW_("'data rawdemod --ab'"));
-            if (search_cont) {
-                found++;
-            } else {
-                goto out;
-            }
-        }
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
 
-        if (CmdPSK1rawDemod("") == PM3_SUCCESS) {
-            PrintAndLogEx(INFO, "Possible unknown PSK1 Modulated Tag found above!");
-            PrintAndLogEx(INFO, "    Could also be PSK2 - try " _YELLOW_("'data rawdemod --p2'"));
-            PrintAndLogEx(INFO, "    Could also be PSK3 - [currently not supported]");
-            PrintAndLogEx(INFO, "    Could also be  NRZ - try " _YELLOW_("'data rawdemod --nr"));
-            if (search_cont) {
-                found++;
-            } else {
-                goto out;
-            }
-        }
+    uint64_t t2 = msclock() - t1;
+    if (t2 == 0)
+        t2 = 1;
 
-        if (found == 0) {
-            PrintAndLogEx(FAILED, _RED_("No data found!"));
-        }
-    }
+    if (f)
+        PrintAndLogEx(SUCCESS, "saved results to " _YELLOW_("%s"), filename);
 
-    if (found == 0) {
-        retval = PM3_ESOFT;
-    }
+    PrintAndLogEx(SUCCESS, "traces......... " _YELLOW_("%zu"), count);
+    PrintAndLogEx(SUCCESS, "tags found..... " _GREEN_("%zu"), hits);
+    if (errors)
+        PrintAndLogEx(SUCCESS, "load errors.... " _RED_("%zu"), errors);
+    PrintAndLogEx(SUCCESS, "time........... " _YELLOW_("%.3f") " s", (float)t2 / 1000.0);
+    PrintAndLogEx(SUCCESS, "throughput..... " _YELLOW_("%.1f") " traces/s, " _YELLOW_("%.2f") " Msamples/s"
+                  , (float)count * 1000.0 / t2
+                  , (float)samples / 1000.0 / t2
+                 );
 
 out:
-    // identify chipset
-    if (CheckChipType(is_online) == false) {
-        PrintAndLogEx(DEBUG, "Automatic chip type detection " _RED_("failed"));
-    }
-    return retval;
+    if (f)
+        fclose(f);
+
+    pthread_mutex_destroy(&b.lock);
+    pthread_cond_destroy(&b.cond);
+    free(threads);
+    free(workers);
+    free(b.jobs);
+    for (size_t i = 0; i < count; i++)
+        free(files[i]);
+    free(files);
+    return res;
 }
 
 static command_t CommandTable[] = {
@@ -1833,6 +2185,7 @@ static command_t CommandTable[] = {
     {"visa2000",    CmdLFVisa2k,        AlwaysAvailable, "{ Visa2000 RFIDs...          }"},
 //    {"zx",          CmdLFZx8211,        AlwaysAvailable, "{ ZX8211 RFIDs...            }"},
     {"-----------", CmdHelp,            AlwaysAvailable, "--------------------- " _CYAN_("General") " ---------------------"},
+    {"batch",       CmdLFBatch,         AlwaysAvailable, "Search for known tags in a directory of traces"},
     {"config",      CmdLFConfig,        IfPm3Lf,         "Get/Set config for LF sampling, bit/sample, decimation, frequency"},
     {"cmdread",     CmdLFCommandRead,   IfPm3Lf,         "Modulate LF reader field to send command before read"},
     {"read",        CmdLFRead,          IfPm3Lf,         "Read LF tag"},
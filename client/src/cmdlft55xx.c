@@ -787,7 +787,7 @@ static bool DecodeT5555TraceBlock(void) {
 
 // sanity check. Don't use proxmark if it is offline and you didn't specify useGraphbuf
 static int SanityOfflineCheck(bool useGraphBuffer) {
-    if (!useGraphBuffer && !g_session.pm3_present) {
+    if (!useGraphBuffer && !g_device->pm3_present) {
         PrintAndLogEx(WARNING, "Your proxmark3 device is offline. Specify [1] to use graphbuffer data instead");
         return PM3_ENODATA;
     }
@@ -1318,179 +1318,15 @@ void printT55xxBlock(uint8_t blockNum, bool page1) {
     PrintAndLogEx(SUCCESS, " %02d | %08X | %s | %s", blockNum, val, sprint_bytebits_bin(g_DemodBuffer + config.offset, 32), sprint_ascii(bytes, 4));
 }
 
-static bool testModulation(uint8_t mode, uint8_t modread) {
-    switch (mode) {
-        case DEMOD_FSK:
-            if (modread >= DEMOD_FSK1 && modread <= DEMOD_FSK2a) return true;
-            break;
-        case DEMOD_ASK:
-            if (modread == DEMOD_ASK) return true;
-            break;
-        case DEMOD_PSK1:
-            if (modread == DEMOD_PSK1) return true;
-            break;
-        case DEMOD_PSK2:
-            if (modread == DEMOD_PSK2) return true;
-            break;
-        case DEMOD_PSK3:
-            if (modread == DEMOD_PSK3) return true;
-            break;
-        case DEMOD_NRZ:
-            if (modread == DEMOD_NRZ) return true;
-            break;
-        case DEMOD_BI:
-            if (modread == DEMOD_BI) return true;
-            break;
-        case DEMOD_BIa:
-            if (modread == DEMOD_BIa) return true;
-            break;
-        default:
-            return false;
-    }
-    return false;
-}
-
-static bool testQ5Modulation(uint8_t mode, uint8_t modread) {
-    switch (mode) {
-        case DEMOD_FSK:
-            if (modread >= 4 && modread <= 5) return true;
-            break;
-        case DEMOD_ASK:
-            if (modread == 0) return true;
-            break;
-        case DEMOD_PSK1:
-            if (modread == 1) return true;
-            break;
-        case DEMOD_PSK2:
-            if (modread == 2) return true;
-            break;
-        case DEMOD_PSK3:
-            if (modread == 3) return true;
-            break;
-        case DEMOD_NRZ:
-            if (modread == 7) return true;
-            break;
-        case DEMOD_BI:
-            if (modread == 6) return true;
-            break;
-        default:
-            return false;
-    }
-    return false;
-}
-
-static int convertQ5bitRate(uint8_t bitRateRead) {
-    const uint8_t expected[] = {8, 16, 32, 40, 50, 64, 100, 128};
-    for (int i = 0; i < 8; i++)
-        if (expected[i] == bitRateRead)
-            return i;
-
-    return -1;
-}
-
-static bool testQ5(uint8_t mode, uint8_t *offset, int *fndBitRate, uint8_t clk) {
-
-    if (g_DemodBufferLen < 64) return false;
-
-    for (uint8_t idx = 28; idx < 64; idx++) {
-        uint8_t si = idx;
-        if (PackBits(si, 28, g_DemodBuffer) == 0x00) continue;
-
-        uint8_t safer     = PackBits(si, 4, g_DemodBuffer);
-        si += 4;     //master key
-        uint8_t resv      = PackBits(si, 8, g_DemodBuffer);
-        si += 8;
-        // 2nibble must be zeroed.
-        if (safer != 0x6 && safer != 0x9) continue;
-        if (resv > 0x00) continue;
-        //uint8_t pageSel   = PackBits(si, 1, g_DemodBuffer); si += 1;
-        //uint8_t fastWrite = PackBits(si, 1, g_DemodBuffer); si += 1;
-        si += 1 + 1;
-        int bitRate       = PackBits(si, 6, g_DemodBuffer) * 2 + 2;
-        si += 6;     //bit rate
-        if (bitRate > 128 || bitRate < 8) continue;
-
-        //uint8_t AOR       = PackBits(si, 1, g_DemodBuffer); si += 1;
-        //uint8_t PWD       = PackBits(si, 1, g_DemodBuffer); si += 1;
-        //uint8_t pskcr     = PackBits(si, 2, g_DemodBuffer); si += 2;  //could check psk cr
-        //uint8_t inverse   = PackBits(si, 1, g_DemodBuffer); si += 1;
-        si += 1 + 1 + 2 + 1;
-        uint8_t modread   = PackBits(si, 3, g_DemodBuffer);
-        si += 3;
-        uint8_t maxBlk    = PackBits(si, 3, g_DemodBuffer);
-        si += 3;
-        //uint8_t ST        = PackBits(si, 1, g_DemodBuffer); si += 1;
-        if (maxBlk == 0) continue;
-
-        //test modulation
-        if (!testQ5Modulation(mode, modread)) continue;
-        if (bitRate != clk) continue;
-
-        *fndBitRate = convertQ5bitRate(bitRate);
-        if (*fndBitRate < 0) continue;
-
-        *offset = idx;
-
-        return true;
-    }
-    return false;
-}
-
-static bool testBitRate(uint8_t readRate, uint8_t clk) {
-    const uint8_t expected[] = {8, 16, 32, 40, 50, 64, 100, 128};
-    if (expected[readRate] == clk)
-        return true;
-
-    return false;
-}
-
 bool test(uint8_t mode, uint8_t *offset, int *fndBitRate, uint8_t clk, bool *Q5) {
+    t55xx_block0_t found;
+    if (t55xx_block0_find(g_DemodBuffer, g_DemodBufferLen, mode, clk, &found) == false)
+        return false;
 
-    if (g_DemodBufferLen < 64) return false;
-    for (uint8_t idx = 28; idx < 64; idx++) {
-        uint8_t si = idx;
-        if (PackBits(si, 28, g_DemodBuffer) == 0x00) continue;
-
-        uint8_t safer    = PackBits(si, 4, g_DemodBuffer);
-        si += 4;     //master key
-        uint8_t resv     = PackBits(si, 4, g_DemodBuffer);
-        si += 4;     //was 7 & +=7+3 //should be only 4 bits if extended mode
-        // 2nibble must be zeroed.
-        // moved test to here, since this gets most faults first.
-        if (resv > 0x00) continue;
-
-        int bitRate      = PackBits(si, 6, g_DemodBuffer);
-        si += 6;     //bit rate (includes extended mode part of rate)
-        uint8_t extend   = PackBits(si, 1, g_DemodBuffer);
-        si += 1;     //bit 15 extended mode
-        uint8_t modread  = PackBits(si, 5, g_DemodBuffer);
-        si += 5 + 2 + 1;
-        //uint8_t pskcr   = PackBits(si, 2, g_DemodBuffer); si += 2+1;  //could check psk cr
-        //uint8_t nml01    = PackBits(si, 1, g_DemodBuffer); si += 1+5;   //bit 24, 30, 31 could be tested for 0 if not extended mode
-        //uint8_t nml02    = PackBits(si, 2, g_DemodBuffer); si += 2;
-
-        //if extended mode
-        bool extMode = ((safer == 0x6 || safer == 0x9) && extend) ? true : false;
-
-        if (!extMode) {
-            if (bitRate > 7) continue;
-            if (!testBitRate(bitRate, clk)) continue;
-        } else { //extended mode bitrate = same function to calc bitrate as em4x05
-            if (EM4x05_GET_BITRATE(bitRate) != clk) continue;
-
-        }
-        //test modulation
-        if (!testModulation(mode, modread)) continue;
-        *fndBitRate = bitRate;
-        *offset = idx;
-        *Q5 = false;
-        return true;
-    }
-    if (testQ5(mode, offset, fndBitRate, clk)) {
-        *Q5 = true;
-        return true;
-    }
-    return false;
+    *offset = found.offset;
+    *fndBitRate = found.bitrate;
+    *Q5 = found.q5;
+    return true;
 }
 
 int CmdT55xxSpecial(const char *Cmd) {
@@ -3024,6 +2860,135 @@ static bool IsCancelled(void) {
     return false;
 }
 
+static int t55xx_brute_send(t55xx_brute_packet_t *packet, PacketResponseNG *resp) {
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_T55XX_BRUTE, (uint8_t *)packet, sizeof(t55xx_brute_packet_t) - sizeof(packet->data) + packet->len);
+    if (WaitForResponseTimeout(CMD_LF_T55XX_BRUTE, resp, 2000) == false) {
+        PrintAndLogEx(WARNING, "command execution time out");
+        return PM3_ETIMEOUT;
+    }
+    return resp->status;
+}
+
+// Lets the device try a password range, or a list (pwds != NULL), and only report hits and progress.
+// The device expects block 0 in the modulation / bitrate of the current 'lf t55xx config'.
+// Every hit is verified with a regular read and detect, false hits resume the search.
+static int t55xx_brute_device(uint32_t start, uint32_t end, const uint8_t *pwds, uint32_t pwdcount, uint8_t downlink_mode, uint32_t *found_pwd) {
+
+    t55xx_brute_cfg_t cfg = {
+        .flags = (pwds != NULL) ? T55XX_BRUTE_LIST : 0,
+        .downlink_mode = downlink_mode,
+        .modulation = config.modulation,
+        .clock = t55xx_block0_clock(config.bitrate),
+        .inverted = config.inverted,
+    };
+
+    PrintAndLogEx(INFO, "Device side search, expecting block 0 as " _YELLOW_("%s") " RF/" _YELLOW_("%u") "%s",
+                  GetSelectedModulationStr(cfg.modulation),
+                  cfg.clock,
+                  (cfg.inverted) ? " inverted" : ""
+                 );
+
+    t55xx_brute_packet_t packet;
+    PacketResponseNG resp;
+    t55xx_brute_result_t *result = (t55xx_brute_result_t *)resp.data.asBytes;
+
+    uint64_t total = (pwds != NULL) ? pwdcount : (uint64_t)end - start + 1;
+    uint64_t done = 0;
+    uint64_t t1 = msclock();
+
+    while (done < total) {
+
+        uint16_t count = 0;
+        if (pwds != NULL) {
+            cfg.start = 0;
+            cfg.end = MIN(total - done, 0xFFFF);
+        } else {
+            cfg.start = start + done;
+            cfg.end = end;
+        }
+
+        memset(&packet, 0, sizeof(packet));
+        packet.op = T55XX_BRUTE_OP_INIT;
+        packet.len = sizeof(cfg);
+        memcpy(packet.data, &cfg, sizeof(cfg));
+
+        int res = t55xx_brute_send(&packet, &resp);
+        if (res != PM3_SUCCESS)
+            return res;
+
+        // list mode, the device answers how many passwords it accepts
+        if (pwds != NULL) {
+            memcpy(&count, resp.data.asBytes, sizeof(count));
+            if (count == 0)
+                return PM3_EMALLOC;
+
+            const uint16_t per_packet = sizeof(packet.data) / 4;
+            for (uint16_t i = 0; i < count; i += per_packet) {
+                uint16_t n = MIN(count - i, per_packet);
+                packet.op = T55XX_BRUTE_OP_UPLOAD;
+                packet.offset = i;
+                packet.len = n * 4;
+                memcpy(packet.data, pwds + (done + i) * 4, packet.len);
+
+                res = t55xx_brute_send(&packet, &resp);
+                if (res != PM3_SUCCESS)
+                    return res;
+            }
+        }
+
+        packet.op = T55XX_BRUTE_OP_RUN;
+        packet.len = 0;
+        clearCommandBuffer();
+        SendCommandNG(CMD_LF_T55XX_BRUTE, (uint8_t *)&packet, sizeof(t55xx_brute_packet_t) - sizeof(packet.data));
+
+        uint8_t retry = 10;
+        while (true) {
+            if (kbd_enter_pressed()) {
+                SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            }
+
+            if (WaitForResponseTimeout(CMD_LF_T55XX_BRUTE, &resp, 2000) == false) {
+                if (--retry == 0) {
+                    PrintAndLogEx(WARNING, "\ncommand execution time out");
+                    SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+                    return PM3_ETIMEOUT;
+                }
+                continue;
+            }
+            retry = 10;
+
+            if (resp.length < sizeof(t55xx_brute_result_t))
+                return (resp.status != PM3_SUCCESS) ? resp.status : PM3_ESOFT;
+
+            if (result->done)
+                break;
+
+            uint64_t tried = done + result->tried;
+            float pwd_per_second = (float)tried / ((msclock() - t1) / 1000.0);
+            PrintAndLogEx(INPLACE, "%10" PRIu64 "/%" PRIu64 " pwds | %5.1f pwds/sec | last tried %08X", tried, total, pwd_per_second, result->password);
+        }
+        PrintAndLogEx(NORMAL, "");
+
+        if (resp.status != PM3_SUCCESS)
+            return resp.status;
+
+        if (result->found) {
+            PrintAndLogEx(INFO, "candidate [ " _YELLOW_("%08X") " ] block 0 " _YELLOW_("%08X") ", verifying...", result->password, result->block0);
+            if (t55xx_try_one_password(result->password, downlink_mode, false)) {
+                *found_pwd = result->password;
+                return PM3_SUCCESS;
+            }
+            PrintAndLogEx(INFO, "false hit, resuming");
+            done += result->tried;
+            continue;
+        }
+
+        done += (pwds != NULL) ? count : result->tried;
+    }
+    return PM3_ESOFT;
+}
+
 // load a default pwd file.
 static int CmdT55xxChkPwds(const char *Cmd) {
     CLIParserContext *ctx;
@@ -3034,6 +2999,7 @@ static int CmdT55xxChkPwds(const char *Cmd) {
                   _RED_("WARNING:") _CYAN_(" this may brick non-password protected chips!"),
                   "lf t55xx chk -m                     -> use dictionary from flash memory (RDV4)\n"
                   "lf t55xx chk -f my_dictionary_pwds  -> loads a default keys dictionary file\n"
+                  "lf t55xx chk -f my_dictionary_pwds --dev -> check the dictionary on device, expects 'lf t55xx config' modulation\n"
                   "lf t55xx chk --em aa11223344        -> try known pwdgen algo from some cloners based on EM4100 ID"
                  );
 
@@ -3043,14 +3009,15 @@ static int CmdT55xxChkPwds(const char *Cmd) {
       start index to call arg_add_t55xx_downloadlink() is 4 (1 + 3) given the above sample
     */
 
-    // 1 (help) + 3 (three user specified params) + (6 T55XX_DLMODE_ALL)
-    void *argtable[4 + 6] = {
+    // 1 (help) + 4 (four user specified params) + (6 T55XX_DLMODE_ALL)
+    void *argtable[5 + 6] = {
         arg_param_begin,
         arg_lit0("m", "fm", "use dictionary from flash memory (RDV4)"),
         arg_str0("f", "file", "<fn>", "file name"),
         arg_str0(NULL, "em", "<hex>", "EM4100 ID (5 hex bytes)"),
+        arg_lit0(NULL, "dev", "check the dictionary on device"),
     };
-    uint8_t idx = 4;
+    uint8_t idx = 5;
     arg_add_t55xx_downloadlink(argtable, &idx, T55XX_DLMODE_ALL, T55XX_DLMODE_ALL);
     CLIExecWithReturn(ctx, Cmd, argtable, true);
 
@@ -3080,11 +3047,12 @@ static int CmdT55xxChkPwds(const char *Cmd) {
         return PM3_EINVARG;
     }
 
-    bool r0 = arg_get_lit(ctx, 4);
-    bool r1 = arg_get_lit(ctx, 5);
-    bool r2 = arg_get_lit(ctx, 6);
-    bool r3 = arg_get_lit(ctx, 7);
-    bool ra = arg_get_lit(ctx, 8);
+    bool on_device = arg_get_lit(ctx, 4);
+    bool r0 = arg_get_lit(ctx, 5);
+    bool r1 = arg_get_lit(ctx, 6);
+    bool r2 = arg_get_lit(ctx, 7);
+    bool r3 = arg_get_lit(ctx, 8);
+    bool ra = arg_get_lit(ctx, 9);
     CLIParserFree(ctx);
 
     if ((r0 + r1 + r2 + r3 + ra) > 1) {
@@ -3207,9 +3175,23 @@ static int CmdT55xxChkPwds(const char *Cmd) {
 
         PrintAndLogEx(INFO, "press " _GREEN_("<Enter>") " to exit");
 
+        if (on_device) {
+            for (dl_mode = downlink_mode; dl_mode <= 3 && found == false; dl_mode++) {
+                uint32_t curr_password = 0;
+                res = t55xx_brute_device(0, 0, keyblock, keycount, dl_mode, &curr_password);
+                if (res == PM3_SUCCESS) {
+                    found = true;
+                    PrintAndLogEx(SUCCESS, "found valid password: [ " _GREEN_("%08"PRIX32) " ]", curr_password);
+                } else if (res != PM3_ESOFT || ra == false) {
+                    break;
+                }
+            }
+            keycount = 0;
+        }
+
         for (uint32_t c = 0; c < keycount && found == false; ++c) {
 
-            if (!g_session.pm3_present) {
+            if (!g_device->pm3_present) {
                 PrintAndLogEx(WARNING, "device offline\n");
                 free(keyblock);
                 return PM3_ENODATA;
@@ -3259,15 +3241,17 @@ static int CmdT55xxBruteForce(const char *Cmd) {
                   "Try reading Page 0, block 7 before.\n\n"
                   _RED_("WARNING") _CYAN_(" this may brick non-password protected chips!"),
                   "lf t55xx bruteforce --r2 -s aaaaaa77 -e aaaaaa99\n"
+                  "lf t55xx bruteforce -s 00000000 -e 0000ffff --dev  -> search on device, expects 'lf t55xx config' modulation\n"
                  );
 
-    // 1 (help) + 2 (two user specified params) + (6 T55XX_DLMODE_ALL)
-    void *argtable[3 + 6] = {
+    // 1 (help) + 3 (three user specified params) + (6 T55XX_DLMODE_ALL)
+    void *argtable[4 + 6] = {
         arg_param_begin,
         arg_str1("s", "start", "<hex>", "search start password (4 hex bytes)"),
         arg_str1("e", "end", "<hex>", "search end password (4 hex bytes)"),
+        arg_lit0(NULL, "dev", "run the search on device"),
     };
-    uint8_t idx = 3;
+    uint8_t idx = 4;
     arg_add_t55xx_downloadlink(argtable, &idx, T55XX_DLMODE_ALL, T55XX_DLMODE_ALL);
     CLIExecWithReturn(ctx, Cmd, argtable, true);
 
@@ -3287,11 +3271,12 @@ static int CmdT55xxBruteForce(const char *Cmd) {
         return PM3_EINVARG;
     }
 
-    bool r0 = arg_get_lit(ctx, 3);
-    bool r1 = arg_get_lit(ctx, 4);
-    bool r2 = arg_get_lit(ctx, 5);
-    bool r3 = arg_get_lit(ctx, 6);
-    bool ra = arg_get_lit(ctx, 7);
+    bool on_device = arg_get_lit(ctx, 3);
+    bool r0 = arg_get_lit(ctx, 4);
+    bool r1 = arg_get_lit(ctx, 5);
+    bool r2 = arg_get_lit(ctx, 6);
+    bool r3 = arg_get_lit(ctx, 7);
+    bool ra = arg_get_lit(ctx, 8);
     CLIParserFree(ctx);
 
     if ((r0 + r1 + r2 + r3 + ra) > 1) {
@@ -3325,6 +3310,26 @@ static int CmdT55xxBruteForce(const char *Cmd) {
     uint64_t t1 = msclock();
     curr = start_password;
 
+    if (on_device) {
+        for (uint8_t dl_mode = downlink_mode; dl_mode <= 3; dl_mode++) {
+            res = t55xx_brute_device(start_password, end_password, NULL, 0, dl_mode, &curr);
+            if (res == PM3_SUCCESS) {
+                PrintAndLogEx(SUCCESS, "Found valid password: [ " _GREEN_("%08X") " ]", curr);
+                T55xx_Print_DownlinkMode(dl_mode);
+                break;
+            }
+            if (res != PM3_ESOFT || ra == false) {
+                break;
+            }
+        }
+        if (res == PM3_ESOFT)
+            PrintAndLogEx(WARNING, "Bruteforce failed, range [%08X -> %08X]", start_password, end_password);
+
+        t1 = msclock() - t1;
+        PrintAndLogEx(SUCCESS, "\ntime in bruteforce " _YELLOW_("%.0f") " seconds\n", (float)t1 / 1000.0);
+        return (res == PM3_ESOFT) ? PM3_SUCCESS : res;
+    }
+
     while (found == 0) {
 
         PrintAndLogEx(NORMAL, "." NOLF);
@@ -4269,6 +4274,105 @@ static int CmdT55xxSniff(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// Direct access reads of block 0 as demodulated bitstreams: <prefix> bits of whatever
+// came before, then block 0 with its leading 0 bit, <repeat> times.
+typedef struct {
+    uint32_t block0;
+    uint8_t mode;
+    uint8_t clk;
+    uint8_t prefix;
+    uint8_t repeat;
+    bool valid;
+} t55xx_block0_vector_t;
+
+static const t55xx_block0_vector_t Block0Vectors[] = {
+    {T55X7_DEFAULT_CONFIG_BLOCK,     DEMOD_ASK,  32,  5, 4, true},
+    {T55X7_EM_UNIQUE_CONFIG_BLOCK,   DEMOD_ASK,  64, 17, 4, true},
+    {T55X7_SECURAKEY_CONFIG_BLOCK,   DEMOD_ASK,  40, 40, 3, true},
+    {T55X7_HID_26_CONFIG_BLOCK,      DEMOD_FSK,  50, 30, 4, true},
+    {T55X7_IOPROX_CONFIG_BLOCK,      DEMOD_FSK,  64,  0, 3, true},
+    {T55X7_INDALA_64_CONFIG_BLOCK,   DEMOD_PSK1, 32,  9, 4, true},
+    {T55X7_PAC_CONFIG_BLOCK,         DEMOD_NRZ,  32, 27, 4, true},
+    {T55X7_JABLOTRON_CONFIG_BLOCK,   DEMOD_BIa,  64, 12, 4, true},
+    {T55X7_NEDAP_64_CONFIG_BLOCK,    DEMOD_BI,   64, 33, 4, true},
+    // wrong data rate / modulation for the tag
+    {T55X7_DEFAULT_CONFIG_BLOCK,     DEMOD_ASK,  64,  5, 4, false},
+    {T55X7_HID_26_CONFIG_BLOCK,      DEMOD_ASK,  50, 30, 4, false},
+    // seen only once, like a config lookalike in a regular read stream
+    {T55X7_DEFAULT_CONFIG_BLOCK,     DEMOD_ASK,  32, 40, 1, false},
+};
+
+static size_t T55xxBlock0Stream(const t55xx_block0_vector_t *v, uint8_t *bits) {
+    size_t len = 0;
+    uint32_t noise = 0x9E3779B9;
+    for (uint8_t i = 0; i < v->prefix; i++) {
+        bits[len++] = (noise >> (i & 31)) & 1;
+    }
+
+    for (uint8_t r = 0; r < v->repeat; r++) {
+        bits[len++] = 0;
+        for (int8_t i = 31; i >= 0; i--) {
+            bits[len++] = (v->block0 >> i) & 1;
+        }
+    }
+
+    // pad out to the length of a typical read
+    while (len < 140) {
+        bits[len] = ((noise >> (len & 31)) & 1) ^ 1;
+        len++;
+    }
+    return len;
+}
+
+static bool TestBlock0Vectors(void) {
+    uint8_t bits[256];
+
+    for (size_t i = 0; i < ARRAYLEN(Block0Vectors); i++) {
+        const t55xx_block0_vector_t *v = &Block0Vectors[i];
+
+        size_t len = T55xxBlock0Stream(v, bits);
+
+        t55xx_block0_t found = {0};
+        bool ok = t55xx_block0_find(bits, len, v->mode, v->clk, &found) &&
+                  t55xx_block0_repeats(bits, len, &found) &&
+                  (found.block0 == v->block0);
+
+        if (ok != v->valid) {
+            PrintAndLogEx(ERR, "block 0 vector %zu, %08X %s RF/%u.. " _RED_("fail"), i, v->block0, GetSelectedModulationStr(v->mode), v->clk);
+            return false;
+        }
+    }
+    PrintAndLogEx(INFO, "block 0 plausibility.. " _GREEN_("passed"));
+    return true;
+}
+
+static int CmdT55xxTest(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "lf t55xx test",
+                  "Regression tests for the config block checks shared with the device",
+                  "lf t55xx test");
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    CLIParserFree(ctx);
+
+    PrintAndLogEx(INFO, "------ " _CYAN_("T55xx tests") " ------");
+
+    bool res = TestBlock0Vectors();
+
+    PrintAndLogEx(INFO, "---------------------------");
+    if (res)
+        PrintAndLogEx(SUCCESS, "    Tests [ %s ]", _GREEN_("ok"));
+    else
+        PrintAndLogEx(FAILED, "    Tests [ %s ]", _RED_("fail"));
+
+    PrintAndLogEx(NORMAL, "");
+    return PM3_SUCCESS;
+}
+
 static command_t CommandTable[] = {
     {"-----------",  CmdHelp,                 AlwaysAvailable, "---------------------------- " _CYAN_("notice") " -----------------------------"},
     {"",             CmdHelp,                 AlwaysAvailable, "Remember to run `" _YELLOW_("lf t55xx detect") "` first whenever a new card"},
@@ -4297,6 +4401,7 @@ static command_t CommandTable[] = {
     {"recoverpw",    CmdT55xxRecoverPW,       IfPm3Lf,         "Try to recover from bad password write from a cloner"},
     {"sniff",        CmdT55xxSniff,           AlwaysAvailable, "Attempt to recover T55xx commands from sample buffer"},
     {"special",      CmdT55xxSpecial,         IfPm3Lf,         "Show block changes with 64 different offsets"},
+    {"test",         CmdT55xxTest,            AlwaysAvailable, "Regression tests"},
     {"wipe",         CmdT55xxWipe,            IfPm3Lf,         "Wipe a T55xx tag and set defaults (will destroy any data on tag)"},
     {NULL, NULL, NULL, NULL}
 };
@@ -101,6 +101,13 @@ int demodTI(bool verbose) {
     if (g_GraphTraceLen < convLen) {
         return retval;
     }
+
+    // low tone sums go to the demod channel, high tone sums overwrite the samples
+    if (graph_reserve(GRAPH_DEMOD, g_GraphTraceLen) == false) {
+        return PM3_EMALLOC;
+    }
+    int16_t *lowBuf = graph_channel(GRAPH_DEMOD);
+
     for (i = 0; i < g_GraphTraceLen - convLen; i++) {
         lowSum = 0;
         highSum = 0;
@@ -116,7 +123,8 @@ int demodTI(bool verbose) {
         lowSum = (lowSum < 0) ? -lowSum : lowSum;
         highSum = (highSum < 0) ? -highSum : highSum;
 
-        g_GraphBuffer[i] = (highSum << 16) | lowSum;
+        lowBuf[i] = GRAPH_CLAMP(lowSum);
+        g_GraphBuffer[i] = GRAPH_CLAMP(highSum);
     }
 
     for (i = 0; i < g_GraphTraceLen - convLen - 16; i++) {
@@ -124,12 +132,13 @@ int demodTI(bool verbose) {
         highTot = 0;
         // 16 and 15 are f_s divided by f_l and f_h, rounded
         for (j = 0; j < 16; j++) {
-            lowTot += (g_GraphBuffer[i + j] & 0xffff);
+            lowTot += lowBuf[i + j];
         }
         for (j = 0; j < 15; j++) {
-            highTot += (g_GraphBuffer[i + j] >> 16);
+            highTot += g_GraphBuffer[i + j];
         }
-        g_GraphBuffer[i] = lowTot - highTot;
+        // averaged over the 16 samples to fit a graph sample
+        g_GraphBuffer[i] = GRAPH_CLAMP((lowTot - highTot) / 16);
     }
 
     g_GraphTraceLen -= (convLen + 16);
@@ -261,7 +270,6 @@ int demodTI(bool verbose) {
             (shift1 >> 16) & 0xFF,
             (shift1 >> 24) & 0xFF
         };
-        init_table(CRC_KERMIT);
         uint16_t calccrc = crc16_kermit(raw, sizeof(raw));
         const char *crc_str = (calccrc == (shift2 & 0xFFFF)) ? _GREEN_("ok") : _RED_("fail");
         PrintAndLogEx(INFO, "Tag data = %08X%08X  [%04X] ( %s )", shift1, shift0, calccrc, crc_str);
@@ -32,7 +32,7 @@ bool AlwaysAvailable(void) {
 bool IfPm3Present(void) {
     if (g_session.help_dump_mode)
         return false;
-    return g_session.pm3_present;
+    return g_device->pm3_present;
 }
 
 bool IfPm3Rdv4Fw(void) {
@@ -35,18 +35,28 @@ static int CmdHelp(const char *Cmd);
 
 // trace pointer
 static uint8_t *gs_trace;
-static uint16_t gs_traceLen = 0;
+static uint32_t gs_traceLen = 0;
 
-static bool is_last_record(uint16_t tracepos, uint16_t traceLen) {
+// record index, built once when a trace is downloaded or loaded so listing
+// a range or a filtered subset doesn't have to decode the whole buffer again
+typedef struct {
+    uint32_t offset;
+    uint16_t data_len;
+} trace_record_t;
+
+static trace_record_t *gs_records = NULL;
+static uint32_t gs_recordsCount = 0;
+
+static bool is_last_record(uint32_t tracepos, uint32_t traceLen) {
     return ((tracepos + TRACELOG_HDR_LEN) >= traceLen);
 }
 
-static bool next_record_is_response(uint16_t tracepos, uint8_t *trace) {
+static bool next_record_is_response(uint32_t tracepos, uint8_t *trace) {
     tracelog_hdr_t *hdr = (tracelog_hdr_t *)(trace + tracepos);
     return (hdr->isResponse);
 }
 
-static bool merge_topaz_reader_frames(uint32_t timestamp, uint32_t *duration, uint16_t *tracepos, uint16_t traceLen,
+static bool merge_topaz_reader_frames(uint32_t timestamp, uint32_t *duration, uint32_t *tracepos, uint32_t traceLen,
                                       uint8_t *trace, uint8_t *frame, uint8_t *topaz_reader_command, uint16_t *data_len) {
 
 #define MAX_TOPAZ_READER_CMD_LEN 16
@@ -79,6 +89,59 @@ static bool merge_topaz_reader_frames(uint32_t timestamp, uint32_t *duration, ui
 
     return true;
 }
+static void trace_free_index(void) {
+    free(gs_records);
+    gs_records = NULL;
+    gs_recordsCount = 0;
+}
+
+// one pass over the trace buffer, stops at the first truncated record
+static int trace_build_index(void) {
+    trace_free_index();
+
+    if (gs_trace == NULL || gs_traceLen == 0)
+        return PM3_SUCCESS;
+
+    // lower bound for the record size, a header without data or parity
+    uint32_t max_records = gs_traceLen / TRACELOG_HDR_LEN + 1;
+    gs_records = calloc(max_records, sizeof(trace_record_t));
+    if (gs_records == NULL) {
+        PrintAndLogEx(FAILED, "Cannot allocate memory for trace index");
+        return PM3_EMALLOC;
+    }
+
+    uint32_t tracepos = 0;
+    while (is_last_record(tracepos, gs_traceLen) == false && gs_recordsCount < max_records) {
+        tracelog_hdr_t *hdr = (tracelog_hdr_t *)(gs_trace + tracepos);
+        uint32_t next = tracepos + TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr);
+        if (next > gs_traceLen) {
+            PrintAndLogEx(DEBUG, "trace record at offset %u truncated", tracepos);
+            break;
+        }
+
+        trace_record_t *rec = &gs_records[gs_recordsCount++];
+        rec->offset = tracepos;
+        rec->data_len = hdr->data_len;
+        tracepos = next;
+    }
+    return PM3_SUCCESS;
+}
+
+static bool trace_record_matches(const trace_record_t *rec, const uint8_t *pattern, size_t patternlen) {
+    if (patternlen == 0)
+        return true;
+
+    if (rec->data_len < patternlen)
+        return false;
+
+    const uint8_t *frame = ((tracelog_hdr_t *)(gs_trace + rec->offset))->frame;
+    for (size_t i = 0; i + patternlen <= rec->data_len; i++) {
+        if (memcmp(frame + i, pattern, patternlen) == 0)
+            return true;
+    }
+    return false;
+}
+
 static uint8_t calc_pos(const uint8_t *d) {
     // PCB [CID] [NAD] [INF] CRC CRC
     uint8_t pos = 1;
@@ -97,7 +160,7 @@ static uint8_t extract_epurse[8] = {0};
 
 #define SKIP_TO_NEXT(a)  (TRACELOG_HDR_LEN + (a)->data_len + TRACELOG_PARITY_LEN((a)))
 
-static uint16_t extractChall_ev2(uint16_t tracepos, uint8_t *trace, uint8_t cmdpos, uint8_t long_jmp) {
+static uint32_t extractChall_ev2(uint32_t tracepos, uint8_t *trace, uint8_t cmdpos, uint8_t long_jmp) {
     tracelog_hdr_t *next_hdr = (tracelog_hdr_t *)(trace + tracepos);
     if (next_hdr->data_len != 21) {
         return 0;
@@ -118,7 +181,7 @@ static uint16_t extractChall_ev2(uint16_t tracepos, uint8_t *trace, uint8_t cmdp
     return tracepos;
 }
 
-static uint16_t extractChallenges(uint16_t tracepos, uint16_t traceLen, uint8_t *trace) {
+static uint32_t extractChallenges(uint32_t tracepos, uint32_t traceLen, uint8_t *trace) {
 
     // sanity check
     if (is_last_record(tracepos, traceLen)) {
@@ -387,7 +450,7 @@ static uint16_t extractChallenges(uint16_t tracepos, uint16_t traceLen, uint8_t
             }
             case MFDES_AUTHENTICATE_EV2F: {
                 PrintAndLogEx(INFO, "AUTH EV2 First");
-                uint16_t tmp = extractChall_ev2(tracepos, trace, pos, long_jmp);
+                uint32_t tmp = extractChall_ev2(tracepos, trace, pos, long_jmp);
                 if (tmp == 0)
                     break;
                 else
@@ -396,7 +459,7 @@ static uint16_t extractChallenges(uint16_t tracepos, uint16_t traceLen, uint8_t
             }
             case MFDES_AUTHENTICATE_EV2NF: {
                 PrintAndLogEx(INFO, "AUTH EV2 Non First");
-                uint16_t tmp = extractChall_ev2(tracepos, trace, pos, long_jmp);
+                uint32_t tmp = extractChall_ev2(tracepos, trace, pos, long_jmp);
                 if (tmp == 0)
                     break;
                 else
@@ -408,7 +471,7 @@ static uint16_t extractChallenges(uint16_t tracepos, uint16_t traceLen, uint8_t
     return tracepos;
 }
 
-static uint16_t printHexLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trace, uint8_t protocol) {
+static uint32_t printHexLine(uint32_t tracepos, uint32_t traceLen, uint8_t *trace, uint8_t protocol) {
     // sanity check
     if (is_last_record(tracepos, traceLen)) return traceLen;
 
@@ -426,7 +489,7 @@ static uint16_t printHexLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trac
         return tracepos;
     }
 
-    uint16_t ret;
+    uint32_t ret;
 
     switch (protocol) {
         case ISO_14443A: {
@@ -469,7 +532,7 @@ static uint16_t printHexLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trac
     return ret;
 }
 
-static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trace, uint8_t protocol, bool showWaitCycles, bool markCRCBytes, uint32_t *prev_eot, bool use_us,
+static uint32_t printTraceLine(uint32_t tracepos, uint32_t traceLen, uint8_t *trace, uint8_t protocol, bool showWaitCycles, bool markCRCBytes, uint32_t *prev_eot, bool use_us,
                                const uint64_t *mfDicKeys, uint32_t mfDicKeysCount) {
     // sanity check
     if (is_last_record(tracepos, traceLen)) {
@@ -869,6 +932,7 @@ static int download_trace(void) {
         free(gs_trace);
 
     gs_traceLen = 0;
+    trace_free_index();
 
     gs_trace = calloc(PM3_CMD_DATA_SIZE, sizeof(uint8_t));
     if (gs_trace == NULL) {
@@ -906,7 +970,7 @@ static int download_trace(void) {
             return PM3_ETIMEOUT;
         }
     }
-    return PM3_SUCCESS;
+    return trace_build_index();
 }
 
 // sanity check. Don't use proxmark if it is offline and you didn't specify useTraceBuffer
@@ -952,7 +1016,7 @@ static int CmdTraceExtract(const char *Cmd) {
         return PM3_SUCCESS;
     }
 
-    uint16_t tracepos = 0;
+    uint32_t tracepos = 0;
 
     while (tracepos < gs_traceLen) {
         tracepos = extractChallenges(tracepos, gs_traceLen, gs_trace);
@@ -989,6 +1053,8 @@ static int CmdTraceLoad(const char *Cmd) {
         free(gs_trace);
         gs_trace = NULL;
     }
+    gs_traceLen = 0;
+    trace_free_index();
 
     size_t len = 0;
     if (loadFile_safe(filename, ".trace", (void **)&gs_trace, &len) != PM3_SUCCESS) {
@@ -996,9 +1062,20 @@ static int CmdTraceLoad(const char *Cmd) {
         return PM3_EIO;
     }
 
-    gs_traceLen = (long)len;
+    if (len > UINT32_MAX) {
+        PrintAndLogEx(FAILED, "Trace file too large");
+        free(gs_trace);
+        gs_trace = NULL;
+        return PM3_EFILE;
+    }
 
-    PrintAndLogEx(SUCCESS, "Recorded Activity (TraceLen = " _YELLOW_("%u") " bytes)", gs_traceLen);
+    gs_traceLen = (uint32_t)len;
+
+    int res = trace_build_index();
+    if (res != PM3_SUCCESS)
+        return res;
+
+    PrintAndLogEx(SUCCESS, "Recorded Activity (TraceLen = " _YELLOW_("%u") " bytes, " _YELLOW_("%u") " records)", gs_traceLen, gs_recordsCount);
     PrintAndLogEx(HINT, "try " _YELLOW_("`trace list -1 -t ...`") " to view trace.  Remember the " _YELLOW_("`-1`") " param");
     return PM3_SUCCESS;
 }
@@ -1063,6 +1140,9 @@ int CmdTraceListAlias(const char *Cmd, const char *alias, const char *protocol)
         arg_lit0("x", NULL, "show hexdump to convert to pcap(ng)\n"
                  "                                   or to import into Wireshark using encapsulation type \"ISO 14443\""),
         arg_str0(NULL, "dict", "<file>", "use dictionary keys file"),
+        arg_u64_0(NULL, "from", "<dec>", "first record to list"),
+        arg_u64_0(NULL, "to", "<dec>", "last record to list"),
+        arg_str0(NULL, "match", "<hex>", "only list records containing these bytes"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -1101,7 +1181,9 @@ int CmdTraceList(const char *Cmd) {
                   "\n"
                   "trace list -t mf --dict <mfc_default_keys>    -> use dictionary keys file\n"
                   "trace list -t 14a -f                          -> show frame delay times\n"
-                  "trace list -t 14a -1                          -> use trace buffer "
+                  "trace list -t 14a -1                          -> use trace buffer\n"
+                  "trace list -t 14a -1 --from 10 --to 20        -> only list records 10 to 20\n"
+                  "trace list -t 14a -1 --match 3000             -> only list records containing 30 00"
                  );
 
     void *argtable[] = {
@@ -1115,6 +1197,9 @@ int CmdTraceList(const char *Cmd) {
                  "                                   or to import into Wireshark using encapsulation type \"ISO 14443\""),
         arg_str0("t", "type", NULL, "protocol to annotate the trace"),
         arg_str0(NULL, "dict", "<fn>", "use dictionary keys file"),
+        arg_u64_0(NULL, "from", "<dec>", "first record to list"),
+        arg_u64_0(NULL, "to", "<dec>", "last record to list"),
+        arg_str0(NULL, "match", "<hex>", "only list records containing these bytes"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -1138,8 +1223,20 @@ int CmdTraceList(const char *Cmd) {
         diclen = 0;
     }
 
+    uint32_t rec_from = arg_get_u32_def(ctx, 9, 0);
+    uint32_t rec_to = arg_get_u32_def(ctx, 10, UINT32_MAX);
+
+    int matchlen = 0;
+    uint8_t match[64] = {0};
+    CLIGetHexWithReturn(ctx, 11, match, &matchlen);
+
     CLIParserFree(ctx);
 
+    if (rec_from > rec_to) {
+        PrintAndLogEx(FAILED, "--from must not be larger than --to");
+        return PM3_EINVARG;
+    }
+
     clearCommandBuffer();
 
     // no crc, no annotations
@@ -1183,7 +1280,24 @@ int CmdTraceList(const char *Cmd) {
         return PM3_SUCCESS;
     }
 
-    uint16_t tracepos = 0;
+    bool filtered = (rec_from > 0 || rec_to < UINT32_MAX || matchlen > 0);
+    if (filtered) {
+        PrintAndLogEx(INFO, "listing records " _YELLOW_("%u") " - " _YELLOW_("%u") " of " _YELLOW_("%u") "%s%s",
+                      rec_from,
+                      MIN(rec_to, gs_recordsCount ? gs_recordsCount - 1 : 0),
+                      gs_recordsCount,
+                      matchlen ? " containing " : "",
+                      matchlen ? sprint_hex_inrow(match, matchlen) : ""
+                     );
+        if (protocol == PROTO_MIFARE)
+            PrintAndLogEx(HINT, "crypto1 decoding only follows authentications inside the listed records");
+    }
+
+    if (rec_to >= gs_recordsCount)
+        rec_to = gs_recordsCount - 1;
+
+    // records before this offset were already merged into a printed line (topaz)
+    uint32_t tracepos = 0;
 
     /*
     if (protocol == FELICA) {
@@ -1191,8 +1305,12 @@ int CmdTraceList(const char *Cmd) {
     } */
 
     if (show_hex) {
-        while (tracepos < gs_traceLen) {
-            tracepos = printHexLine(tracepos, gs_traceLen, gs_trace, protocol);
+        for (uint32_t i = rec_from; gs_recordsCount && i <= rec_to; i++) {
+            if (trace_record_matches(&gs_records[i], match, matchlen) == false)
+                continue;
+
+            if (printHexLine(gs_records[i].offset, gs_traceLen, gs_trace, protocol) == gs_traceLen)
+                break;
         }
     } else {
 
@@ -1294,8 +1412,14 @@ int CmdTraceList(const char *Cmd) {
             prev_EOT = &previous_EOT;
         }
 
-        while (tracepos < gs_traceLen) {
-            tracepos = printTraceLine(tracepos, gs_traceLen, gs_trace, protocol, show_wait_cycles, mark_crc, prev_EOT, use_us, dicKeys, dicKeysCount);
+        for (uint32_t i = rec_from; gs_recordsCount && i <= rec_to; i++) {
+            if (gs_records[i].offset < tracepos)
+                continue;
+
+            if (trace_record_matches(&gs_records[i], match, matchlen) == false)
+                continue;
+
+            tracepos = printTraceLine(gs_records[i].offset, gs_traceLen, gs_trace, protocol, show_wait_cycles, mark_crc, prev_EOT, use_us, dicKeys, dicKeysCount);
 
             if (kbd_enter_pressed())
                 break;
@@ -22,10 +22,12 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include "uart/uart.h"
 #include "ui.h"
 #include "crc16.h"
+#include "lz4/lz4.h"  // compressed download
 #include "util.h" // g_pendingPrompt
 #include "util_posix.h" // msclock
 #include "util_darwin.h" // en/dis-ableNapp();
@@ -33,43 +35,88 @@
 //#define COMMS_DEBUG
 //#define COMMS_DEBUG_RAW
 
-// Serial port that we are communicating with the PM3 on.
-static serial_port sp = NULL;
-
-communication_arg_t g_conn;
-capabilities_t g_pm3_capabilities;
-
-static pthread_t communication_thread;
-static bool comm_thread_dead = false;
-
-// Transmit buffer.
-static PacketCommandOLD txBuffer;
-static PacketCommandNGRaw txBufferNG;
-static size_t txBufferNGLen;
-static bool txBuffer_pending = false;
-static pthread_mutex_t txBufferMutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t txBufferSig = PTHREAD_COND_INITIALIZER;
-
-// Used by PacketResponseReceived as a ring buffer for messages that are yet to be
-// processed by a command handler (WaitForResponse{,Timeout})
-static PacketResponseNG rxBuffer[CMD_BUFFER_SIZE];
-
-// Points to the next empty position to write to
-static int cmd_head = 0;
-
-// Points to the position of the last unread command
-static int cmd_tail = 0;
-
-// to lock rxBuffer operations from different threads
-static pthread_mutex_t rxBufferMutex = PTHREAD_MUTEX_INITIALIZER;
+// Everything a connection needs, one per device.
+typedef struct comms_state {
+    // Serial port that we are communicating with the PM3 on.
+    serial_port sp;
+
+    pthread_t communication_thread;
+    bool comm_thread_dead;
+
+    // Transmit buffer.
+    PacketCommandOLD txBuffer;
+    PacketCommandNGRaw txBufferNG;
+    size_t txBufferNGLen;
+    bool txBuffer_pending;
+    pthread_mutex_t txBufferMutex;
+    pthread_cond_t txBufferSig;
+
+    // Used by PacketResponseReceived as a ring buffer for messages that are yet to be
+    // processed by a command handler (WaitForResponse{,Timeout})
+    //
+    // Single producer (the communication thread) / single consumer (the command handler).
+    // The producer decodes frames straight into the slot at rx_head and publishes it,
+    // the consumer reads slots in place at rx_tail and releases them.  While the ring is
+    // full frames are decoded into rxScratch, and only the ones to be stored wait for a
+    // slot (back-pressure).  Both indexes are
+    // free running and only ever written by their owner, so no lock is needed on the
+    // data path.  The mutex below is only taken by a side that is about to sleep.
+    PacketResponseNG rxBuffer[CMD_BUFFER_SIZE];
+    // frame being decoded while the ring is full
+    PacketResponseNG rxScratch;
+    // producer gave up waiting for a slot, drop without waiting until the consumer reads again
+    bool rx_dropping;
+
+    // Points to the next empty position to write to (owned by producer)
+    uint32_t rx_head;
+
+    // Points to the position of the last unread command (owned by consumer)
+    uint32_t rx_tail;
+
+    // wakeups between producer and consumer
+    pthread_mutex_t rxSigMutex;
+    pthread_cond_t rxDataSig;
+    pthread_cond_t rxSpaceSig;
+    bool rx_consumer_waiting;
+    bool rx_producer_waiting;
+
+    // Command the consumer is currently waiting for, CMD_UNKNOWN for any.
+    // The producer only wakes the consumer for packets it registered for,
+    // unless the ring is filling up and needs draining.
+    uint32_t rx_waiter_cmd;
+
+    // Start time for WaitForResponseTimeout & dl_it, so we can reset timeout when we get packets
+    // as sending lot of these packets can slow down things wuite a lot on slow links (e.g. hw status or lf read at 9600)
+    uint64_t timeout_start_time;
+
+    uint64_t last_packet_time;
+} comms_state_t;
+
+#if (CMD_BUFFER_SIZE & (CMD_BUFFER_SIZE - 1)) != 0
+#error "CMD_BUFFER_SIZE must be a power of two"
+#endif
+#define RX_RING_MASK          (CMD_BUFFER_SIZE - 1)
+// max time the communication thread is blocked on a full ring before it starts dropping
+#define RX_BACKPRESSURE_MS    2000
+
+#define COMMS_STATE_INIT { \
+        .txBufferMutex = PTHREAD_MUTEX_INITIALIZER, \
+        .txBufferSig = PTHREAD_COND_INITIALIZER, \
+        .rxSigMutex = PTHREAD_MUTEX_INITIALIZER, \
+        .rxDataSig = PTHREAD_COND_INITIALIZER, \
+        .rxSpaceSig = PTHREAD_COND_INITIALIZER, \
+        .rx_waiter_cmd = CMD_UNKNOWN, \
+    }
 
-// Global start time for WaitForResponseTimeout & dl_it, so we can reset timeout when we get packets
-// as sending lot of these packets can slow down things wuite a lot on slow links (e.g. hw status or lf read at 9600)
-static uint64_t timeout_start_time;
+// The device of the main session, used by every thread until it selects another one
+static comms_state_t s_state = COMMS_STATE_INIT;
+static pm3_device_t s_device = { .state = &s_state };
 
-static uint64_t last_packet_time;
+__thread pm3_device_t *g_device = &s_device;
 
 static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, size_t ms_timeout, bool show_warning, uint32_t rec_cmd);
+static bool dl_lz4(uint8_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, PacketResponseNG *response, size_t ms_timeout, bool show_warning);
+static void rx_wake(comms_state_t *s, bool *waiting, pthread_cond_t *sig);
 
 // Simple alias to track usages linked to the Bootloader, these commands must not be migrated.
 // - commands sent to enter bootloader mode as we might have to talk to old firmwares
@@ -79,6 +126,7 @@ void SendCommandBL(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, vo
 }
 
 void SendCommandOLD(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, void *data, size_t len) {
+    comms_state_t *s = g_device->state;
     PacketCommandOLD c = {CMD_UNKNOWN, {0, 0, 0}, {{0}}};
     c.cmd = cmd;
     c.arg[0] = arg0;
@@ -96,38 +144,39 @@ void SendCommandOLD(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, v
     print_hex_break((uint8_t *)&c.d, sizeof(c.d), 32);
 #endif
 
-    if (!g_session.pm3_present) {
+    if (!g_device->pm3_present) {
         PrintAndLogEx(WARNING, "Sending bytes to Proxmark3 failed." _YELLOW_("offline"));
         return;
     }
 
-    pthread_mutex_lock(&txBufferMutex);
+    pthread_mutex_lock(&s->txBufferMutex);
     /**
     This causes hangups at times, when the pm3 unit is unresponsive or disconnected. The main console thread is alive,
     but comm thread just spins here. Not good.../holiman
     **/
-    while (txBuffer_pending) {
+    while (s->txBuffer_pending) {
         // wait for communication thread to complete sending a previous command
-        pthread_cond_wait(&txBufferSig, &txBufferMutex);
+        pthread_cond_wait(&s->txBufferSig, &s->txBufferMutex);
     }
 
-    txBuffer = c;
-    txBuffer_pending = true;
+    s->txBuffer = c;
+    s->txBuffer_pending = true;
 
     // tell communication thread that a new command can be send
-    pthread_cond_signal(&txBufferSig);
+    pthread_cond_signal(&s->txBufferSig);
 
-    pthread_mutex_unlock(&txBufferMutex);
+    pthread_mutex_unlock(&s->txBufferMutex);
 
 //__atomic_test_and_set(&txcmd_pending, __ATOMIC_SEQ_CST);
 }
 
 static void SendCommandNG_internal(uint16_t cmd, uint8_t *data, size_t len, bool ng) {
+    comms_state_t *s = g_device->state;
 #ifdef COMMS_DEBUG
     PrintAndLogEx(INFO, "Sending %s", ng ? "NG" : "MIX");
 #endif
 
-    if (!g_session.pm3_present) {
+    if (!g_device->pm3_present) {
         PrintAndLogEx(INFO, "Sending bytes to proxmark failed - offline");
         return;
     }
@@ -136,51 +185,51 @@ static void SendCommandNG_internal(uint16_t cmd, uint8_t *data, size_t len, bool
         return;
     }
 
-    PacketCommandNGPostamble *tx_post = (PacketCommandNGPostamble *)((uint8_t *)&txBufferNG + sizeof(PacketCommandNGPreamble) + len);
+    PacketCommandNGPostamble *tx_post = (PacketCommandNGPostamble *)((uint8_t *)&s->txBufferNG + sizeof(PacketCommandNGPreamble) + len);
 
-    pthread_mutex_lock(&txBufferMutex);
+    pthread_mutex_lock(&s->txBufferMutex);
     /**
     This causes hangups at times, when the pm3 unit is unresponsive or disconnected. The main console thread is alive,
     but comm thread just spins here. Not good.../holiman
     **/
-    while (txBuffer_pending) {
+    while (s->txBuffer_pending) {
         // wait for communication thread to complete sending a previous command
-        pthread_cond_wait(&txBufferSig, &txBufferMutex);
+        pthread_cond_wait(&s->txBufferSig, &s->txBufferMutex);
     }
 
-    txBufferNG.pre.magic = COMMANDNG_PREAMBLE_MAGIC;
-    txBufferNG.pre.ng = ng;
-    txBufferNG.pre.length = len;
-    txBufferNG.pre.cmd = cmd;
+    s->txBufferNG.pre.magic = COMMANDNG_PREAMBLE_MAGIC;
+    s->txBufferNG.pre.ng = ng;
+    s->txBufferNG.pre.length = len;
+    s->txBufferNG.pre.cmd = cmd;
     if (len > 0 && data)
-        memcpy(&txBufferNG.data, data, len);
+        memcpy(&s->txBufferNG.data, data, len);
 
     if ((g_conn.send_via_fpc_usart && g_conn.send_with_crc_on_fpc) || ((!g_conn.send_via_fpc_usart) && g_conn.send_with_crc_on_usb)) {
         uint8_t first, second;
-        compute_crc(CRC_14443_A, (uint8_t *)&txBufferNG, sizeof(PacketCommandNGPreamble) + len, &first, &second);
+        compute_crc(CRC_14443_A, (uint8_t *)&s->txBufferNG, sizeof(PacketCommandNGPreamble) + len, &first, &second);
         tx_post->crc = (first << 8) + second;
     } else {
         tx_post->crc = COMMANDNG_POSTAMBLE_MAGIC;
     }
 
-    txBufferNGLen = sizeof(PacketCommandNGPreamble) + len + sizeof(PacketCommandNGPostamble);
+    s->txBufferNGLen = sizeof(PacketCommandNGPreamble) + len + sizeof(PacketCommandNGPostamble);
 
 #ifdef COMMS_DEBUG_RAW
-    print_hex_break((uint8_t *)&txBufferNG.pre, sizeof(PacketCommandNGPreamble), 32);
+    print_hex_break((uint8_t *)&s->txBufferNG.pre, sizeof(PacketCommandNGPreamble), 32);
     if (ng) {
-        print_hex_break((uint8_t *)&txBufferNG.data, len, 32);
+        print_hex_break((uint8_t *)&s->txBufferNG.data, len, 32);
     } else {
-        print_hex_break((uint8_t *)&txBufferNG.data, 3 * sizeof(uint64_t), 32);
-        print_hex_break((uint8_t *)&txBufferNG.data + 3 * sizeof(uint64_t), len - 3 * sizeof(uint64_t), 32);
+        print_hex_break((uint8_t *)&s->txBufferNG.data, 3 * sizeof(uint64_t), 32);
+        print_hex_break((uint8_t *)&s->txBufferNG.data + 3 * sizeof(uint64_t), len - 3 * sizeof(uint64_t), 32);
     }
     print_hex_break((uint8_t *)tx_post, sizeof(PacketCommandNGPostamble), 32);
 #endif
-    txBuffer_pending = true;
+    s->txBuffer_pending = true;
 
     // tell communication thread that a new command can be send
-    pthread_cond_signal(&txBufferSig);
+    pthread_cond_signal(&s->txBufferSig);
 
-    pthread_mutex_unlock(&txBufferMutex);
+    pthread_mutex_unlock(&s->txBufferMutex);
 
 //__atomic_test_and_set(&txcmd_pending, __ATOMIC_SEQ_CST);
 }
@@ -210,65 +259,159 @@ void SendCommandMIX(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, v
  *  operation. Right now we'll just have to live with this.
  */
 void clearCommandBuffer(void) {
-    //This is a very simple operation
-    pthread_mutex_lock(&rxBufferMutex);
-    cmd_tail = cmd_head;
-    pthread_mutex_unlock(&rxBufferMutex);
+    comms_state_t *s = g_device->state;
+    uint32_t head = __atomic_load_n(&s->rx_head, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&s->rx_tail, head, __ATOMIC_RELEASE);
+    rx_wake(s, &s->rx_producer_waiting, &s->rxSpaceSig);
+}
+
+static void rx_wake(comms_state_t *s, bool *waiting, pthread_cond_t *sig) {
+    if (__atomic_load_n(waiting, __ATOMIC_SEQ_CST) == false) {
+        return;
+    }
+    pthread_mutex_lock(&s->rxSigMutex);
+    pthread_cond_broadcast(sig);
+    pthread_mutex_unlock(&s->rxSigMutex);
+}
+
+// sleep on `sig` until `ready` holds or `ms` milliseconds passed
+static void rx_sleep(comms_state_t *s, bool *waiting, pthread_cond_t *sig, bool (*ready)(comms_state_t *), uint32_t ms) {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&s->rxSigMutex);
+    __atomic_store_n(waiting, true, __ATOMIC_SEQ_CST);
+    // re-check after announcing ourselves, the other side checks `waiting` after publishing
+    if (ready(s) == false) {
+        pthread_cond_timedwait(sig, &s->rxSigMutex, &ts);
+    }
+    __atomic_store_n(waiting, false, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&s->rxSigMutex);
+}
+
+static bool rx_has_data(comms_state_t *s) {
+    return __atomic_load_n(&s->rx_head, __ATOMIC_SEQ_CST) != __atomic_load_n(&s->rx_tail, __ATOMIC_SEQ_CST);
 }
+
+static bool rx_has_space(comms_state_t *s) {
+    return __atomic_load_n(&s->rx_head, __ATOMIC_SEQ_CST) - __atomic_load_n(&s->rx_tail, __ATOMIC_SEQ_CST) < CMD_BUFFER_SIZE;
+}
+
 /**
- * @brief storeCommand stores a USB command in a circular buffer
- * @param UC
+ * @brief rx_slot returns where the communication thread decodes the next frame: the free slot
+ * of the ring, or rxScratch when the ring is full. It never blocks, frames which are not stored
+ * (debug prints) are handled at once.
  */
-static void storeReply(PacketResponseNG *packet) {
-    pthread_mutex_lock(&rxBufferMutex);
-    if ((cmd_head + 1) % CMD_BUFFER_SIZE == cmd_tail) {
-        //If these two are equal, we're about to overwrite in the
-        // circular buffer.
-        PrintAndLogEx(FAILED, "WARNING: Command buffer about to overwrite command! This needs to be fixed!");
-        fflush(stdout);
+static PacketResponseNG *rx_slot(comms_state_t *s) {
+    if (rx_has_space(s) == false) {
+        return &s->rxScratch;
     }
-    //Store the command at the 'head' location
-    PacketResponseNG *destination = &rxBuffer[cmd_head];
-    memcpy(destination, packet, sizeof(PacketResponseNG));
+    return &s->rxBuffer[s->rx_head & RX_RING_MASK];
+}
 
-    //increment head and wrap
-    cmd_head = (cmd_head + 1) % CMD_BUFFER_SIZE;
-    pthread_mutex_unlock(&rxBufferMutex);
+/**
+ * @brief rx_wait_space blocks the communication thread (back-pressure on the serial link) until
+ * the consumer frees a slot. It gives up when a command is pending for transmission or after
+ * RX_BACKPRESSURE_MS, and after that at once until the consumer reads again, so a flood of
+ * frames nobody reads (e.g. hw status) doesn't stall on each of them.
+ * @return true if there is a free slot
+ */
+static bool rx_wait_space(comms_state_t *s) {
+    uint64_t start = msclock();
+    while (rx_has_space(s) == false) {
+        if (s->rx_dropping || g_conn.run == false || __atomic_load_n(&s->txBuffer_pending, __ATOMIC_SEQ_CST)
+                || msclock() - start > RX_BACKPRESSURE_MS) {
+            s->rx_dropping = true;
+            return false;
+        }
+        rx_sleep(s, &s->rx_producer_waiting, &s->rxSpaceSig, rx_has_space, 100);
+    }
+    s->rx_dropping = false;
+    return true;
 }
+
+/**
+ * @brief storeReply publishes a packet decoded into rx_slot() to the consumer
+ * @param packet
+ */
+static void storeReply(comms_state_t *s, PacketResponseNG *packet) {
+    if (packet == &s->rxScratch) {
+        // decoded while the ring was full
+        if (rx_wait_space(s) == false) {
+            PrintAndLogEx(FAILED, "WARNING: Command buffer full, dropping reply 0x%04x", packet->cmd);
+            fflush(stdout);
+            return;
+        }
+        memcpy(&s->rxBuffer[s->rx_head & RX_RING_MASK], packet, sizeof(PacketResponseNG));
+    }
+
+    uint32_t head = s->rx_head + 1;
+    __atomic_store_n(&s->rx_head, head, __ATOMIC_SEQ_CST);
+
+    uint32_t waiter = __atomic_load_n(&s->rx_waiter_cmd, __ATOMIC_SEQ_CST);
+    if (waiter == CMD_UNKNOWN || waiter == packet->cmd || packet->cmd == CMD_WTX ||
+            head - __atomic_load_n(&s->rx_tail, __ATOMIC_SEQ_CST) >= CMD_BUFFER_SIZE / 2) {
+        rx_wake(s, &s->rx_consumer_waiting, &s->rxDataSig);
+    }
+}
+
+/**
+ * @brief peekReply gives access in place to the oldest unread packet.
+ * It stays valid until releaseReply() is called.
+ * @return NULL if nothing has been received
+ */
+static PacketResponseNG *peekReply(comms_state_t *s) {
+    if (rx_has_data(s) == false) {
+        return NULL;
+    }
+    return &s->rxBuffer[s->rx_tail & RX_RING_MASK];
+}
+
+static void releaseReply(comms_state_t *s) {
+    __atomic_store_n(&s->rx_tail, s->rx_tail + 1, __ATOMIC_SEQ_CST);
+    rx_wake(s, &s->rx_producer_waiting, &s->rxSpaceSig);
+}
+
 /**
  * @brief getCommand gets a command from an internal circular buffer.
  * @param response location to write command
  * @return 1 if response was returned, 0 if nothing has been received
  */
-static int getReply(PacketResponseNG *packet) {
-    pthread_mutex_lock(&rxBufferMutex);
-    //If head == tail, there's nothing to read, or if we just got initialized
-    if (cmd_head == cmd_tail)  {
-        pthread_mutex_unlock(&rxBufferMutex);
+static int getReply(comms_state_t *s, PacketResponseNG *packet) {
+    PacketResponseNG *p = peekReply(s);
+    if (p == NULL) {
         return 0;
     }
-
-    //Pick out the next unread command
-    memcpy(packet, &rxBuffer[cmd_tail], sizeof(PacketResponseNG));
-
-    //Increment tail - this is a circular buffer, so modulo buffer size
-    cmd_tail = (cmd_tail + 1) % CMD_BUFFER_SIZE;
-
-    pthread_mutex_unlock(&rxBufferMutex);
+    memcpy(packet, p, sizeof(PacketResponseNG));
+    releaseReply(s);
     return 1;
 }
 
+// Block the consumer until a packet for `cmd` arrives or `ms` milliseconds passed
+static void waitReply(comms_state_t *s, uint32_t cmd, uint32_t ms) {
+    __atomic_store_n(&s->rx_waiter_cmd, cmd, __ATOMIC_SEQ_CST);
+    rx_sleep(s, &s->rx_consumer_waiting, &s->rxDataSig, rx_has_data, ms);
+    __atomic_store_n(&s->rx_waiter_cmd, CMD_UNKNOWN, __ATOMIC_SEQ_CST);
+}
+
 //-----------------------------------------------------------------------------
 // Entry point into our code: called whenever we received a packet over USB
 // that we weren't necessarily expecting, for example a debug print.
 //-----------------------------------------------------------------------------
-static void PacketResponseReceived(PacketResponseNG *packet) {
+static void PacketResponseReceived(comms_state_t *s, PacketResponseNG *packet) {
 
     // we got a packet, reset WaitForResponseTimeout timeout
-    uint64_t prev_clk = __atomic_load_n(&last_packet_time, __ATOMIC_SEQ_CST);
+    uint64_t prev_clk = __atomic_load_n(&s->last_packet_time, __ATOMIC_SEQ_CST);
     uint64_t clk = msclock();
-    __atomic_store_n(&timeout_start_time,  clk, __ATOMIC_SEQ_CST);
-    __atomic_store_n(&last_packet_time, clk, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&s->timeout_start_time,  clk, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&s->last_packet_time, clk, __ATOMIC_SEQ_CST);
     (void) prev_clk;
 //    PrintAndLogEx(NORMAL, "[%07"PRIu64"] RECV %s magic %08x length %04x status %04x crc %04x cmd %04x",
 //                clk - prev_clk, packet->ng ? "NG" : "OLD", packet->magic, packet->length, packet->status, packet->crc, packet->cmd);
@@ -324,7 +467,7 @@ static void PacketResponseReceived(PacketResponseNG *packet) {
         // CMD_DOWNLOAD_BIGBUF packages which is not dealt with. I wonder if simply ignoring them will
         // work. lets try it.
         default: {
-            storeReply(packet);
+            storeReply(s, packet);
             break;
         }
     }
@@ -341,10 +484,13 @@ __attribute__((force_align_arg_pointer))
 #endif
 #endif
 *uart_communication(void *targ) {
-    communication_arg_t *connection = (communication_arg_t *)targ;
+    // everything done from this thread concerns the device it serves
+    UseProxmark((pm3_device_t *)targ);
+    communication_arg_t *connection = &g_conn;
+    comms_state_t *s = g_device->state;
     uint32_t rxlen;
     bool commfailed = false;
-    PacketResponseNG rx;
+    PacketResponseNG *rx;
     PacketResponseNGRaw rx_raw;
 
 #if defined(__MACH__) && defined(__APPLE__)
@@ -364,34 +510,37 @@ __attribute__((force_align_arg_pointer))
             if (g_conn.last_command != CMD_HARDWARE_RESET) {
                 PrintAndLogEx(WARNING, "\nCommunicating with Proxmark3 device " _RED_("failed"));
             }
-            __atomic_test_and_set(&comm_thread_dead, __ATOMIC_SEQ_CST);
+            __atomic_test_and_set(&s->comm_thread_dead, __ATOMIC_SEQ_CST);
             break;
         }
 
-        res = uart_receive(sp, (uint8_t *)&rx_raw.pre, sizeof(PacketResponseNGPreamble), &rxlen);
+        // decode straight into the response ring when it has room
+        rx = rx_slot(s);
+
+        res = uart_receive(s->sp, (uint8_t *)&rx_raw.pre, sizeof(PacketResponseNGPreamble), &rxlen);
         if ((res == PM3_SUCCESS) && (rxlen == sizeof(PacketResponseNGPreamble))) {
-            rx.magic = rx_raw.pre.magic;
+            rx->magic = rx_raw.pre.magic;
             uint16_t length = rx_raw.pre.length;
-            rx.ng = rx_raw.pre.ng;
-            rx.status = rx_raw.pre.status;
-            rx.cmd = rx_raw.pre.cmd;
-            if (rx.magic == RESPONSENG_PREAMBLE_MAGIC) { // New style NG reply
+            rx->ng = rx_raw.pre.ng;
+            rx->status = rx_raw.pre.status;
+            rx->cmd = rx_raw.pre.cmd;
+            if (rx->magic == RESPONSENG_PREAMBLE_MAGIC) { // New style NG reply
                 if (length > PM3_CMD_DATA_SIZE) {
                     PrintAndLogEx(WARNING, "Received packet frame with incompatible length: 0x%04x", length);
                     error = true;
                 }
                 if ((!error) && (length > 0)) { // Get the variable length payload
 
-                    res = uart_receive(sp, (uint8_t *)&rx_raw.data, length, &rxlen);
+                    res = uart_receive(s->sp, (uint8_t *)&rx_raw.data, length, &rxlen);
                     if ((res != PM3_SUCCESS) || (rxlen != length)) {
                         PrintAndLogEx(WARNING, "Received packet frame with variable part too short? %d/%d", rxlen, length);
                         error = true;
                     } else {
 
-                        if (rx.ng) {      // Received a valid NG frame
-                            memcpy(&rx.data, &rx_raw.data, length);
-                            rx.length = length;
-                            if ((rx.cmd == g_conn.last_command) && (rx.status == PM3_SUCCESS)) {
+                        if (rx->ng) {      // Received a valid NG frame
+                            memcpy(&rx->data, &rx_raw.data, length);
+                            rx->length = length;
+                            if ((rx->cmd == g_conn.last_command) && (rx->status == PM3_SUCCESS)) {
                                 ACK_received = true;
                             }
                         } else {
@@ -402,20 +551,20 @@ __attribute__((force_align_arg_pointer))
                             }
                             if (!error) { // Received a valid MIX frame
                                 memcpy(arg, &rx_raw.data, sizeof(arg));
-                                rx.oldarg[0] = arg[0];
-                                rx.oldarg[1] = arg[1];
-                                rx.oldarg[2] = arg[2];
-                                memcpy(&rx.data, ((uint8_t *)&rx_raw.data) + sizeof(arg), length - sizeof(arg));
-                                rx.length = length - sizeof(arg);
-                                if (rx.cmd == CMD_ACK) {
+                                rx->oldarg[0] = arg[0];
+                                rx->oldarg[1] = arg[1];
+                                rx->oldarg[2] = arg[2];
+                                memcpy(&rx->data, ((uint8_t *)&rx_raw.data) + sizeof(arg), length - sizeof(arg));
+                                rx->length = length - sizeof(arg);
+                                if (rx->cmd == CMD_ACK) {
                                     ACK_received = true;
                                 }
                             }
                         }
                     }
                 } else if ((!error) && (length == 0)) { // we received an empty frame
-                    if (rx.ng)
-                        rx.length = 0; // set received length to 0
+                    if (rx->ng)
+                        rx->length = 0; // set received length to 0
                     else {  // old frames can't be empty
                         PrintAndLogEx(WARNING, "Received empty MIX packet frame (length: 0x00)");
 
@@ -423,39 +572,39 @@ __attribute__((force_align_arg_pointer))
                     }
                 }
                 if (!error) {                        // Get the postamble
-                    res = uart_receive(sp, (uint8_t *)&rx_raw.foopost, sizeof(PacketResponseNGPostamble), &rxlen);
+                    res = uart_receive(s->sp, (uint8_t *)&rx_raw.foopost, sizeof(PacketResponseNGPostamble), &rxlen);
                     if ((res != PM3_SUCCESS) || (rxlen != sizeof(PacketResponseNGPostamble))) {
                         PrintAndLogEx(WARNING, "Received packet frame without postamble");
                         error = true;
                     }
                 }
                 if (!error) {                        // Check CRC, accept MAGIC as placeholder
-                    rx.crc = rx_raw.foopost.crc;
-                    if (rx.crc != RESPONSENG_POSTAMBLE_MAGIC) {
+                    rx->crc = rx_raw.foopost.crc;
+                    if (rx->crc != RESPONSENG_POSTAMBLE_MAGIC) {
                         uint8_t first, second;
                         compute_crc(CRC_14443_A, (uint8_t *)&rx_raw, sizeof(PacketResponseNGPreamble) + length, &first, &second);
-                        if ((first << 8) + second != rx.crc) {
-                            PrintAndLogEx(WARNING, "Received packet frame with invalid CRC %02X%02X <> %04X", first, second, rx.crc);
+                        if ((first << 8) + second != rx->crc) {
+                            PrintAndLogEx(WARNING, "Received packet frame with invalid CRC %02X%02X <> %04X", first, second, rx->crc);
                             error = true;
                         }
                     }
                 }
                 if (!error) {             // Received a valid OLD frame
 #ifdef COMMS_DEBUG
-                    PrintAndLogEx(NORMAL, "Receiving %s:", rx.ng ? "NG" : "MIX");
+                    PrintAndLogEx(NORMAL, "Receiving %s:", rx->ng ? "NG" : "MIX");
 #endif
 #ifdef COMMS_DEBUG_RAW
                     print_hex_break((uint8_t *)&rx_raw.pre, sizeof(PacketResponseNGPreamble), 32);
                     print_hex_break((uint8_t *)&rx_raw.data, rx_raw.pre.length, 32);
                     print_hex_break((uint8_t *)&rx_raw.foopost, sizeof(PacketResponseNGPostamble), 32);
 #endif
-                    PacketResponseReceived(&rx);
+                    PacketResponseReceived(s, rx);
                 }
             } else {                               // Old style reply
                 PacketResponseOLD rx_old;
                 memcpy(&rx_old, &rx_raw.pre, sizeof(PacketResponseNGPreamble));
 
-                res = uart_receive(sp, ((uint8_t *)&rx_old) + sizeof(PacketResponseNGPreamble), sizeof(PacketResponseOLD) - sizeof(PacketResponseNGPreamble), &rxlen);
+                res = uart_receive(s->sp, ((uint8_t *)&rx_old) + sizeof(PacketResponseNGPreamble), sizeof(PacketResponseOLD) - sizeof(PacketResponseNGPreamble), &rxlen);
                 if ((res != PM3_SUCCESS) || (rxlen != sizeof(PacketResponseOLD) - sizeof(PacketResponseNGPreamble))) {
                     PrintAndLogEx(WARNING, "Received packet OLD frame with payload too short? %d/%zu", rxlen, sizeof(PacketResponseOLD) - sizeof(PacketResponseNGPreamble));
                     error = true;
@@ -469,20 +618,20 @@ __attribute__((force_align_arg_pointer))
                     print_hex_break((uint8_t *)&rx_old.arg, sizeof(rx_old.arg), 32);
                     print_hex_break((uint8_t *)&rx_old.d, sizeof(rx_old.d), 32);
 #endif
-                    rx.ng = false;
-                    rx.magic = 0;
-                    rx.status = 0;
-                    rx.crc = 0;
-                    rx.cmd = rx_old.cmd;
-                    rx.oldarg[0] = rx_old.arg[0];
-                    rx.oldarg[1] = rx_old.arg[1];
-                    rx.oldarg[2] = rx_old.arg[2];
-                    rx.length = PM3_CMD_DATA_SIZE;
-                    memcpy(&rx.data, &rx_old.d, rx.length);
-                    PacketResponseReceived(&rx);
-                    if (rx.cmd == CMD_ACK) {
+                    rx->ng = false;
+                    rx->magic = 0;
+                    rx->status = 0;
+                    rx->crc = 0;
+                    rx->cmd = rx_old.cmd;
+                    rx->oldarg[0] = rx_old.arg[0];
+                    rx->oldarg[1] = rx_old.arg[1];
+                    rx->oldarg[2] = rx_old.arg[2];
+                    rx->length = PM3_CMD_DATA_SIZE;
+                    memcpy(&rx->data, &rx_old.d, rx->length);
+                    if (rx->cmd == CMD_ACK) {
                         ACK_received = true;
                     }
+                    PacketResponseReceived(s, rx);
                 }
             }
         } else {
@@ -497,7 +646,7 @@ __attribute__((force_align_arg_pointer))
 
         // TODO if error, shall we resync ?
 
-        pthread_mutex_lock(&txBufferMutex);
+        pthread_mutex_lock(&s->txBufferMutex);
 
         if (connection->block_after_ACK) {
             // if we just received an ACK, wait here until a new command is to be transmitted
@@ -506,43 +655,43 @@ __attribute__((force_align_arg_pointer))
 #ifdef COMMS_DEBUG
                 PrintAndLogEx(NORMAL, "Received ACK, fast TX mode: ignoring other RX till TX");
 #endif
-                while (!txBuffer_pending) {
-                    pthread_cond_wait(&txBufferSig, &txBufferMutex);
+                while (!s->txBuffer_pending) {
+                    pthread_cond_wait(&s->txBufferSig, &s->txBufferMutex);
                 }
             }
         }
 
-        if (txBuffer_pending) {
+        if (s->txBuffer_pending) {
 
-            if (txBufferNGLen) { // NG packet
-                res = uart_send(sp, (uint8_t *) &txBufferNG, txBufferNGLen);
+            if (s->txBufferNGLen) { // NG packet
+                res = uart_send(s->sp, (uint8_t *) &s->txBufferNG, s->txBufferNGLen);
                 if (res == PM3_EIO) {
                     commfailed = true;
                 }
-                g_conn.last_command = txBufferNG.pre.cmd;
-                txBufferNGLen = 0;
+                g_conn.last_command = s->txBufferNG.pre.cmd;
+                s->txBufferNGLen = 0;
             } else {
-                res = uart_send(sp, (uint8_t *) &txBuffer, sizeof(PacketCommandOLD));
+                res = uart_send(s->sp, (uint8_t *) &s->txBuffer, sizeof(PacketCommandOLD));
                 if (res == PM3_EIO) {
                     commfailed = true;
                 }
-                g_conn.last_command = txBuffer.cmd;
+                g_conn.last_command = s->txBuffer.cmd;
             }
 
-            txBuffer_pending = false;
+            s->txBuffer_pending = false;
 
             // main thread doesn't know send failed...
 
             // tell main thread that txBuffer is empty
-            pthread_cond_signal(&txBufferSig);
+            pthread_cond_signal(&s->txBufferSig);
         }
 
-        pthread_mutex_unlock(&txBufferMutex);
+        pthread_mutex_unlock(&s->txBufferMutex);
     }
 
     // when thread dies, we close the serial port.
-    uart_close(sp);
-    sp = NULL;
+    uart_close(s->sp);
+    s->sp = NULL;
 
 #if defined(__MACH__) && defined(__APPLE__)
     enableAppNap();
@@ -553,39 +702,95 @@ __attribute__((force_align_arg_pointer))
 }
 
 bool IsCommunicationThreadDead(void) {
-    bool ret = __atomic_load_n(&comm_thread_dead, __ATOMIC_SEQ_CST);
+    comms_state_t *s = g_device->state;
+    bool ret = __atomic_load_n(&s->comm_thread_dead, __ATOMIC_SEQ_CST);
     return ret;
 }
 
+pm3_device_t *NewProxmark(void) {
+    pm3_device_t *dev = calloc(1, sizeof(pm3_device_t));
+    comms_state_t *s = calloc(1, sizeof(comms_state_t));
+    if (dev == NULL || s == NULL) {
+        free(dev);
+        free(s);
+        return NULL;
+    }
+
+    pthread_mutex_init(&s->txBufferMutex, NULL);
+    pthread_cond_init(&s->txBufferSig, NULL);
+    pthread_mutex_init(&s->rxSigMutex, NULL);
+    pthread_cond_init(&s->rxDataSig, NULL);
+    pthread_cond_init(&s->rxSpaceSig, NULL);
+    s->rx_waiter_cmd = CMD_UNKNOWN;
+
+    dev->state = s;
+    return dev;
+}
+
+void FreeProxmark(pm3_device_t *dev) {
+    if (dev == NULL || dev == &s_device) {
+        return;
+    }
+
+    if (dev->pm3_present) {
+        CloseProxmark(dev);
+    }
+
+    if (g_device == dev) {
+        UseProxmark(NULL);
+    }
+
+    comms_state_t *s = dev->state;
+    pthread_mutex_destroy(&s->txBufferMutex);
+    pthread_cond_destroy(&s->txBufferSig);
+    pthread_mutex_destroy(&s->rxSigMutex);
+    pthread_cond_destroy(&s->rxDataSig);
+    pthread_cond_destroy(&s->rxSpaceSig);
+    free(s);
+    free(dev);
+}
+
+void UseProxmark(pm3_device_t *dev) {
+    g_device = (dev != NULL) ? dev : &s_device;
+}
+
 bool OpenProxmark(pm3_device_t **dev, const char *port, bool wait_for_port, int timeout, bool flash_mode, uint32_t speed) {
 
+    // without a device given, open the one this thread uses. Either way
+    // the calling thread talks to the opened device from now on.
+    if (*dev == NULL) {
+        *dev = g_device;
+    }
+    UseProxmark(*dev);
+    comms_state_t *s = g_device->state;
+
     if (!wait_for_port) {
         PrintAndLogEx(INFO, "Using UART port " _YELLOW_("%s"), port);
-        sp = uart_open(port, speed);
+        s->sp = uart_open(port, speed);
     } else {
         PrintAndLogEx(SUCCESS, "Waiting for Proxmark3 to appear on " _YELLOW_("%s"), port);
         fflush(stdout);
         int openCount = 0;
         PrintAndLogEx(INPLACE, "% 3i", timeout);
         do {
-            sp = uart_open(port, speed);
+            s->sp = uart_open(port, speed);
             msleep(500);
             PrintAndLogEx(INPLACE, "% 3i", timeout - openCount - 1);
 
-        } while (++openCount < timeout && (sp == INVALID_SERIAL_PORT || sp == CLAIMED_SERIAL_PORT));
+        } while (++openCount < timeout && (s->sp == INVALID_SERIAL_PORT || s->sp == CLAIMED_SERIAL_PORT));
     }
 
     // check result of uart opening
-    if (sp == INVALID_SERIAL_PORT) {
+    if (s->sp == INVALID_SERIAL_PORT) {
         PrintAndLogEx(WARNING, "\n" _RED_("ERROR:") " invalid serial port " _YELLOW_("%s"), port);
         PrintAndLogEx(HINT, "Try the shell script " _YELLOW_("`./pm3 --list`") " to get a list of possible serial ports");
-        sp = NULL;
+        s->sp = NULL;
         return false;
-    } else if (sp == CLAIMED_SERIAL_PORT) {
+    } else if (s->sp == CLAIMED_SERIAL_PORT) {
         PrintAndLogEx(WARNING, "\n" _RED_("ERROR:") " serial port " _YELLOW_("%s") " is claimed by another process", port);
         PrintAndLogEx(HINT, "Try the shell script " _YELLOW_("`./pm3 --list`") " to get a list of possible serial ports");
 
-        sp = NULL;
+        s->sp = NULL;
         return false;
     } else {
         // start the communication thread
@@ -602,15 +807,11 @@ bool OpenProxmark(pm3_device_t **dev, const char *port, bool wait_for_port, int
         // "Session" flag, to tell via which interface next msgs should be sent: USB or FPC USART
         g_conn.send_via_fpc_usart = false;
 
-        pthread_create(&communication_thread, NULL, &uart_communication, &g_conn);
-        __atomic_clear(&comm_thread_dead, __ATOMIC_SEQ_CST);
-        g_session.pm3_present = true; // TODO support for multiple devices
+        pthread_create(&s->communication_thread, NULL, &uart_communication, g_device);
+        __atomic_clear(&s->comm_thread_dead, __ATOMIC_SEQ_CST);
+        g_device->pm3_present = true;
 
         fflush(stdout);
-        if (*dev == NULL) {
-            *dev = calloc(sizeof(pm3_device_t), sizeof(uint8_t));
-        }
-        (*dev)->g_conn = &g_conn; // TODO g_conn shouldn't be global
         return true;
     }
 }
@@ -618,13 +819,16 @@ bool OpenProxmark(pm3_device_t **dev, const char *port, bool wait_for_port, int
 // check if we can communicate with Pm3
 int TestProxmark(pm3_device_t *dev) {
 
+    UseProxmark(dev);
+    comms_state_t *s = g_device->state;
+
     PacketResponseNG resp;
     uint16_t len = 32;
     uint8_t data[len];
     for (uint16_t i = 0; i < len; i++)
         data[i] = i & 0xFF;
 
-    __atomic_store_n(&last_packet_time,  msclock(), __ATOMIC_SEQ_CST);
+    __atomic_store_n(&s->last_packet_time,  msclock(), __ATOMIC_SEQ_CST);
     clearCommandBuffer();
     SendCommandNG(CMD_PING, data, len);
 
@@ -680,31 +884,32 @@ int TestProxmark(pm3_device_t *dev) {
 }
 
 void CloseProxmark(pm3_device_t *dev) {
-    dev->g_conn->run = false;
+    comms_state_t *s = dev->state;
+    dev->conn.run = false;
 
 #ifdef __BIONIC__
-    if (communication_thread != 0) {
-        pthread_join(communication_thread, NULL);
+    if (s->communication_thread != 0) {
+        pthread_join(s->communication_thread, NULL);
     }
 #else
-    pthread_join(communication_thread, NULL);
+    pthread_join(s->communication_thread, NULL);
 #endif
 
-    if (sp) {
-        uart_close(sp);
+    if (s->sp) {
+        uart_close(s->sp);
     }
 
     // Clean up our state
-    sp = NULL;
+    s->sp = NULL;
 #ifdef __BIONIC__
-    if (communication_thread != 0) {
-        memset(&communication_thread, 0, sizeof(pthread_t));
+    if (s->communication_thread != 0) {
+        memset(&s->communication_thread, 0, sizeof(pthread_t));
     }
 #else
-    memset(&communication_thread, 0, sizeof(pthread_t));
+    memset(&s->communication_thread, 0, sizeof(pthread_t));
 #endif
 
-    g_session.pm3_present = false;
+    dev->pm3_present = false;
 }
 
 // Gives a rough estimate of the communication delay based on channel & baudrate
@@ -722,6 +927,17 @@ static size_t communication_delay(void) {
     return 0;
 }
 
+// How long the consumer may sleep before it has to re-check its timeout.
+// Each received packet pushes timeout_start_time forward, so a deadline can only move later.
+static uint32_t wait_slice(uint64_t elapsed, size_t ms_timeout, bool show_warning) {
+    uint64_t slice = 1000;
+    if (ms_timeout != (size_t) - 1 && ms_timeout - elapsed < slice)
+        slice = ms_timeout - elapsed + 1;
+    if (show_warning && elapsed < 3000 && 3000 - elapsed < slice)
+        slice = 3000 - elapsed + 1;
+    return (uint32_t)slice;
+}
+
 /**
  * @brief Waits for a certain response type. This method waits for a maximum of
  * ms_timeout milliseconds for a specified response command.
@@ -734,6 +950,7 @@ static size_t communication_delay(void) {
  */
 bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms_timeout, bool show_warning) {
 
+    comms_state_t *s = g_device->state;
     PacketResponseNG resp;
 
     if (response == NULL)
@@ -743,12 +960,12 @@ bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms
     if (ms_timeout != (size_t) - 1)
         ms_timeout += communication_delay();
 
-    __atomic_store_n(&timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
+    __atomic_store_n(&s->timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
 
     // Wait until the command is received
     while (true) {
 
-        while (getReply(response)) {
+        while (getReply(s, response)) {
             if (cmd == CMD_UNKNOWN || response->cmd == cmd) {
                 return true;
             }
@@ -760,18 +977,20 @@ bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms
             }
         }
 
-        uint64_t tmp_clk = __atomic_load_n(&timeout_start_time, __ATOMIC_SEQ_CST);
-        if ((ms_timeout != (size_t) - 1) && (msclock() - tmp_clk > ms_timeout))
+        uint64_t tmp_clk = __atomic_load_n(&s->timeout_start_time, __ATOMIC_SEQ_CST);
+        uint64_t elapsed = msclock() - tmp_clk;
+        if ((ms_timeout != (size_t) - 1) && (elapsed > ms_timeout))
             break;
 
-        if (msclock() - tmp_clk > 3000 && show_warning) {
+        if (elapsed > 3000 && show_warning) {
             // 3 seconds elapsed (but this doesn't mean the timeout was exceeded)
 //            PrintAndLogEx(INFO, "Waiting for a response from the Proxmark3...");
             PrintAndLogEx(INFO, "You can cancel this operation by pressing the pm3 button");
             show_warning = false;
         }
-        // just to avoid CPU busy loop:
-        msleep(10);
+
+        // sleep until the communication thread hands us a packet for `cmd`
+        waitReply(s, cmd, wait_slice(elapsed, ms_timeout, show_warning));
     }
     return false;
 }
@@ -813,10 +1032,16 @@ bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint3
 
     switch (memtype) {
         case BIG_BUF: {
+            if (g_pm3_capabilities.compressed_download) {
+                return dl_lz4(DL_LZ4_MEM_BIGBUF, dest, bytes, start_index, response, ms_timeout, show_warning);
+            }
             SendCommandMIX(CMD_DOWNLOAD_BIGBUF, start_index, bytes, 0, NULL, 0);
             return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_BIGBUF);
         }
         case BIG_BUF_EML: {
+            if (g_pm3_capabilities.compressed_download) {
+                return dl_lz4(DL_LZ4_MEM_EML, dest, bytes, start_index, response, ms_timeout, show_warning);
+            }
             SendCommandMIX(CMD_DOWNLOAD_EML_BIGBUF, start_index, bytes, 0, NULL, 0);
             return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_EML_BIGBUF);
         }
@@ -841,10 +1066,21 @@ bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint3
     return false;
 }
 
+static bool dl_lz4(uint8_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, PacketResponseNG *response, size_t ms_timeout, bool show_warning) {
+    dl_lz4_request_t req = {
+        .memtype = memtype,
+        .offset = start_index,
+        .len = bytes,
+    };
+    SendCommandNG(CMD_DOWNLOAD_BIGBUF_LZ4, (uint8_t *)&req, sizeof(req));
+    return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_BIGBUF_LZ4);
+}
+
 static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, size_t ms_timeout, bool show_warning, uint32_t rec_cmd) {
 
+    comms_state_t *s = g_device->state;
     uint32_t bytes_completed = 0;
-    __atomic_store_n(&timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
+    __atomic_store_n(&s->timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
 
     // Add delay depending on the communication channel & speed
     if (ms_timeout != (size_t) - 1)
@@ -852,23 +1088,57 @@ static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, siz
 
     while (true) {
 
-        if (getReply(response)) {
+        PacketResponseNG *rx;
+        while ((rx = peekReply(s)) != NULL) {
 
-            if (response->cmd == CMD_ACK)
-                return true;
-            // Spiffs download is converted to NG,
-            if (response->cmd == CMD_SPIFFS_DOWNLOAD)
+            if (rx->cmd == CMD_ACK || rx->cmd == CMD_SPIFFS_DOWNLOAD) {
+                // Spiffs download is converted to NG,
+                memcpy(response, rx, sizeof(PacketResponseNG));
+                releaseReply(s);
                 return true;
+            }
+
+            // compressed chunks carry their own header, see dl_lz4_chunk_t
+            if (rx->cmd == CMD_DOWNLOADED_BIGBUF_LZ4 && rec_cmd == CMD_DOWNLOADED_BIGBUF_LZ4 && rx->length >= offsetof(dl_lz4_chunk_t, data)) {
+
+                const dl_lz4_chunk_t *chunk = (const dl_lz4_chunk_t *)rx->data.asBytes;
+                uint32_t clen = rx->length - offsetof(dl_lz4_chunk_t, data);
+
+                if (chunk->offset + chunk->rawlen > bytes) {
+                    PrintAndLogEx(FAILED, "ERROR: Out of bounds when downloading from device,  offset %u | len %u | total len %u > buf_size %u", chunk->offset, chunk->rawlen,  chunk->offset + chunk->rawlen,  bytes);
+                    releaseReply(s);
+                    return false;
+                }
+
+                // decompress straight into the destination
+                int res = chunk->rawlen;
+                if (chunk->flags & DL_LZ4_STORED) {
+                    if (clen != chunk->rawlen)
+                        res = -1;
+                    else
+                        memcpy(dest + chunk->offset, chunk->data, clen);
+                } else {
+                    res = LZ4_decompress_safe((const char *)chunk->data, (char *)dest + chunk->offset, clen, bytes - chunk->offset);
+                }
+                if (res != chunk->rawlen) {
+                    PrintAndLogEx(FAILED, "ERROR: Corrupt compressed chunk when downloading from device,  offset %u | len %u", chunk->offset, chunk->rawlen);
+                    releaseReply(s);
+                    return false;
+                }
+                bytes_completed += chunk->rawlen;
+                releaseReply(s);
+                continue;
+            }
 
             // sample_buf is a array pointer, located in data.c
             // arg0 = offset in transfer. Startindex of this chunk
             // arg1 = length bytes to transfer
             // arg2 = bigbuff tracelength (?)
-            if (response->cmd == rec_cmd) {
+            if (rx->cmd == rec_cmd) {
 
-                uint32_t offset = response->oldarg[0];
-                uint32_t copy_bytes = MIN(bytes - bytes_completed, response->oldarg[1]);
-                //uint32_t tracelen = response->oldarg[2];
+                uint32_t offset = rx->oldarg[0];
+                uint32_t copy_bytes = MIN(bytes - bytes_completed, rx->oldarg[1]);
+                //uint32_t tracelen = rx->oldarg[2];
 
                 // extended bounds check1.  upper limit is PM3_CMD_DATA_SIZE
                 // shouldn't happen
@@ -877,31 +1147,38 @@ static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, siz
                 // extended bounds check2.
                 if (offset + copy_bytes > bytes) {
                     PrintAndLogEx(FAILED, "ERROR: Out of bounds when downloading from device,  offset %u | len %u | total len %u > buf_size %u", offset, copy_bytes,  offset + copy_bytes,  bytes);
-                    break;
+                    releaseReply(s);
+                    return false;
                 }
 
-                memcpy(dest + offset, response->data.asBytes, copy_bytes);
+                // copy chunk directly out of the response ring
+                memcpy(dest + offset, rx->data.asBytes, copy_bytes);
                 bytes_completed += copy_bytes;
-            } else if (response->cmd == CMD_WTX && response->length == sizeof(uint16_t)) {
-                uint16_t wtx = response->data.asDwords[0] & 0xFFFF;
+            } else if (rx->cmd == CMD_WTX && rx->length == sizeof(uint16_t)) {
+                uint16_t wtx = rx->data.asDwords[0] & 0xFFFF;
                 PrintAndLogEx(DEBUG, "Got Waiting Time eXtension request %i ms", wtx);
                 if (ms_timeout != (size_t) - 1)
                     ms_timeout += wtx;
             }
+            releaseReply(s);
         }
 
-        uint64_t tmp_clk = __atomic_load_n(&timeout_start_time, __ATOMIC_SEQ_CST);
-        if (msclock() - tmp_clk > ms_timeout) {
+        uint64_t tmp_clk = __atomic_load_n(&s->timeout_start_time, __ATOMIC_SEQ_CST);
+        uint64_t elapsed = msclock() - tmp_clk;
+        if (elapsed > ms_timeout) {
             PrintAndLogEx(FAILED, "Timed out while trying to download data from device");
             break;
         }
 
-        if (msclock() - tmp_clk > 3000 && show_warning) {
+        if (elapsed > 3000 && show_warning) {
             // 3 seconds elapsed (but this doesn't mean the timeout was exceeded)
             PrintAndLogEx(INFO, "Waiting for a response from the Proxmark3...");
             PrintAndLogEx(INFO, "You can cancel this operation by pressing the pm3 button");
             show_warning = false;
         }
+
+        // every chunk is of interest here
+        waitReply(s, CMD_UNKNOWN, wait_slice(elapsed, ms_timeout, show_warning));
     }
     return false;
 }
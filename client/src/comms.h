@@ -42,7 +42,7 @@ extern "C" {
 
 //For storing command that are received from the device
 #ifndef CMD_BUFFER_SIZE
-#define CMD_BUFFER_SIZE 100
+#define CMD_BUFFER_SIZE 128
 #endif
 
 typedef enum {
@@ -68,13 +68,22 @@ typedef struct {
     char serial_port_name[FILE_PATH_SIZE];
 } communication_arg_t;
 
-extern communication_arg_t g_conn;
-
 typedef struct pm3_device {
-    communication_arg_t *g_conn;
+    communication_arg_t conn;
+    capabilities_t capabilities;
+    bool pm3_present;
     int script_embedded;
+    // communication thread, transmit buffer and response ring, private to comms.c
+    struct comms_state *state;
 } pm3_device_t;
 
+// Device the commands of the calling thread go to. Threads start on the
+// device of the main session, see UseProxmark()
+extern __thread pm3_device_t *g_device;
+
+#define g_conn              (g_device->conn)
+#define g_pm3_capabilities  (g_device->capabilities)
+
 void *uart_receiver(void *targ);
 void SendCommandBL(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, void *data, size_t len);
 void SendCommandOLD(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, void *data, size_t len);
@@ -84,6 +93,13 @@ void clearCommandBuffer(void);
 
 #define FLASHMODE_SPEED 460800
 bool IsCommunicationThreadDead(void);
+
+// Extra devices, each with its own connection. The session device always
+// exists and is never freed.
+pm3_device_t *NewProxmark(void);
+void FreeProxmark(pm3_device_t *dev);
+// select the device for the calling thread, NULL for the session device
+void UseProxmark(pm3_device_t *dev);
 bool OpenProxmark(pm3_device_t **dev, const char *port, bool wait_for_port, int timeout, bool flash_mode, uint32_t speed);
 int TestProxmark(pm3_device_t *dev);
 void CloseProxmark(pm3_device_t *dev);
@@ -0,0 +1,345 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Key dictionary engine
+//-----------------------------------------------------------------------------
+#include "dictionary.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "fileutils.h"
+#include "ui.h"
+
+typedef struct {
+    char magic[8];
+    uint64_t src_size;      // size of the text dictionary the cache was built from
+    int64_t src_mtime;      // and its modification time
+    uint32_t count;
+    uint32_t duplicates;
+    uint8_t keylen;
+    uint8_t reserved[7];
+} dictionary_cache_header_t;
+
+static int hexnibble(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Same rules as the old line based loader: a line holds a key if it starts with
+// keylen * 2 hex digits, everything after that is ignored. '#' starts a comment.
+static bool parse_key(const char *line, size_t linelen, uint8_t keylen, uint8_t *key) {
+    if (linelen < (size_t)keylen * 2 || line[0] == '#')
+        return false;
+
+    for (uint8_t i = 0; i < keylen; i++) {
+        int hi = hexnibble(line[i * 2]);
+        int lo = hexnibble(line[i * 2 + 1]);
+        if (hi < 0 || lo < 0)
+            return false;
+        key[i] = (hi << 4) | lo;
+    }
+    return true;
+}
+
+static const uint8_t *sort_keys;
+static uint8_t sort_keylen;
+
+static int compare_key_index(const void *a, const void *b) {
+    uint32_t ia = *(const uint32_t *)a;
+    uint32_t ib = *(const uint32_t *)b;
+    int res = memcmp(sort_keys + (size_t)ia * sort_keylen, sort_keys + (size_t)ib * sort_keylen, sort_keylen);
+    if (res)
+        return res;
+    // equal keys sort by position, the first occurrence leads its group
+    return (ia > ib) - (ia < ib);
+}
+
+// drops repeated keys in place, keeping the first occurrence and the file order
+static uint32_t dedup_keys(uint8_t *keys, uint32_t count, uint8_t keylen) {
+    if (count < 2)
+        return count;
+
+    uint32_t *order = calloc(count, sizeof(uint32_t));
+    uint8_t *keep = calloc(count, sizeof(uint8_t));
+    if (order == NULL || keep == NULL) {
+        free(order);
+        free(keep);
+        return count;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+        order[i] = i;
+
+    sort_keys = keys;
+    sort_keylen = keylen;
+    qsort(order, count, sizeof(uint32_t), compare_key_index);
+
+    keep[order[0]] = 1;
+    for (uint32_t i = 1; i < count; i++) {
+        if (memcmp(keys + (size_t)order[i] * keylen, keys + (size_t)order[i - 1] * keylen, keylen) != 0)
+            keep[order[i]] = 1;
+    }
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (keep[i] == 0)
+            continue;
+        if (n != i)
+            memcpy(keys + (size_t)n * keylen, keys + (size_t)i * keylen, keylen);
+        n++;
+    }
+
+    free(order);
+    free(keep);
+    return n;
+}
+
+static int parse_dictionary(dictionary_t *dict, const char *text, size_t len) {
+
+    size_t mem_size = 0;
+    uint8_t *keys = NULL;
+    uint32_t count = 0;
+
+    for (size_t i = 0; i < len;) {
+        const char *line = text + i;
+        const char *eol = memchr(line, '\n', len - i);
+        size_t linelen = (eol) ? (size_t)(eol - line) : len - i;
+        i += linelen + 1;
+
+        if (((size_t)count + 1) * dict->keylen > mem_size) {
+            // grow geometrically, big dictionaries hold millions of keys
+            size_t new_size = (mem_size) ? mem_size * 2 : 64 * dict->keylen;
+            uint8_t *tmp = realloc(keys, new_size);
+            if (tmp == NULL) {
+                free(keys);
+                return PM3_EMALLOC;
+            }
+            keys = tmp;
+            mem_size = new_size;
+        }
+
+        if (parse_key(line, linelen, dict->keylen, keys + (size_t)count * dict->keylen))
+            count++;
+    }
+
+    dict->count = dedup_keys(keys, count, dict->keylen);
+    dict->duplicates = count - dict->count;
+    dict->keys = keys;
+    dict->base = keys;
+    dict->size = (size_t)dict->count * dict->keylen;
+    dict->mapped = false;
+    return PM3_SUCCESS;
+}
+
+#if !defined(_WIN32)
+static char *cache_path(const dictionary_t *dict) {
+    size_t len = strlen(dict->path) + 16;
+    char *path = calloc(len, sizeof(char));
+    if (path != NULL)
+        snprintf(path, len, "%s.%u.cache", dict->path, dict->keylen);
+    return path;
+}
+
+static bool map_cache(dictionary_t *dict, const struct stat *src) {
+    char *path = cache_path(dict);
+    if (path == NULL)
+        return false;
+
+    int fd = open(path, O_RDONLY);
+    free(path);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(dictionary_cache_header_t)) {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    const dictionary_cache_header_t *hdr = (const dictionary_cache_header_t *)map;
+    if (memcmp(hdr->magic, DICTIONARY_CACHE_MAGIC, sizeof(hdr->magic)) != 0
+            || hdr->keylen != dict->keylen
+            || hdr->src_size != (uint64_t)src->st_size
+            || hdr->src_mtime != (int64_t)src->st_mtime
+            || sizeof(dictionary_cache_header_t) + (uint64_t)hdr->count * hdr->keylen != (uint64_t)st.st_size) {
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    dict->count = hdr->count;
+    dict->duplicates = hdr->duplicates;
+    dict->keys = (const uint8_t *)map + sizeof(dictionary_cache_header_t);
+    dict->base = map;
+    dict->size = st.st_size;
+    dict->mapped = true;
+    return true;
+}
+
+static void write_cache(const dictionary_t *dict, const struct stat *src) {
+    dictionary_cache_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, DICTIONARY_CACHE_MAGIC, sizeof(hdr.magic));
+    hdr.src_size = src->st_size;
+    hdr.src_mtime = src->st_mtime;
+    hdr.count = dict->count;
+    hdr.duplicates = dict->duplicates;
+    hdr.keylen = dict->keylen;
+
+    char *path = cache_path(dict);
+    if (path == NULL)
+        return;
+
+    // write to a temporary file and rename, concurrent clients never see a partial cache
+    char tmp_path[strlen(path) + 16];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, (int)getpid());
+
+    // dictionaries in a read-only install location simply stay uncached
+    FILE *f = fopen(tmp_path, "wb");
+    if (f == NULL) {
+        free(path);
+        return;
+    }
+
+    bool ok = (fwrite(&hdr, sizeof(hdr), 1, f) == 1);
+    if (ok && dict->count)
+        ok = (fwrite(dict->keys, (size_t)dict->count * dict->keylen, 1, f) == 1);
+    ok &= (fclose(f) == 0);
+
+    if (ok == false || rename(tmp_path, path) != 0)
+        remove(tmp_path);
+
+    free(path);
+}
+
+static int load_text(dictionary_t *dict, const struct stat *src) {
+    if (src->st_size == 0)
+        return parse_dictionary(dict, "", 0);
+
+    int fd = open(dict->path, O_RDONLY);
+    if (fd < 0)
+        return PM3_EFILE;
+
+    void *map = mmap(NULL, src->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return PM3_EFILE;
+
+    madvise(map, src->st_size, MADV_SEQUENTIAL);
+    int res = parse_dictionary(dict, map, src->st_size);
+    munmap(map, src->st_size);
+    return res;
+}
+#else
+static int load_text(dictionary_t *dict, const struct stat *src) {
+    FILE *f = fopen(dict->path, "rb");
+    if (f == NULL)
+        return PM3_EFILE;
+
+    char *text = calloc(src->st_size + 1, sizeof(char));
+    if (text == NULL) {
+        fclose(f);
+        return PM3_EMALLOC;
+    }
+
+    size_t len = fread(text, 1, src->st_size, f);
+    fclose(f);
+
+    int res = parse_dictionary(dict, text, len);
+    free(text);
+    return res;
+}
+#endif
+
+int dictionary_open(dictionary_t *dict, const char *preferredName, uint8_t keylen, bool verbose) {
+
+    if (dict == NULL || keylen == 0)
+        return PM3_EINVARG;
+
+    memset(dict, 0, sizeof(dictionary_t));
+    dict->keylen = keylen;
+
+    if (searchFile(&dict->path, DICTIONARIES_SUBDIR, preferredName, ".dic", false) != PM3_SUCCESS)
+        return PM3_EFILE;
+
+    struct stat st;
+    if (stat(dict->path, &st) != 0) {
+        PrintAndLogEx(WARNING, "file not found or locked. '" _YELLOW_("%s")"'", dict->path);
+        dictionary_close(dict);
+        return PM3_EFILE;
+    }
+
+#if !defined(_WIN32)
+    if (map_cache(dict, &st))
+        return PM3_SUCCESS;
+#endif
+
+    int res = load_text(dict, &st);
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "file not found or locked. '" _YELLOW_("%s")"'", dict->path);
+        dictionary_close(dict);
+        return res;
+    }
+
+#if !defined(_WIN32)
+    write_cache(dict, &st);
+#endif
+
+    if (verbose && dict->duplicates)
+        PrintAndLogEx(INFO, "skipped " _YELLOW_("%u") " duplicate keys in " _YELLOW_("%s"), dict->duplicates, dict->path);
+
+    return PM3_SUCCESS;
+}
+
+uint32_t dictionary_next(dictionary_t *dict, uint8_t *dest, uint32_t maxkeys) {
+    if (dict->pos >= dict->count)
+        return 0;
+
+    uint32_t n = MIN(maxkeys, dict->count - dict->pos);
+    memcpy(dest, dict->keys + (size_t)dict->pos * dict->keylen, (size_t)n * dict->keylen);
+    dict->pos += n;
+    return n;
+}
+
+void dictionary_seek(dictionary_t *dict, uint32_t pos) {
+    dict->pos = MIN(pos, dict->count);
+}
+
+void dictionary_close(dictionary_t *dict) {
+    if (dict->base != NULL) {
+#if !defined(_WIN32)
+        if (dict->mapped)
+            munmap(dict->base, dict->size);
+        else
+#endif
+            free(dict->base);
+    }
+    free(dict->path);
+    memset(dict, 0, sizeof(dictionary_t));
+}
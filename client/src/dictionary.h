@@ -0,0 +1,55 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Key dictionary engine
+//
+// A text dictionary (.dic) is parsed once into a deduplicated binary key list
+// which is stored next to it as <name>.dic.<keylen>.cache. Later loads map the
+// cache directly as long as the size and mtime of the text file didn't change.
+// Keys keep the order of their first occurrence in the text file, since
+// dictionaries are ordered by likelihood.
+//-----------------------------------------------------------------------------
+
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include "common.h"
+
+#define DICTIONARY_CACHE_MAGIC      "PM3DICT1"
+
+typedef struct {
+    char *path;             // resolved path of the text dictionary
+    uint8_t keylen;         // key length in bytes
+    uint32_t count;         // number of unique keys
+    uint32_t duplicates;    // number of keys dropped as duplicates
+    uint32_t pos;           // index of the next key handed out
+    const uint8_t *keys;    // count * keylen bytes
+    void *base;             // mapping / allocation backing keys
+    size_t size;
+    bool mapped;
+} dictionary_t;
+
+// open dictionary <preferredName> from the dictionaries search path
+int dictionary_open(dictionary_t *dict, const char *preferredName, uint8_t keylen, bool verbose);
+
+// copy up to <maxkeys> keys starting at the current position into <dest>, returns the number of keys copied
+uint32_t dictionary_next(dictionary_t *dict, uint8_t *dest, uint32_t maxkeys);
+
+// set the position of the next key to hand out
+void dictionary_seek(dictionary_t *dict, uint32_t pos);
+
+void dictionary_close(dictionary_t *dict);
+
+#endif
@@ -26,6 +26,7 @@
 #include "commonutil.h"
 #include "proxmark3.h"
 #include "util.h"
+#include "dictionary.h"
 #include "cmdhficlass.h"  // pagemap
 #include "protocols.h"    // iclass defines
 
@@ -672,7 +673,7 @@ int saveFileJSONrootEx(const char *preferredName, void *root, size_t flags, bool
     return PM3_EFILE;
 }
 
-int saveFileWAVE(const char *preferredName, const int *data, size_t datalen) {
+int saveFileWAVE(const char *preferredName, const int16_t *data, size_t datalen) {
 
     if (data == NULL) return PM3_EINVARG;
     char *fileName = newfilenamemcopy(preferredName, ".wav");
@@ -715,7 +716,7 @@ out:
     return retval;
 }
 
-int saveFilePM3(const char *preferredName, int *data, size_t datalen) {
+int saveFilePM3(const char *preferredName, const int16_t *data, size_t datalen) {
 
     if (data == NULL) return PM3_EINVARG;
     char *fileName = newfilenamemcopy(preferredName, ".pm3");
@@ -1308,95 +1309,39 @@ int loadFileDICTIONARYEx(const char *preferredName, void *data, size_t maxdatale
     if (endFilePosition)
         *endFilePosition = 0;
 
-    char *path;
-    if (searchFile(&path, DICTIONARIES_SUBDIR, preferredName, ".dic", false) != PM3_SUCCESS)
-        return PM3_EFILE;
-
-    // double up since its chars
-    keylen <<= 1;
-
-    char line[255];
-    uint32_t vkeycnt = 0;
-    size_t counter = 0;
-    int retval = PM3_SUCCESS;
-
-    FILE *f = fopen(path, "r");
-    if (!f) {
-        PrintAndLogEx(WARNING, "file not found or locked. '" _YELLOW_("%s")"'", path);
-        retval = PM3_EFILE;
-        goto out;
-    }
-
-    if (startFilePosition) {
-        if (fseek(f, startFilePosition, SEEK_SET) < 0) {
-            fclose(f);
-            retval = PM3_EFILE;
-            goto out;
-        }
-    }
-
-    uint8_t *udata = (uint8_t *)data;
-
-    // read file
-    while (!feof(f)) {
-        long filepos = ftell(f);
-
-        if (!fgets(line, sizeof(line), f)) {
-            if (endFilePosition)
-                *endFilePosition = 0;
-            break;
-        }
-
-        // add null terminator
-        line[keylen] = 0;
-
-        // smaller keys than expected is skipped
-        if (strlen(line) < keylen)
-            continue;
+    dictionary_t dict;
+    int res = dictionary_open(&dict, preferredName, keylen, verbose);
+    if (res != PM3_SUCCESS)
+        return res;
 
-        // The line start with # is comment, skip
-        if (line[0] == '#')
-            continue;
+    // positions are key indexes into the deduplicated dictionary
+    dictionary_seek(&dict, startFilePosition);
 
-        if (!CheckStringIsHEXValue(line))
-            continue;
+    uint32_t maxkeys = (maxdatalen) ? maxdatalen / keylen : dict.count;
+    uint32_t vkeycnt = dictionary_next(&dict, data, maxkeys);
 
+    int retval = PM3_SUCCESS;
+    if (dict.pos < dict.count) {
         // cant store more data
-        if (maxdatalen && (counter + (keylen >> 1) > maxdatalen)) {
-            retval = 1;
-            if (endFilePosition)
-                *endFilePosition = filepos;
-            break;
-        }
-
-        if (hex_to_bytes(line, udata + counter, keylen >> 1) != (keylen >> 1))
-            continue;
-
-        vkeycnt++;
-        memset(line, 0, sizeof(line));
-        counter += (keylen >> 1);
+        retval = 1;
+        if (endFilePosition)
+            *endFilePosition = dict.pos;
     }
-    fclose(f);
+
     if (verbose)
-        PrintAndLogEx(SUCCESS, "loaded " _GREEN_("%2d") " keys from dictionary file " _YELLOW_("%s"), vkeycnt, path);
+        PrintAndLogEx(SUCCESS, "loaded " _GREEN_("%2d") " keys from dictionary file " _YELLOW_("%s"), vkeycnt, dict.path);
 
     if (datalen)
-        *datalen = counter;
+        *datalen = (size_t)vkeycnt * keylen;
     if (keycnt)
         *keycnt = vkeycnt;
-out:
-    free(path);
+
+    dictionary_close(&dict);
     return retval;
 }
 
 int loadFileDICTIONARY_safe(const char *preferredName, void **pdata, uint8_t keylen, uint32_t *keycnt) {
 
-    int retval = PM3_SUCCESS;
-
-    char *path;
-    if (searchFile(&path, DICTIONARIES_SUBDIR, preferredName, ".dic", false) != PM3_SUCCESS)
-        return PM3_EFILE;
-
     // t5577 == 4bytes
     // mifare == 6 bytes
     // mf plus == 16 bytes
@@ -1407,75 +1352,24 @@ int loadFileDICTIONARY_safe(const char *preferredName, void **pdata, uint8_t key
         keylen = 6;
     }
 
-    size_t mem_size;
-    size_t block_size = 10 * keylen;
-
-    // double up since its chars
-    keylen <<= 1;
-
-    char line[255];
+    dictionary_t dict;
+    int res = dictionary_open(&dict, preferredName, keylen, true);
+    if (res != PM3_SUCCESS)
+        return res;
 
-    // allocate some space for the dictionary
-    *pdata = calloc(block_size, sizeof(uint8_t));
+    // keys are appended after the <keycnt> slots the caller accounts for
+    *pdata = calloc((size_t)(*keycnt + dict.count + 1), keylen);
     if (*pdata == NULL) {
-        free(path);
-        return PM3_EFILE;
-    }
-    mem_size = block_size;
-
-    FILE *f = fopen(path, "r");
-    if (!f) {
-        PrintAndLogEx(WARNING, "file not found or locked. '" _YELLOW_("%s")"'", path);
-        retval = PM3_EFILE;
-        goto out;
+        dictionary_close(&dict);
+        return PM3_EMALLOC;
     }
 
-    // read file
-    while (fgets(line, sizeof(line), f)) {
-
-        // check if we have enough space (if not allocate more)
-        if ((*keycnt * (keylen >> 1)) >= mem_size) {
-
-            mem_size += block_size;
-            *pdata = realloc(*pdata, mem_size);
-
-            if (*pdata == NULL) {
-                retval = PM3_EFILE;
-                fclose(f);
-                goto out;
-            } else {
-                memset((uint8_t *)*pdata + (mem_size - block_size), 0, block_size);
-            }
-        }
-
-        // add null terminator
-        line[keylen] = 0;
-
-        // smaller keys than expected is skipped
-        if (strlen(line) < keylen)
-            continue;
-
-        // The line start with # is comment, skip
-        if (line[0] == '#')
-            continue;
-
-        if (!CheckStringIsHEXValue(line))
-            continue;
+    *keycnt += dictionary_next(&dict, (uint8_t *)*pdata + (*keycnt * keylen), dict.count);
 
-        uint64_t key = strtoull(line, NULL, 16);
+    PrintAndLogEx(SUCCESS, "loaded " _GREEN_("%2d") " keys from dictionary file " _YELLOW_("%s"), *keycnt, dict.path);
 
-        num_to_bytes(key, keylen >> 1, (uint8_t *)*pdata + (*keycnt * (keylen >> 1)));
-
-        (*keycnt)++;
-
-        memset(line, 0, sizeof(line));
-    }
-    fclose(f);
-    PrintAndLogEx(SUCCESS, "loaded " _GREEN_("%2d") " keys from dictionary file " _YELLOW_("%s"), *keycnt, path);
-
-out:
-    free(path);
-    return retval;
+    dictionary_close(&dict);
+    return PM3_SUCCESS;
 }
 
 mfu_df_e detect_mfu_dump_format(uint8_t **dump, size_t *dumplen, bool verbose) {
@@ -1679,6 +1573,65 @@ static int filelist(const char *path, const char *ext, uint8_t last, bool tentat
     return PM3_SUCCESS;
 }
 
+int listFilesBySuffix(const char *path, const char *suffix, char ***pfiles, size_t *count) {
+    *pfiles = NULL;
+    *count = 0;
+
+    struct dirent **namelist;
+    int n = scandir(path, &namelist, NULL, alphasort);
+    if (n == -1) {
+        return PM3_EFILE;
+    }
+
+    char **files = calloc(n + 1, sizeof(char *));
+    if (files == NULL) {
+        for (int i = 0; i < n; i++) {
+            free(namelist[i]);
+        }
+        free(namelist);
+        return PM3_EMALLOC;
+    }
+
+    size_t plen = strlen(path);
+    bool sep = (plen && path[plen - 1] != '/' && path[plen - 1] != '\\');
+    size_t found = 0;
+    int res = PM3_SUCCESS;
+
+    for (int i = 0; i < n; i++) {
+        const char *name = namelist[i]->d_name;
+        size_t nlen = strlen(name);
+
+        if (res == PM3_SUCCESS && str_endswith(name, suffix)) {
+
+            char *fn = calloc(plen + nlen + 2, sizeof(char));
+            if (fn == NULL) {
+                res = PM3_EMALLOC;
+            } else {
+                snprintf(fn, plen + nlen + 2, "%s%s%s", path, (sep) ? "/" : "", name);
+                if (fileExists(fn) && is_directory(fn) == false) {
+                    files[found++] = fn;
+                } else {
+                    free(fn);
+                }
+            }
+        }
+        free(namelist[i]);
+    }
+    free(namelist);
+
+    if (res != PM3_SUCCESS) {
+        for (size_t i = 0; i < found; i++) {
+            free(files[i]);
+        }
+        free(files);
+        return res;
+    }
+
+    *pfiles = files;
+    *count = found;
+    return PM3_SUCCESS;
+}
+
 int searchAndList(const char *pm3dir, const char *ext) {
     // display in same order as searched by searchFile
     // try pm3 dirs in current workdir (dev mode)
@@ -113,7 +113,7 @@ int saveFileJSONrootEx(const char *preferredName, void *root, size_t flags, bool
  * @param datalen the length of the data
  * @return 0 for ok
  */
-int saveFileWAVE(const char *preferredName, const int *data, size_t datalen);
+int saveFileWAVE(const char *preferredName, const int16_t *data, size_t datalen);
 
 /** STUB
  * @brief Utility function to save PM3 data to a file. This method takes a preferred name, but if that
@@ -125,7 +125,7 @@ int saveFileWAVE(const char *preferredName, const int *data, size_t datalen);
  * @param datalen the length of the data
  * @return 0 for ok
  */
-int saveFilePM3(const char *preferredName, int *data, size_t datalen);
+int saveFilePM3(const char *preferredName, const int16_t *data, size_t datalen);
 
 /**
  * @brief Utility function to save a keydump into a binary file.
@@ -213,8 +213,8 @@ int loadFileDICTIONARY(const char *preferredName, void *data, size_t *datalen, u
  * @param datalen the number of bytes loaded from file. may be NULL
  * @param keylen  the number of bytes a key per row is
  * @param keycnt key count that lays in data. may be NULL
- * @param startFilePosition  start position in dictionary file. used for big dictionaries.
- * @param endFilePosition in case we have keys in file and maxdatalen reached it returns current key position in file. may be NULL
+ * @param startFilePosition  start key position in dictionary. used for big dictionaries.
+ * @param endFilePosition in case we have keys in file and maxdatalen reached it returns the position of the next key. may be NULL
  * @param verbose print messages if true
  * @return 0 for ok, 1 for failz
 */
@@ -253,6 +253,17 @@ mfu_df_e detect_mfu_dump_format(uint8_t **dump, size_t *dumplen, bool verbose);
 int searchAndList(const char *pm3dir, const char *ext);
 int searchFile(char **foundpath, const char *pm3dir, const char *searchname, const char *suffix, bool silent);
 
+/**
+ * @brief  Lists the regular files of a directory whose names end with suffix, sorted by name.
+ * No recursion into subdirectories.
+ * @param path directory to list
+ * @param suffix the file suffix, e.g. ".pm3". Empty string lists all files
+ * @param pfiles pointer to the allocated array of paths (path + name), caller frees every entry and the array
+ * @param count the number of files found
+ * @return PM3_SUCCESS, PM3_EFILE if the directory can't be read or PM3_EMALLOC
+ */
+int listFilesBySuffix(const char *path, const char *suffix, char ***pfiles, size_t *count);
+
 
 /**
  * @brief detects if file is of a supported filetype based on extension
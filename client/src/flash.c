@@ -644,7 +644,7 @@ int flash_write(flash_file_t *ctx) {
         uint32_t end = seg->start + length;
 
         PrintAndLogEx(SUCCESS, " 0x%08x..0x%08x [0x%x / %u blocks]", seg->start, end - 1, length, blocks);
-        fflush(stdout);
+        PrintAndLogEx_flush();
         int block = 0;
         uint8_t *data = seg->data;
         uint32_t baddr = seg->start;
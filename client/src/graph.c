@@ -18,6 +18,7 @@
 #include "graph.h"
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include "ui.h"
 #include "proxgui.h"
 #include "util.h"    //param_get32ex
@@ -25,13 +26,141 @@
 #include "cmddata.h" //for g_debugmode
 
 
-int g_GraphBuffer[MAX_GRAPH_TRACE_LEN];
-size_t g_GraphTraceLen;
+// The raw channel starts out in static storage, so the graph is always usable
+// up to MAX_GRAPH_TRACE_LEN samples. Pages that are never touched cost nothing.
+static int16_t s_graph_initial[MAX_GRAPH_TRACE_LEN];
 
-/* write a manchester bit to the graph
-TODO,  verfy that this doesn't overflow buffer  (iceman)
-*/
+static graph_t s_graph = {
+    .ch = {
+        [GRAPH_RAW] = { s_graph_initial, MAX_GRAPH_TRACE_LEN },
+    },
+};
+
+__thread graph_t *g_graph = &s_graph;
+
+// The lock is recursive because the plot window runs filters that grow the
+// GRAPH_DEMOD store while it holds the lock.
+static pthread_mutex_t s_graph_lock;
+static pthread_once_t s_graph_once = PTHREAD_ONCE_INIT;
+
+static void graph_lock_init(void) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&s_graph_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+void graph_lock(void) {
+    pthread_once(&s_graph_once, graph_lock_init);
+    pthread_mutex_lock(&s_graph_lock);
+}
+
+void graph_unlock(void) {
+    pthread_mutex_unlock(&s_graph_lock);
+}
+
+// the plot window only ever shows the global graph
+static bool graph_is_shown(void) {
+    return (g_graph == &s_graph);
+}
+
+// stores of the global graph can be read by the plot window at any time
+static bool graph_store_shown(const graph_store_t *st) {
+    return (st >= s_graph.ch && st < s_graph.ch + GRAPH_CHANNELS);
+}
+
+// The new store is filled before it is swapped in and the old one is only freed
+// afterwards, so a reader holding the graph lock never sees a freed store.
+static bool graph_grow(graph_store_t *st, size_t len) {
+    if (len <= st->cap)
+        return true;
+
+    size_t cap = (st->cap) ? st->cap : MAX_GRAPH_TRACE_LEN;
+    while (cap < len)
+        cap *= 2;
+
+    int16_t *tmp = calloc(cap, sizeof(int16_t));
+    if (tmp == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory for %zu graph samples", len);
+        return false;
+    }
+    bool shown = graph_store_shown(st);
+    if (shown)
+        graph_lock();
+
+    if (st->data)
+        memcpy(tmp, st->data, st->cap * sizeof(int16_t));
+
+    int16_t *old = st->data;
+    st->data = tmp;
+    st->cap = cap;
+
+    if (shown)
+        graph_unlock();
+
+    if (old != s_graph_initial)
+        free(old);
+    return true;
+}
+
+// grow channel `ch` to hold at least `len` samples, content is kept.
+bool graph_reserve(graph_channel_t ch, size_t len) {
+    if (ch >= GRAPH_CHANNELS)
+        return false;
+
+    return graph_grow(&g_graph->ch[ch], len);
+}
+
+int16_t *graph_channel(graph_channel_t ch) {
+    if (ch >= GRAPH_CHANNELS)
+        return NULL;
+    return g_graph->ch[ch].data;
+}
+
+size_t graph_capacity(graph_channel_t ch) {
+    if (ch >= GRAPH_CHANNELS)
+        return 0;
+    return g_graph->ch[ch].cap;
+}
+
+void graph_free(void) {
+    bool shown = graph_is_shown();
+    int16_t *old[GRAPH_CHANNELS];
+
+    if (shown)
+        graph_lock();
+
+    for (int i = 0; i < GRAPH_CHANNELS; i++) {
+        old[i] = g_graph->ch[i].data;
+        g_graph->ch[i].data = NULL;
+        g_graph->ch[i].cap = 0;
+    }
+    if (shown) {
+        s_graph.ch[GRAPH_RAW].data = s_graph_initial;
+        s_graph.ch[GRAPH_RAW].cap = MAX_GRAPH_TRACE_LEN;
+    }
+    g_GraphTraceLen = 0;
+
+    if (shown)
+        graph_unlock();
+
+    for (int i = 0; i < GRAPH_CHANNELS; i++) {
+        if (old[i] != s_graph_initial)
+            free(old[i]);
+    }
+}
+
+// switch the calling thread to a private graph, NULL goes back to the global one
+void graph_use(graph_t *graph) {
+    g_graph = (graph) ? graph : &s_graph;
+}
+
+// write a manchester bit to the graph
 void AppendGraph(bool redraw, uint16_t clock, int bit) {
+    if (graph_reserve(GRAPH_RAW, g_GraphTraceLen + clock) == false)
+        return;
+
     uint8_t half = clock / 2;
     uint16_t i;
     //set first half the clock bit (all 1's or 0's for a 0 or 1 bit)
@@ -49,31 +178,47 @@ void AppendGraph(bool redraw, uint16_t clock, int bit) {
 // clear out our graph window
 size_t ClearGraph(bool redraw) {
     size_t gtl = g_GraphTraceLen;
-    memset(g_GraphBuffer, 0x00, g_GraphTraceLen);
+    memset(g_GraphBuffer, 0x00, g_GraphTraceLen * sizeof(int16_t));
     g_GraphTraceLen = 0;
+    g_DemodBufferLen = 0;
+
+    if (graph_is_shown() == false)
+        return gtl;
+
     g_GraphStart = 0;
     g_GraphStop = 0;
-
-    g_DemodBufferLen = 0;
     if (redraw)
         RepaintGraphWindow();
 
     return gtl;
 }
+
 // option '1' to save g_GraphBuffer any other to restore
+// Only the samples in use are copied, the snapshot storage is kept around for the next save.
 void save_restoreGB(uint8_t saveOpt) {
-    static int SavedGB[MAX_GRAPH_TRACE_LEN];
+    static graph_store_t SavedGB = { NULL, 0 };
     static size_t SavedGBlen = 0;
     static bool GB_Saved = false;
     static int Savedg_GridOffsetAdj = 0;
 
     if (saveOpt == GRAPH_SAVE) { //save
-        memcpy(SavedGB, g_GraphBuffer, sizeof(g_GraphBuffer));
+        if (graph_grow(&SavedGB, g_GraphTraceLen) == false) {
+            GB_Saved = false;
+            return;
+        }
+        if (SavedGB.data)
+            memcpy(SavedGB.data, g_GraphBuffer, g_GraphTraceLen * sizeof(int16_t));
         SavedGBlen = g_GraphTraceLen;
         GB_Saved = true;
         Savedg_GridOffsetAdj = g_GridOffset;
     } else if (GB_Saved) { //restore
-        memcpy(g_GraphBuffer, SavedGB, sizeof(g_GraphBuffer));
+        if (graph_reserve(GRAPH_RAW, SavedGBlen) == false)
+            return;
+        if (SavedGBlen)
+            memcpy(g_GraphBuffer, SavedGB.data, SavedGBlen * sizeof(int16_t));
+        // clear whatever the caller appended after the save
+        if (g_GraphTraceLen > SavedGBlen)
+            memset(g_GraphBuffer + SavedGBlen, 0, (g_GraphTraceLen - SavedGBlen) * sizeof(int16_t));
         g_GraphTraceLen = SavedGBlen;
         g_GridOffset = Savedg_GridOffsetAdj;
         RepaintGraphWindow();
@@ -85,22 +230,30 @@ void setGraphBuf(const uint8_t *src, size_t size) {
 
     ClearGraph(false);
 
-    if (size > MAX_GRAPH_TRACE_LEN)
-        size = MAX_GRAPH_TRACE_LEN;
+    if (graph_reserve(GRAPH_RAW, size) == false)
+        size = MIN(size, graph_capacity(GRAPH_RAW));
 
     for (size_t i = 0; i < size; ++i)
         g_GraphBuffer[i] = src[i] - 128;
 
     g_GraphTraceLen = size;
-    RepaintGraphWindow();
+    if (graph_is_shown())
+        RepaintGraphWindow();
 }
 
+// Demodulators work on buffers of MAX_GRAPH_TRACE_LEN bytes,
+// a longer graph hands over its first MAX_GRAPH_TRACE_LEN samples.
 size_t getFromGraphBuf(uint8_t *dest) {
+    return getFromGraphBufEx(dest, MAX_GRAPH_TRACE_LEN);
+}
+
+size_t getFromGraphBufEx(uint8_t *dest, size_t maxLen) {
     if (dest == NULL) return 0;
     if (g_GraphTraceLen == 0) return 0;
 
+    size_t len = MIN(g_GraphTraceLen, maxLen);
     size_t i;
-    for (i = 0; i < g_GraphTraceLen; ++i) {
+    for (i = 0; i < len; ++i) {
         //trim
         if (g_GraphBuffer[i] > 127) g_GraphBuffer[i] = 127;
         if (g_GraphBuffer[i] < -127) g_GraphBuffer[i] = -127;
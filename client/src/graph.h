@@ -31,6 +31,7 @@ bool HasGraphData(void);
 void setGraphBuf(const uint8_t *src, size_t size);
 void save_restoreGB(uint8_t saveOpt);
 size_t getFromGraphBuf(uint8_t *dest);
+size_t getFromGraphBufEx(uint8_t *dest, size_t maxLen);
 void convertGraphFromBitstream(void);
 void convertGraphFromBitstreamEx(int hi, int low);
 bool isGraphBitstream(void);
@@ -42,12 +43,58 @@ int GetNrzClock(const char *str, bool verbose);
 int GetFskClock(const char *str, bool verbose);
 bool fskClocks(uint8_t *fc1, uint8_t *fc2, uint8_t *rf1, int *firstClockEdge);
 
+// Initial capacity of the graph and max number of samples handed to the demodulators.
+// The graph itself grows past this on demand (long sniffs, data load)
 #define MAX_GRAPH_TRACE_LEN (40000 * 8)
 #define GRAPH_SAVE 1
 #define GRAPH_RESTORE 0
 
-extern int g_GraphBuffer[MAX_GRAPH_TRACE_LEN];
-extern size_t g_GraphTraceLen;
+// Named graph channels, all of them are int16 sample stores.
+// GRAPH_RAW is the trace g_GraphBuffer points to,
+// GRAPH_FILTERED is the preview of a filter operation in the plot window,
+// GRAPH_DEMOD is scratch space for demodulators working on a full length trace.
+typedef enum {
+    GRAPH_RAW = 0,
+    GRAPH_FILTERED,
+    GRAPH_DEMOD,
+    GRAPH_CHANNELS
+} graph_channel_t;
+
+int16_t *graph_channel(graph_channel_t ch);
+bool graph_reserve(graph_channel_t ch, size_t len);
+size_t graph_capacity(graph_channel_t ch);
+// releases the stores of the calling thread's graph
+void graph_free(void);
+
+// saturate a computed value into a graph sample
+#define GRAPH_CLAMP(x) ((x) > INT16_MAX ? INT16_MAX : ((x) < INT16_MIN ? INT16_MIN : (x)))
+
+typedef struct {
+    int16_t *data;
+    size_t cap;
+} graph_store_t;
+
+// Sample stores of a graph.
+// g_GraphBuffer & co resolve through the calling thread's g_graph, which is the
+// global graph shown in the plot window unless the thread switched to a private
+// one with graph_use(). lf batch does that to analyse several traces at once.
+typedef struct {
+    graph_store_t ch[GRAPH_CHANNELS];
+    size_t len;
+} graph_t;
+
+extern __thread graph_t *g_graph;
+
+// always the GRAPH_RAW store, re-read it after graph_reserve()
+#define g_GraphBuffer       (g_graph->ch[GRAPH_RAW].data)
+#define g_GraphTraceLen     (g_graph->len)
+
+void graph_use(graph_t *graph);
+
+// The plot window reads the stores of the global graph from its own thread.
+// Hold the lock while drawing, growing or freeing them swaps the stores under it.
+void graph_lock(void);
+void graph_unlock(void);
 
 #ifdef __cplusplus
 }
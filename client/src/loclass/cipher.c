@@ -276,6 +276,138 @@ void doMAC_N(uint8_t *address_data_p, uint8_t address_data_size, uint8_t *div_ke
     free(address_data);
 }
 
+/**
+* Bitsliced MAC for many keys with the same input.
+*
+* Every register bit is a 64 bit word holding that bit for 64 different keys,
+* plane[i] is bit i of the register (LSB = 0, so r0 of the paper is r[7]).
+* The input bits are shared by all lanes, the only key dependent operation is
+* the k[select()] lookup which becomes a 3 level multiplexer.
+**/
+typedef uint64_t bitslice_t;
+
+#define BS_LANES    64
+
+// a + b + carry_in over 8 bit planes
+static void bs_add8(const bitslice_t *a, const bitslice_t *b, bitslice_t *sum) {
+    bitslice_t carry = 0;
+    for (uint8_t i = 0; i < 8; i++) {
+        bitslice_t x = a[i] ^ b[i];
+        bitslice_t s = x ^ carry;
+        carry = (a[i] & b[i]) | (carry & x);
+        sum[i] = s;
+    }
+}
+
+static void bs_const8(uint8_t v, bitslice_t *planes) {
+    for (uint8_t i = 0; i < 8; i++)
+        planes[i] = ((v >> i) & 1) ? ~(bitslice_t)0 : 0;
+}
+
+typedef struct {
+    bitslice_t l[8];
+    bitslice_t r[8];
+    bitslice_t b[8];
+    bitslice_t t[16];
+} BsState_t;
+
+static inline bitslice_t bs_mux(bitslice_t a, bitslice_t b, bitslice_t sel) {
+    return a ^ ((a ^ b) & sel);
+}
+
+static void bs_successor(const bitslice_t k[8][8], BsState_t *s, bitslice_t y) {
+    const bitslice_t *r = s->r;
+
+    bitslice_t Tt = s->t[15] ^ s->t[14] ^ s->t[10] ^ s->t[8] ^ s->t[5] ^ s->t[4] ^ s->t[1] ^ s->t[0];
+    bitslice_t Bb = s->b[6] ^ s->b[5] ^ s->b[4] ^ s->b[0];
+
+    // select(T(t), y, r)
+    bitslice_t z0 = (r[7] & r[5]) ^ (r[6] & ~r[4]) ^ (r[5] | r[3]);
+    bitslice_t z1 = (r[7] | r[5]) ^ (r[2] | r[0]) ^ r[6] ^ r[1] ^ Tt ^ y;
+    bitslice_t z2 = (r[4] & ~r[2]) ^ (r[3] & r[1]) ^ r[0] ^ Tt;
+
+    bitslice_t t15 = Tt ^ r[7] ^ r[3];
+    bitslice_t b7 = Bb ^ r[0];
+
+    memmove(s->t, s->t + 1, 15 * sizeof(bitslice_t));
+    s->t[15] = t15;
+    memmove(s->b, s->b + 1, 7 * sizeof(bitslice_t));
+    s->b[7] = b7;
+
+    // k[select] ^ b'
+    bitslice_t v[8];
+    for (uint8_t i = 0; i < 8; i++) {
+        bitslice_t m01 = bs_mux(k[0][i], k[1][i], z2);
+        bitslice_t m23 = bs_mux(k[2][i], k[3][i], z2);
+        bitslice_t m45 = bs_mux(k[4][i], k[5][i], z2);
+        bitslice_t m67 = bs_mux(k[6][i], k[7][i], z2);
+        bitslice_t m03 = bs_mux(m01, m23, z1);
+        bitslice_t m47 = bs_mux(m45, m67, z1);
+        v[i] = bs_mux(m03, m47, z0) ^ s->b[i];
+    }
+
+    // r' = v + l, l' = v + l + r
+    bitslice_t vl[8];
+    bs_add8(v, s->l, vl);
+    bs_add8(vl, s->r, s->l);
+    memcpy(s->r, vl, sizeof(vl));
+}
+
+// MAC over 64 diversified keys, lanes beyond <count> are don't care
+static void bs_mac64(const uint8_t *cc_nr, const uint8_t *div_keys, uint32_t count, uint8_t *macs) {
+    bitslice_t k[8][8];
+    memset(k, 0, sizeof(k));
+    for (uint32_t lane = 0; lane < count; lane++) {
+        for (uint8_t j = 0; j < 8; j++) {
+            uint8_t kb = div_keys[lane * 8 + j];
+            for (uint8_t i = 0; i < 8; i++)
+                k[j][i] |= (bitslice_t)((kb >> i) & 1) << lane;
+        }
+    }
+
+    // init(k)
+    BsState_t s;
+    bitslice_t k0[8], c[8];
+    bs_const8(0x4c, c);
+    for (uint8_t i = 0; i < 8; i++)
+        k0[i] = k[0][i] ^ c[i];
+    bs_const8(0xEC, c);
+    bs_add8(k0, c, s.l);
+    bs_const8(0x21, c);
+    bs_add8(k0, c, s.r);
+    bs_const8(0x4c, s.b);
+    for (uint8_t i = 0; i < 16; i++)
+        s.t[i] = ((0xE012 >> i) & 1) ? ~(bitslice_t)0 : 0;
+
+    // same bit order as doMAC(), which feeds the bit reversed cc_nr head first
+    for (uint8_t i = 0; i < 96; i++) {
+        bitslice_t y = ((cc_nr[i >> 3] >> (i & 7)) & 1) ? ~(bitslice_t)0 : 0;
+        bs_successor(k, &s, y);
+    }
+
+    bitslice_t out[32];
+    for (uint8_t i = 0; i < 32; i++) {
+        out[i] = s.r[2];
+        bs_successor(k, &s, 0);
+    }
+
+    for (uint32_t lane = 0; lane < count; lane++) {
+        for (uint8_t m = 0; m < 4; m++) {
+            uint8_t v = 0;
+            for (uint8_t i = 0; i < 8; i++)
+                v |= ((out[m * 8 + i] >> lane) & 1) << i;
+            macs[lane * 4 + m] = v;
+        }
+    }
+}
+
+void doMAC_multi(const uint8_t *cc_nr, const uint8_t *div_keys, uint32_t count, uint8_t *macs) {
+    for (uint32_t i = 0; i < count; i += BS_LANES) {
+        uint32_t n = (count - i < BS_LANES) ? count - i : BS_LANES;
+        bs_mac64(cc_nr, div_keys + i * 8, n, macs + i * 4);
+    }
+}
+
 #ifndef ON_DEVICE
 int testMAC(void) {
     PrintAndLogEx(SUCCESS, "Testing MAC calculation...");
@@ -297,6 +429,25 @@ int testMAC(void) {
         printarr("    Correct_MAC   ", correct_MAC, 4);
         return PM3_ESOFT;
     }
+
+    // bitsliced engine against the reference, over more than one batch of lanes
+    uint8_t keys[100 * 8];
+    uint8_t macs[100 * 4];
+    for (size_t i = 0; i < sizeof(keys); i++)
+        keys[i] = (i * 0x9D + 0x3B) ^ (i >> 3);
+    memcpy(keys, div_key, 8);
+
+    doMAC_multi(cc_nr, keys, 100, macs);
+    for (uint32_t i = 0; i < 100; i++) {
+        doMAC(cc_nr, keys + i * 8, calculated_mac);
+        if (memcmp(calculated_mac, macs + i * 4, 4) != 0) {
+            PrintAndLogEx(FAILED, "    Bitsliced MAC calculation (%s) key %u", _RED_("failed"), i);
+            printarr("    Calculated_MAC", macs + i * 4, 4);
+            printarr("    Correct_MAC   ", calculated_mac, 4);
+            return PM3_ESOFT;
+        }
+    }
+    PrintAndLogEx(SUCCESS, "    Bitsliced MAC calculation (%s)", _GREEN_("ok"));
     return PM3_SUCCESS;
 }
 #endif
@@ -40,6 +40,9 @@
 void doMAC(uint8_t *cc_nr_p, uint8_t *div_key_p, uint8_t mac[4]);
 void doMAC_N(uint8_t *address_data_p, uint8_t address_data_size, uint8_t *div_key_p, uint8_t mac[4]);
 
+// doMAC() for <count> diversified keys (8 bytes each) sharing one cc_nr, bitsliced 64 keys at a time
+void doMAC_multi(const uint8_t *cc_nr, const uint8_t *div_keys, uint32_t count, uint8_t *macs);
+
 #ifndef ON_DEVICE
 int testMAC(void);
 #endif
@@ -172,12 +172,11 @@ static void rk(uint8_t *key, uint8_t n, uint8_t *outp_key) {
     }
 }
 
-static mbedtls_des_context ctx_enc;
-static mbedtls_des_context ctx_dec;
-
+// contexts live on the stack, hash2() is called from several threads at once
 static void desdecrypt_iclass(uint8_t *iclass_key, uint8_t *input, uint8_t *output) {
     uint8_t key_std_format[8] = {0};
     permutekey_rev(iclass_key, key_std_format);
+    mbedtls_des_context ctx_dec;
     mbedtls_des_setkey_dec(&ctx_dec, key_std_format);
     mbedtls_des_crypt_ecb(&ctx_dec, input, output);
 }
@@ -185,6 +184,7 @@ static void desdecrypt_iclass(uint8_t *iclass_key, uint8_t *input, uint8_t *outp
 static void desencrypt_iclass(uint8_t *iclass_key, uint8_t *input, uint8_t *output) {
     uint8_t key_std_format[8] = {0};
     permutekey_rev(iclass_key, key_std_format);
+    mbedtls_des_context ctx_enc;
     mbedtls_des_setkey_enc(&ctx_enc, key_std_format);
     mbedtls_des_crypt_ecb(&ctx_enc, input, output);
 }
@@ -287,119 +287,219 @@ static int _readFromDump(uint8_t dump[], dumpdata *item, uint8_t i) {
 }
 */
 
-typedef struct {
-    int thread_idx;
-    uint32_t endmask;
-    uint8_t numbytes_to_recover;
-    uint8_t bytes_to_recover[3];
-    uint8_t key_index[8];
-    uint16_t keytable[128];
-    loclass_dumpdata_t item;
-} loclass_thread_arg_t;
+/**
+ * Bruteforce thread pool
+ *
+ * The workers live for a whole dump. For every item the candidate range is cut in
+ * chunks which idle workers claim from a shared cursor, so a thread that is done
+ * with its chunk takes the next unclaimed one and no core waits for a slow sibling.
+ * Each chunk is diversified and then MACed in bitsliced batches.
+ */
+#define LOCLASS_CHUNK       1024    // candidates claimed per grab
+#define LOCLASS_BATCH       64      // candidates per bitsliced MAC pass
 
 typedef struct {
-    uint8_t values[3];
-} loclass_thread_ret_t;
-
-static size_t loclass_tc = 1;
-static int loclass_found = 0;
-
-static void *bf_thread(void *thread_arg) {
-
-    loclass_thread_arg_t *targ = (loclass_thread_arg_t *)thread_arg;
-    const uint32_t endmask = targ->endmask;
-    const uint8_t numbytes_to_recover = targ->numbytes_to_recover;
-    uint32_t brute = targ->thread_idx;
-
+    // current item, written by bruteforceItem() while all workers are idle
     uint8_t csn[8];
     uint8_t cc_nr[12];
     uint8_t mac[4];
-    uint8_t key_index[8];
+    uint8_t key_sel[8];         // key bytes already known
+    int8_t brute_byte[8];       // which brute byte feeds key_sel[i], -1 if known
+    uint8_t numbytes_to_recover;
     uint8_t bytes_to_recover[3];
-    uint16_t keytable[128];
+    uint32_t total;
 
-    memcpy(csn, targ->item.csn, sizeof(csn));
-    memcpy(cc_nr, targ->item.cc_nr, sizeof(cc_nr));
-    memcpy(mac, targ->item.mac, sizeof(mac));
-    memcpy(key_index, targ->key_index, sizeof(key_index));
-    memcpy(bytes_to_recover, targ->bytes_to_recover, sizeof(bytes_to_recover));
-    memcpy(keytable, targ->keytable, sizeof(keytable));
+    uint32_t next;              // next unclaimed candidate
+    int found;
+    uint32_t found_value;
 
-    while (!(brute & endmask)) {
+    uint32_t generation;        // bumped for every item
+    size_t busy;                // workers still on the current item
+    bool quit;
+    bool running;
 
-        int found = __atomic_load_n(&loclass_found, __ATOMIC_SEQ_CST);
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t idle;
+    pthread_t *threads;
+    size_t nthreads;            // workers actually started
+} loclass_pool_t;
 
-        if (found != 0xFF) return NULL;
+static size_t loclass_tc = 1;
+static loclass_pool_t loclass_pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work = PTHREAD_COND_INITIALIZER,
+    .idle = PTHREAD_COND_INITIALIZER,
+};
 
-        //Update the keytable with the brute-values
-        for (uint8_t i = 0; i < numbytes_to_recover; i++) {
-            keytable[bytes_to_recover[i]] &= 0xFF00;
-            keytable[bytes_to_recover[i]] |= (brute >> (i * 8) & 0xFF);
-        }
+#define _CLR_ "\x1b[0K"
+
+static void loclass_progress(uint32_t brute) {
+    loclass_pool_t *p = &loclass_pool;
+    if (p->numbytes_to_recover == 3) {
+        if ((brute & 0xFFFF) == 0)
+            PrintAndLogEx(INPLACE, "[ %02x %02x %02x ] %8u / %u", p->bytes_to_recover[0], p->bytes_to_recover[1], p->bytes_to_recover[2], brute, 0xFFFFFF);
+    } else if (p->numbytes_to_recover == 2) {
+        PrintAndLogEx(INPLACE, "[ %02x %02x ] %5u / %u" _CLR_, p->bytes_to_recover[0], p->bytes_to_recover[1], brute, 0xFFFF);
+    }
+}
 
-        uint8_t key_sel[8] = {0};
+// returns true if one of the candidates [start, end) gives the MAC
+static bool loclass_try_chunk(uint32_t start, uint32_t end, uint32_t *value) {
+    loclass_pool_t *p = &loclass_pool;
 
-        // Piece together the key
-        key_sel[0] = keytable[key_index[0]] & 0xFF;
-        key_sel[1] = keytable[key_index[1]] & 0xFF;
-        key_sel[2] = keytable[key_index[2]] & 0xFF;
-        key_sel[3] = keytable[key_index[3]] & 0xFF;
-        key_sel[4] = keytable[key_index[4]] & 0xFF;
-        key_sel[5] = keytable[key_index[5]] & 0xFF;
-        key_sel[6] = keytable[key_index[6]] & 0xFF;
-        key_sel[7] = keytable[key_index[7]] & 0xFF;
+    uint8_t div_keys[LOCLASS_BATCH * 8];
+    uint8_t macs[LOCLASS_BATCH * 4];
 
-        // Permute from iclass format to standard format
+    for (uint32_t base = start; base < end; base += LOCLASS_BATCH) {
 
-        uint8_t key_sel_p[8] = {0};
-        permutekey_rev(key_sel, key_sel_p);
+        uint32_t n = MIN(LOCLASS_BATCH, end - base);
 
-        // Diversify
-        uint8_t div_key[8] = {0};
-        diversifyKey(csn, key_sel_p, div_key);
+        for (uint32_t j = 0; j < n; j++) {
+            uint32_t brute = base + j;
 
-        // Calc mac
-        uint8_t calculated_MAC[4] = {0};
-        doMAC(cc_nr, div_key, calculated_MAC);
+            // piece together the key
+            uint8_t key_sel[8];
+            for (uint8_t i = 0; i < 8; i++) {
+                if (p->brute_byte[i] < 0)
+                    key_sel[i] = p->key_sel[i];
+                else
+                    key_sel[i] = (brute >> (p->brute_byte[i] * 8)) & 0xFF;
+            }
 
-        // success
-        if (memcmp(calculated_MAC, mac, 4) == 0) {
+            // permute from iclass format to standard format
+            uint8_t key_sel_p[8];
+            permutekey_rev(key_sel, key_sel_p);
+            diversifyKey(p->csn, key_sel_p, div_keys + j * 8);
+        }
 
-            loclass_thread_ret_t *r = (loclass_thread_ret_t *)malloc(sizeof(loclass_thread_ret_t));
+        doMAC_multi(p->cc_nr, div_keys, n, macs);
 
-            for (uint8_t i = 0 ; i < numbytes_to_recover; i++) {
-                r->values[i] = keytable[bytes_to_recover[i]] & 0xFF;
+        for (uint32_t j = 0; j < n; j++) {
+            if (memcmp(macs + j * 4, p->mac, 4) == 0) {
+                *value = base + j;
+                return true;
             }
-            __atomic_store_n(&loclass_found, targ->thread_idx, __ATOMIC_SEQ_CST);
-            pthread_exit((void *)r);
         }
+    }
+    return false;
+}
 
-        brute += loclass_tc;
+static void *loclass_worker(void *arg) {
+    (void)arg;
+    loclass_pool_t *p = &loclass_pool;
+    uint32_t seen = 0;
 
-#define _CLR_ "\x1b[0K"
+    for (;;) {
+        pthread_mutex_lock(&p->lock);
+        while (p->quit == false && p->generation == seen)
+            pthread_cond_wait(&p->work, &p->lock);
 
-        if (numbytes_to_recover == 3) {
-            if ((brute > 0) && ((brute & 0xFFFF) == 0)) {
-                PrintAndLogEx(INPLACE, "[ %02x %02x %02x ] %8u / %u", bytes_to_recover[0], bytes_to_recover[1], bytes_to_recover[2], brute, 0xFFFFFF);
+        if (p->quit) {
+            pthread_mutex_unlock(&p->lock);
+            break;
+        }
+        seen = p->generation;
+        pthread_mutex_unlock(&p->lock);
+
+        for (;;) {
+            if (__atomic_load_n(&p->found, __ATOMIC_ACQUIRE))
+                break;
+
+            uint32_t start = __atomic_fetch_add(&p->next, LOCLASS_CHUNK, __ATOMIC_RELAXED);
+            if (start >= p->total)
+                break;
+
+            if (start)
+                loclass_progress(start);
+
+            uint32_t value = 0;
+            if (loclass_try_chunk(start, MIN(start + LOCLASS_CHUNK, p->total), &value)) {
+                pthread_mutex_lock(&p->lock);
+                if (p->found == 0) {
+                    p->found_value = value;
+                    __atomic_store_n(&p->found, 1, __ATOMIC_RELEASE);
+                }
+                pthread_mutex_unlock(&p->lock);
+                break;
             }
-        } else if (numbytes_to_recover == 2) {
-            if ((brute > 0) && ((brute & 0x3F) == 0))
-                PrintAndLogEx(INPLACE, "[ %02x %02x ] %5u / %u" _CLR_, bytes_to_recover[0], bytes_to_recover[1], brute, 0xFFFF);
-        } else {
-            if ((brute > 0) && ((brute & 0x1F) == 0))
-                PrintAndLogEx(INPLACE, "[ %02x ] %3u / %u" _CLR_, bytes_to_recover[0], brute, 0xFF);
         }
+
+        pthread_mutex_lock(&p->lock);
+        if (--p->busy == 0)
+            pthread_cond_signal(&p->idle);
+        pthread_mutex_unlock(&p->lock);
     }
-    pthread_exit(NULL);
+    return NULL;
+}
+
+static int loclass_pool_start(void) {
+    loclass_pool_t *p = &loclass_pool;
+
+    p->threads = calloc(loclass_tc, sizeof(pthread_t));
+    if (p->threads == NULL)
+        return PM3_EMALLOC;
+
+    p->quit = false;
+    p->generation = 0;
+    p->busy = 0;
+    p->nthreads = 0;
 
-    void *dummyptr = NULL;
-    return dummyptr;
+    for (size_t i = 0; i < loclass_tc; i++) {
+        if (pthread_create(&p->threads[i], NULL, loclass_worker, NULL)) {
+            PrintAndLogEx(NORMAL, "");
+            PrintAndLogEx(WARNING, "Failed to create pthreads. Quitting");
+            break;
+        }
+        p->nthreads++;
+    }
+
+    if (p->nthreads == 0) {
+        free(p->threads);
+        p->threads = NULL;
+        return PM3_ESOFT;
+    }
+
+    p->running = true;
+    return PM3_SUCCESS;
 }
 
-int bruteforceItem(loclass_dumpdata_t item, uint16_t keytable[]) {
+static void loclass_pool_stop(void) {
+    loclass_pool_t *p = &loclass_pool;
+
+    pthread_mutex_lock(&p->lock);
+    p->quit = true;
+    pthread_cond_broadcast(&p->work);
+    pthread_mutex_unlock(&p->lock);
 
-    // reset thread signals
-    loclass_found = 0xFF;
+    for (size_t i = 0; i < p->nthreads; i++)
+        pthread_join(p->threads[i], NULL);
+
+    free(p->threads);
+    p->threads = NULL;
+    p->nthreads = 0;
+    p->running = false;
+}
+
+// hand one item to the pool and wait until it is solved or exhausted
+static bool loclass_pool_run(uint32_t *value) {
+    loclass_pool_t *p = &loclass_pool;
+
+    pthread_mutex_lock(&p->lock);
+    p->next = 0;
+    p->found = 0;
+    p->busy = p->nthreads;
+    p->generation++;
+    pthread_cond_broadcast(&p->work);
+    while (p->busy)
+        pthread_cond_wait(&p->idle, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+
+    *value = p->found_value;
+    return p->found;
+}
+
+int bruteforceItem(loclass_dumpdata_t item, uint16_t keytable[]) {
 
     //Get the key index (hash1)
     uint8_t key_index[8] = {0};
@@ -443,37 +543,40 @@ int bruteforceItem(loclass_dumpdata_t item, uint16_t keytable[]) {
         return PM3_ESOFT;
     }
 
-    loclass_thread_arg_t args[loclass_tc];
-    // init thread arguments
-    for (size_t i = 0; i < loclass_tc; i++) {
-        args[i].thread_idx = i;
-        args[i].numbytes_to_recover = numbytes_to_recover;
-        args[i].endmask = 1 << 8 * numbytes_to_recover;
+    // workers are idle between items, the item can be set up without locking
+    loclass_pool_t *p = &loclass_pool;
+    memcpy(p->csn, item.csn, sizeof(p->csn));
+    memcpy(p->cc_nr, item.cc_nr, sizeof(p->cc_nr));
+    memcpy(p->mac, item.mac, sizeof(p->mac));
+    memcpy(p->bytes_to_recover, bytes_to_recover, sizeof(p->bytes_to_recover));
+    p->numbytes_to_recover = numbytes_to_recover;
+    p->total = 1 << 8 * numbytes_to_recover;
 
-        memcpy((void *)&args[i].item, (void *)&item, sizeof(loclass_dumpdata_t));
-        memcpy(args[i].bytes_to_recover, bytes_to_recover, sizeof(args[i].bytes_to_recover));
-        memcpy(args[i].key_index, key_index, sizeof(args[i].key_index));
-        memcpy(args[i].keytable, keytable, sizeof(args[i].keytable));
+    for (uint8_t i = 0; i < 8; i++) {
+        p->key_sel[i] = keytable[key_index[i]] & 0xFF;
+        p->brute_byte[i] = -1;
+        for (uint8_t j = 0; j < numbytes_to_recover; j++) {
+            if (key_index[i] == bytes_to_recover[j])
+                p->brute_byte[i] = j;
+        }
     }
 
-    pthread_t threads[loclass_tc];
-    // create threads
-    for (size_t i = 0; i < loclass_tc; i++) {
-        int res = pthread_create(&threads[i], NULL, bf_thread, (void *)&args[i]);
-        if (res) {
-            PrintAndLogEx(NORMAL, "");
-            PrintAndLogEx(WARNING, "Failed to create pthreads. Quitting");
+    // bruteforceDump() keeps a pool for the whole dump, single items get their own
+    bool own_pool = (p->running == false);
+    if (own_pool) {
+        if (loclass_pool_start() != PM3_SUCCESS)
             return PM3_ESOFT;
-        }
     }
-    // wait for threads to terminate:
-    void *ptrs[loclass_tc];
-    for (size_t i = 0; i < loclass_tc; i++)
-        pthread_join(threads[i], &ptrs[i]);
+
+    uint32_t value = 0;
+    bool found = loclass_pool_run(&value);
+
+    if (own_pool)
+        loclass_pool_stop();
 
     // was it a success?
     int res = PM3_SUCCESS;
-    if (loclass_found == 0xFF) {
+    if (found == false) {
         res = PM3_ESOFT;
         PrintAndLogEx(NORMAL, "");
         PrintAndLogEx(WARNING, "Failed to recover %d bytes using the following CSN", numbytes_to_recover);
@@ -486,20 +589,11 @@ int bruteforceItem(loclass_dumpdata_t item, uint16_t keytable[]) {
         }
 
     } else {
-        loclass_thread_ret_t ice = *((loclass_thread_ret_t *)ptrs[loclass_found]);
-
         for (uint8_t i = 0; i < numbytes_to_recover; i++) {
-            keytable[bytes_to_recover[i]] = ice.values[i];
-            keytable[bytes_to_recover[i]] &= 0xFF;
+            keytable[bytes_to_recover[i]] = (value >> (i * 8)) & 0xFF;
             keytable[bytes_to_recover[i]] |= LOCLASS_CRACKED;
         }
-        for (size_t i = 0; i < loclass_tc; i++) {
-            free(ptrs[i]);
-        }
     }
-
-    memset(args, 0x00, sizeof(args));
-    memset(threads, 0x00, sizeof(threads));
     return res;
 }
 
@@ -730,7 +824,11 @@ int bruteforceDump(uint8_t dump[], size_t dumpsize, uint16_t keytable[]) {
     loclass_tc = num_CPUs();
     PrintAndLogEx(INFO, "bruteforce using " _YELLOW_("%zu") " threads", loclass_tc);
 
-    int res = 0;
+    int res = loclass_pool_start();
+    if (res != PM3_SUCCESS) {
+        free(attack);
+        return res;
+    }
 
     uint64_t t1 = msclock();
     for (i = 0 ; i * itemsize < dumpsize ; i++) {
@@ -739,6 +837,7 @@ int bruteforceDump(uint8_t dump[], size_t dumpsize, uint16_t keytable[]) {
         if (res != PM3_SUCCESS)
             break;
     }
+    loclass_pool_stop();
     free(attack);
     t1 = msclock() - t1;
     PrintAndLogEx(NORMAL, "");
@@ -26,7 +26,10 @@
 #include "jansson.h"
 
 // https://www.nxp.com/docs/en/application-note/AN10787.pdf
+// mad.json is loaded once and shared, mad_aid_index maps the lowercase "0x...." AID to its record
 static json_t *mad_known_aids = NULL;
+static json_t *mad_aid_index = NULL;
+static pthread_mutex_t mad_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static const char *holder_info_type[] = {
     "Surname",
@@ -75,11 +78,6 @@ out:
     return retval;
 }
 
-static int close_mad_file(json_t *root) {
-    json_decref(root);
-    return PM3_SUCCESS;
-}
-
 static const char *mad_json_get_str(json_t *data, const char *name) {
 
     json_t *jstr = json_object_get(data, name);
@@ -98,28 +96,54 @@ static const char *mad_json_get_str(json_t *data, const char *name) {
     return cstr;
 }
 
-static int print_aid_description(json_t *root, uint16_t aid, char *fmt, bool verbose) {
-    char lmad[7] = {0};
-    sprintf(lmad, "0x%04x", aid); // must be lowercase
+static json_t *mad_get_index(bool verbose) {
+    pthread_mutex_lock(&mad_lock);
+    if (mad_aid_index != NULL)
+        goto out;
 
-    json_t *elm = NULL;
+    json_t *root = NULL;
+    if (open_mad_file(&root, verbose) != PM3_SUCCESS) {
+        json_decref(root);
+        goto out;
+    }
+
+    json_t *aid_index = json_object();
+    if (aid_index == NULL) {
+        json_decref(root);
+        goto out;
+    }
 
-    for (uint32_t idx = 0; idx < json_array_size(root); idx++) {
+    for (size_t idx = 0; idx < json_array_size(root); idx++) {
         json_t *data = json_array_get(root, idx);
         if (!json_is_object(data)) {
-            PrintAndLogEx(ERR, "data [%d] is not an object\n", idx);
+            PrintAndLogEx(ERR, "data [%zu] is not an object\n", idx);
             continue;
         }
         const char *fmad = mad_json_get_str(data, "mad");
+        if (fmad == NULL)
+            continue;
+
         char lfmad[strlen(fmad) + 1];
         strcpy(lfmad, fmad);
         str_lower(lfmad);
-        if (strcmp(lmad, lfmad) == 0) {
-            elm = data;
-            break;
-        }
+        // first record wins, like the linear search did
+        if (json_object_get(aid_index, lfmad) == NULL)
+            json_object_set(aid_index, lfmad, data);
     }
 
+    mad_known_aids = root;
+    mad_aid_index = aid_index;
+out:
+    pthread_mutex_unlock(&mad_lock);
+    return mad_aid_index;
+}
+
+static int print_aid_description(json_t *aid_index, uint16_t aid, char *fmt, bool verbose) {
+    char lmad[7] = {0};
+    sprintf(lmad, "0x%04x", aid); // must be lowercase
+
+    json_t *elm = (aid_index) ? json_object_get(aid_index, lmad) : NULL;
+
     if (elm == NULL) {
         PrintAndLogEx(INFO, fmt, " (unknown)");
         return PM3_ENODATA;
@@ -298,7 +322,7 @@ static int MADInfoByteDecode(const uint8_t *sector, bool swapmad, int mad_ver, b
 }
 
 int MAD1DecodeAndPrint(uint8_t *sector, bool swapmad, bool verbose, bool *haveMAD2) {
-    open_mad_file(&mad_known_aids, verbose);
+    json_t *aid_index = mad_get_index(verbose);
 
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(INFO, "------------ " _CYAN_("MAD v1 details") " -------------");
@@ -328,16 +352,15 @@ int MAD1DecodeAndPrint(uint8_t *sector, bool swapmad, bool verbose, bool *haveMA
         } else {
             char fmt[30];
             sprintf(fmt, (ibs == i) ? _MAGENTA_(" %02d [%04X]%s") : " %02d [%04X]%s", i, aid, "%s");
-            print_aid_description(mad_known_aids, aid, fmt, verbose);
+            print_aid_description(aid_index, aid, fmt, verbose);
             prev_aid = aid;
         }
     }
-    close_mad_file(mad_known_aids);
     return PM3_SUCCESS;
 }
 
 int MAD2DecodeAndPrint(uint8_t *sector, bool swapmad, bool verbose) {
-    open_mad_file(&mad_known_aids, verbose);
+    json_t *aid_index = mad_get_index(verbose);
 
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(INFO, "------------ " _CYAN_("MAD v2 details") " -------------");
@@ -372,21 +395,19 @@ int MAD2DecodeAndPrint(uint8_t *sector, bool swapmad, bool verbose) {
         } else {
             char fmt[30];
             sprintf(fmt, (ibs == i) ? _MAGENTA_(" %02d [%04X]%s") : " %02d [%04X]%s", i + 16, aid, "%s");
-            print_aid_description(mad_known_aids, aid, fmt, verbose);
+            print_aid_description(aid_index, aid, fmt, verbose);
             prev_aid = aid;
         }
     }
-    close_mad_file(mad_known_aids);
 
     return PM3_SUCCESS;
 }
 
 int MADDFDecodeAndPrint(uint32_t short_aid) {
-    open_mad_file(&mad_known_aids, false);
+    json_t *aid_index = mad_get_index(false);
 
     char fmt[50];
     sprintf(fmt, "  MAD AID Function 0x%04X    :" _YELLOW_("%s"), short_aid, "%s");
-    print_aid_description(mad_known_aids, short_aid, fmt, false);
-    close_mad_file(mad_known_aids);
+    print_aid_description(aid_index, short_aid, fmt, false);
     return PM3_SUCCESS;
 }
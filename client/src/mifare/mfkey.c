@@ -18,7 +18,13 @@
 //-----------------------------------------------------------------------------
 #include "mfkey.h"
 
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
 #include "crapto1/crapto1.h"
+#include "util.h"               // num_CPUs
+#include "pm3_cmd.h"            // PM3_EMALLOC
 
 // MIFARE
 int inline compare_uint64(const void *a, const void *b) {
@@ -49,6 +55,288 @@ uint32_t intersection(uint64_t *listA, uint64_t *listB) {
     return p3 - listA;
 }
 
+// Nested attack key recovery
+//
+// lfsr_recovery32() gives us a few million states per nonce. The 16 bits selected by
+// NESTED_BUCKET() are not touched by the 32 bit rollback, so two states can only end up
+// as the same key if they agree on them. Instead of sorting the lists we radix-partition
+// both of them on those 16 bits, roll back only the states of buckets present in both
+// lists and join each bucket pair with a small hash table. Partitioning and joining are
+// spread over all logical CPUs.
+#define NESTED_MAX_THREADS      64
+#define NESTED_BUCKETS          0x10000
+#define NESTED_BUCKET_BLOCK     0x100
+#define NESTED_MIN_SLICE        0x4000
+#define NESTED_BUCKET(s)        ((uint32_t)((((s) >> 16) & 0x00ff) | (((s) >> 40) & 0xff00)))
+#define NESTED_EMPTY            UINT64_C(-1)
+
+typedef struct {
+    uint64_t *list[2];
+    uint32_t len[2];
+    uint32_t in[2];
+    uint64_t *part[2];          // lists, partitioned by bucket
+    uint32_t *start[2];         // first entry of each bucket in part[]
+    uint32_t *offsets;          // per thread counts, then per thread scatter positions
+    uint32_t *found;            // number of keys per bucket, stored at start[0][bucket]
+    uint32_t next_block;
+    uint16_t num_threads;
+    bool failed;                // a join thread ran out of memory
+} nested_join_t;
+
+typedef struct {
+    nested_join_t *join;
+    uint16_t thread;
+} nested_thread_arg_t;
+
+static uint16_t nested_num_threads(uint32_t len) {
+    uint32_t n = num_CPUs();
+    if (n > NESTED_MAX_THREADS)
+        n = NESTED_MAX_THREADS;
+    if (n > len / NESTED_MIN_SLICE)
+        n = len / NESTED_MIN_SLICE;
+    return (n == 0) ? 1 : n;
+}
+
+// a slice whose thread can't be started is done by the caller, no part of the lists is skipped
+static void nested_run_threads(uint16_t num_threads, void *(*worker)(void *), nested_thread_arg_t *args) {
+    pthread_t thread_id[NESTED_MAX_THREADS];
+    bool started[NESTED_MAX_THREADS];
+    for (uint16_t i = 0; i < num_threads; i++) {
+        started[i] = (pthread_create(&thread_id[i], NULL, worker, &args[i]) == 0);
+        if (started[i] == false)
+            worker(&args[i]);
+    }
+    for (uint16_t i = 0; i < num_threads; i++) {
+        if (started[i])
+            pthread_join(thread_id[i], NULL);
+    }
+}
+
+static inline uint32_t *nested_offsets(nested_join_t *j, uint16_t thread, uint8_t l) {
+    return j->offsets + ((size_t)thread * 2 + l) * NESTED_BUCKETS;
+}
+
+static void *nested_count_thread(void *arg) {
+    nested_thread_arg_t *a = arg;
+    nested_join_t *j = a->join;
+    for (uint8_t l = 0; l < 2; l++) {
+        uint32_t *cnt = nested_offsets(j, a->thread, l);
+        uint32_t from = (uint64_t)j->len[l] * a->thread / j->num_threads;
+        uint32_t to = (uint64_t)j->len[l] * (a->thread + 1) / j->num_threads;
+        for (uint32_t i = from; i < to; i++)
+            cnt[NESTED_BUCKET(j->list[l][i])]++;
+    }
+    return NULL;
+}
+
+static void *nested_scatter_thread(void *arg) {
+    nested_thread_arg_t *a = arg;
+    nested_join_t *j = a->join;
+    for (uint8_t l = 0; l < 2; l++) {
+        uint32_t *pos = nested_offsets(j, a->thread, l);
+        uint32_t from = (uint64_t)j->len[l] * a->thread / j->num_threads;
+        uint32_t to = (uint64_t)j->len[l] * (a->thread + 1) / j->num_threads;
+        for (uint32_t i = from; i < to; i++) {
+            uint64_t s = j->list[l][i];
+            j->part[l][pos[NESTED_BUCKET(s)]++] = s;
+        }
+    }
+    return NULL;
+}
+
+static inline uint64_t nested_hash(uint64_t s) {
+    s ^= s >> 29;
+    s *= UINT64_C(0xbf58476d1ce4e5b9);
+    return s ^ (s >> 32);
+}
+
+static void *nested_join_thread(void *arg) {
+    nested_thread_arg_t *a = arg;
+    nested_join_t *j = a->join;
+    uint64_t *table = NULL;
+    uint32_t table_size = 0;
+
+    for (;;) {
+        if (__atomic_load_n(&j->failed, __ATOMIC_RELAXED))
+            break;
+
+        uint32_t block = __atomic_fetch_add(&j->next_block, NESTED_BUCKET_BLOCK, __ATOMIC_RELAXED);
+        if (block >= NESTED_BUCKETS)
+            break;
+
+        for (uint32_t b = block; b < block + NESTED_BUCKET_BLOCK; b++) {
+            uint64_t *pa = j->part[0] + j->start[0][b];
+            uint64_t *pb = j->part[1] + j->start[1][b];
+            uint32_t na = j->start[0][b + 1] - j->start[0][b];
+            uint32_t nb = j->start[1][b + 1] - j->start[1][b];
+            j->found[b] = 0;
+            if (na == 0 || nb == 0)
+                continue;
+
+            uint32_t size = 16;
+            while (size < nb * 2)
+                size <<= 1;
+            if (size > table_size) {
+                uint64_t *tmp = realloc(table, size * sizeof(uint64_t));
+                if (tmp == NULL) {
+                    // skipping the bucket could lose the key, give up on the whole join
+                    __atomic_store_n(&j->failed, true, __ATOMIC_RELAXED);
+                    break;
+                }
+                table = tmp;
+                table_size = size;
+            }
+            memset(table, 0xff, size * sizeof(uint64_t));
+
+            for (uint32_t i = 0; i < nb; i++) {
+                lfsr_rollback_word((struct Crypto1State *)&pb[i], j->in[1], 0);
+                uint32_t h = nested_hash(pb[i]) & (size - 1);
+                while (table[h] != NESTED_EMPTY && table[h] != pb[i])
+                    h = (h + 1) & (size - 1);
+                table[h] = pb[i];
+            }
+
+            uint32_t found = 0;
+            for (uint32_t i = 0; i < na; i++) {
+                uint64_t s = pa[i];
+                lfsr_rollback_word((struct Crypto1State *)&s, j->in[0], 0);
+                uint32_t h = nested_hash(s) & (size - 1);
+                while (table[h] != NESTED_EMPTY) {
+                    if (table[h] == s) {
+                        pa[found++] = s;
+                        break;
+                    }
+                    h = (h + 1) & (size - 1);
+                }
+            }
+            j->found[b] = found;
+        }
+    }
+    free(table);
+    return NULL;
+}
+
+// Roll back both state lists with their input (nt_enc ^ uid) and keep the common members.
+// Result will be in listA, terminated by -1, <keycnt> gets the number of elements.
+// PM3_EMALLOC if memory ran out, the result is incomplete then and must not be used.
+int nested_intersection(struct Crypto1State *listA, uint32_t lenA, uint32_t inA, struct Crypto1State *listB, uint32_t lenB, uint32_t inB, uint32_t *keycnt) {
+    *keycnt = 0;
+    if (listA == NULL || listB == NULL)
+        return PM3_EMALLOC;
+
+    nested_join_t j = {
+        .list = { (uint64_t *)listA, (uint64_t *)listB },
+        .len = { lenA, lenB },
+        .in = { inA, inB },
+        .next_block = 0,
+        .num_threads = nested_num_threads(lenA > lenB ? lenA : lenB),
+        .failed = false,
+    };
+
+    int res = PM3_SUCCESS;
+    uint32_t cnt = 0;
+    j.part[0] = malloc(((size_t)lenA + lenB + 1) * sizeof(uint64_t));
+    j.start[0] = calloc((NESTED_BUCKETS + 1) * 2, sizeof(uint32_t));
+    j.offsets = calloc((size_t)j.num_threads * 2 * NESTED_BUCKETS, sizeof(uint32_t));
+    j.found = calloc(NESTED_BUCKETS, sizeof(uint32_t));
+    if (j.part[0] == NULL || j.start[0] == NULL || j.offsets == NULL || j.found == NULL) {
+        res = PM3_EMALLOC;
+        goto out;
+    }
+
+    j.part[1] = j.part[0] + lenA;
+    j.start[1] = j.start[0] + NESTED_BUCKETS + 1;
+
+    nested_thread_arg_t args[NESTED_MAX_THREADS];
+    for (uint16_t i = 0; i < j.num_threads; i++) {
+        args[i].join = &j;
+        args[i].thread = i;
+    }
+
+    // histogram of both lists
+    nested_run_threads(j.num_threads, nested_count_thread, args);
+
+    // turn the counts into bucket starts and per thread scatter positions
+    for (uint8_t l = 0; l < 2; l++) {
+        uint32_t pos = 0;
+        for (uint32_t b = 0; b < NESTED_BUCKETS; b++) {
+            j.start[l][b] = pos;
+            for (uint16_t t = 0; t < j.num_threads; t++) {
+                uint32_t *cnt = nested_offsets(&j, t, l);
+                uint32_t c = cnt[b];
+                cnt[b] = pos;
+                pos += c;
+            }
+        }
+        j.start[l][NESTED_BUCKETS] = pos;
+    }
+
+    nested_run_threads(j.num_threads, nested_scatter_thread, args);
+    nested_run_threads(j.num_threads, nested_join_thread, args);
+    if (j.failed) {
+        res = PM3_EMALLOC;
+        goto out;
+    }
+
+    // gather the keys of all buckets, in bucket order
+    for (uint32_t b = 0; b < NESTED_BUCKETS; b++) {
+        memcpy((uint64_t *)listA + cnt, j.part[0] + j.start[0][b], j.found[b] * sizeof(uint64_t));
+        cnt += j.found[b];
+    }
+
+out:
+    ((uint64_t *)listA)[cnt] = UINT64_C(-1);
+    *keycnt = cnt;
+    free(j.found);
+    free(j.offsets);
+    free(j.start[0]);
+    free(j.part[0]);
+    return res;
+}
+
+typedef struct {
+    struct Crypto1State *list;
+    uint32_t from;
+    uint32_t to;
+    uint32_t in;
+} nested_rollback_arg_t;
+
+static void *nested_rollback_thread(void *arg) {
+    nested_rollback_arg_t *a = arg;
+    for (uint32_t i = a->from; i < a->to; i++)
+        lfsr_rollback_word(a->list + i, a->in, 0);
+    return NULL;
+}
+
+// Roll back all states of a list with its input (nt_enc ^ uid). List will be terminated by -1.
+uint32_t nested_rollback(struct Crypto1State *list, uint32_t len, uint32_t in) {
+    if (list == NULL)
+        return 0;
+
+    uint16_t num_threads = nested_num_threads(len);
+    pthread_t thread_id[NESTED_MAX_THREADS];
+    bool started[NESTED_MAX_THREADS];
+    nested_rollback_arg_t args[NESTED_MAX_THREADS];
+
+    for (uint16_t i = 0; i < num_threads; i++) {
+        args[i].list = list;
+        args[i].from = (uint64_t)len * i / num_threads;
+        args[i].to = (uint64_t)len * (i + 1) / num_threads;
+        args[i].in = in;
+        started[i] = (pthread_create(&thread_id[i], NULL, nested_rollback_thread, &args[i]) == 0);
+        if (started[i] == false)
+            nested_rollback_thread(&args[i]);
+    }
+    for (uint16_t i = 0; i < num_threads; i++) {
+        if (started[i])
+            pthread_join(thread_id[i], NULL);
+    }
+
+    list[len].odd = -1;
+    list[len].even = -1;
+    return len;
+}
+
 // Darkside attack (hf mf mifare)
 // if successful it will return a list of keys, not just one.
 uint32_t nonce2key(uint32_t uid, uint32_t nt, uint32_t nr, uint32_t ar, uint64_t par_info, uint64_t ks_info, uint64_t **keys) {
@@ -31,4 +31,8 @@ int mfkey64(nonces_t *data, uint64_t *outputkey);
 int compare_uint64(const void *a, const void *b);
 uint32_t intersection(uint64_t *listA, uint64_t *listB);
 
+struct Crypto1State;
+int nested_intersection(struct Crypto1State *listA, uint32_t lenA, uint32_t inA, struct Crypto1State *listB, uint32_t lenB, uint32_t inB, uint32_t *keycnt);
+uint32_t nested_rollback(struct Crypto1State *list, uint32_t len, uint32_t in);
+
 #endif
@@ -32,6 +32,7 @@
 #include "crc16.h"
 #include "protocols.h"
 #include "mfkey.h"
+#include "mfc_candidates.h"
 #include "util_posix.h"         // msclock
 #include "cmdparser.h"          // detection of flash capabilities
 #include "cmdflashmemspiffs.h"  // upload to flash mem
@@ -337,6 +338,108 @@ int mfCheckKeys_file(uint8_t *destfn, uint64_t *key) {
     return PM3_SUCCESS;
 }
 
+static int mfCheckKeys_list_send(mfc_cand_packet_t *packet, PacketResponseNG *resp) {
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_MIFARE_CHKKEYS_LIST, (uint8_t *)packet, sizeof(mfc_cand_packet_t) - sizeof(packet->data) + packet->len);
+    if (!WaitForResponseTimeout(CMD_HF_MIFARE_CHKKEYS_LIST, resp, 2000)) {
+        PrintAndLogEx(WARNING, "Chk keys list, command execution time out");
+        return PM3_ETIMEOUT;
+    }
+    return resp->status;
+}
+
+// Uploads the key list into device memory, as many keys as fit at once, and lets
+// the device check them against the card. No round trip per key block.
+int mfCheckKeys_list(uint8_t blockNo, uint8_t keyType, const uint64_t *keys, uint32_t keycnt, uint64_t *key) {
+    *key = -1;
+
+    mfc_cand_packet_t packet;
+    PacketResponseNG resp;
+    uint64_t start_time = msclock();
+
+    for (uint32_t done = 0; done < keycnt;) {
+
+        // new list, the device answers how many keys it accepts
+        mfc_cand_hdr_t hdr = {
+            .keytype = keyType,
+            .block = blockNo,
+            .count = MIN(keycnt - done, 0xFFFF),
+        };
+        memset(&packet, 0, sizeof(packet));
+        packet.op = MFC_CAND_OP_INIT;
+        packet.len = sizeof(hdr);
+        memcpy(packet.data, &hdr, sizeof(hdr));
+
+        int res = mfCheckKeys_list_send(&packet, &resp);
+        if (res != PM3_SUCCESS)
+            return res;
+
+        uint16_t count = 0;
+        memcpy(&count, resp.data.asBytes, sizeof(count));
+        if (count == 0)
+            return PM3_EMALLOC;
+
+        for (uint16_t i = 0; i < count; i += MFC_CAND_KEYS_PER_PACKET) {
+            uint16_t n = MIN(count - i, MFC_CAND_KEYS_PER_PACKET);
+            packet.op = MFC_CAND_OP_UPLOAD;
+            packet.offset = i;
+            packet.len = n * MFC_CAND_KEY_SIZE;
+            for (uint16_t j = 0; j < n; j++) {
+                num_to_bytes(keys[done + i + j], MFC_CAND_KEY_SIZE, packet.data + j * MFC_CAND_KEY_SIZE);
+            }
+
+            res = mfCheckKeys_list_send(&packet, &resp);
+            if (res != PM3_SUCCESS)
+                return res;
+        }
+
+        packet.op = MFC_CAND_OP_RUN;
+        packet.len = 0;
+        clearCommandBuffer();
+        SendCommandNG(CMD_HF_MIFARE_CHKKEYS_LIST, (uint8_t *)&packet, sizeof(mfc_cand_packet_t) - sizeof(packet.data));
+
+        // the device reports progress while it works through the list
+        mfc_cand_result_t *result = (mfc_cand_result_t *)resp.data.asBytes;
+        uint8_t retry = 10;
+        while (true) {
+            if (kbd_enter_pressed()) {
+                SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            }
+
+            if (!WaitForResponseTimeout(CMD_HF_MIFARE_CHKKEYS_LIST, &resp, 2000)) {
+                if (--retry == 0) {
+                    PrintAndLogEx(WARNING, "\nChk keys list, command execution time out");
+                    SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+                    return PM3_ETIMEOUT;
+                }
+                continue;
+            }
+            retry = 10;
+
+            if (resp.length < sizeof(mfc_cand_result_t))
+                return (resp.status != PM3_SUCCESS) ? resp.status : PM3_ESOFT;
+
+            if (result->done)
+                break;
+
+            uint32_t tried = done + result->tried;
+            float bruteforce_per_second = (float)tried / ((msclock() - start_time) / 1000.0);
+            PrintAndLogEx(INPLACE, "%6u/%u keys | %5.1f keys/sec | worst case %6.1f seconds remaining", tried, keycnt, bruteforce_per_second, (keycnt - tried) / bruteforce_per_second);
+        }
+
+        if (resp.status != PM3_SUCCESS)
+            return resp.status;
+
+        if (result->found) {
+            *key = bytes_to_num(result->key, sizeof(result->key));
+            return PM3_SUCCESS;
+        }
+
+        done += count;
+    }
+    return PM3_ESOFT;
+}
+
 // PM3 imp of J-Run mf_key_brute (part 2)
 // ref: https://github.com/J-Run/mf_key_brute
 int mfKeyBrute(uint8_t blockNo, uint8_t keyType, const uint8_t *key, uint64_t *resultkey) {
@@ -381,13 +484,6 @@ int mfKeyBrute(uint8_t blockNo, uint8_t keyType, const uint8_t *key, uint64_t *r
     return found;
 }
 
-// Compare 16 Bits out of cryptostate
-inline static int Compare16Bits(const void *a, const void *b) {
-    if ((*(uint64_t *)b & 0x00ff000000ff0000) == (*(uint64_t *)a & 0x00ff000000ff0000)) return 0;
-    if ((*(uint64_t *)b & 0x00ff000000ff0000) > (*(uint64_t *)a & 0x00ff000000ff0000)) return 1;
-    return -1;
-}
-
 // wrapper function for multi-threaded lfsr_recovery32
 static void
 #ifdef __has_attribute
@@ -405,8 +501,6 @@ __attribute__((force_align_arg_pointer))
     statelist->len = p1 - statelist->head.slhead;
     statelist->tail.sltail = --p1;
 
-    qsort(statelist->head.slhead, statelist->len, sizeof(uint64_t), Compare16Bits);
-
     return statelist->head.slhead;
 }
 
@@ -414,7 +508,6 @@ int mfnested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo,
 
     uint32_t uid;
     StateList_t statelists[2];
-    struct Crypto1State *p1, *p2, *p3, *p4;
 
     struct {
         uint8_t block;
@@ -482,50 +575,16 @@ int mfnested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo,
         pthread_join(thread_id[i], (void *)&statelists[i].head.slhead);
 
     // the first 16 Bits of the cryptostate already contain part of our key.
-    // Create the intersection of the two lists based on these 16 Bits and
-    // roll back the cryptostate
-    p1 = p3 = statelists[0].head.slhead;
-    p2 = p4 = statelists[1].head.slhead;
-
-    while (p1 <= statelists[0].tail.sltail && p2 <= statelists[1].tail.sltail) {
-        if (Compare16Bits(p1, p2) == 0) {
-
-            struct Crypto1State savestate;
-            savestate = *p1;
-            while (Compare16Bits(p1, &savestate) == 0 && p1 <= statelists[0].tail.sltail) {
-                *p3 = *p1;
-                lfsr_rollback_word(p3, statelists[0].nt_enc ^ statelists[0].uid, 0);
-                p3++;
-                p1++;
-            }
-            savestate = *p2;
-            while (Compare16Bits(p2, &savestate) == 0 && p2 <= statelists[1].tail.sltail) {
-                *p4 = *p2;
-                lfsr_rollback_word(p4, statelists[1].nt_enc ^ statelists[1].uid, 0);
-                p4++;
-                p2++;
-            }
-        } else {
-            while (Compare16Bits(p1, p2) == -1) p1++;
-            while (Compare16Bits(p1, p2) == 1) p2++;
-        }
+    // Roll back the cryptostates sharing these 16 Bits. The key we are searching for
+    // must be in the intersection of both lists.
+    if (nested_intersection(statelists[0].head.slhead, statelists[0].len, statelists[0].nt_enc ^ statelists[0].uid,
+                            statelists[1].head.slhead, statelists[1].len, statelists[1].nt_enc ^ statelists[1].uid,
+                            &statelists[0].len) != PM3_SUCCESS) {
+        free(statelists[0].head.slhead);
+        free(statelists[1].head.slhead);
+        return PM3_EMALLOC;
     }
-
-    p3->odd = -1;
-    p3->even = -1;
-    p4->odd = -1;
-    p4->even = -1;
-    statelists[0].len = p3 - statelists[0].head.slhead;
-    statelists[1].len = p4 - statelists[1].head.slhead;
-    statelists[0].tail.sltail = --p3;
-    statelists[1].tail.sltail = --p4;
-
-    // the statelists now contain possible keys. The key we are searching for must be in the
-    // intersection of both lists
-    qsort(statelists[0].head.keyhead, statelists[0].len, sizeof(uint64_t), compare_uint64);
-    qsort(statelists[1].head.keyhead, statelists[1].len, sizeof(uint64_t), compare_uint64);
-    // Create the intersection
-    statelists[0].len = intersection(statelists[0].head.keyhead, statelists[1].head.keyhead);
+    statelists[0].tail.sltail = statelists[0].head.slhead + statelists[0].len - 1;
 
     //statelists[0].tail.keytail = --p7;
     uint32_t keycnt = statelists[0].len;
@@ -536,37 +595,29 @@ int mfnested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo,
     memset(resultKey, 0, 6);
     uint64_t key64 = -1;
 
-    // The list may still contain several key candidates. Test each of them with mfCheckKeys
-    uint32_t max_keys = keycnt > KEYS_IN_BLOCK ? KEYS_IN_BLOCK : keycnt;
-    uint8_t keyBlock[PM3_CMD_DATA_SIZE] = {0x00};
-
-    for (uint32_t i = 0; i < keycnt; i += max_keys) {
-
-        uint64_t start_time = msclock();
-
-        uint8_t size = keycnt - i > max_keys ? max_keys : keycnt - i;
-
-        register uint8_t j;
-        for (j = 0; j < size; j++) {
-            crypto1_get_lfsr(statelists[0].head.slhead + i, &key64);
-            num_to_bytes(key64, 6, keyBlock + j * 6);
-        }
-
-        if (mfCheckKeys(statelists[0].blockNo, statelists[0].keyType, false, size, keyBlock, &key64) == PM3_SUCCESS) {
-            free(statelists[0].head.slhead);
-            free(statelists[1].head.slhead);
-            num_to_bytes(key64, 6, resultKey);
-
-            PrintAndLogEx(SUCCESS, "\ntarget block %4u key type %c -- found valid key [ " _GREEN_("%s") " ]",
-                          package->block,
-                          package->keytype ? 'B' : 'A',
-                          sprint_hex_inrow(resultKey, 6)
-                         );
-            return PM3_SUCCESS;
-        }
+    // The list may still contain several key candidates. Turn them into keys and let the device test them all
+    for (uint32_t i = 0; i < keycnt; i++) {
+        crypto1_get_lfsr(statelists[0].head.slhead + i, &key64);
+        statelists[0].head.keyhead[i] = key64;
+    }
 
-        float bruteforce_per_second = (float)(i + max_keys) / ((msclock() - start_time) / 1000.0);
-        PrintAndLogEx(INPLACE, "%6d/%u keys | %5.1f keys/sec | worst case %6.1f seconds remaining", i, keycnt, bruteforce_per_second, (keycnt - i) / bruteforce_per_second);
+    int res = mfCheckKeys_list(statelists[0].blockNo, statelists[0].keyType, statelists[0].head.keyhead, keycnt, &key64);
+    if (res == PM3_SUCCESS) {
+        free(statelists[0].head.slhead);
+        free(statelists[1].head.slhead);
+        num_to_bytes(key64, 6, resultKey);
+
+        PrintAndLogEx(SUCCESS, "\ntarget block %4u key type %c -- found valid key [ " _GREEN_("%s") " ]",
+                      package->block,
+                      package->keytype ? 'B' : 'A',
+                      sprint_hex_inrow(resultKey, 6)
+                     );
+        return PM3_SUCCESS;
+    } else if (res == PM3_ETIMEOUT || res == PM3_EOPABORTED) {
+        PrintAndLogEx(NORMAL, "");
+        free(statelists[0].head.slhead);
+        free(statelists[1].head.slhead);
+        return res;
     }
 
 out:
@@ -585,7 +636,6 @@ int mfStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBl
 
     uint32_t uid;
     StateList_t statelists[1];
-    struct Crypto1State *p1, *p3;
 
     struct {
         uint8_t block;
@@ -641,25 +691,13 @@ int mfStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBl
     // wait for thread to terminate:
     pthread_join(t, (void *)&statelists[0].head.slhead);
 
-    // the first 16 Bits of the cryptostate already contain part of our key.
-    p1 = p3 = statelists[0].head.slhead;
-
-    // create key candidates.
-    while (p1 <= statelists[0].tail.sltail) {
-        struct Crypto1State savestate;
-        savestate = *p1;
-        while (Compare16Bits(p1, &savestate) == 0 && p1 <= statelists[0].tail.sltail) {
-            *p3 = *p1;
-            lfsr_rollback_word(p3, statelists[0].nt_enc ^ statelists[0].uid, 0);
-            p3++;
-            p1++;
-        }
+    if (statelists[0].head.slhead == NULL) {
+        return PM3_EMALLOC;
     }
 
-    p3->odd = -1;
-    p3->even = -1;
-    statelists[0].len = p3 - statelists[0].head.slhead;
-    statelists[0].tail.sltail = --p3;
+    // create key candidates.
+    statelists[0].len = nested_rollback(statelists[0].head.slhead, statelists[0].len, statelists[0].nt_enc ^ statelists[0].uid);
+    statelists[0].tail.sltail = statelists[0].head.slhead + statelists[0].len - 1;
 
     uint32_t keycnt = statelists[0].len;
     if (keycnt == 0) goto out;
@@ -667,111 +705,32 @@ int mfStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBl
     PrintAndLogEx(SUCCESS, "Found " _YELLOW_("%u") " key candidates", keycnt);
 
     memset(resultKey, 0, 6);
+    uint64_t key64 = -1;
 
-    // The list may still contain several key candidates. Test each of them with mfCheckKeys
-    uint32_t maxkeysinblock = IfPm3Flash() ? 1000 : KEYS_IN_BLOCK;
-    uint32_t max_keys_chunk = keycnt > maxkeysinblock ? maxkeysinblock : keycnt;
-
-    uint8_t *mem = NULL;
-    uint8_t *p_keyblock = NULL;
-
-    if (IfPm3Flash()) {
-
-        // used for mfCheckKeys_file, which needs a header
-        mem = calloc((maxkeysinblock * 6) + 5, sizeof(uint8_t));
-        if (mem == NULL) {
-            free(statelists[0].head.slhead);
-            return PM3_EMALLOC;
-        }
-
-        mem[0] = statelists[0].keyType;
-        mem[1] = statelists[0].blockNo;
-        mem[2] = 1;
-        mem[3] = ((max_keys_chunk >> 8) & 0xFF);
-        mem[4] = (max_keys_chunk & 0xFF);
-
-        p_keyblock = mem + 5;
-    } else {
-
-        // used for mfCheckKeys, which adds its own header.
-        mem = calloc((maxkeysinblock * 6), sizeof(uint8_t));
-        if (mem == NULL) {
-            free(statelists[0].head.slhead);
-            return PM3_EMALLOC;
-        }
-        p_keyblock = mem;
+    // The list may still contain several key candidates. Turn them into keys and let the device test them all
+    for (uint32_t i = 0; i < keycnt; i++) {
+        crypto1_get_lfsr(statelists[0].head.slhead + i, &key64);
+        statelists[0].head.keyhead[i] = key64;
     }
 
-    uint8_t destfn[32];
-    strncpy((char *)destfn, "static_nested_000.bin", sizeof(destfn) - 1);
-
-    uint64_t start_time = msclock();
-    for (uint32_t i = 0; i < keycnt; i += max_keys_chunk) {
-
-        //flush queue
-        while (kbd_enter_pressed()) {
-            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
-            PrintAndLogEx(NORMAL, "");
-            free(mem);
-            return PM3_EOPABORTED;
-        }
-
-        int res = 0;
-        uint64_t key64 = 0;
-
-        uint32_t chunk = keycnt - i > max_keys_chunk ? max_keys_chunk : keycnt - i;
-
-        // copy x keys to device.
-        for (uint32_t j = 0; j < chunk; j++) {
-            crypto1_get_lfsr(statelists[0].head.slhead + i + j, &key64);
-            num_to_bytes(key64, 6, p_keyblock + j * 6);
-        }
-
-        // check a block of generated key candidates.
-        if (IfPm3Flash()) {
-
-            mem[3] = ((chunk >> 8) & 0xFF);
-            mem[4] = (chunk & 0xFF);
-
-            // upload to flash.
-            res = flashmem_spiffs_load((char *)destfn, mem, 5 + (chunk * 6));
-            if (res != PM3_SUCCESS) {
-                PrintAndLogEx(WARNING, "\nSPIFFS upload failed");
-                free(mem);
-                return res;
-            }
-            res = mfCheckKeys_file(destfn, &key64);
-        } else {
-            res = mfCheckKeys(statelists[0].blockNo, statelists[0].keyType, true, chunk, mem, &key64);
-        }
-
-        if (res == PM3_SUCCESS) {
-            p_keyblock = NULL;
-            free(statelists[0].head.slhead);
-            free(mem);
-
-            num_to_bytes(key64, 6, resultKey);
-
-            PrintAndLogEx(NORMAL, "");
-            PrintAndLogEx(SUCCESS, "target block: %3u key type: %c  -- found valid key [ " _GREEN_("%s") " ]",
-                          package->block,
-                          package->keytype ? 'B' : 'A',
-                          sprint_hex_inrow(resultKey, 6)
-                         );
-            return PM3_SUCCESS;
-        } else if (res == PM3_ETIMEOUT || res == PM3_EOPABORTED) {
-            PrintAndLogEx(NORMAL, "");
-            free(mem);
-            return res;
-        }
+    int res = mfCheckKeys_list(statelists[0].blockNo, statelists[0].keyType, statelists[0].head.keyhead, keycnt, &key64);
+    if (res == PM3_SUCCESS) {
+        free(statelists[0].head.slhead);
+        num_to_bytes(key64, 6, resultKey);
 
-        float bruteforce_per_second = (float)(i + max_keys_chunk) / ((msclock() - start_time) / 1000.0);
-        PrintAndLogEx(INPLACE, "%6u/%u keys | %5.1f keys/sec | worst case %6.1f seconds", i, keycnt, bruteforce_per_second, (keycnt - i) / bruteforce_per_second);
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(SUCCESS, "target block: %3u key type: %c  -- found valid key [ " _GREEN_("%s") " ]",
+                      package->block,
+                      package->keytype ? 'B' : 'A',
+                      sprint_hex_inrow(resultKey, 6)
+                     );
+        return PM3_SUCCESS;
+    } else if (res == PM3_ETIMEOUT || res == PM3_EOPABORTED) {
+        PrintAndLogEx(NORMAL, "");
+        free(statelists[0].head.slhead);
+        return res;
     }
 
-    p_keyblock = NULL;
-    free(mem);
-
 out:
     PrintAndLogEx(SUCCESS, "\ntarget block: %3u key type: %c",
                   package->block,
@@ -828,6 +787,26 @@ int mfReadBlock(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t *data) {
     return PM3_SUCCESS;
 }
 
+int mfWriteBlock(uint8_t blockNo, uint8_t keyType, const uint8_t *key, const uint8_t *block) {
+    uint8_t data[26];
+    memcpy(data, key, 6);
+    memcpy(data + 10, block, 16);
+
+    clearCommandBuffer();
+    SendCommandMIX(CMD_HF_MIFARE_WRITEBL, blockNo, keyType, 0, data, sizeof(data));
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_ACK, &resp, 1500) == false) {
+        PrintAndLogEx(DEBUG, "Command execute timeout");
+        return PM3_ETIMEOUT;
+    }
+
+    if ((resp.oldarg[0] & 0xff) == 0) {
+        PrintAndLogEx(DEBUG, "failed writing block");
+        return PM3_ESOFT;
+    }
+    return PM3_SUCCESS;
+}
+
 // EMULATOR
 int mfEmlGetMem(uint8_t *data, int blockNum, int blocksCount) {
 
@@ -76,11 +76,13 @@ int mfCheckKeys_fast(uint8_t sectorsCnt, uint8_t firstChunk, uint8_t lastChunk,
                      uint8_t strategy, uint32_t size, uint8_t *keyBlock, sector_t *e_sector, bool use_flashmemory);
 
 int mfCheckKeys_file(uint8_t *destfn, uint64_t *key);
+int mfCheckKeys_list(uint8_t blockNo, uint8_t keyType, const uint64_t *keys, uint32_t keycnt, uint64_t *key);
 
 int mfKeyBrute(uint8_t blockNo, uint8_t keyType, const uint8_t *key, uint64_t *resultkey);
 
 int mfReadSector(uint8_t sectorNo, uint8_t keyType, uint8_t *key, uint8_t *data);
 int mfReadBlock(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t *data);
+int mfWriteBlock(uint8_t blockNo, uint8_t keyType, const uint8_t *key, const uint8_t *block);
 
 int mfEmlGetMem(uint8_t *data, int blockNum, int blocksCount);
 int mfEmlSetMem(uint8_t *data, int blockNum, int blocksCount);
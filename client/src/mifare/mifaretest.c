@@ -0,0 +1,293 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+//  tests for MIFARE Classic key recovery
+//-----------------------------------------------------------------------------
+
+#include "mifaretest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>      // memcpy memset
+#include <unistd.h>      // getpid
+
+#include "ui.h"
+#include "commonutil.h"
+#include "crapto1/crapto1.h"
+#include "mifare/mfkey.h"
+#include "mfc_candidates.h"
+#include "dictionary.h"
+
+// nonce sets as returned by CMD_HF_MIFARE_NESTED, with the number of key candidates
+// left after the intersection and the index of the real key among them
+typedef struct {
+    uint32_t cuid;
+    uint32_t nt_a;
+    uint32_t ks_a;
+    uint32_t nt_b;
+    uint32_t ks_b;
+    uint64_t key;
+    uint32_t keycnt;
+    uint32_t keyidx;
+} nested_vector_t;
+
+static const nested_vector_t NestedVectors[] = {
+    {0x2e4b7c1a, 0x7eef3586, 0xff9ff927, 0x02d9aa62, 0xff879923, 0xffffffffffff, 3, 2},
+    {0xa7b3c1d9, 0xe3fad05c, 0x505187d8, 0x861f6be3, 0x5a518ff9, 0xa0a1a2a3a4a5, 2, 1},
+    {0x0d8e1f22, 0xa6809e04, 0x6047f8c1, 0x183325f0, 0xa063f9ab, 0x4d3a99c351dd, 1, 0},
+};
+
+static uint32_t StateListLen(struct Crypto1State *list) {
+    uint32_t len = 0;
+    while (list[len].odd | list[len].even)
+        len++;
+    return len;
+}
+
+static bool TestNestedIntersection(void) {
+    bool res = true;
+
+    for (size_t i = 0; i < ARRAYLEN(NestedVectors) && res; i++) {
+        const nested_vector_t *v = &NestedVectors[i];
+
+        struct Crypto1State *a = lfsr_recovery32(v->ks_a, v->nt_a ^ v->cuid);
+        struct Crypto1State *b = lfsr_recovery32(v->ks_b, v->nt_b ^ v->cuid);
+        res = (a != NULL && b != NULL);
+
+        if (res) {
+            uint32_t keycnt = 0;
+            res = (nested_intersection(a, StateListLen(a), v->nt_a ^ v->cuid, b, StateListLen(b), v->nt_b ^ v->cuid, &keycnt) == PM3_SUCCESS);
+            res = res && (keycnt == v->keycnt);
+            res = res && (((uint64_t *)a)[keycnt] == UINT64_C(-1));
+
+            uint64_t key = 0;
+            if (res)
+                crypto1_get_lfsr(a + v->keyidx, &key);
+            res = res && (key == v->key);
+        }
+
+        free(a);
+        free(b);
+    }
+
+    if (res)
+        PrintAndLogEx(INFO, "nested intersection.. " _GREEN_("passed"));
+    else
+        PrintAndLogEx(ERR,  "nested intersection.. " _RED_("fail"));
+
+    return res;
+}
+
+static bool TestStaticNestedRollback(void) {
+    bool res = true;
+
+    for (size_t i = 0; i < ARRAYLEN(NestedVectors) && res; i++) {
+        const nested_vector_t *v = &NestedVectors[i];
+
+        struct Crypto1State *a = lfsr_recovery32(v->ks_a, v->nt_a ^ v->cuid);
+        res = (a != NULL);
+        if (res == false)
+            break;
+
+        uint32_t len = StateListLen(a);
+        res = (nested_rollback(a, len, v->nt_a ^ v->cuid) == len);
+
+        bool found = false;
+        for (uint32_t j = 0; j < len && res && found == false; j++) {
+            uint64_t key = 0;
+            crypto1_get_lfsr(a + j, &key);
+            found = (key == v->key);
+        }
+        res = res && found;
+
+        free(a);
+    }
+
+    if (res)
+        PrintAndLogEx(INFO, "static nested rollback.. " _GREEN_("passed"));
+    else
+        PrintAndLogEx(ERR,  "static nested rollback.. " _RED_("fail"));
+
+    return res;
+}
+
+static bool TestCandidateList(void) {
+    const nested_vector_t *v = &NestedVectors[0];
+
+    // pad the candidates of the first nonce set up to a few upload packets, real key last
+    uint16_t count = MFC_CAND_KEYS_PER_PACKET * 2 + 7;
+    uint64_t keys[MFC_CAND_KEYS_PER_PACKET * 2 + 7];
+    for (uint16_t i = 0; i < count; i++)
+        keys[i] = (v->key ^ (0x010101010101 * (i + 1))) & 0xFFFFFFFFFFFF;
+    keys[count - 1] = v->key;
+
+    uint32_t listsize = mfc_cand_size(count);
+    uint8_t *list = calloc(listsize, sizeof(uint8_t));
+    if (list == NULL)
+        return false;
+
+    bool res = (mfc_cand_capacity(listsize) == count);
+    res = res && (mfc_cand_capacity(sizeof(mfc_cand_hdr_t)) == 0);
+
+    mfc_cand_hdr_t hdr = {.keytype = 0, .block = 4, .count = count};
+    memcpy(list, &hdr, sizeof(hdr));
+    res = res && mfc_cand_check(list, listsize);
+    res = res && (mfc_cand_check(list, listsize - 1) == false);
+
+    // upload in packets, the same way the client does
+    uint8_t data[MFC_CAND_KEYS_PER_PACKET * MFC_CAND_KEY_SIZE];
+    for (uint16_t i = 0; i < count && res; i += MFC_CAND_KEYS_PER_PACKET) {
+        uint16_t n = MIN(count - i, MFC_CAND_KEYS_PER_PACKET);
+        for (uint16_t j = 0; j < n; j++)
+            num_to_bytes(keys[i + j], MFC_CAND_KEY_SIZE, data + j * MFC_CAND_KEY_SIZE);
+        res = mfc_cand_put(list, listsize, i, data, n * MFC_CAND_KEY_SIZE);
+    }
+
+    // out of bounds and partial keys are refused
+    res = res && (mfc_cand_put(list, listsize, count - 1, data, 2 * MFC_CAND_KEY_SIZE) == false);
+    res = res && (mfc_cand_put(list, listsize, 0, data, MFC_CAND_KEY_SIZE - 1) == false);
+    res = res && (mfc_cand_set_key(list, listsize, count, v->key) == false);
+
+    // iterate, with a retry of every 5th key and progress reports
+    mfc_cand_iter_t it;
+    mfc_cand_iter_init(&it, list);
+    uint64_t key = 0;
+    uint16_t idx = 0, retries = 0, reports = 0;
+    bool found = false;
+    while (res && mfc_cand_iter_next(&it, &key)) {
+        if ((it.pos % 5) == 0 && retries < it.pos / 5) {
+            retries++;
+            mfc_cand_iter_retry(&it);
+            continue;
+        }
+        res = (key == keys[idx]);
+        if (key == v->key) {
+            found = true;
+            break;
+        }
+        idx++;
+        if (mfc_cand_iter_progress(&it))
+            reports++;
+    }
+    res = res && found && (it.pos == count) && (idx == count - 1);
+    res = res && (reports == (count - 1) / MFC_CAND_PROGRESS_INTERVAL);
+
+    free(list);
+
+    if (res)
+        PrintAndLogEx(INFO, "candidate key list.. " _GREEN_("passed"));
+    else
+        PrintAndLogEx(ERR,  "candidate key list.. " _RED_("fail"));
+
+    return res;
+}
+
+static bool WriteDictionary(const char *path, const char *text) {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL)
+        return false;
+
+    bool res = (fwrite(text, strlen(text), 1, f) == 1);
+    res &= (fclose(f) == 0);
+    return res;
+}
+
+static bool CheckDictionary(const char *path, const uint64_t *keys, uint32_t count, uint32_t duplicates, bool cached) {
+    dictionary_t dict;
+    if (dictionary_open(&dict, path, 6, false) != PM3_SUCCESS)
+        return false;
+
+    bool res = (dict.count == count) && (dict.duplicates == duplicates);
+#if !defined(_WIN32)
+    res = res && (dict.mapped == cached);
+#else
+    (void)cached;
+#endif
+
+    uint8_t key[6];
+    for (uint32_t i = 0; i < count && res; i++)
+        res = (dictionary_next(&dict, key, 1) == 1) && (bytes_to_num(key, sizeof(key)) == keys[i]);
+    res = res && (dictionary_next(&dict, key, 1) == 0);
+
+    dictionary_close(&dict);
+    return res;
+}
+
+static bool TestDictionary(void) {
+    const char *tmpdir = getenv("TMPDIR");
+    if (tmpdir == NULL)
+        tmpdir = getenv("TEMP");
+    if (tmpdir == NULL)
+        tmpdir = "/tmp";
+
+    char path[FILENAME_MAX];
+    char cache[FILENAME_MAX + 16];
+    snprintf(path, sizeof(path), "%s/pm3_dictionary_test_%d.dic", tmpdir, (int)getpid());
+    snprintf(cache, sizeof(cache), "%s.6.cache", path);
+    remove(cache);
+
+    // duplicates are dropped, the first occurrence keeps its place
+    const uint64_t keys_a[] = {0xffffffffffff, 0xa0a1a2a3a4a5, 0xd3f7d3f7d3f7, 0x000000000000};
+    bool res = WriteDictionary(path,
+                               "# test dictionary\n"
+                               "ffffffffffff\n"
+                               "a0a1a2a3a4a5\n"
+                               "FFFFFFFFFFFF\n"
+                               "d3f7d3f7d3f7\n"
+                               "a0a1a2a3a4a5 // again\n"
+                               "000000000000\n");
+    res = res && CheckDictionary(path, keys_a, ARRAYLEN(keys_a), 2, false);
+    res = res && CheckDictionary(path, keys_a, ARRAYLEN(keys_a), 2, true);
+
+    // a changed dictionary replaces the cache. The size changes too, the mtime alone
+    // may not within the same second
+    const uint64_t keys_b[] = {0xd3f7d3f7d3f7, 0xb0b1b2b3b4b5};
+    res = res && WriteDictionary(path,
+                                 "d3f7d3f7d3f7\n"
+                                 "b0b1b2b3b4b5\n"
+                                 "d3f7d3f7d3f7\n");
+    res = res && CheckDictionary(path, keys_b, ARRAYLEN(keys_b), 1, false);
+    res = res && CheckDictionary(path, keys_b, ARRAYLEN(keys_b), 1, true);
+
+    remove(path);
+    remove(cache);
+
+    if (res)
+        PrintAndLogEx(INFO, "key dictionary.. " _GREEN_("passed"));
+    else
+        PrintAndLogEx(ERR,  "key dictionary.. " _RED_("fail"));
+
+    return res;
+}
+
+bool MifareClassicTest(bool verbose) {
+    bool res = true;
+
+    PrintAndLogEx(INFO, "------ " _CYAN_("MIFARE Classic tests") " ------");
+
+    res = res && TestNestedIntersection();
+    res = res && TestStaticNestedRollback();
+    res = res && TestCandidateList();
+    res = res && TestDictionary();
+
+    PrintAndLogEx(INFO, "---------------------------");
+    if (res)
+        PrintAndLogEx(SUCCESS, "    Tests [ %s ]", _GREEN_("ok"));
+    else
+        PrintAndLogEx(FAILED, "    Tests [ %s ]", _RED_("fail"));
+
+    PrintAndLogEx(NORMAL, "");
+    return res;
+}
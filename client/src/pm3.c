@@ -19,6 +19,8 @@
 #include "pm3.h"
 
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
 #include "proxmark3.h"
 #include "cmdmain.h"
@@ -26,44 +28,308 @@
 #include "usart_defs.h"
 #include "util_posix.h"
 #include "comms.h"
+#include "commonutil.h"
+#include "mifare.h"
+#include "mifare/mifarehost.h"
 
 pm3_device_t *pm3_open(const char *port) {
-    pm3_init();
-    OpenProxmark(&g_session.current_device, port, false, 20, false, USART_BAUD_RATE);
-    if (g_session.pm3_present && (TestProxmark(g_session.current_device) != PM3_SUCCESS)) {
+    // the first device opened is the one of the session, every further one
+    // gets a connection of its own
+    pm3_device_t *dev = g_session.current_device;
+    bool extra = (dev != NULL && dev->pm3_present);
+    if (extra) {
+        dev = NewProxmark();
+        if (dev == NULL)
+            return NULL;
+    } else {
+        pm3_init();
+    }
+
+    OpenProxmark(&dev, port, false, 20, false, USART_BAUD_RATE);
+    if (dev->pm3_present && (TestProxmark(dev) != PM3_SUCCESS)) {
         PrintAndLogEx(ERR, _RED_("ERROR:") " cannot communicate with the Proxmark\n");
-        CloseProxmark(g_session.current_device);
+        CloseProxmark(dev);
+    }
+
+    if (extra) {
+        // other devices are still in use, leave it to the caller
+        if (dev->pm3_present == false) {
+            FreeProxmark(dev);
+            return NULL;
+        }
+        return dev;
     }
 
-    if ((port != NULL) && (!g_session.pm3_present))
+    g_session.current_device = dev;
+
+    if ((port != NULL) && (!dev->pm3_present))
         exit(EXIT_FAILURE);
 
-    if (!g_session.pm3_present)
+    if (!dev->pm3_present)
         PrintAndLogEx(INFO, "Running in " _YELLOW_("OFFLINE") " mode");
-    // For now, there is no real device context:
-    return g_session.current_device;
+    return dev;
 }
 
 void pm3_close(pm3_device_t *dev) {
     // Clean up the port
-    if (g_session.pm3_present) {
+    if (dev->pm3_present) {
+        pm3_device_t *prev = g_device;
+        UseProxmark(dev);
         clearCommandBuffer();
         SendCommandNG(CMD_QUIT_SESSION, NULL, 0);
         msleep(100); // Make sure command is sent before killing client
         CloseProxmark(dev);
+        UseProxmark(prev);
     }
+    // the session device stays around. Closing the device in use falls back to it
+    FreeProxmark(dev);
+}
+
+// Commands share the graph, demod and trace buffers and plenty of static state,
+// so only one of them runs at a time. The lock is recursive because a script
+// run by a command may call pm3_console() again.
+static pthread_mutex_t s_console_lock;
+static pthread_once_t s_console_once = PTHREAD_ONCE_INIT;
+
+static void console_lock_init(void) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&s_console_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
 }
 
 int pm3_console(pm3_device_t *dev, const char *cmd) {
-    // For now, there is no real device context:
-    (void) dev;
-    return CommandReceived(cmd);
+    pthread_once(&s_console_once, console_lock_init);
+    pthread_mutex_lock(&s_console_lock);
+    pm3_device_t *prev = g_device;
+    UseProxmark(dev);
+    int res = CommandReceived(cmd);
+    UseProxmark(prev);
+    pthread_mutex_unlock(&s_console_lock);
+    return res;
 }
 
 const char *pm3_name_get(pm3_device_t *dev) {
-    return dev->g_conn->serial_port_name;
+    return dev->conn.serial_port_name;
 }
 
 pm3_device_t *pm3_get_current_dev(void) {
-    return g_session.current_device;
+    return g_device;
+}
+
+// The structured API below talks to the device directly and never formats
+// anything, failures are only reported through the return code. Like
+// pm3_console(), every call switches to its device and back to the previous one.
+
+_Static_assert(sizeof(pm3_hf14a_card_t) == sizeof(iso14a_card_select_t), "pm3_hf14a_card_t must match iso14a_card_select_t");
+
+static int api_hf14a_select(bool keep_field, pm3_hf14a_card_t *card) {
+    if (g_device->pm3_present == false) return PM3_ENOTTY;
+    if (card == NULL) return PM3_EINVARG;
+
+    memset(card, 0, sizeof(pm3_hf14a_card_t));
+
+    clearCommandBuffer();
+    SendCommandMIX(CMD_HF_ISO14443A_READER, ISO14A_CONNECT | (keep_field ? ISO14A_NO_DISCONNECT : 0), 0, 0, NULL, 0);
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_ACK, &resp, 1500) == false) return PM3_ETIMEOUT;
+
+    // 0: couldn't read, 1: OK, with ATS, 2: OK, no ATS, 3: proprietary Anticollision
+    if (resp.oldarg[0] == 0 || resp.oldarg[0] == 3) {
+        if (keep_field) DropField();
+        return PM3_ECARDEXCHANGE;
+    }
+
+    memcpy(card, resp.data.asBytes, sizeof(pm3_hf14a_card_t));
+    return PM3_SUCCESS;
+}
+
+int pm3_hf14a_select(pm3_device_t *dev, bool keep_field, pm3_hf14a_card_t *card) {
+    pm3_device_t *prev = g_device;
+    UseProxmark(dev);
+    int res = api_hf14a_select(keep_field, card);
+    UseProxmark(prev);
+    return res;
+}
+
+static int api_hf_drop_field(void) {
+    if (g_device->pm3_present == false) return PM3_ENOTTY;
+    DropField();
+    return PM3_SUCCESS;
+}
+
+int pm3_hf_drop_field(pm3_device_t *dev) {
+    pm3_device_t *prev = g_device;
+    UseProxmark(dev);
+    int res = api_hf_drop_field();
+    UseProxmark(prev);
+    return res;
+}
+
+static int api_mf_read_block(uint8_t blockno, uint8_t keytype, const uint8_t *key, size_t keylen, uint8_t *data, size_t datalen) {
+    if (g_device->pm3_present == false) return PM3_ENOTTY;
+    if (key == NULL || keylen != PM3_MF_KEY_LEN || data == NULL || datalen < PM3_MF_BLOCK_LEN || keytype > PM3_MF_KEY_B)
+        return PM3_EINVARG;
+
+    uint8_t k[PM3_MF_KEY_LEN];
+    memcpy(k, key, sizeof(k));
+    return mfReadBlock(blockno, keytype, k, data);
+}
+
+int pm3_mf_read_block(pm3_device_t *dev, uint8_t blockno, uint8_t keytype, const uint8_t *key, size_t keylen, uint8_t *data, size_t datalen) {
+    pm3_device_t *prev = g_device;
+    UseProxmark(dev);
+    int res = api_mf_read_block(blockno, keytype, key, keylen, data, datalen);
+    UseProxmark(prev);
+    return res;
+}
+
+static int api_mf_write_block(uint8_t blockno, uint8_t keytype, const uint8_t *key, size_t keylen, const uint8_t *data, size_t datalen) {
+    if (g_device->pm3_present == false) return PM3_ENOTTY;
+    if (key == NULL || keylen != PM3_MF_KEY_LEN || data == NULL || datalen < PM3_MF_BLOCK_LEN || keytype > PM3_MF_KEY_B)
+        return PM3_EINVARG;
+
+    return mfWriteBlock(blockno, keytype, key, data);
+}
+
+int pm3_mf_write_block(pm3_device_t *dev, uint8_t blockno, uint8_t keytype, const uint8_t *key, size_t keylen, const uint8_t *data, size_t datalen) {
+    pm3_device_t *prev = g_device;
+    UseProxmark(dev);
+    int res = api_mf_write_block(blockno, keytype, key, keylen, data, datalen);
+    UseProxmark(prev);
+    return res;
+}
+
+static int api_mf_check_keys(uint8_t blockno, uint8_t keytype, const uint8_t *keys, size_t keyslen, int *found) {
+    if (found) *found = -1;
+    if (g_device->pm3_present == false) return PM3_ENOTTY;
+    if (keys == NULL || keyslen == 0 || (keyslen % PM3_MF_KEY_LEN) || keytype > PM3_MF_KEY_B)
+        return PM3_EINVARG;
+
+    // as many keys as fit in one command
+    const size_t chunk = (PM3_CMD_DATA_SIZE - 5) / PM3_MF_KEY_LEN;
+    size_t keycnt = keyslen / PM3_MF_KEY_LEN;
+
+    uint8_t block[chunk * PM3_MF_KEY_LEN];
+    for (size_t i = 0; i < keycnt; i += chunk) {
+        size_t n = MIN(chunk, keycnt - i);
+        memcpy(block, keys + i * PM3_MF_KEY_LEN, n * PM3_MF_KEY_LEN);
+
+        uint64_t key = 0;
+        int res = mfCheckKeys(blockno, keytype, true, n, block, &key);
+        if (res == PM3_ESOFT)
+            continue;
+        if (res != PM3_SUCCESS)
+            return res;
+
+        // device only reports the key, look up its position
+        uint8_t k[PM3_MF_KEY_LEN];
+        num_to_bytes(key, sizeof(k), k);
+        for (size_t j = 0; j < n; j++) {
+            if (memcmp(block + j * PM3_MF_KEY_LEN, k, sizeof(k)) == 0) {
+                if (found) *found = i + j;
+                break;
+            }
+        }
+        return PM3_SUCCESS;
+    }
+    return PM3_ESOFT;
+}
+
+int pm3_mf_check_keys(pm3_device_t *dev, uint8_t blockno, uint8_t keytype, const uint8_t *keys, size_t keyslen, int *found) {
+    pm3_device_t *prev = g_device;
+    UseProxmark(dev);
+    int res = api_mf_check_keys(blockno, keytype, keys, keyslen, found);
+    UseProxmark(prev);
+    return res;
+}
+
+static int api_lf_read(uint32_t samples, uint8_t *buf, size_t buflen, size_t *len) {
+    if (len) *len = 0;
+    if (g_device->pm3_present == false) return PM3_ENOTTY;
+    if (buf == NULL || buflen == 0) return PM3_EINVARG;
+
+    struct p {
+        uint32_t samples : 31;
+        bool     verbose : 1;
+    } PACKED payload;
+    payload.samples = samples;
+    payload.verbose = false;
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_ACQ_RAW_ADC, (uint8_t *)&payload, sizeof(payload));
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_LF_ACQ_RAW_ADC, &resp, 2500) == false) return PM3_ETIMEOUT;
+
+    // response is number of bits read
+    size_t n = MIN(resp.data.asDwords[0] / 8, buflen);
+    if (n == 0) return PM3_SUCCESS;
+
+    // straight into the caller buffer
+    if (GetFromDevice(BIG_BUF, buf, n, 0, NULL, 0, &resp, 10000, false) == false) return PM3_ETIMEOUT;
+
+    uint8_t bps = 8;
+    // Old devices without this feature would send 0 at arg[0]
+    if (resp.oldarg[0] > 0) {
+        const sample_config *sc = (const sample_config *)resp.data.asBytes;
+        if (sc->bits_per_sample > 0 && sc->bits_per_sample < 8)
+            bps = sc->bits_per_sample;
+    }
+
+    if (bps < 8) {
+        // unpack in place, back to front. All samples before j end before
+        // byte j, so no packed bits are overwritten before they are read.
+        size_t cnt = MIN(n * 8 / bps, buflen);
+        for (size_t j = cnt; j-- > 0;) {
+            uint8_t val = 0;
+            size_t pos = j * bps;
+            for (uint8_t i = 0; i < bps; i++, pos++)
+                val |= ((buf[pos >> 3] >> (7 - (pos & 7))) & 1) << (7 - i);
+            buf[j] = val;
+        }
+        n = cnt;
+    }
+
+    if (len) *len = n;
+    return PM3_SUCCESS;
+}
+
+int pm3_lf_read(pm3_device_t *dev, uint32_t samples, uint8_t *buf, size_t buflen, size_t *len) {
+    pm3_device_t *prev = g_device;
+    UseProxmark(dev);
+    int res = api_lf_read(samples, buf, buflen, len);
+    UseProxmark(prev);
+    return res;
+}
+
+static int api_trace_download(uint8_t *buf, size_t buflen, size_t *len) {
+    if (len) *len = 0;
+    if (g_device->pm3_present == false) return PM3_ENOTTY;
+    if (buf == NULL && buflen) return PM3_EINVARG;
+
+    // first chunk tells the trace length
+    uint8_t first[PM3_CMD_DATA_SIZE];
+    PacketResponseNG resp;
+    if (GetFromDevice(BIG_BUF, first, sizeof(first), 0, NULL, 0, &resp, 4000, false) == false) return PM3_ETIMEOUT;
+
+    size_t tracelen = resp.oldarg[2];
+    if (len) *len = tracelen;
+
+    if (tracelen > buflen) return PM3_EOVFLOW;
+
+    if (tracelen > sizeof(first)) {
+        if (GetFromDevice(BIG_BUF, buf, tracelen, 0, NULL, 0, NULL, 2500, false) == false) return PM3_ETIMEOUT;
+    } else if (tracelen) {
+        memcpy(buf, first, tracelen);
+    }
+    return PM3_SUCCESS;
+}
+
+int pm3_trace_download(pm3_device_t *dev, uint8_t *buf, size_t buflen, size_t *len) {
+    pm3_device_t *prev = g_device;
+    UseProxmark(dev);
+    int res = api_trace_download(buf, buflen, len);
+    UseProxmark(prev);
+    return res;
 }
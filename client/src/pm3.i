@@ -8,6 +8,56 @@
 /* Strip "pm3_" from API functions for SWIG */
 %rename("%(strip:[pm3_])s") "";
 %feature("immutable","1") pm3_current_dev;
+
+%include "stdint.i"
+%include "typemaps.i"
+
+/* Structured API: counts come back as extra return values */
+%apply size_t *OUTPUT { size_t *len };
+%apply int *OUTPUT { int *found };
+
+#ifdef SWIGPYTHON
+/* Buffers are passed through the buffer protocol without copies,
+   bytes in, bytearray / memoryview / numpy arrays filled in place */
+%define PM3_PYBUFFER(TYPEMAP, FLAGS)
+%typemap(in) TYPEMAP (Py_buffer view, int got = 0) {
+    if (PyObject_GetBuffer($input, &view, FLAGS) < 0) SWIG_fail;
+    got = 1;
+    $1 = ($1_ltype) view.buf;
+    $2 = ($2_ltype) view.len;
+}
+%typemap(freearg) TYPEMAP {
+    if (got$argnum) PyBuffer_Release(&view$argnum);
+}
+%enddef
+
+PM3_PYBUFFER((const uint8_t *key, size_t keylen), PyBUF_SIMPLE)
+PM3_PYBUFFER((const uint8_t *keys, size_t keyslen), PyBUF_SIMPLE)
+PM3_PYBUFFER((const uint8_t *data, size_t datalen), PyBUF_SIMPLE)
+PM3_PYBUFFER((uint8_t *data, size_t datalen), PyBUF_WRITABLE)
+PM3_PYBUFFER((uint8_t *buf, size_t buflen), PyBUF_WRITABLE)
+
+%typemap(out) uint8_t [ANY] {
+    $result = PyBytes_FromStringAndSize((const char *)$1, $1_dim0);
+}
+#endif
+
+%immutable;
+typedef struct {
+    uint8_t uid[10];
+    uint8_t uidlen;
+    uint8_t atqa[2];
+    uint8_t sak;
+    uint8_t ats_len;
+    uint8_t ats[256];
+} pm3_hf14a_card_t;
+%mutable;
+
+#define PM3_MF_KEY_A        0
+#define PM3_MF_KEY_B        1
+#define PM3_MF_KEY_LEN      6
+#define PM3_MF_BLOCK_LEN    16
+
 typedef struct {
     %extend {
         pm3() {
@@ -32,6 +82,17 @@ typedef struct {
         }
         int console(char *cmd);
         char const * const name;
+
+        int hf14a_select(bool keep_field, pm3_hf14a_card_t *card);
+        int hf_drop_field();
+#ifdef SWIGPYTHON
+        /* only Python has buffer typemaps, the calls below are not wrapped for Lua */
+        int mf_read_block(uint8_t blockno, uint8_t keytype, const uint8_t *key, size_t keylen, uint8_t *data, size_t datalen);
+        int mf_write_block(uint8_t blockno, uint8_t keytype, const uint8_t *key, size_t keylen, const uint8_t *data, size_t datalen);
+        int mf_check_keys(uint8_t blockno, uint8_t keytype, const uint8_t *keys, size_t keyslen, int *found);
+        int lf_read(uint32_t samples, uint8_t *buf, size_t buflen, size_t *len);
+        int trace_download(uint8_t *buf, size_t buflen, size_t *len);
+#endif
     }
 } pm3;
 //%nodefaultctor device;
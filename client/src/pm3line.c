@@ -50,7 +50,7 @@ static char *rl_command_generator(const char *text, int state) {
         // When no pm3 device present
         // and the command is not available offline,
         // we skip it.
-        if ((g_session.pm3_present == false) && (vocabulory[index].offline == false))  {
+        if ((g_device->pm3_present == false) && (vocabulory[index].offline == false))  {
             index++;
             continue;
         }
@@ -87,7 +87,7 @@ static void ln_command_completion(const char *text, linenoiseCompletions *lc) {
         // When no pm3 device present
         // and the command is not available offline,
         // we skip it.
-        if ((g_session.pm3_present == false) && (vocabulory[index].offline == false))  {
+        if ((g_device->pm3_present == false) && (vocabulory[index].offline == false))  {
             index++;
             continue;
         }
@@ -161,6 +161,7 @@ void pm3line_init(void) {
 }
 
 char *pm3line_read(const char *s) {
+    PrintAndLogEx_flush();
 #if defined(HAVE_READLINE)
     return readline(s);
 #elif defined(HAVE_LINENOISE)
@@ -186,6 +187,7 @@ void pm3line_free(void *ref) {
 
 void pm3line_update_prompt(const char *prompt) {
 #if defined(HAVE_READLINE)
+    PrintAndLogEx_flush();
     rl_set_prompt(prompt);
     rl_forced_update_display();
 #else
@@ -727,7 +727,7 @@ static int setCmdDeviceDebug (const char *Cmd)
         showDeviceDebugState (prefShowNone);
     }
 
-    if (g_session.pm3_present) {
+    if (g_device->pm3_present) {
         PrintAndLogEx (INFO,"setting device debug loglevel");
         SendCommandNG(CMD_SET_DBGMODE, &g_session.device_debug_level, 1);
         PacketResponseNG resp;
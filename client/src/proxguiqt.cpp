@@ -45,7 +45,6 @@
 
 extern "C" int preferences_save(void);
 
-static int s_Buff[MAX_GRAPH_TRACE_LEN];
 static bool gs_useOverlays = false;
 static int gs_absVMax = 0;
 static uint32_t startMax; // Maximum offset in the graph (right side of graph)
@@ -348,11 +347,29 @@ void SliderWidget::moveEvent(QMoveEvent *event) {
     g_session.window_changed = true;
 }
 
+// filter previews are drawn from the GRAPH_FILTERED channel.
+// On success the graph is locked, release it with graph_unlock()
+static int16_t *filteredBuffer(void) {
+    if (graph_reserve(GRAPH_FILTERED, g_GraphTraceLen) == false)
+        return NULL;
+    graph_lock();
+    // the trace may have grown in the meantime
+    if (graph_capacity(GRAPH_FILTERED) < g_GraphTraceLen) {
+        graph_unlock();
+        return NULL;
+    }
+    return graph_channel(GRAPH_FILTERED);
+}
+
 //--------------------
 void ProxWidget::applyOperation() {
     //printf("ApplyOperation()");
+    int16_t *filtered = filteredBuffer();
+    if (filtered == NULL)
+        return;
     save_restoreGB(GRAPH_SAVE);
-    memcpy(g_GraphBuffer, s_Buff, sizeof(int) * g_GraphTraceLen);
+    memcpy(g_GraphBuffer, filtered, sizeof(int16_t) * g_GraphTraceLen);
+    graph_unlock();
     RepaintGraphWindow();
 }
 void ProxWidget::stickOperation() {
@@ -360,21 +377,33 @@ void ProxWidget::stickOperation() {
     //printf("stickOperation()");
 }
 void ProxWidget::vchange_autocorr(int v) {
-    int ans = AutoCorrelate(g_GraphBuffer, s_Buff, g_GraphTraceLen, v, true, false);
+    int16_t *filtered = filteredBuffer();
+    if (filtered == NULL)
+        return;
+    int ans = AutoCorrelate(g_GraphBuffer, filtered, g_GraphTraceLen, v, true, false);
+    graph_unlock();
     if (g_debugMode) printf("vchange_autocorr(w:%d): %d\n", v, ans);
     gs_useOverlays = true;
     RepaintGraphWindow();
 }
 void ProxWidget::vchange_askedge(int v) {
-    //extern int AskEdgeDetect(const int *in, int *out, int len, int threshold);
-    int ans = AskEdgeDetect(g_GraphBuffer, s_Buff, g_GraphTraceLen, v);
+    //extern int AskEdgeDetect(const int16_t *in, int16_t *out, int len, int threshold);
+    int16_t *filtered = filteredBuffer();
+    if (filtered == NULL)
+        return;
+    int ans = AskEdgeDetect(g_GraphBuffer, filtered, g_GraphTraceLen, v);
+    graph_unlock();
     if (g_debugMode) printf("vchange_askedge(w:%d)%d\n", v, ans);
     gs_useOverlays = true;
     RepaintGraphWindow();
 }
 void ProxWidget::vchange_dthr_up(int v) {
     int down = opsController->horizontalSlider_dirthr_down->value();
-    directionalThreshold(g_GraphBuffer, s_Buff, g_GraphTraceLen, v, down);
+    int16_t *filtered = filteredBuffer();
+    if (filtered == NULL)
+        return;
+    directionalThreshold(g_GraphBuffer, filtered, g_GraphTraceLen, v, down);
+    graph_unlock();
     //printf("vchange_dthr_up(%d)", v);
     gs_useOverlays = true;
     RepaintGraphWindow();
@@ -382,7 +411,11 @@ void ProxWidget::vchange_dthr_up(int v) {
 void ProxWidget::vchange_dthr_down(int v) {
     //printf("vchange_dthr_down(%d)", v);
     int up = opsController->horizontalSlider_dirthr_up->value();
-    directionalThreshold(g_GraphBuffer, s_Buff, g_GraphTraceLen, v, up);
+    int16_t *filtered = filteredBuffer();
+    if (filtered == NULL)
+        return;
+    directionalThreshold(g_GraphBuffer, filtered, g_GraphTraceLen, v, up);
+    graph_unlock();
     gs_useOverlays = true;
     RepaintGraphWindow();
 }
@@ -543,7 +576,7 @@ QColor Plot::getColor(int graphNum) {
     }
 }
 
-void Plot::setMaxAndStart(int *buffer, size_t len, QRect plotRect) {
+void Plot::setMaxAndStart(const int16_t *buffer, size_t len, QRect plotRect) {
     if (len == 0) return;
     startMax = 0;
     if (plotRect.right() >= plotRect.left() + 40) {
@@ -624,7 +657,7 @@ void Plot::PlotDemod(uint8_t *buffer, size_t len, QRect plotRect, QRect annotati
     painter->drawPath(penPath);
 }
 
-void Plot::PlotGraph(int *buffer, size_t len, QRect plotRect, QRect annotationRect, QPainter *painter, int graphNum) {
+void Plot::PlotGraph(const int16_t *buffer, size_t len, QRect plotRect, QRect annotationRect, QPainter *painter, int graphNum) {
     if (len == 0) return;
     // clock_t begin = clock();
     QPainterPath penPath;
@@ -741,6 +774,9 @@ void Plot::paintEvent(QPaintEvent *event) {
 
     painter.setFont(QFont("Courier New", 10));
 
+    // the client thread may swap the graph stores while we draw them
+    graph_lock();
+
     if (CursorAPos > g_GraphTraceLen)
         CursorAPos = 0;
     if (CursorBPos > g_GraphTraceLen)
@@ -774,11 +810,12 @@ void Plot::paintEvent(QPaintEvent *event) {
     if (g_DemodBufferLen > 8) {
         PlotDemod(g_DemodBuffer, g_DemodBufferLen, plotRect, infoRect, &painter, 2, g_DemodStartIdx);
     }
-    if (gs_useOverlays) {
+    if (gs_useOverlays && graph_capacity(GRAPH_FILTERED) >= g_GraphTraceLen) {
         //init graph variables
-        setMaxAndStart(s_Buff, g_GraphTraceLen, plotRect);
-        PlotGraph(s_Buff, g_GraphTraceLen, plotRect, infoRect, &painter, 1);
+        setMaxAndStart(graph_channel(GRAPH_FILTERED), g_GraphTraceLen, plotRect);
+        PlotGraph(graph_channel(GRAPH_FILTERED), g_GraphTraceLen, plotRect, infoRect, &painter, 1);
     }
+    graph_unlock();
     // End graph drawing
 
     //Draw the cursors
@@ -927,9 +964,11 @@ void Plot::Trim(void) {
         CursorBPos -= lref;
     }
     g_DemodStartIdx -= lref;
+    graph_lock();
     for (uint32_t i = lref; i < rref; ++i)
         g_GraphBuffer[i - lref] = g_GraphBuffer[i];
     g_GraphTraceLen = rref - lref;
+    graph_unlock();
     g_GraphStart = 0;
 }
 
@@ -43,13 +43,13 @@ class Plot: public QWidget {
     double g_GraphPixelsPerPoint; // How many visual pixels are between each sample point (x axis)
     uint32_t CursorAPos;
     uint32_t CursorBPos;
-    void PlotGraph(int *buffer, size_t len, QRect plotRect, QRect annotationRect, QPainter *painter, int graphNum);
+    void PlotGraph(const int16_t *buffer, size_t len, QRect plotRect, QRect annotationRect, QPainter *painter, int graphNum);
     void PlotDemod(uint8_t *buffer, size_t len, QRect plotRect, QRect annotationRect, QPainter *painter, int graphNum, uint32_t plotOffset);
     void plotGridLines(QPainter *painter, QRect r);
     int xCoordOf(int i, QRect r);
     int yCoordOf(int v, QRect r, int maxVal);
     int valueOf_yCoord(int y, QRect r, int maxVal);
-    void setMaxAndStart(int *buffer, size_t len, QRect plotRect);
+    void setMaxAndStart(const int16_t *buffer, size_t len, QRect plotRect);
     QColor getColor(int graphNum);
 
   public:
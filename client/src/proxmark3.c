@@ -134,7 +134,7 @@ static void prompt_compose(char *buf, size_t buflen, const char *promptctx, cons
 
 static int check_comm(void) {
     // If communications thread goes down. Device disconnected then this should hook up PM3 again.
-    if (IsCommunicationThreadDead() && g_session.pm3_present) {
+    if (IsCommunicationThreadDead() && g_device->pm3_present) {
         PrintAndLogEx(INFO, "Running in " _YELLOW_("OFFLINE") " mode. Use "_YELLOW_("\"hw connect\"") " to reconnect\n");
         prompt_dev = PROXPROMPT_DEV_OFFLINE;
         char prompt[PROXPROMPT_MAX_SIZE] = {0};
@@ -267,7 +267,7 @@ main_loop(char *script_cmds_file, char *script_cmd, bool stayInCommandLoop) {
     while (1) {
 
         bool printprompt = false;
-        if (g_session.pm3_present) {
+        if (g_device->pm3_present) {
             if (g_conn.send_via_fpc_usart == false)
                 prompt_dev = PROXPROMPT_DEV_USB;
             else
@@ -426,7 +426,7 @@ check_script:
         }
     } // end while
 
-    if (g_session.pm3_present) {
+    if (g_device->pm3_present) {
         clearCommandBuffer();
         SendCommandNG(CMD_QUIT_SESSION, NULL, 0);
         msleep(100); // Make sure command is sent before killing client
@@ -701,7 +701,7 @@ finish2:
 void pm3_init(void) {
     srand(time(0));
 
-    g_session.pm3_present = false;
+    g_device->pm3_present = false;
     g_session.help_dump_mode = false;
     g_session.incognito = false;
     g_session.supports_colors = false;
@@ -1031,15 +1031,15 @@ int main(int argc, char *argv[]) {
         OpenProxmark(&g_session.current_device, port, waitCOMPort, 20, false, speed);
     }
 
-    if (g_session.pm3_present && (TestProxmark(g_session.current_device) != PM3_SUCCESS)) {
+    if (g_device->pm3_present && (TestProxmark(g_session.current_device) != PM3_SUCCESS)) {
         PrintAndLogEx(ERR, _RED_("ERROR:") " cannot communicate with the Proxmark\n");
         CloseProxmark(g_session.current_device);
     }
 
-    if ((port != NULL) && (!g_session.pm3_present))
+    if ((port != NULL) && (!g_device->pm3_present))
         exit(EXIT_FAILURE);
 
-    if (!g_session.pm3_present)
+    if (!g_device->pm3_present)
         PrintAndLogEx(INFO, "Running in " _YELLOW_("OFFLINE") " mode. Check " _YELLOW_("\"%s -h\"") " if it's not what you want.\n", exec_name);
 
     // ascii art only in interactive client
@@ -1056,7 +1056,7 @@ int main(int argc, char *argv[]) {
     } /* else {
         // Set device debug level
         PrintAndLogEx(INFO,"setting device debug loglevel");
-        if (g_session.pm3_present) {
+        if (g_device->pm3_present) {
            SendCommandNG(CMD_SET_DBGMODE, &g_session.device_debug_level, 1);
            PacketResponseNG resp;
             if (WaitForResponseTimeout(CMD_SET_DBGMODE, &resp, 2000) == false)
@@ -1088,7 +1088,7 @@ int main(int argc, char *argv[]) {
 #endif
 
     // Clean up the port
-    if (g_session.pm3_present) {
+    if (g_device->pm3_present) {
         CloseProxmark(g_session.current_device);
     }
 
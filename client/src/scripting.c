@@ -655,8 +655,7 @@ static int l_crc16legic(lua_State *L) {
     const char *p_uid = luaL_checklstring(L, 2, &uidsize);
     uint16_t uidcrc = CRC8Legic((uint8_t *)p_uid, uidsize);
 
-    init_table(CRC_LEGIC_16);
-    uint16_t retval = crc16_legic((uint8_t *)p_hexstr, hexsize, uidcrc);
+    uint16_t retval = crc16_legic16((uint8_t *)p_hexstr, hexsize, uidcrc);
     lua_pushunsigned(L, retval);
     return 1;
 }
@@ -38,6 +38,7 @@
 #include "proxmark3.h"  // PROXLOG
 #include "fileutils.h"
 #include "pm3_cmd.h"
+#include "util_posix.h"  // msleep
 
 #ifdef _WIN32
 # include <direct.h>    // _mkdir
@@ -60,7 +61,11 @@ bool g_GridLocked = false;
 
 pthread_mutex_t g_print_lock = PTHREAD_MUTEX_INITIALIZER;
 
-static void fPrintAndLog(FILE *stream, const char *fmt, ...);
+#define PRINT_LINE_STDERR       0x01
+#define PRINT_LINE_NOLF         0x02
+#define PRINT_LINE_INPLACE      0x04
+
+static void print_line_post(FILE *stream, uint8_t flags, const char *text);
 
 // needed by flasher, so let's put it here instead of fileutils.c
 int searchHomeFilePath(char **foundpath, const char *subdir, const char *filename, bool create_home) {
@@ -187,6 +192,52 @@ void PrintAndLogOptions(const char *str[][2], size_t size, size_t space) {
 
 static uint8_t PrintAndLogEx_spinidx = 0;
 
+static __thread print_capture_t *s_capture = NULL;
+
+void PrintAndLogEx_capture(print_capture_t *cap) {
+    s_capture = cap;
+}
+
+static void print_capture_add(print_capture_t *cap, logLevel_t level, const char *line) {
+    if (cap->count == cap->size) {
+        size_t size = (cap->size) ? cap->size * 2 : 16;
+        logLevel_t *levels = realloc(cap->levels, size * sizeof(logLevel_t));
+        if (levels == NULL)
+            return;
+        cap->levels = levels;
+
+        char **lines = realloc(cap->lines, size * sizeof(char *));
+        if (lines == NULL)
+            return;
+        cap->lines = lines;
+        cap->size = size;
+    }
+
+    size_t len = strlen(line) + 1;
+    char *copy = malloc(len);
+    if (copy == NULL)
+        return;
+    memcpy(copy, line, len);
+
+    cap->levels[cap->count] = level;
+    cap->lines[cap->count] = copy;
+    cap->count++;
+}
+
+void PrintAndLogEx_capture_free(print_capture_t *cap) {
+    for (size_t i = 0; i < cap->count; i++)
+        free(cap->lines[i]);
+    free(cap->levels);
+    free(cap->lines);
+    memset(cap, 0, sizeof(print_capture_t));
+}
+
+void PrintAndLogEx_replay(print_capture_t *cap) {
+    for (size_t i = 0; i < cap->count; i++)
+        PrintAndLogEx(cap->levels[i], "%s", cap->lines[i]);
+    PrintAndLogEx_capture_free(cap);
+}
+
 void PrintAndLogEx(logLevel_t level, const char *fmt, ...) {
 
     // skip debug messages if client debugging is turned off i.e. 'DATA SETDEBUG -0'
@@ -197,6 +248,16 @@ void PrintAndLogEx(logLevel_t level, const char *fmt, ...) {
     if (g_session.show_hints == false && level == HINT)
         return;
 
+    if (s_capture) {
+        char line[MAX_PRINT_BUFFER] = {0};
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(line, sizeof(line), fmt, args);
+        va_end(args);
+        print_capture_add(s_capture, level, line);
+        return;
+    }
+
     char prefix[40] = {0};
     char buffer[MAX_PRINT_BUFFER] = {0};
     char buffer2[MAX_PRINT_BUFFER + sizeof(prefix)] = {0};
@@ -264,7 +325,7 @@ void PrintAndLogEx(logLevel_t level, const char *fmt, ...) {
 
     // no prefixes for normal & inplace
     if (level == NORMAL) {
-        fPrintAndLog(stream, "%s", buffer);
+        print_line_post(stream, 0, buffer);
         return;
     }
 
@@ -274,7 +335,7 @@ void PrintAndLogEx(logLevel_t level, const char *fmt, ...) {
 
         // line starts with newline
         if (buffer[0] == '\n')
-            fPrintAndLog(stream, "");
+            print_line_post(stream, 0, "");
 
         token = strtok_r(buffer, delim, &tmp_ptr);
 
@@ -289,129 +350,426 @@ void PrintAndLogEx(logLevel_t level, const char *fmt, ...) {
 
             token = strtok_r(NULL, delim, &tmp_ptr);
         }
-        fPrintAndLog(stream, "%s", buffer2);
+        print_line_post(stream, 0, buffer2);
+    } else if (level == INPLACE) {
+        snprintf(buffer2, sizeof(buffer2), "\r%s%s", prefix, buffer);
+        print_line_post(stream, PRINT_LINE_INPLACE | PRINT_LINE_NOLF, buffer2);
     } else {
         snprintf(buffer2, sizeof(buffer2), "%s%s", prefix, buffer);
-        if (level == INPLACE) {
-            char buffer3[sizeof(buffer2)] = {0};
-            char buffer4[sizeof(buffer2)] = {0};
-            memcpy_filter_ansi(buffer3, buffer2, sizeof(buffer2), !g_session.supports_colors);
-            memcpy_filter_emoji(buffer4, buffer3, sizeof(buffer3), g_session.emoji_mode);
-            fprintf(stream, "\r%s", buffer4);
-            fflush(stream);
-        } else {
-            fPrintAndLog(stream, "%s", buffer2);
-        }
+        print_line_post(stream, 0, buffer2);
     }
 }
 
-static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
-    va_list argptr;
-    static FILE *logfile = NULL;
-    static int logging = 1;
-    char buffer[MAX_PRINT_BUFFER] = {0};
-    char buffer2[MAX_PRINT_BUFFER] = {0};
-    char buffer3[MAX_PRINT_BUFFER] = {0};
-    // lock this section to avoid interlacing prints from different threads
-    pthread_mutex_lock(&g_print_lock);
-    bool linefeed = true;
-
-    if (logging && g_session.incognito) {
-        logging = 0;
-    }
-    if ((g_printAndLog & PRINTANDLOG_LOG) && logging && !logfile) {
-        char *my_logfile_path = NULL;
-        char filename[40];
-        struct tm *timenow;
-        time_t now = time(NULL);
-        timenow = gmtime(&now);
-        strftime(filename, sizeof(filename), PROXLOG, timenow);
-        if (searchHomeFilePath(&my_logfile_path, LOGS_SUBDIR, filename, true) != PM3_SUCCESS) {
-            printf(_YELLOW_("[-]") " Logging disabled!\n");
-            my_logfile_path = NULL;
-            logging = 0;
-        } else {
-            logfile = fopen(my_logfile_path, "a");
-            if (logfile == NULL) {
-                printf(_YELLOW_("[-]") " Can't open logfile %s, logging disabled!\n", my_logfile_path);
-                logging = 0;
-            } else {
+// PrintAndLogEx only formats a line and queues it, a writer thread does the slow
+// part: filtering, console and logfile output. Producers reserve a slot in a bounded
+// multi producer / single consumer ring without taking a lock and publish it through
+// the slot sequence number. The sinks are flushed in batches instead of every line.
+#define PRINT_QUEUE_SIZE        256     // lines, must be a power of 2
+#define PRINT_BATCH             64      // lines written between two flushes of the sinks
+
+typedef struct {
+    uint32_t seq;
+    uint8_t flags;
+    uint8_t printandlog;    // g_printAndLog at the time the line was printed
+    uint16_t len;
+    char text[MAX_PRINT_BUFFER + 40];
+} print_line_t;
+
+static print_line_t s_print_queue[PRINT_QUEUE_SIZE];
+static uint32_t s_print_head = 0;       // next slot to reserve, all producers
+static uint32_t s_print_tail = 0;       // only written by the writer
+static uint32_t s_print_done = 0;       // lines written so far
+static bool s_print_idle = false;       // writer sleeps, waiting for lines
+static uint32_t s_print_flushing = 0;   // threads waiting in PrintAndLogEx_flush
+static bool s_print_stop = false;
+static bool s_print_async = true;
+static bool s_print_running = false;
+static pthread_t s_print_thread;
+static pthread_once_t s_print_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t s_print_sig_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_print_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t s_print_written = PTHREAD_COND_INITIALIZER;
+static FILE *s_print_stream = NULL;     // scratch file replacing the console, see PrintAndLogEx_scratch
+
+static FILE *s_logfile = NULL;
+static int s_logging = 1;
+
+static void print_timeout(struct timespec *ts, uint32_t ms) {
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
 
-                if (g_session.supports_colors) {
-                    printf("["_YELLOW_("=")"] Session log " _YELLOW_("%s") "\n", my_logfile_path);
-                } else {
-                    printf("[=] Session log %s\n", my_logfile_path);
-                }
+static void print_wake_writer(void) {
+    if (__atomic_load_n(&s_print_idle, __ATOMIC_SEQ_CST) == false) {
+        return;
+    }
+    pthread_mutex_lock(&s_print_sig_lock);
+    pthread_cond_signal(&s_print_wake);
+    pthread_mutex_unlock(&s_print_sig_lock);
+}
+
+static bool print_queue_ready(void) {
+    const print_line_t *line = &s_print_queue[s_print_tail & (PRINT_QUEUE_SIZE - 1)];
+    return __atomic_load_n(&line->seq, __ATOMIC_SEQ_CST) == s_print_tail + 1;
+}
 
+static void print_logfile_open(void) {
+    if (s_logging && g_session.incognito) {
+        s_logging = 0;
+    }
+    if (s_logging == 0 || s_logfile) {
+        return;
+    }
+
+    char *my_logfile_path = NULL;
+    char filename[40];
+    struct tm *timenow;
+    time_t now = time(NULL);
+    timenow = gmtime(&now);
+    strftime(filename, sizeof(filename), PROXLOG, timenow);
+    if (searchHomeFilePath(&my_logfile_path, LOGS_SUBDIR, filename, true) != PM3_SUCCESS) {
+        printf(_YELLOW_("[-]") " Logging disabled!\n");
+        my_logfile_path = NULL;
+        s_logging = 0;
+    } else {
+        s_logfile = fopen(my_logfile_path, "a");
+        if (s_logfile == NULL) {
+            printf(_YELLOW_("[-]") " Can't open logfile %s, logging disabled!\n", my_logfile_path);
+            s_logging = 0;
+        } else {
+
+            if (g_session.supports_colors) {
+                printf("["_YELLOW_("=")"] Session log " _YELLOW_("%s") "\n", my_logfile_path);
+            } else {
+                printf("[=] Session log %s\n", my_logfile_path);
             }
-            free(my_logfile_path);
+
         }
+        free(my_logfile_path);
     }
-
+}
 
 // If there is an incoming message from the hardware (eg: lf hid read) in
 // the background (while the prompt is displayed and accepting user input),
 // stash the prompt and bring it back later.
 #ifdef RL_STATE_READCMD
-    // We are using GNU readline. libedit (OSX) doesn't support this flag.
-    int need_hack = (rl_readline_state & RL_STATE_READCMD) > 0;
-    char *saved_line;
-    int saved_point;
+static char *s_rl_saved_line = NULL;
+static int s_rl_saved_point;
+#endif
 
-    if (need_hack) {
-        saved_point = rl_point;
-        saved_line = rl_copy_text(0, rl_end);
-        rl_save_prompt();
-        rl_replace_line("", 0);
-        rl_redisplay();
+static bool print_prompt_stash(void) {
+#ifdef RL_STATE_READCMD
+    // We are using GNU readline. libedit (OSX) doesn't support this flag.
+    if ((rl_readline_state & RL_STATE_READCMD) == 0) {
+        return false;
     }
+    s_rl_saved_point = rl_point;
+    s_rl_saved_line = rl_copy_text(0, rl_end);
+    rl_save_prompt();
+    rl_replace_line("", 0);
+    rl_redisplay();
+    return true;
+#else
+    return false;
 #endif
+}
+
+static void print_prompt_restore(void) {
+#ifdef RL_STATE_READCMD
+    rl_restore_prompt();
+    rl_replace_line(s_rl_saved_line, 0);
+    rl_point = s_rl_saved_point;
+    rl_redisplay();
+    free(s_rl_saved_line);
+    s_rl_saved_line = NULL;
+#endif
+}
 
-    va_start(argptr, fmt);
-    vsnprintf(buffer, sizeof(buffer), fmt, argptr);
-    va_end(argptr);
-    if (strlen(buffer) > 0 && buffer[strlen(buffer) - 1] == NOLF[0]) {
-        linefeed = false;
-        buffer[strlen(buffer) - 1] = 0;
+// Writes one line to the console and the logfile, caller holds g_print_lock.
+// The ANSI and emoji filters only run if the sink needs them and the line holds
+// something to filter.
+static void print_line_write(const print_line_t *line) {
+    static char buffer[MAX_PRINT_BUFFER + 40];
+    static char buffer2[2 * (MAX_PRINT_BUFFER + 40)];
+
+    const char *text = line->text;
+    size_t len = line->len;
+    bool has_esc = memchr(text, '\x1b', len) != NULL;
+    bool has_colon = memchr(text, ':', len) != NULL;
+    bool filter_ansi = !g_session.supports_colors && has_esc;
+
+    if (line->printandlog & PRINTANDLOG_PRINT) {
+        FILE *stream = s_print_stream ? s_print_stream : (line->flags & PRINT_LINE_STDERR) ? stderr : stdout;
+        const char *out = text;
+        if (filter_ansi) {
+            memcpy_filter_ansi(buffer, out, len + 1, true);
+            out = buffer;
+        }
+        if (g_session.emoji_mode != EMO_ALIAS && has_colon) {
+            memcpy_filter_emoji(buffer2, out, strlen(out) + 1, g_session.emoji_mode);
+            out = buffer2;
+        }
+        fputs(out, stream);
+        if ((line->flags & PRINT_LINE_NOLF) == 0)
+            fputc('\n', stream);
+        if (line->flags & PRINT_LINE_INPLACE)
+            fflush(stream);
     }
-    bool filter_ansi = !g_session.supports_colors;
-    memcpy_filter_ansi(buffer2, buffer, sizeof(buffer), filter_ansi);
-    if (g_printAndLog & PRINTANDLOG_PRINT) {
-        memcpy_filter_emoji(buffer3, buffer2, sizeof(buffer2), g_session.emoji_mode);
-        fprintf(stream, "%s", buffer3);
-        if (linefeed)
-            fprintf(stream, "\n");
+
+    if ((line->printandlog & PRINTANDLOG_LOG) == 0) {
+        return;
     }
 
-#ifdef RL_STATE_READCMD
-    // We are using GNU readline. libedit (OSX) doesn't support this flag.
-    if (need_hack) {
-        rl_restore_prompt();
-        rl_replace_line(saved_line, 0);
-        rl_point = saved_point;
-        rl_redisplay();
-        free(saved_line);
+    print_logfile_open();
+    if (s_logfile == NULL) {
+        return;
+    }
+
+    const char *out = text;
+    if (has_colon) {
+        memcpy_filter_emoji(buffer2, out, len + 1, EMO_ALTTEXT);
+        out = buffer2;
+    }
+    if (has_esc) {
+        memcpy_filter_ansi(buffer, out, strlen(out) + 1, true);
+        out = buffer;
+    }
+    fputs(out, s_logfile);
+    if ((line->flags & PRINT_LINE_NOLF) == 0)
+        fputc('\n', s_logfile);
+}
+
+static void print_sinks_flush(void) {
+    fflush(s_print_stream ? s_print_stream : stdout);
+    if (s_logfile)
+        fflush(s_logfile);
+}
+
+static void *print_writer_thread(void *arg) {
+    (void)arg;
+
+    for (;;) {
+        if (print_queue_ready() == false) {
+            if (__atomic_load_n(&s_print_stop, __ATOMIC_SEQ_CST)) {
+                break;
+            }
+            struct timespec ts;
+            print_timeout(&ts, 10);
+            pthread_mutex_lock(&s_print_sig_lock);
+            __atomic_store_n(&s_print_idle, true, __ATOMIC_SEQ_CST);
+            // re-check after announcing ourselves, producers check `idle` after publishing
+            if (print_queue_ready() == false && __atomic_load_n(&s_print_stop, __ATOMIC_SEQ_CST) == false) {
+                pthread_cond_timedwait(&s_print_wake, &s_print_sig_lock, &ts);
+            }
+            __atomic_store_n(&s_print_idle, false, __ATOMIC_SEQ_CST);
+            pthread_mutex_unlock(&s_print_sig_lock);
+            continue;
+        }
+
+        pthread_mutex_lock(&g_print_lock);
+        bool stashed = false;
+        int n = 0;
+        while (n < PRINT_BATCH && print_queue_ready()) {
+            print_line_t *line = &s_print_queue[s_print_tail & (PRINT_QUEUE_SIZE - 1)];
+            // in-place lines are progress updates, keep them off a prompt which is being edited
+            if (stashed == false && (line->flags & PRINT_LINE_INPLACE) == 0) {
+                stashed = print_prompt_stash();
+            }
+            print_line_write(line);
+            __atomic_store_n(&line->seq, s_print_tail + PRINT_QUEUE_SIZE, __ATOMIC_SEQ_CST);
+            s_print_tail++;
+            n++;
+        }
+        if (stashed) {
+            print_prompt_restore();
+        }
+        print_sinks_flush();
+        pthread_mutex_unlock(&g_print_lock);
+
+        __atomic_store_n(&s_print_done, s_print_tail, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&s_print_flushing, __ATOMIC_SEQ_CST)) {
+            pthread_mutex_lock(&s_print_sig_lock);
+            pthread_cond_broadcast(&s_print_written);
+            pthread_mutex_unlock(&s_print_sig_lock);
+        }
+    }
+    return NULL;
+}
+
+static void print_writer_stop(void) {
+    PrintAndLogEx_flush();
+    __atomic_store_n(&s_print_async, false, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&s_print_stop, true, __ATOMIC_SEQ_CST);
+    pthread_mutex_lock(&s_print_sig_lock);
+    pthread_cond_signal(&s_print_wake);
+    pthread_mutex_unlock(&s_print_sig_lock);
+    pthread_join(s_print_thread, NULL);
+}
+
+static void print_writer_start(void) {
+    for (uint32_t i = 0; i < PRINT_QUEUE_SIZE; i++)
+        s_print_queue[i].seq = i;
+
+    if (pthread_create(&s_print_thread, NULL, print_writer_thread, NULL) != 0) {
+        // keep printing synchronously
+        return;
+    }
+    atexit(print_writer_stop);
+    __atomic_store_n(&s_print_running, true, __ATOMIC_SEQ_CST);
+}
+
+static void print_line_sync(print_line_t *line) {
+    // lines queued before asynchronous printing got turned off go first
+    if (__atomic_load_n(&s_print_running, __ATOMIC_SEQ_CST))
+        PrintAndLogEx_flush();
+
+    // lock this section to avoid interlacing prints from different threads
+    pthread_mutex_lock(&g_print_lock);
+    bool stashed = false;
+    if ((line->flags & PRINT_LINE_INPLACE) == 0) {
+        stashed = print_prompt_stash();
+    }
+    print_line_write(line);
+    if (stashed) {
+        print_prompt_restore();
+    }
+    if (s_logfile)
+        fflush(s_logfile);
+    if (flushAfterWrite)
+        fflush(stdout);
+    pthread_mutex_unlock(&g_print_lock);
+}
+
+// Hands a formatted line over to the writer thread, or writes it directly when
+// asynchronous printing is off or the thread could not be started
+static void print_line_post(FILE *stream, uint8_t flags, const char *text) {
+    size_t len = strlen(text);
+    if (len >= sizeof(((print_line_t *)0)->text))
+        len = sizeof(((print_line_t *)0)->text) - 1;
+
+    if (stream == stderr)
+        flags |= PRINT_LINE_STDERR;
+    if (len && text[len - 1] == NOLF[0]) {
+        flags |= PRINT_LINE_NOLF;
+        len--;
+    }
+    // in-place lines never made it into the logfile
+    uint8_t printandlog = (flags & PRINT_LINE_INPLACE) ? PRINTANDLOG_PRINT : g_printAndLog;
+
+    if (__atomic_load_n(&s_print_async, __ATOMIC_SEQ_CST)) {
+        pthread_once(&s_print_once, print_writer_start);
+    }
+    if (__atomic_load_n(&s_print_async, __ATOMIC_SEQ_CST) == false || __atomic_load_n(&s_print_running, __ATOMIC_SEQ_CST) == false) {
+        print_line_t line = {.flags = flags, .printandlog = printandlog, .len = len};
+        memcpy(line.text, text, len);
+        line.text[len] = '\0';
+        print_line_sync(&line);
+        return;
     }
-#endif
 
-    if ((g_printAndLog & PRINTANDLOG_LOG) && logging && logfile) {
-        memcpy_filter_emoji(buffer3, buffer2, sizeof(buffer2), EMO_ALTTEXT);
-        if (filter_ansi) { // already done
-            fprintf(logfile, "%s", buffer3);
+    // reserve a slot, it is ours once the sequence number equals the position
+    print_line_t *line;
+    uint32_t pos = __atomic_load_n(&s_print_head, __ATOMIC_RELAXED);
+    for (;;) {
+        line = &s_print_queue[pos & (PRINT_QUEUE_SIZE - 1)];
+        int32_t dif = (int32_t)(__atomic_load_n(&line->seq, __ATOMIC_ACQUIRE) - pos);
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&s_print_head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (dif < 0) {
+            // queue is full, back pressure
+            print_wake_writer();
+            msleep(1);
+            pos = __atomic_load_n(&s_print_head, __ATOMIC_RELAXED);
         } else {
-            memcpy_filter_ansi(buffer, buffer3, sizeof(buffer3), true);
-            fprintf(logfile, "%s", buffer);
+            pos = __atomic_load_n(&s_print_head, __ATOMIC_RELAXED);
         }
-        if (linefeed)
-            fprintf(logfile, "\n");
-        fflush(logfile);
     }
 
+    line->flags = flags;
+    line->printandlog = printandlog;
+    line->len = len;
+    memcpy(line->text, text, len);
+    line->text[len] = '\0';
+    __atomic_store_n(&line->seq, pos + 1, __ATOMIC_SEQ_CST);
+
+    print_wake_writer();
+
     if (flushAfterWrite)
+        PrintAndLogEx_flush();
+}
+
+void PrintAndLogEx_flush(void) {
+    if (__atomic_load_n(&s_print_running, __ATOMIC_SEQ_CST) == false) {
         fflush(stdout);
+        return;
+    }
+
+    uint32_t target = __atomic_load_n(&s_print_head, __ATOMIC_SEQ_CST);
+    while ((int32_t)(__atomic_load_n(&s_print_done, __ATOMIC_SEQ_CST) - target) < 0) {
+        print_wake_writer();
+
+        struct timespec ts;
+        print_timeout(&ts, 10);
+        pthread_mutex_lock(&s_print_sig_lock);
+        __atomic_add_fetch(&s_print_flushing, 1, __ATOMIC_SEQ_CST);
+        if ((int32_t)(__atomic_load_n(&s_print_done, __ATOMIC_SEQ_CST) - target) < 0) {
+            pthread_cond_timedwait(&s_print_written, &s_print_sig_lock, &ts);
+        }
+        __atomic_sub_fetch(&s_print_flushing, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&s_print_sig_lock);
+    }
+}
+
+int PrintAndLogEx_scratch(bool enable, uint32_t *lines) {
+    PrintAndLogEx_flush();
 
-    //release lock
+    if (enable) {
+        FILE *f = tmpfile();
+        if (f == NULL)
+            return PM3_EFILE;
+        pthread_mutex_lock(&g_print_lock);
+        s_print_stream = f;
+        pthread_mutex_unlock(&g_print_lock);
+        return PM3_SUCCESS;
+    }
+
+    pthread_mutex_lock(&g_print_lock);
+    FILE *f = s_print_stream;
+    s_print_stream = NULL;
     pthread_mutex_unlock(&g_print_lock);
+    if (f == NULL)
+        return PM3_EINVARG;
+
+    uint32_t count = 0;
+    char buf[4096];
+    size_t n;
+    rewind(f);
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            count += (buf[i] == '\n');
+        }
+    }
+    fclose(f);
+
+    if (lines)
+        *lines = count;
+    return PM3_SUCCESS;
+}
+
+void SetAsyncPrint(bool value) {
+    if (value == false)
+        PrintAndLogEx_flush();
+    __atomic_store_n(&s_print_async, value, __ATOMIC_SEQ_CST);
+}
+
+bool GetAsyncPrint(void) {
+    return __atomic_load_n(&s_print_async, __ATOMIC_SEQ_CST);
 }
 
 void SetFlushAfterWrite(bool value) {
@@ -624,7 +982,7 @@ void iceIIR_Butterworth(int *data, const size_t len) {
 }
 */
 
-void iceSimple_Filter(int *data, const size_t len, uint8_t k) {
+void iceSimple_Filter(int16_t *data, const size_t len, uint8_t k) {
 // ref: http://www.edn.com/design/systems-design/4320010/A-simple-software-lowpass-filter-suits-embedded-system-applications
 // parameter K
 #define FILTER_SHIFT 4
@@ -719,6 +1077,9 @@ void print_progress(size_t count, uint64_t max, barMode_t style) {
         snprintf(cbar,  collen,  "%s", bar);
     }
 
+    // the bar is drawn directly, let the queued lines out first
+    PrintAndLogEx_flush();
+
     size_t olen = strlen(cbar) + 40;
     char *out = (char *)calloc(olen, sizeof(uint8_t));
 
@@ -44,7 +44,6 @@ typedef struct {
     bool stdoutOnTTY;
     bool supports_colors;
     emojiMode_t emoji_mode;
-    bool pm3_present;
     bool help_dump_mode;
     bool show_hints;
     bool window_changed; // track if plot/overlay pos/size changed to save on exit
@@ -70,6 +69,29 @@ extern session_arg_t g_session;
 #define PROMPT_CLEARLINE PrintAndLogEx(INPLACE, "                                          \r")
 void PrintAndLogOptions(const char *str[][2], size_t size, size_t space);
 void PrintAndLogEx(logLevel_t level, const char *fmt, ...);
+
+// Output of a thread held back to be printed later in one piece, lets
+// commands running work in parallel keep their output in order.
+typedef struct {
+    logLevel_t *levels;
+    char **lines;
+    size_t count;
+    size_t size;
+} print_capture_t;
+
+void PrintAndLogEx_capture(print_capture_t *cap);   // NULL prints directly again
+void PrintAndLogEx_replay(print_capture_t *cap);    // prints and frees the captured lines
+void PrintAndLogEx_capture_free(print_capture_t *cap);
+
+// Lines are written by a background thread. Flush before writing to stdout
+// directly or prompting the user, so the queued lines come out first.
+void PrintAndLogEx_flush(void);
+// Console output goes to a scratch file while enabled, for benchmarks. Disabling
+// it returns the number of lines which got written there.
+int PrintAndLogEx_scratch(bool enable, uint32_t *lines);
+void SetAsyncPrint(bool value);                     // false writes every line from the calling thread
+bool GetAsyncPrint(void);
+
 void SetFlushAfterWrite(bool value);
 bool GetFlushAfterWrite(void);
 void memcpy_filter_ansi(void *dest, const void *src, size_t n, bool filter);
@@ -83,7 +105,7 @@ extern pthread_mutex_t g_print_lock;
 void print_progress(size_t count, uint64_t max, barMode_t style);
 
 void iceIIR_Butterworth(int *data, const size_t len);
-void iceSimple_Filter(int *data, const size_t len, uint8_t k);
+void iceSimple_Filter(int16_t *data, const size_t len, uint8_t k);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,17 @@
+#include "common.h"
+/* Generated file, do not edit */
+#ifndef ON_DEVICE
+#define SECTVERSINFO
+#else
+#define SECTVERSINFO __attribute__((section(".version_information")))
+#endif
+
+const struct version_information_t SECTVERSINFO g_version_information = {
+    VERSION_INFORMATION_MAGIC,
+    1,
+    1,
+    0,
+    "Iceman/master/fce67c6-dirty",
+    "2026-10-16 23:23:53",
+    "7cf20b689"
+};
@@ -27,17 +27,18 @@ extern void bucket_sort_intersect(uint32_t *const estart, uint32_t *const estop,
     start[1] = ostart;
     stop[1] = ostop;
 
-    // init buckets to be empty
-    for (uint32_t i = 0; i < 2; i++) {
-        for (uint32_t j = 0x00; j <= 0xff; j++) {
-            bucket[i][j].bp = bucket[i][j].head;
-        }
-    }
-
-    // sort the lists into the buckets based on the MSB (contribution bits)
+    // sort the lists into the buckets based on the MSB (contribution bits).
+    // Deep in the recursion the lists are short, so only buckets actually used are
+    // reset and visited. used[] keeps track of them, one bit per bucket.
+    uint32_t used[2][8] = {{0}};
     for (uint32_t i = 0; i < 2; i++) {
         for (p1 = start[i]; p1 <= stop[i]; p1++) {
             uint32_t bucket_index = (*p1 & 0xff000000) >> 24;
+            uint32_t bit = 1U << (bucket_index & 0x1f);
+            if ((used[i][bucket_index >> 5] & bit) == 0) {
+                used[i][bucket_index >> 5] |= bit;
+                bucket[i][bucket_index].bp = bucket[i][bucket_index].head;
+            }
             *(bucket[i][bucket_index].bp++) = *p1;
         }
     }
@@ -47,8 +48,11 @@ extern void bucket_sort_intersect(uint32_t *const estart, uint32_t *const estop,
     for (uint32_t i = 0; i < 2; i++) {
         p1 = start[i];
         uint32_t nonempty_bucket = 0;
-        for (uint32_t j = 0x00; j <= 0xff; j++) {
-            if (bucket[0][j].bp != bucket[0][j].head && bucket[1][j].bp != bucket[1][j].head) { // non-empty intersecting buckets only
+        for (uint32_t w = 0; w < 8; w++) {
+            uint32_t intersecting = used[0][w] & used[1][w]; // non-empty intersecting buckets only
+            while (intersecting) {
+                uint32_t j = (w << 5) | __builtin_ctz(intersecting);
+                intersecting &= intersecting - 1;
                 bucket_info->bucket_info[i][nonempty_bucket].head = p1;
                 for (p2 = bucket[i][j].head; p2 < bucket[i][j].bp; *p1++ = *p2++);
                 bucket_info->bucket_info[i][nonempty_bucket].tail = p1 - 1;
@@ -19,8 +19,18 @@
 #include "bucketsort.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include "parity.h"
 
+// AVX2 kernels for the table extension and the prefix search, picked at runtime
+#if !defined LOWMEM && defined __GNUC__ && (defined __x86_64__ || defined __i386__) && !defined __OPTIMIZE_SIZE__
+#define CRAPTO1_AVX2
+#include <immintrin.h>
+#endif
+
+// tables shorter than this are extended in place, longer ones through a buffer
+#define EXTEND_BUFFERED_MIN 64
+
 #if !defined LOWMEM && defined __GNUC__
 static uint8_t filterlut[1 << 20];
 static void __attribute__((constructor)) fill_lut(void) {
@@ -77,13 +87,214 @@ static inline void extend_table_simple(uint32_t *tbl, uint32_t **end, int bit) {
         }
     }
 }
+/** extend_table_generic
+ * same as extend_table / extend_table_simple (contribution == false), but writes
+ * the extended table to out, keeping the order of the states. Returns the new end of out
+ */
+static uint32_t *extend_table_generic(const uint32_t *tbl, const uint32_t *end, uint32_t *out, int bit, uint32_t m1, uint32_t m2, uint32_t in, bool contribution) {
+    in <<= 24;
+    for (; tbl <= end; tbl++) {
+        uint32_t x = *tbl << 1;
+        if (filter(x) ^ filter(x | 1)) {          // replace
+            x |= filter(x) ^ bit;
+            if (contribution) {
+                update_contribution(&x, m1, m2);
+                x ^= in;
+            }
+            *out++ = x;
+        } else if (filter(x) == bit) {            // insert
+            uint32_t y = x | 1;
+            if (contribution) {
+                update_contribution(&x, m1, m2);
+                update_contribution(&y, m1, m2);
+                x ^= in;
+                y ^= in;
+            }
+            *out++ = x;
+            *out++ = y;
+        }                                         // else drop
+    }
+    return out;
+}
+
+typedef uint32_t *(*extend_table_kernel_t)(const uint32_t *, const uint32_t *, uint32_t *, int, uint32_t, uint32_t, uint32_t, bool);
+static extend_table_kernel_t extend_table_kernel = extend_table_generic;
+
+#ifdef CRAPTO1_AVX2
+// permutation indices to move the selected lanes of a vector to the front
+static uint32_t compress_lut[256][8];
+
+__attribute__((target("avx2")))
+static inline __m256i filter_avx2(__m256i x) {
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i nibble = _mm256_set1_epi32(0xf);
+    const __m256i fa = _mm256_set1_epi32(0xf22c);
+    const __m256i fb = _mm256_set1_epi32(0xd938);
+
+    __m256i f = _mm256_slli_epi32(_mm256_and_si256(_mm256_srlv_epi32(fa, _mm256_and_si256(x, nibble)), one), 4);
+    f = _mm256_or_si256(f, _mm256_slli_epi32(_mm256_and_si256(_mm256_srlv_epi32(fb, _mm256_and_si256(_mm256_srli_epi32(x, 4), nibble)), one), 3));
+    f = _mm256_or_si256(f, _mm256_slli_epi32(_mm256_and_si256(_mm256_srlv_epi32(fa, _mm256_and_si256(_mm256_srli_epi32(x, 8), nibble)), one), 2));
+    f = _mm256_or_si256(f, _mm256_slli_epi32(_mm256_and_si256(_mm256_srlv_epi32(fa, _mm256_and_si256(_mm256_srli_epi32(x, 12), nibble)), one), 1));
+    f = _mm256_or_si256(f, _mm256_and_si256(_mm256_srlv_epi32(fb, _mm256_and_si256(_mm256_srli_epi32(x, 16), nibble)), one));
+    return _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(0xEC57E80A), f), one);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i evenparity_avx2(__m256i x) {
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 8));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 4));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 2));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 1));
+    return _mm256_and_si256(x, _mm256_set1_epi32(1));
+}
+
+// vector version of update_contribution, parities are given
+__attribute__((target("avx2")))
+static inline __m256i update_contribution_avx2(__m256i x, __m256i p1, __m256i p2) {
+    __m256i p = _mm256_slli_epi32(_mm256_srli_epi32(x, 25), 2);
+    p = _mm256_or_si256(p, _mm256_or_si256(_mm256_slli_epi32(p1, 1), p2));
+    return _mm256_or_si256(_mm256_slli_epi32(p, 24), _mm256_and_si256(x, _mm256_set1_epi32(0xffffff)));
+}
+
+// store the lanes of v selected by mask contiguously at out
+__attribute__((target("avx2,popcnt")))
+static inline uint32_t *compress_store_avx2(uint32_t *out, __m256i v, uint32_t mask) {
+    __m256i idx = _mm256_loadu_si256((const __m256i *)compress_lut[mask]);
+    _mm256_storeu_si256((__m256i *)out, _mm256_permutevar8x32_epi32(v, idx));
+    return out + __builtin_popcount(mask);
+}
+
+__attribute__((target("avx2,popcnt")))
+static uint32_t *extend_table_avx2(const uint32_t *tbl, const uint32_t *end, uint32_t *out, int bit, uint32_t m1, uint32_t m2, uint32_t in, bool contribution) {
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i vbit = _mm256_set1_epi32(bit);
+    const __m256i vm1 = _mm256_set1_epi32(m1);
+    const __m256i vm2 = _mm256_set1_epi32(m2);
+    const __m256i vm1_lsb = _mm256_set1_epi32(m1 & 1);
+    const __m256i vm2_lsb = _mm256_set1_epi32(m2 & 1);
+    const __m256i vin = _mm256_set1_epi32(in << 24);
+
+    for (; tbl + 7 <= end; tbl += 8) {
+        __m256i x0 = _mm256_slli_epi32(_mm256_loadu_si256((const __m256i *)tbl), 1);
+        __m256i x1 = _mm256_or_si256(x0, one);
+        __m256i f0 = filter_avx2(x0);
+        __m256i f1 = filter_avx2(x1);
+
+        __m256i replace = _mm256_cmpeq_epi32(_mm256_xor_si256(f0, f1), one);
+        __m256i insert = _mm256_andnot_si256(replace, _mm256_cmpeq_epi32(f0, vbit));
+        // replacing takes the state with the last bit set when filter(x0) != bit
+        __m256i take_x1 = _mm256_andnot_si256(_mm256_cmpeq_epi32(f0, vbit), replace);
+
+        if (contribution) {
+            __m256i p1 = evenparity_avx2(_mm256_and_si256(x0, vm1));
+            __m256i p2 = evenparity_avx2(_mm256_and_si256(x0, vm2));
+            __m256i y0 = update_contribution_avx2(x0, p1, p2);
+            __m256i y1 = update_contribution_avx2(x1, _mm256_xor_si256(p1, vm1_lsb), _mm256_xor_si256(p2, vm2_lsb));
+            x0 = _mm256_xor_si256(y0, vin);
+            x1 = _mm256_xor_si256(y1, vin);
+        }
+
+        // every state gives up to two: first (replaced or inserted) and second (inserted)
+        __m256i first = _mm256_blendv_epi8(x0, x1, take_x1);
+        __m256i keep_first = _mm256_or_si256(replace, insert);
+
+        // interleave into state order: first0 second0 first1 second1 ...
+        __m256i lo = _mm256_unpacklo_epi32(first, x1);
+        __m256i hi = _mm256_unpackhi_epi32(first, x1);
+        __m256i keep_lo = _mm256_unpacklo_epi32(keep_first, insert);
+        __m256i keep_hi = _mm256_unpackhi_epi32(keep_first, insert);
+
+        __m256i a = _mm256_permute2x128_si256(lo, hi, 0x20);
+        __m256i b = _mm256_permute2x128_si256(lo, hi, 0x31);
+        uint32_t mask_a = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_permute2x128_si256(keep_lo, keep_hi, 0x20)));
+        uint32_t mask_b = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_permute2x128_si256(keep_lo, keep_hi, 0x31)));
+
+        out = compress_store_avx2(out, a, mask_a);
+        out = compress_store_avx2(out, b, mask_b);
+    }
+
+    return extend_table_generic(tbl, end, out, bit, m1, m2, in, contribution);
+}
+
+__attribute__((target("avx2")))
+static uint32_t prefix_ks_avx2(const uint8_t ks[8], int isodd, uint32_t *candidates, uint32_t size, const uint32_t fastfwd[8]) {
+    const __m256i one = _mm256_set1_epi32(1);
+    __m256i i = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    for (uint32_t base = 0; base < 1 << 21; base += 8) {
+        __m256i good = _mm256_set1_epi32(-1);
+        for (uint32_t c = 0; c < 8; ++c) {
+            __m256i entry = _mm256_xor_si256(i, _mm256_set1_epi32(fastfwd[c]));
+            __m256i f1 = filter_avx2(_mm256_srli_epi32(entry, 1));
+            __m256i f0 = filter_avx2(entry);
+            good = _mm256_and_si256(good, _mm256_cmpeq_epi32(f1, _mm256_set1_epi32(BIT(ks[c], isodd))));
+            good = _mm256_and_si256(good, _mm256_cmpeq_epi32(f0, _mm256_set1_epi32(BIT(ks[c], isodd + 2))));
+            if (_mm256_testz_si256(good, good))
+                break;
+        }
+
+        uint32_t mask = _mm256_movemask_ps(_mm256_castsi256_ps(good));
+        while (mask) {
+            candidates[size++] = base + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+        i = _mm256_add_epi32(i, _mm256_slli_epi32(one, 3));
+    }
+    return size;
+}
+
+static bool use_avx2 = false;
+
+static void __attribute__((constructor)) select_kernels(void) {
+    for (uint32_t mask = 0; mask < 256; mask++) {
+        uint32_t n = 0;
+        for (uint32_t lane = 0; lane < 8; lane++) {
+            if (mask & (1 << lane))
+                compress_lut[mask][n++] = lane;
+        }
+        while (n < 8)
+            compress_lut[mask][n++] = 0;
+    }
+
+    __builtin_cpu_init();
+    use_avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+    if (use_avx2)
+        extend_table_kernel = extend_table_avx2;
+}
+#endif
+
+/** extend_table_buffered
+ * extend_table for long tables: the states are extended into a buffer and copied back.
+ * Short tables, deep in the recursion, are extended in place.
+ */
+static inline void extend_table_buffered(uint32_t *tbl, uint32_t **end, int bit, int m1, int m2, uint32_t in, uint32_t *buf) {
+    if (*end - tbl + 1 < EXTEND_BUFFERED_MIN) {
+        extend_table(tbl, end, bit, m1, m2, in);
+        return;
+    }
+    uint32_t n = extend_table_kernel(tbl, *end, buf, bit, m1, m2, in, true) - buf;
+    memcpy(tbl, buf, n * sizeof(uint32_t));
+    *end = tbl + n - 1;
+}
+
+static inline void extend_table_simple_buffered(uint32_t *tbl, uint32_t **end, int bit, uint32_t *buf) {
+    if (*end - tbl + 1 < EXTEND_BUFFERED_MIN) {
+        extend_table_simple(tbl, end, bit);
+        return;
+    }
+    uint32_t n = extend_table_kernel(tbl, *end, buf, bit, 0, 0, 0, false) - buf;
+    memcpy(tbl, buf, n * sizeof(uint32_t));
+    *end = tbl + n - 1;
+}
+
 /** recover
  * recursively narrow down the search space, 4 bits of keystream at a time
  */
 static struct Crypto1State *
 recover(uint32_t *o_head, uint32_t *o_tail, uint32_t oks,
         uint32_t *e_head, uint32_t *e_tail, uint32_t eks, int rem,
-        struct Crypto1State *sl, uint32_t in, bucket_array_t bucket) {
+        struct Crypto1State *sl, uint32_t in, bucket_array_t bucket, uint32_t *buf) {
     bucket_info_t bucket_info;
 
     if (rem == -1) {
@@ -102,11 +313,11 @@ recover(uint32_t *o_head, uint32_t *o_tail, uint32_t oks,
         oks >>= 1;
         eks >>= 1;
         in >>= 2;
-        extend_table(o_head, &o_tail, oks & 1, LF_POLY_EVEN << 1 | 1, LF_POLY_ODD << 1, 0);
+        extend_table_buffered(o_head, &o_tail, oks & 1, LF_POLY_EVEN << 1 | 1, LF_POLY_ODD << 1, 0, buf);
         if (o_head > o_tail)
             return sl;
 
-        extend_table(e_head, &e_tail, eks & 1, LF_POLY_ODD, LF_POLY_EVEN << 1 | 1, in & 3);
+        extend_table_buffered(e_head, &e_tail, eks & 1, LF_POLY_ODD, LF_POLY_EVEN << 1 | 1, in & 3, buf);
         if (e_head > e_tail)
             return sl;
     }
@@ -116,7 +327,7 @@ recover(uint32_t *o_head, uint32_t *o_tail, uint32_t oks,
     for (int i = bucket_info.numbuckets - 1; i >= 0; i--) {
         sl = recover(bucket_info.bucket_info[1][i].head, bucket_info.bucket_info[1][i].tail, oks,
                      bucket_info.bucket_info[0][i].head, bucket_info.bucket_info[0][i].tail, eks,
-                     rem, sl, in, bucket);
+                     rem, sl, in, bucket, buf);
     }
 
     return sl;
@@ -133,6 +344,7 @@ struct Crypto1State *lfsr_recovery32(uint32_t ks2, uint32_t in) {
     struct Crypto1State *statelist;
     uint32_t *odd_head = 0, *odd_tail = 0, oks = 0;
     uint32_t *even_head = 0, *even_tail = 0, eks = 0;
+    uint32_t *buf = 0;
     int i;
 
     // split the keystream into an odd and even part
@@ -144,7 +356,9 @@ struct Crypto1State *lfsr_recovery32(uint32_t ks2, uint32_t in) {
     odd_head = odd_tail = calloc(1, sizeof(uint32_t) << 21);
     even_head = even_tail = calloc(1, sizeof(uint32_t) << 21);
     statelist =  calloc(1, sizeof(struct Crypto1State) << 18);
-    if (!odd_tail-- || !even_tail-- || !statelist) {
+    // extension buffer, the vector kernels store up to 8 entries beyond the end
+    buf = malloc((sizeof(uint32_t) << 21) + 8 * sizeof(uint32_t));
+    if (!odd_tail-- || !even_tail-- || !statelist || !buf) {
         free(statelist);
         statelist = 0;
         goto out;
@@ -174,20 +388,21 @@ struct Crypto1State *lfsr_recovery32(uint32_t ks2, uint32_t in) {
 
     // extend the statelists. Look at the next 8 Bits of the keystream (4 Bit each odd and even):
     for (i = 0; i < 4; i++) {
-        extend_table_simple(odd_head,  &odd_tail, (oks >>= 1) & 1);
-        extend_table_simple(even_head, &even_tail, (eks >>= 1) & 1);
+        extend_table_simple_buffered(odd_head,  &odd_tail, (oks >>= 1) & 1, buf);
+        extend_table_simple_buffered(even_head, &even_tail, (eks >>= 1) & 1, buf);
     }
 
     // the statelists now contain all states which could have generated the last 10 Bits of the keystream.
     // 22 bits to go to recover 32 bits in total. From now on, we need to take the "in"
     // parameter into account.
     in = (in >> 16 & 0xff) | (in << 16) | (in & 0xff00); // Byte swapping
-    recover(odd_head, odd_tail, oks, even_head, even_tail, eks, 11, statelist, in << 1, bucket);
+    recover(odd_head, odd_tail, oks, even_head, even_tail, eks, 11, statelist, in << 1, bucket, buf);
 
 out:
     for (i = 0; i < 2; i++)
         for (uint32_t j = 0; j <= 0xff; j++)
             free(bucket[i][j].head);
+    free(buf);
     free(odd_head);
     free(even_head);
     return statelist;
@@ -421,6 +636,14 @@ uint32_t *lfsr_prefix_ks(const uint8_t ks[8], int isodd) {
 
     int size = 0;
 
+#ifdef CRAPTO1_AVX2
+    if (use_avx2) {
+        size = prefix_ks_avx2(ks, isodd, candidates, size, fastfwd[isodd]);
+        candidates[size] = -1;
+        return candidates;
+    }
+#endif
+
     for (int i = 0; i < 1 << 21; ++i) {
         int good = 1;
         for (uint32_t c = 0; good && c < 8; ++c) {
@@ -0,0 +1,174 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Bitsliced Crypto1
+//-----------------------------------------------------------------------------
+#include "crypto1_bs.h"
+
+#include <string.h>
+
+// filter function (f20)
+#define f20a(a,b,c,d) (((a|b)^(a&d))^(c&((a^b)|d)))
+#define f20b(a,b,c,d) (((a&b)|c)^((a^b)&(c|d)))
+#define f20c(a,b,c,d,e) ((a|((b|e)&(d^e)))^((a^(b&d))&((c^d)|(b&e))))
+
+#define BS_ONES     (~(crypto1_bs_t)0)
+#define BS_BIT(x)   ((x) ? BS_ONES : 0)
+
+static inline crypto1_bs_t bs_filter(const crypto1_bs_t *p) {
+    return f20c(f20a(p[38], p[36], p[34], p[32]),
+                f20b(p[30], p[28], p[26], p[24]),
+                f20b(p[22], p[20], p[18], p[16]),
+                f20a(p[14], p[12], p[10], p[8]),
+                f20b(p[6], p[4], p[2], p[0]));
+}
+
+// feedback taps except the oldest bit p[47], which is shifted out
+static inline crypto1_bs_t bs_feedback(const crypto1_bs_t *p) {
+    return p[42] ^ p[38] ^ p[37] ^ p[35] ^ p[33] ^ p[32] ^ p[30] ^ p[28] ^ p[23] ^
+           p[22] ^ p[20] ^ p[18] ^ p[12] ^ p[8] ^ p[6] ^ p[5] ^ p[4];
+}
+
+// p walks down while clocking and up while rolling back, move the 48 live
+// slices back to the middle once it runs out of room
+static inline void bs_recenter(crypto1_bs_state_t *s) {
+    crypto1_bs_t *mid = s->buf + CRYPTO1_BS_WINDOW;
+    memmove(mid, s->p, 48 * sizeof(crypto1_bs_t));
+    s->p = mid;
+}
+
+static inline crypto1_bs_t bs_step(crypto1_bs_state_t *s, crypto1_bs_t in, bool is_encrypted) {
+    if (s->p == s->buf)
+        bs_recenter(s);
+
+    crypto1_bs_t *p = s->p;
+    crypto1_bs_t ks = bs_filter(p);
+    crypto1_bs_t fb = p[47] ^ bs_feedback(p) ^ in;
+    if (is_encrypted)
+        fb ^= ks;
+
+    *--s->p = fb;
+    return ks;
+}
+
+static inline void bs_rollback(crypto1_bs_state_t *s, crypto1_bs_t in, bool is_encrypted) {
+    if (s->p == s->buf + 2 * CRYPTO1_BS_WINDOW)
+        bs_recenter(s);
+
+    // the state before the step is p[1..48], p[48] is the bit to recover
+    crypto1_bs_t *p = s->p;
+    crypto1_bs_t old = p[0] ^ bs_feedback(p + 1) ^ in;
+    if (is_encrypted)
+        old ^= bs_filter(p + 1);
+
+    p[48] = old;
+    s->p++;
+}
+
+void crypto1_bs_load_states(crypto1_bs_state_t *s, const struct Crypto1State *states, size_t n) {
+    s->p = s->buf + CRYPTO1_BS_WINDOW;
+    memset(s->p, 0, 48 * sizeof(crypto1_bs_t));
+
+    if (n > CRYPTO1_BS_LANES)
+        n = CRYPTO1_BS_LANES;
+
+    for (size_t lane = 0; lane < n; lane++) {
+        crypto1_bs_t m = (crypto1_bs_t)1 << lane;
+        uint32_t odd = states[lane].odd;
+        uint32_t even = states[lane].even;
+        for (int j = 0; j < 24; j++) {
+            if (BIT(odd, j))
+                s->p[2 * j] |= m;
+            if (BIT(even, j))
+                s->p[2 * j + 1] |= m;
+        }
+    }
+}
+
+void crypto1_bs_load_keys(crypto1_bs_state_t *s, const uint64_t *keys, size_t n) {
+    struct Crypto1State states[CRYPTO1_BS_LANES];
+
+    if (n > CRYPTO1_BS_LANES)
+        n = CRYPTO1_BS_LANES;
+
+    for (size_t lane = 0; lane < n; lane++)
+        crypto1_init(&states[lane], keys[lane]);
+
+    crypto1_bs_load_states(s, states, n);
+}
+
+void crypto1_bs_get_state(const crypto1_bs_state_t *s, int lane, struct Crypto1State *state) {
+    state->odd = 0;
+    state->even = 0;
+    for (int j = 23; j >= 0; j--) {
+        state->odd = state->odd << 1 | BIT(s->p[2 * j], lane);
+        state->even = state->even << 1 | BIT(s->p[2 * j + 1], lane);
+    }
+}
+
+crypto1_bs_t crypto1_bs_bit(crypto1_bs_state_t *s, crypto1_bs_t in, bool is_encrypted) {
+    return bs_step(s, in, is_encrypted);
+}
+
+void crypto1_bs_byte(crypto1_bs_state_t *s, uint8_t in, bool is_encrypted, crypto1_bs_t ks[8]) {
+    for (int i = 0; i < 8; i++) {
+        crypto1_bs_t k = bs_step(s, BS_BIT(BIT(in, i)), is_encrypted);
+        if (ks)
+            ks[i] = k;
+    }
+}
+
+// plain clocking when nobody looks at the keystream, the filter is not needed
+static inline void bs_clock(crypto1_bs_state_t *s, crypto1_bs_t in) {
+    if (s->p == s->buf)
+        bs_recenter(s);
+
+    crypto1_bs_t *p = s->p;
+    crypto1_bs_t fb = p[47] ^ bs_feedback(p) ^ in;
+    *--s->p = fb;
+}
+
+void crypto1_bs_word(crypto1_bs_state_t *s, uint32_t in, bool is_encrypted, crypto1_bs_t ks[32]) {
+    if (ks == NULL && is_encrypted == false) {
+        for (int i = 0; i < 32; i++)
+            bs_clock(s, BS_BIT(BEBIT(in, i)));
+        return;
+    }
+
+    for (int i = 0; i < 32; i++) {
+        crypto1_bs_t k = bs_step(s, BS_BIT(BEBIT(in, i)), is_encrypted);
+        if (ks)
+            ks[24 ^ i] = k;
+    }
+}
+
+void crypto1_bs_rollback_word(crypto1_bs_state_t *s, uint32_t in, bool is_encrypted) {
+    for (int i = 31; i >= 0; i--)
+        bs_rollback(s, BS_BIT(BEBIT(in, i)), is_encrypted);
+}
+
+crypto1_bs_t crypto1_bs_match(const crypto1_bs_t *bits, uint32_t value, int n) {
+    crypto1_bs_t res = BS_ONES;
+    for (int i = 0; i < n && res; i++)
+        res &= bits[i] ^ BS_BIT(!BIT(value, i));
+    return res;
+}
+
+uint32_t crypto1_bs_extract(const crypto1_bs_t *bits, int lane, int n) {
+    uint32_t res = 0;
+    for (int i = n - 1; i >= 0; i--)
+        res = res << 1 | BIT(bits[i], lane);
+    return res;
+}
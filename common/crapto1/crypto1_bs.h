@@ -0,0 +1,68 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Bitsliced Crypto1, runs 64 independent cipher states side by side.
+//
+// Bit n of every slice belongs to lane n. The LFSR is kept as a sliding
+// window of slices, p[0] is the bit shifted in last and p[47] the oldest one,
+// so a step only writes a single slice. Filter and feedback follow the
+// bitsliced cipher of the hardnested bruteforce core.
+//
+// Inputs which are the same for all lanes are passed as plain words, their
+// bits are numbered like the crypto1_byte() / crypto1_word() results.
+//-----------------------------------------------------------------------------
+#ifndef CRYPTO1_BS_INCLUDED
+#define CRYPTO1_BS_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "crapto1.h"
+
+#define CRYPTO1_BS_LANES    64
+#define CRYPTO1_BS_WINDOW   512
+
+typedef uint64_t crypto1_bs_t;
+
+typedef struct {
+    crypto1_bs_t *p;
+    crypto1_bs_t buf[48 + 2 * CRYPTO1_BS_WINDOW];
+} crypto1_bs_state_t;
+
+// load up to CRYPTO1_BS_LANES keys / cipher states, unused lanes are zeroed
+void crypto1_bs_load_keys(crypto1_bs_state_t *s, const uint64_t *keys, size_t n);
+void crypto1_bs_load_states(crypto1_bs_state_t *s, const struct Crypto1State *states, size_t n);
+
+// state of a single lane
+void crypto1_bs_get_state(const crypto1_bs_state_t *s, int lane, struct Crypto1State *state);
+
+// one clock with <in> as input bit, returns the keystream bit
+crypto1_bs_t crypto1_bs_bit(crypto1_bs_state_t *s, crypto1_bs_t in, bool is_encrypted);
+
+// 8 / 32 clocks, keystream bit n lands in ks[n]. <ks> may be NULL if the
+// keystream is not needed
+void crypto1_bs_byte(crypto1_bs_state_t *s, uint8_t in, bool is_encrypted, crypto1_bs_t ks[8]);
+void crypto1_bs_word(crypto1_bs_state_t *s, uint32_t in, bool is_encrypted, crypto1_bs_t ks[32]);
+
+// reverse of crypto1_bs_word, like lfsr_rollback_word
+void crypto1_bs_rollback_word(crypto1_bs_state_t *s, uint32_t in, bool is_encrypted);
+
+// lanes where <bits> equals <value>, for the lowest <n> bits
+crypto1_bs_t crypto1_bs_match(const crypto1_bs_t *bits, uint32_t value, int n);
+
+// value of the lowest <n> bits in <lane>
+uint32_t crypto1_bs_extract(const crypto1_bs_t *bits, int lane, int n);
+
+#endif
@@ -77,11 +77,13 @@ uint16_t crc16_iclass(uint8_t const *d, size_t n);
 // the initial_value is based on the previous legic_Crc8 of the UID.
 // ie:  uidcrc = 0x78  then initial_value == 0x7878
 uint16_t crc16_legic(uint8_t const *d, size_t n, uint8_t uidcrc);
-
-// table implementation
-void init_table(CrcType_t crctype);
-void reset_table(void);
-void generate_table(uint16_t polynomial, bool refin);
-uint16_t crc16_fast(uint8_t const *d, size_t n, uint16_t initval, bool refin, bool refout);
+uint16_t crc16_legic16(uint8_t const *d, size_t n, uint8_t uidcrc);
+
+// table implementation, the crc type picks the polynomial and input bit order.
+// Tables are constant, safe to use from several threads.
+// On the client buffers are processed 8 bytes at a time (slice-by-8).
+uint16_t crc16_fast(CrcType_t ct, uint8_t const *d, size_t n, uint16_t initval, bool refout);
+// one table lookup per byte, reference for the slice-by-8 path
+uint16_t crc16_fast_bytewise(CrcType_t ct, uint8_t const *d, size_t n, uint16_t initval, bool refout);
 
 #endif
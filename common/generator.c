@@ -514,7 +514,7 @@ int mfc_generate4b_nuid(uint8_t *uid, uint8_t *nuid) {
     nuid[1] = b1;
     crc = b1;
     crc |= b2 << 8;
-    crc = crc16_fast(&uid[3], 4, reflect16(crc), true, true);
+    crc = crc16_fast(CRC_14443_A, &uid[3], 4, reflect16(crc), true);
     nuid[2] = (crc >> 8) & 0xFF ;
     nuid[3] = crc & 0xFF;
     return PM3_SUCCESS;
@@ -69,7 +69,12 @@ uint8_t g_debugMode = 0;
 # define prnt Dbprintf
 #endif
 
+#ifndef ON_DEVICE
+// per thread, lf search runs the demodulators from several threads
+static __thread signal_t signalprop = { 255, -255, 0, 0, true };
+#else
 static signal_t signalprop = { 255, -255, 0, 0, true };
+#endif
 signal_t *getSignalProperties(void) {
     return &signalprop;
 }
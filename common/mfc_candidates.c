@@ -0,0 +1,95 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// MIFARE Classic candidate key lists, shared by client and device
+//-----------------------------------------------------------------------------
+#include "mfc_candidates.h"
+
+#include <string.h>
+#include "commonutil.h"     // num_to_bytes, bytes_to_num
+
+// number of keys fitting in <memsize> bytes, header included
+uint16_t mfc_cand_capacity(uint32_t memsize) {
+    if (memsize <= sizeof(mfc_cand_hdr_t))
+        return 0;
+
+    uint32_t n = (memsize - sizeof(mfc_cand_hdr_t)) / MFC_CAND_KEY_SIZE;
+    return (n > 0xFFFF) ? 0xFFFF : n;
+}
+
+// bytes needed for a list of <count> keys, header included
+uint32_t mfc_cand_size(uint16_t count) {
+    return sizeof(mfc_cand_hdr_t) + (uint32_t)count * MFC_CAND_KEY_SIZE;
+}
+
+bool mfc_cand_set_key(uint8_t *list, uint32_t listsize, uint16_t idx, uint64_t key) {
+    const mfc_cand_hdr_t *hdr = (const mfc_cand_hdr_t *)list;
+    if (idx >= hdr->count || mfc_cand_size(idx + 1) > listsize)
+        return false;
+
+    num_to_bytes(key, MFC_CAND_KEY_SIZE, list + sizeof(mfc_cand_hdr_t) + idx * MFC_CAND_KEY_SIZE);
+    return true;
+}
+
+// copy <len> bytes of keys, starting at key index <offset>
+bool mfc_cand_put(uint8_t *list, uint32_t listsize, uint16_t offset, const uint8_t *keys, uint16_t len) {
+    const mfc_cand_hdr_t *hdr = (const mfc_cand_hdr_t *)list;
+    if (len % MFC_CAND_KEY_SIZE)
+        return false;
+
+    uint32_t end = (uint32_t)offset + len / MFC_CAND_KEY_SIZE;
+    if (end > hdr->count || mfc_cand_size(end) > listsize)
+        return false;
+
+    memcpy(list + sizeof(mfc_cand_hdr_t) + offset * MFC_CAND_KEY_SIZE, keys, len);
+    return true;
+}
+
+// sanity check of a received list
+bool mfc_cand_check(const uint8_t *list, uint32_t listsize) {
+    if (list == NULL || listsize < sizeof(mfc_cand_hdr_t))
+        return false;
+
+    const mfc_cand_hdr_t *hdr = (const mfc_cand_hdr_t *)list;
+    return (hdr->keytype <= 1) && (mfc_cand_size(hdr->count) <= listsize);
+}
+
+void mfc_cand_iter_init(mfc_cand_iter_t *it, const uint8_t *list) {
+    const mfc_cand_hdr_t *hdr = (const mfc_cand_hdr_t *)list;
+    it->keys = list + sizeof(mfc_cand_hdr_t);
+    it->count = hdr->count;
+    it->pos = 0;
+}
+
+// next key of the list, false when all keys are consumed
+bool mfc_cand_iter_next(mfc_cand_iter_t *it, uint64_t *key) {
+    if (it->pos >= it->count)
+        return false;
+
+    *key = bytes_to_num((uint8_t *)it->keys + it->pos * MFC_CAND_KEY_SIZE, MFC_CAND_KEY_SIZE);
+    it->pos++;
+    return true;
+}
+
+// the last key couldn't be tested (ie card lost), hand it out once again
+void mfc_cand_iter_retry(mfc_cand_iter_t *it) {
+    if (it->pos > 0)
+        it->pos--;
+}
+
+// time for a progress report
+bool mfc_cand_iter_progress(const mfc_cand_iter_t *it) {
+    return (it->pos % MFC_CAND_PROGRESS_INTERVAL) == 0;
+}
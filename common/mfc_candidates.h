@@ -0,0 +1,81 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// MIFARE Classic candidate key lists, shared by client and device
+//
+// The client uploads a list of candidate keys into BigBuf once and the
+// device checks them against the card without further round trips.
+// The list is a mfc_cand_hdr_t followed by <count> 6 byte keys (MSB first).
+//-----------------------------------------------------------------------------
+
+#ifndef __MFC_CANDIDATES_H
+#define __MFC_CANDIDATES_H
+
+#include "common.h"
+#include "pm3_cmd.h"
+
+#define MFC_CAND_KEY_SIZE           6
+// send a progress report every n tried keys
+#define MFC_CAND_PROGRESS_INTERVAL  64
+
+// CMD_HF_MIFARE_CHKKEYS_LIST operations
+#define MFC_CAND_OP_INIT            0x01    // allocate a new list, data holds a mfc_cand_hdr_t
+#define MFC_CAND_OP_UPLOAD          0x02    // copy keys into the list
+#define MFC_CAND_OP_RUN             0x03    // check all keys of the list
+
+typedef struct {
+    uint8_t keytype;
+    uint8_t block;
+    uint16_t count;
+} PACKED mfc_cand_hdr_t;
+
+typedef struct {
+    uint8_t op;
+    uint16_t offset;            // MFC_CAND_OP_UPLOAD: index of the first key
+    uint16_t len;               // number of bytes in data
+    uint8_t data[PM3_CMD_DATA_SIZE - 5];
+} PACKED mfc_cand_packet_t;
+
+// max number of keys in one MFC_CAND_OP_UPLOAD
+#define MFC_CAND_KEYS_PER_PACKET    (sizeof(((mfc_cand_packet_t *)0)->data) / MFC_CAND_KEY_SIZE)
+
+// reply to MFC_CAND_OP_RUN. Several progress reports, then a final one
+typedef struct {
+    uint8_t done;
+    uint8_t found;
+    uint8_t key[MFC_CAND_KEY_SIZE];
+    uint16_t tried;
+    uint16_t count;
+} PACKED mfc_cand_result_t;
+
+typedef struct {
+    const uint8_t *keys;
+    uint16_t count;
+    uint16_t pos;
+} mfc_cand_iter_t;
+
+uint16_t mfc_cand_capacity(uint32_t memsize);
+uint32_t mfc_cand_size(uint16_t count);
+
+bool mfc_cand_set_key(uint8_t *list, uint32_t listsize, uint16_t idx, uint64_t key);
+bool mfc_cand_put(uint8_t *list, uint32_t listsize, uint16_t offset, const uint8_t *keys, uint16_t len);
+bool mfc_cand_check(const uint8_t *list, uint32_t listsize);
+
+void mfc_cand_iter_init(mfc_cand_iter_t *it, const uint8_t *list);
+bool mfc_cand_iter_next(mfc_cand_iter_t *it, uint64_t *key);
+void mfc_cand_iter_retry(mfc_cand_iter_t *it);
+bool mfc_cand_iter_progress(const mfc_cand_iter_t *it);
+
+#endif
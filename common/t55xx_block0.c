@@ -0,0 +1,214 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// T55x7 / Q5 config block (block 0) plausibility checks, shared by client and device
+//-----------------------------------------------------------------------------
+#include "t55xx_block0.h"
+
+static const uint8_t t55xx_rates[] = {8, 16, 32, 40, 50, 64, 100, 128};
+
+// same bitrate formula as EM4x05 / extended mode
+#define T55XX_EXT_BITRATE(x)    ((((x) & 0x3F) * 2) + 2)
+
+static uint32_t getbits(const uint8_t *bits, size_t start, uint8_t len) {
+    uint32_t v = 0;
+    for (uint8_t i = 0; i < len; i++) {
+        v <<= 1;
+        v |= bits[start + i] & 1;
+    }
+    return v;
+}
+
+uint8_t t55xx_block0_clock(uint8_t rate) {
+    if (rate >= sizeof(t55xx_rates))
+        return 0;
+    return t55xx_rates[rate];
+}
+
+static bool testModulation(uint8_t mode, uint8_t modread) {
+    switch (mode) {
+        case DEMOD_FSK:
+            if (modread >= DEMOD_FSK1 && modread <= DEMOD_FSK2a) return true;
+            break;
+        case DEMOD_ASK:
+            if (modread == DEMOD_ASK) return true;
+            break;
+        case DEMOD_PSK1:
+            if (modread == DEMOD_PSK1) return true;
+            break;
+        case DEMOD_PSK2:
+            if (modread == DEMOD_PSK2) return true;
+            break;
+        case DEMOD_PSK3:
+            if (modread == DEMOD_PSK3) return true;
+            break;
+        case DEMOD_NRZ:
+            if (modread == DEMOD_NRZ) return true;
+            break;
+        case DEMOD_BI:
+            if (modread == DEMOD_BI) return true;
+            break;
+        case DEMOD_BIa:
+            if (modread == DEMOD_BIa) return true;
+            break;
+        default:
+            return false;
+    }
+    return false;
+}
+
+static bool testQ5Modulation(uint8_t mode, uint8_t modread) {
+    switch (mode) {
+        case DEMOD_FSK:
+            if (modread >= 4 && modread <= 5) return true;
+            break;
+        case DEMOD_ASK:
+            if (modread == 0) return true;
+            break;
+        case DEMOD_PSK1:
+            if (modread == 1) return true;
+            break;
+        case DEMOD_PSK2:
+            if (modread == 2) return true;
+            break;
+        case DEMOD_PSK3:
+            if (modread == 3) return true;
+            break;
+        case DEMOD_NRZ:
+            if (modread == 7) return true;
+            break;
+        case DEMOD_BI:
+            if (modread == 6) return true;
+            break;
+        default:
+            return false;
+    }
+    return false;
+}
+
+static int convertQ5bitRate(uint8_t bitRateRead) {
+    for (size_t i = 0; i < sizeof(t55xx_rates); i++)
+        if (t55xx_rates[i] == bitRateRead)
+            return i;
+
+    return -1;
+}
+
+static bool testQ5(const uint8_t *bits, size_t len, uint8_t mode, uint8_t clk, t55xx_block0_t *found) {
+
+    if (len < 64) return false;
+
+    for (size_t idx = 28; idx < 64 && idx + 32 <= len; idx++) {
+        size_t si = idx;
+        if (getbits(bits, si, 28) == 0x00) continue;
+
+        uint8_t safer     = getbits(bits, si, 4);
+        si += 4;     //master key
+        uint8_t resv      = getbits(bits, si, 8);
+        si += 8;
+        // 2nibble must be zeroed.
+        if (safer != 0x6 && safer != 0x9) continue;
+        if (resv > 0x00) continue;
+        //uint8_t pageSel   = getbits(bits, si, 1); si += 1;
+        //uint8_t fastWrite = getbits(bits, si, 1); si += 1;
+        si += 1 + 1;
+        int bitRate       = getbits(bits, si, 6) * 2 + 2;
+        si += 6;     //bit rate
+        if (bitRate > 128 || bitRate < 8) continue;
+
+        //uint8_t AOR       = getbits(bits, si, 1); si += 1;
+        //uint8_t PWD       = getbits(bits, si, 1); si += 1;
+        //uint8_t pskcr     = getbits(bits, si, 2); si += 2;  //could check psk cr
+        //uint8_t inverse   = getbits(bits, si, 1); si += 1;
+        si += 1 + 1 + 2 + 1;
+        uint8_t modread   = getbits(bits, si, 3);
+        si += 3;
+        uint8_t maxBlk    = getbits(bits, si, 3);
+        si += 3;
+        //uint8_t ST        = getbits(bits, si, 1); si += 1;
+        if (maxBlk == 0) continue;
+
+        //test modulation
+        if (!testQ5Modulation(mode, modread)) continue;
+        if (bitRate != clk) continue;
+
+        found->bitrate = convertQ5bitRate(bitRate);
+        if (found->bitrate < 0) continue;
+
+        found->offset = idx;
+        found->block0 = getbits(bits, idx, 32);
+        found->q5 = true;
+        return true;
+    }
+    return false;
+}
+
+bool t55xx_block0_find(const uint8_t *bits, size_t len, uint8_t mode, uint8_t clk, t55xx_block0_t *found) {
+
+    if (len < 64) return false;
+
+    for (size_t idx = 28; idx < 64 && idx + 32 <= len; idx++) {
+        size_t si = idx;
+        if (getbits(bits, si, 28) == 0x00) continue;
+
+        uint8_t safer    = getbits(bits, si, 4);
+        si += 4;     //master key
+        uint8_t resv     = getbits(bits, si, 4);
+        si += 4;     //was 7 & +=7+3 //should be only 4 bits if extended mode
+        // 2nibble must be zeroed.
+        // moved test to here, since this gets most faults first.
+        if (resv > 0x00) continue;
+
+        int bitRate      = getbits(bits, si, 6);
+        si += 6;     //bit rate (includes extended mode part of rate)
+        uint8_t extend   = getbits(bits, si, 1);
+        si += 1;     //bit 15 extended mode
+        uint8_t modread  = getbits(bits, si, 5);
+        si += 5 + 2 + 1;
+        //uint8_t pskcr   = getbits(bits, si, 2); si += 2+1;  //could check psk cr
+        //uint8_t nml01    = getbits(bits, si, 1); si += 1+5;   //bit 24, 30, 31 could be tested for 0 if not extended mode
+        //uint8_t nml02    = getbits(bits, si, 2); si += 2;
+
+        //if extended mode
+        bool extMode = ((safer == 0x6 || safer == 0x9) && extend) ? true : false;
+
+        if (!extMode) {
+            if (bitRate > 7) continue;
+            if (t55xx_rates[bitRate] != clk) continue;
+        } else {
+            if (T55XX_EXT_BITRATE(bitRate) != clk) continue;
+        }
+        //test modulation
+        if (!testModulation(mode, modread)) continue;
+
+        found->bitrate = bitRate;
+        found->offset = idx;
+        found->block0 = getbits(bits, idx, 32);
+        found->q5 = false;
+        return true;
+    }
+    return testQ5(bits, len, mode, clk, found);
+}
+
+bool t55xx_block0_repeats(const uint8_t *bits, size_t len, const t55xx_block0_t *found) {
+    // one period is the block, with or without the leading start bit
+    for (size_t period = 32; period <= 33; period++) {
+        if (found->offset + period + 32 <= len && getbits(bits, found->offset + period, 32) == found->block0)
+            return true;
+        if (found->offset >= period && getbits(bits, found->offset - period, 32) == found->block0)
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,57 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// T55x7 / Q5 config block (block 0) plausibility checks, shared by client and device
+//
+// Works on a demodulated bitstream, one bit per byte, as produced by lfdemod.
+//-----------------------------------------------------------------------------
+
+#ifndef __T55XX_BLOCK0_H
+#define __T55XX_BLOCK0_H
+
+#include "common.h"
+
+typedef enum {
+    DEMOD_NRZ  = 0x00,
+    DEMOD_PSK1 = 0x01,
+    DEMOD_PSK2 = 0x02,
+    DEMOD_PSK3 = 0x03,
+    DEMOD_FSK1 = 0x04,
+    DEMOD_FSK2 = 0x05,
+    DEMOD_FSK1a = 0x06,
+    DEMOD_FSK2a = 0x07,
+    DEMOD_FSK   = 0xF0, //generic FSK (auto detect FCs)
+    DEMOD_ASK  = 0x08,
+    DEMOD_BI   = 0x10,
+    DEMOD_BIa  = 0x18,
+} t55xx_modulation;
+
+typedef struct {
+    uint32_t block0;
+    uint8_t offset;     // bit offset of block 0 in the stream
+    int bitrate;        // rate field, Q5 rates converted to the T55x7 index
+    bool q5;
+} t55xx_block0_t;
+
+// data rate in field clocks (RF/n) for a T55x7 rate index 0-7, 0 if out of range
+uint8_t t55xx_block0_clock(uint8_t rate);
+
+// search for a config block of modulation <mode> and data rate <clk>
+bool t55xx_block0_find(const uint8_t *bits, size_t len, uint8_t mode, uint8_t clk, t55xx_block0_t *found);
+
+// a block read in direct access mode repeats, a config found in a regular read stream usually doesn't
+bool t55xx_block0_repeats(const uint8_t *bits, size_t len, const t55xx_block0_t *found);
+
+#endif
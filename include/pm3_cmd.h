@@ -205,10 +205,31 @@ typedef struct {
     // rdv4
     bool hw_available_flash            : 1;
     bool hw_available_smartcard        : 1;
+    // comms
+    bool compressed_download           : 1;
 } PACKED capabilities_t;
-#define CAPABILITIES_VERSION 6
+#define CAPABILITIES_VERSION 7
 extern capabilities_t g_pm3_capabilities;
 
+// For CMD_DOWNLOAD_BIGBUF_LZ4
+#define DL_LZ4_MEM_BIGBUF   0
+#define DL_LZ4_MEM_EML      1
+typedef struct {
+    uint8_t memtype;
+    uint32_t offset;
+    uint32_t len;
+} PACKED dl_lz4_request_t;
+
+// For CMD_DOWNLOADED_BIGBUF_LZ4
+// every chunk is an independent LZ4 block, or stored as is when it doesn't compress
+#define DL_LZ4_STORED       0x0001
+typedef struct {
+    uint32_t offset;     // offset into the requested range
+    uint16_t rawlen;     // bytes this chunk expands to
+    uint16_t flags;
+    uint8_t data[PM3_CMD_DATA_SIZE - 8];
+} PACKED dl_lz4_chunk_t;
+
 // For CMD_LF_T55XX_WRITEBL
 typedef struct {
     uint32_t data;
@@ -223,6 +244,40 @@ typedef struct {
     uint32_t time;
 } PACKED t55xx_test_block_t;
 
+// For CMD_LF_T55XX_BRUTE
+#define T55XX_BRUTE_OP_INIT     0x01    // new run, data holds a t55xx_brute_cfg_t
+#define T55XX_BRUTE_OP_UPLOAD   0x02    // copy passwords (4 bytes MSB first) into the list
+#define T55XX_BRUTE_OP_RUN      0x03    // iterate the range or the list
+// t55xx_brute_cfg_t.flags
+#define T55XX_BRUTE_LIST        0x01    // iterate the uploaded list instead of start..end
+// send a progress report every n tried passwords
+#define T55XX_BRUTE_PROGRESS_INTERVAL   16
+typedef struct {
+    uint32_t start;         // first password of the range
+    uint32_t end;           // last password of the range, or number of passwords in the list
+    uint8_t flags;
+    uint8_t downlink_mode;
+    uint8_t modulation;     // expected block 0 modulation (t55xx_modulation)
+    uint8_t clock;          // expected data rate, RF/n
+    uint8_t inverted;
+} PACKED t55xx_brute_cfg_t;
+
+typedef struct {
+    uint8_t op;
+    uint16_t offset;        // T55XX_BRUTE_OP_UPLOAD: index of the first password
+    uint16_t len;           // number of bytes in data
+    uint8_t data[PM3_CMD_DATA_SIZE - 5];
+} PACKED t55xx_brute_packet_t;
+
+// reply to T55XX_BRUTE_OP_RUN. Progress reports, then a final one
+typedef struct {
+    uint8_t done;
+    uint8_t found;
+    uint32_t password;      // the hit, or the last password tried
+    uint32_t block0;
+    uint32_t tried;
+} PACKED t55xx_brute_result_t;
+
 // For CMD_LF_HID_SIMULATE (FSK)
 typedef struct {
     uint32_t hi2;
@@ -378,6 +433,8 @@ typedef struct {
 #define CMD_TIA                                                           0x0117
 #define CMD_BREAK_LOOP                                                    0x0118
 #define CMD_SET_TEAROFF                                                   0x0119
+#define CMD_DOWNLOAD_BIGBUF_LZ4                                           0x011A
+#define CMD_DOWNLOADED_BIGBUF_LZ4                                         0x011B
 
 // RDV40, Flash memory operations
 #define CMD_FLASHMEM_WRITE                                                0x0121
@@ -500,6 +557,7 @@ typedef struct {
 
 #define CMD_LF_T55XX_CHK_PWDS                                             0x0230
 #define CMD_LF_T55XX_DANGERRAW                                            0x0231
+#define CMD_LF_T55XX_BRUTE                                                0x0233
 
 
 // ZX8211
@@ -621,6 +679,7 @@ typedef struct {
 #define CMD_HF_MIFARE_SETMOD                                              0x0624
 #define CMD_HF_MIFARE_CHKKEYS_FAST                                        0x0625
 #define CMD_HF_MIFARE_CHKKEYS_FILE                                        0x0626
+#define CMD_HF_MIFARE_CHKKEYS_LIST                                        0x0627
 
 #define CMD_HF_MIFARE_SNIFF                                               0x0630
 #define CMD_HF_MIFARE_MFKEY                                               0x0631
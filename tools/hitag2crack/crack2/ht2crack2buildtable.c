@@ -1,48 +1,50 @@
 /*
  * ht2crack2buildtable.c
- * This builds the 1.2TB table and sorts it.
+ * This builds the 1.3TB table and sorts it into a single indexed file.
+ *
+ * Phase 1 generates the PRNG states and spills them into 256 files on the first
+ * keystream byte.  Phase 2 is the external memory part of a radix sort: every
+ * spill file is read back in as few passes as the RAM limit allows, scattered on
+ * the second keystream byte and the resulting buckets are radix sorted on the
+ * remaining keystream bytes by all threads before being appended to the table.
  */
 
 #include "ht2crackutils.h"
+#include "ht2crack2table.h"
 #include <stdlib.h>
+#include <inttypes.h>
 
-// DATAMAX is the size of each bucket (bytes).  There are 65536 buckets so choose a value such that
-// DATAMAX * 65536 < RAM available.  For ex, if you want to use 12GB of RAM (for a 16GB machine
-// leaving some RAM free for OS and other stuff), DATAMAX = 12GB / 65536 = 196608.  Round this down
-// to a power of 10; DATAMAX = 196600.
-#define DATAMAX 196600 // around 192K rounded down to a power of 10
-
-// NUM_BUILD_THREADS and NUM_SORT_THREADS are the number of threads to run concurrently.  These should
-// ideally be equal to the number of virtual cores you have available.  A quad-core machine will
-// likely have 8 virtual cores, so set them to 8.
-//
-// If sorting fails with a 'bus error' then that is likely because your disk I/O can't keep up with
-// the read/write demands of the multi-threaded sorting.  In this case, reduce the number of sorting
-// threads.  This will most likely only be a problem with network disks; SATA should be okay;
-// USB2/3 should keep up.
-//
-// These MUST be a power of 2 for the maths to work - you have been warned!
-// Also, sort threads MUST be <= build threads or a horrible buffer overflow will happen!
-#define NUM_BUILD_THREADS 8
-#define NUM_SORT_THREADS 8
-
-// DATASIZE is the number of bytes in an entry.  This is 10; 4 bytes of keystream (2 are in the filepath) +
-// 6 bytes of PRNG state.
-#define DATASIZE 10
+// spill records carry the second keystream byte, the first one selects the spill file
+#define SPILLSIZE (DATASIZE + 1)
+#define NUM_SPILLS 0x100
+
+// read granularity when streaming a spill file
+#define READBUF (4UL * 1024UL * 1024UL)
 
 int debug = 0;
 
-// table entry for a bucket
-struct table {
-    char path[32];
+// runtime parameters
+static int nthreads = 0;
+static uint64_t ramlimit = 1024UL * 1024UL * 1024UL;
+static int log2entries = 37;
+static const char *outfile = HT2TABLE_DEFAULT;
+static const char *spilldir = "table";
+
+// spill file for one first keystream byte
+struct spill {
+    char path[256];
+    int fd;
     pthread_mutex_t mutex;
-    unsigned char *data;
-    unsigned char *ptr;
 };
 
+static struct spill spills[NUM_SPILLS];
 
-// actual table
-struct table *t;
+// per thread staging buffers, one per spill file
+struct stage {
+    unsigned char *data[NUM_SPILLS];
+    size_t len[NUM_SPILLS];
+    size_t max;
+};
 
 // jump table 1
 uint64_t d[48];
@@ -52,146 +54,56 @@ int nsteps;
 uint64_t d2[48];
 int nsteps2;
 
-// create table entry
-static void create_table(struct table *tt, int d_1, int d_2) {
-    if (!tt) {
-        printf("create_table: t is NULL\n");
-        exit(1);
-    }
-
-    // create some space
-    tt->data = (unsigned char *)calloc(1, DATAMAX);
-    if (!(tt->data)) {
-        printf("create_table: cannot calloc data\n");
-        exit(1);
-    }
-
-    // set data ptr to start of data table
-    tt->ptr = tt->data;
-
-    // init the mutex
-    if (pthread_mutex_init(&(tt->mutex), NULL)) {
-        printf("create_table: cannot init mutex\n");
-        exit(1);
-    }
-
-    // create the path
-//    sprintf(tt->path, "/Volumes/2tb/%02X/%02X.bin", d_1 & 0xff, d_2 & 0xff);
-    sprintf(tt->path, "table/%02x/%02x.bin", d_1 & 0xff, d_2 & 0xff);
-}
-
-
-// create all table entries
-static void create_tables(struct table *tt) {
-    int i, j;
-
-    if (!tt) {
-        printf("create_tables: t is NULL\n");
-        exit(1);
-    }
-
-    for (i = 0; i < 0x100; i++) {
-        for (j = 0; j < 0x100; j++) {
-            create_table(tt + ((i * 0x100) + j), i, j);
+static void writeall(int fd, const unsigned char *data, size_t len, const char *path) {
+    while (len) {
+        ssize_t res = write(fd, data, len);
+        if (res <= 0) {
+            printf("cannot write all of the data to %s\n", path);
+            exit(1);
         }
+        data += res;
+        len -= res;
     }
 }
 
-
-// free the table memory
-static void free_tables(struct table *tt) {
-    if (!tt) {
-        printf("free_tables: tt is NULL\n");
-        exit(1);
-    }
-
-    for (int i = 0; i < 0x10000; i++) {
-        struct table *ttmp = tt + i;
-        free(ttmp->data);
-    }
-}
-
-
-
-// write (partial) table to file
-static void writetable(struct table *t1) {
-    int fd;
-
-    if (debug) printf("writetable %s\n", t1->path);
-
-    fd = open(t1->path, O_WRONLY | O_CREAT | O_APPEND, 0644);
-    if (fd <= 0) {
-        printf("writetable cannot open file %s for appending\n", t1->path);
+static void create_spills(void) {
+    if (mkdir(spilldir, 0755)) {
+        printf("cannot make dir %s\n", spilldir);
         exit(1);
     }
 
-    if (debug) printf("writetable %s opened\n", t1->path);
-
-    if (write(fd, t1->data, t1->ptr - t1->data) < (t1->ptr - t1->data)) {
-        printf("writetable cannot write all of the data\n");
-        exit(1);
+    for (int i = 0; i < NUM_SPILLS; i++) {
+        snprintf(spills[i].path, sizeof(spills[i].path), "%s/%02x.bin", spilldir, i);
+        spills[i].fd = open(spills[i].path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        if (spills[i].fd < 0) {
+            printf("cannot create spill file %s\n", spills[i].path);
+            exit(1);
+        }
+        if (pthread_mutex_init(&(spills[i].mutex), NULL)) {
+            printf("create_spills: cannot init mutex\n");
+            exit(1);
+        }
     }
-
-    if (debug) printf("writetable %s written\n", t1->path);
-
-    close(fd);
 }
 
+// write a staging buffer to its spill file
+static void flushstage(struct stage *st, int i) {
+    if (st->len[i] == 0)
+        return;
 
-// store value in table
-static void store(unsigned char *data) {
-    unsigned char d_1, d_2;
-    int offset;
-    struct table *t1;
-
-    // use the first two bytes as an index
-    d_1 = data[0];
-    d_2 = data[1];
-    offset = (d_1 * 0x100) + d_2;
-
-    if (debug) printf("store, d1=%02X, d2=%02X, offset = %d\n", d_1, d_2, offset);
-
-    // get pointer to table entry
-    t1 = t + offset;
-
-    // wait for a lock on this entry
-    if (pthread_mutex_lock(&(t1->mutex))) {
-        printf("store: cannot lock mutex at offset %d\n", offset);
-        exit(1);
-    }
-
-    if (debug) printf("store, offset = %d, got lock\n", offset);
-
-    // store the entry
-    memcpy(t1->ptr, data + 2, 10);
-
-    if (debug) printf("store, offset = %d, copied data\n", offset);
-
-    // update the ptr
-    t1->ptr += 10;
-
-    // check if table is full
-    if ((t1->ptr - t1->data) >= DATAMAX) {
-        // write the table to disk
-        writetable(t1);
-        // reset ptr
-        t1->ptr = t1->data;
-    }
-
-    if (debug) printf("store, offset = %d, after possible write\n", offset);
-
-    // release the lock
-    if (pthread_mutex_unlock(&(t1->mutex))) {
-        printf("store: cannot unlock mutex at offset %d\n", offset);
+    if (pthread_mutex_lock(&(spills[i].mutex))) {
+        printf("flushstage: cannot lock mutex %d\n", i);
         exit(1);
     }
 
-    if (debug) printf("store, offset = %d, unlocked\n", offset);
+    writeall(spills[i].fd, st->data[i], st->len[i], spills[i].path);
 
+    pthread_mutex_unlock(&(spills[i].mutex));
+    st->len[i] = 0;
 }
 
 // writes the ks (keystream) and s (state)
-static void write_ks_s(uint32_t ks1, uint32_t ks2, uint64_t shiftreg) {
+static void write_ks_s(struct stage *st, uint32_t ks1, uint32_t ks2, uint64_t shiftreg) {
     unsigned char buf[16];
 
     // create buffer
@@ -199,8 +111,13 @@ static void write_ks_s(uint32_t ks1, uint32_t ks2, uint64_t shiftreg) {
     writebuf(buf + 3, ks2, 3);
     writebuf(buf + 6, shiftreg, 6);
 
-    // store buffer
-    store(buf);
+    // stage everything but the first byte, which selects the spill
+    int i = buf[0];
+    memcpy(st->data[i] + st->len[i], buf + 1, SPILLSIZE);
+    st->len[i] += SPILLSIZE;
+
+    if (st->len[i] + SPILLSIZE > st->max)
+        flushstage(st, i);
 }
 
 
@@ -272,16 +189,31 @@ static void jumpnsteps(Hitag_State *hstate, int table) {
 }
 
 
+
 // thread to build a part of the table
 static void *buildtable(void *dd) {
     Hitag_State hstate;
     Hitag_State hstate2;
-    unsigned long maxentries = 1;
+    uint64_t maxentries = 1ULL << log2entries;
     int index = (int)(long)dd;
-    int tnum = NUM_BUILD_THREADS;
+    struct stage st;
+
+    // the staging buffers use half of the RAM limit, split over threads and spills
+    st.max = (ramlimit / 2 / nthreads / NUM_SPILLS) / SPILLSIZE * SPILLSIZE;
+    if (st.max < 64 * SPILLSIZE)
+        st.max = 64 * SPILLSIZE;
+
+    for (int i = 0; i < NUM_SPILLS; i++) {
+        st.data[i] = (unsigned char *)malloc(st.max);
+        if (!st.data[i]) {
+            printf("buildtable: cannot malloc staging buffer\n");
+            exit(1);
+        }
+        st.len[i] = 0;
+    }
 
     /* set random state */
-    hstate.shiftreg = 0x123456789abc;
+    hstate.shiftreg = HT2TABLE_START_STATE;
     buildlfsr(&hstate);
 
     /* jump to offset using jump table 2 (2048) */
@@ -289,21 +221,8 @@ static void *buildtable(void *dd) {
         jumpnsteps(&hstate, 2);
     }
 
-    /* set max entries - this is a fraction of 2^37 depending on how many threads we are running.
-       1 thread  = 2^37
-       2 threads = 2^36
-       4 threads = 2^35
-       8 threads = 2^34
-       etc
-    */
-    maxentries = maxentries << 37;
-    while (!(tnum & 0x1)) {
-        maxentries = maxentries >> 1;
-        tnum = tnum >> 1;
-    }
-
-    /* make the entries */
-    for (unsigned long i = 0; i < maxentries; i++) {
+    /* thread n makes entries n, n + nthreads, n + 2 * nthreads ... of the 2^log2entries */
+    for (uint64_t i = index; i < maxentries; i += nthreads) {
 
         // copy the current state
         hstate2.shiftreg = hstate.shiftreg;
@@ -314,226 +233,314 @@ static void *buildtable(void *dd) {
         uint32_t ks1 = hitag2_nstep(&hstate2, 24);
         uint32_t ks2 = hitag2_nstep(&hstate2, 24);
 
-        write_ks_s(ks1, ks2, hstate.shiftreg);
+        write_ks_s(&st, ks1, ks2, hstate.shiftreg);
 
-        // jump hstate forward 2048 * NUM_BUILD_THREADS states using di table
-        // this is because we're running NUM_BUILD_THREADS threads at once, from NUM_BUILD_THREADS
+        // jump hstate forward 2048 * nthreads states using di table
+        // this is because we're running nthreads threads at once, from nthreads
         // different offsets that are 2048 states apart.
         jumpnsteps(&hstate, 1);
+
+        if (index == 0 && ((i / nthreads) & 0xFFFFFF) == 0 && i) {
+            printf("buildtable: %" PRIu64 " / %" PRIu64 " entries\n", i, maxentries);
+        }
+    }
+
+    for (int i = 0; i < NUM_SPILLS; i++) {
+        flushstage(&st, i);
+        free(st.data[i]);
     }
 
     return NULL;
 }
 
-
-// make 'table/' (unsorted) and 'sorted/' dir structures
-static void makedirs(void) {
-    char path[32];
-    int i;
-
-    if (mkdir("table", 0755)) {
-        printf("cannot make dir table\n");
-        exit(1);
-    }
-    if (mkdir("sorted", 0755)) {
-        printf("cannot make dir sorted\n");
+static void runthreads(void *(*fn)(void *)) {
+    pthread_t *threads = (pthread_t *)calloc(nthreads, sizeof(pthread_t));
+    if (!threads) {
+        printf("cannot calloc threads\n");
         exit(1);
     }
 
-    for (i = 0; i < 0x100; i++) {
-        sprintf(path, "table/%02x", i);
-        if (mkdir(path, 0755)) {
-            printf("cannot make dir %s\n", path);
+    for (long i = 0; i < nthreads; i++) {
+        int ret = pthread_create(&(threads[i]), NULL, fn, (void *)(i));
+        if (ret) {
+            printf("cannot start thread %ld\n", i);
             exit(1);
         }
-        sprintf(path, "sorted/%02x", i);
-        if (mkdir(path, 0755)) {
-            printf("cannot make dir %s\n", path);
+    }
+
+    for (long i = 0; i < nthreads; i++) {
+        int ret = pthread_join(threads[i], NULL);
+        if (ret) {
+            printf("cannot join thread %ld\n", i);
             exit(1);
         }
     }
+    free(threads);
 }
 
-static int datacmp(const void *p1, const void *p2, void *dummy) {
-    unsigned char *d_1 = (unsigned char *)p1;
-    unsigned char *d_2 = (unsigned char *)p2;
+// LSD radix sort of n entries on the keystream bytes, tmp must hold n entries
+static void radixsort(unsigned char *data, unsigned char *tmp, uint64_t n) {
+    unsigned char *src = data;
+    unsigned char *dst = tmp;
+
+    for (int byte = KEYSIZE - 1; byte >= 0; byte--) {
+        uint64_t pos[0x100] = {0};
 
-    return memcmp(d_1, d_2, DATASIZE);
+        for (uint64_t i = 0; i < n; i++)
+            pos[src[i * DATASIZE + byte]]++;
+
+        uint64_t sum = 0;
+        for (int i = 0; i < 0x100; i++) {
+            uint64_t c = pos[i];
+            pos[i] = sum;
+            sum += c;
+        }
+
+        for (uint64_t i = 0; i < n; i++)
+            memcpy(dst + (pos[src[i * DATASIZE + byte]]++) * DATASIZE, src + i * DATASIZE, DATASIZE);
+
+        unsigned char *swap = src;
+        src = dst;
+        dst = swap;
+    }
+    // KEYSIZE is even, the result is back in data
 }
 
-static void *sorttable(void *dd) {
-    int i, j;
-    int fdin;
-    int fdout;
-    char infile[64];
-    char outfile[64];
-    unsigned char *data = NULL;
-    struct stat filestat;
-    int index = (int)(long)dd;
-    int space = 0x100 / NUM_SORT_THREADS;
+// buckets of the spill file currently being sorted
+static unsigned char *sortdata;
+static unsigned char *sorttmp;
+static uint64_t bucketstart[0x101];
+static int bucketfirst;
+static int bucketlast;
+static int bucketnext;
+
+static void *sortbuckets(void *dd) {
+    (void)dd;
+    for (;;) {
+        int b = __atomic_fetch_add(&bucketnext, 1, __ATOMIC_RELAXED);
+        if (b >= bucketlast)
+            break;
+
+        uint64_t start = bucketstart[b] - bucketstart[bucketfirst];
+        uint64_t n = bucketstart[b + 1] - bucketstart[b];
+        radixsort(sortdata + start * DATASIZE, sorttmp + start * DATASIZE, n);
+    }
+    return NULL;
+}
 
-    // create table - 50MB should be enough
-    unsigned char *table = (unsigned char *)calloc(1, 50UL * 1024UL * 1024UL);
-    if (!table) {
-        printf("sorttable: cannot calloc table\n");
+// stream a spill file, calling back for every record
+static void readspill(struct spill *sp, void (*fn)(const unsigned char *rec, void *arg), void *arg) {
+    unsigned char *buf = (unsigned char *)malloc(READBUF);
+    if (!buf) {
+        printf("readspill: cannot malloc\n");
         exit(1);
     }
 
-    // loop over our first byte values
-    for (i = (index * space); i < ((index + 1) * space); i++) {
-        // loop over all second byte values
-        for (j = 0; j < 0x100; j++) {
+    int fd = open(sp->path, O_RDONLY);
+    if (fd < 0) {
+        printf("cannot open spill file %s\n", sp->path);
+        exit(1);
+    }
 
-            printf("sorttable: processing bytes 0x%02x/0x%02x\n", i, j);
+    size_t have = 0;
+    for (;;) {
+        ssize_t res = read(fd, buf + have, READBUF - have);
+        if (res < 0) {
+            printf("cannot read spill file %s\n", sp->path);
+            exit(1);
+        }
+        have += res;
 
-            // open file, stat it and mmap it
-            sprintf(infile, "table/%02x/%02x.bin", i, j);
+        size_t used = (have / SPILLSIZE) * SPILLSIZE;
+        for (size_t i = 0; i < used; i += SPILLSIZE)
+            fn(buf + i, arg);
 
-            fdin = open(infile, O_RDONLY);
-            if (fdin <= 0) {
-                printf("cannot open file %s\n", infile);
-                exit(1);
-            }
+        memmove(buf, buf + used, have - used);
+        have -= used;
 
-            if (fstat(fdin, &filestat)) {
-                printf("cannot stat file %s\n", infile);
-                exit(1);
-            }
+        if (res == 0)
+            break;
+    }
 
-            data = mmap((caddr_t)0, filestat.st_size, PROT_READ, MAP_PRIVATE, fdin, 0);
-            if (data == MAP_FAILED) {
-                printf("cannot mmap file %s\n", infile);
-                exit(1);
-            }
+    close(fd);
+    free(buf);
+}
 
-            // copy data into table
-            memcpy(table, data, filestat.st_size);
+static void countrec(const unsigned char *rec, void *arg) {
+    ((uint64_t *)arg)[rec[0]]++;
+}
 
-            uint64_t numentries = filestat.st_size / DATASIZE;
+static void scatterrec(const unsigned char *rec, void *arg) {
+    uint64_t *pos = (uint64_t *)arg;
+    if (rec[0] < bucketfirst || rec[0] >= bucketlast)
+        return;
+    memcpy(sortdata + (pos[rec[0]]++) * DATASIZE, rec + 1, DATASIZE);
+}
 
-            // unmap file and close it
-            if (munmap(data, filestat.st_size)) {
-                printf("cannot munmap %s\n", infile);
-                exit(1);
-            }
+// sort all spill files into the table
+static void sorttable(int fdout, uint64_t *index) {
+    uint64_t written = 0;
 
-            close(fdin);
+    for (int s = 0; s < NUM_SPILLS; s++) {
+        struct spill *sp = spills + s;
 
-            // sort it
-            void *dummy = NULL; // clang
-            qsort_r(table, numentries, DATASIZE, datacmp, dummy);
+        printf("sorttable: processing byte 0x%02x\n", s);
 
-            // write to file
-            sprintf(outfile, "sorted/%02x/%02x.bin", i, j);
-            fdout = open(outfile, O_WRONLY | O_CREAT, 0644);
-            if (fdout <= 0) {
-                printf("cannot create outfile %s\n", outfile);
-                exit(1);
-            }
-            if (write(fdout, table, numentries * DATASIZE)) {
-                printf("writetable cannot write all of the data\n");
-                exit(1);
-            }
-            close(fdout);
+        uint64_t count[0x100] = {0};
+        readspill(sp, countrec, count);
 
-            // remove input file
-            if (unlink(infile)) {
-                printf("cannot remove file %s\n", infile);
-                exit(1);
-            }
-        }
-    }
+        bucketstart[0] = 0;
+        for (int i = 0; i < 0x100; i++)
+            bucketstart[i + 1] = bucketstart[i] + count[i];
 
-    return NULL;
-}
+        for (int i = 0; i < 0x100; i++)
+            index[(s << 8) | i] = written + bucketstart[i];
 
-int main(int argc, char *argv[]) {
-    pthread_t threads[NUM_BUILD_THREADS];
-    void *status;
+        // as many second byte buckets per pass as fit the RAM limit (data + radix buffer)
+        for (bucketfirst = 0; bucketfirst < 0x100; bucketfirst = bucketlast) {
+            bucketlast = bucketfirst + 1;
+            while (bucketlast < 0x100 && (bucketstart[bucketlast + 1] - bucketstart[bucketfirst]) * DATASIZE * 2 <= ramlimit)
+                bucketlast++;
 
-    // make the table of tables
-    t = (struct table *)malloc(sizeof(struct table) * 65536);
-    if (!t) {
-        printf("malloc failed\n");
-        exit(1);
-    }
+            uint64_t n = bucketstart[bucketlast] - bucketstart[bucketfirst];
+            if (n == 0)
+                continue;
+
+            if (n * DATASIZE * 2 > ramlimit)
+                printf("sorttable: bucket 0x%02x%02x exceeds the RAM limit\n", s, bucketfirst);
 
-    // init the table
-    create_tables(t);
+            sortdata = (unsigned char *)malloc(n * DATASIZE);
+            sorttmp = (unsigned char *)malloc(n * DATASIZE);
+            if (!sortdata || !sorttmp) {
+                printf("sorttable: cannot malloc %" PRIu64 " entries\n", n);
+                exit(1);
+            }
 
-    // create the directories
-    makedirs();
+            uint64_t pos[0x100];
+            for (int i = bucketfirst; i < bucketlast; i++)
+                pos[i] = bucketstart[i] - bucketstart[bucketfirst];
 
-    // build the jump table for incremental steps
-    builddi(2048 * NUM_BUILD_THREADS, 1);
+            readspill(sp, scatterrec, pos);
 
-    // build the jump table for setting the offset
-    builddi(2048, 2);
+            bucketnext = bucketfirst;
+            runthreads(sortbuckets);
 
-    // start the threads
-    for (long i = 0; i < NUM_BUILD_THREADS; i++) {
-        int ret = pthread_create(&(threads[i]), NULL, buildtable, (void *)(i));
-        if (ret) {
-            printf("cannot start buildtable thread %ld\n", i);
-            exit(1);
+            writeall(fdout, sortdata, n * DATASIZE, outfile);
+
+            free(sortdata);
+            free(sorttmp);
         }
-    }
 
-    if (debug) printf("main, started buildtable threads\n");
+        written += bucketstart[0x100];
 
-    // wait for threads to finish
-    for (long i = 0; i < NUM_BUILD_THREADS; i++) {
-        int ret = pthread_join(threads[i], &status);
-        if (ret) {
-            printf("cannot join buildtable thread %ld\n", i);
+        // remove input file
+        close(sp->fd);
+        if (unlink(sp->path)) {
+            printf("cannot remove file %s\n", sp->path);
             exit(1);
         }
-        printf("buildtable thread %ld finished\n", i);
     }
 
-    // write all remaining files
-    for (long i = 0; i < 0x10000; i++) {
-        struct table *t1 = t + i;
-        if (t1->ptr > t1->data) {
-            writetable(t1);
+    index[FANOUT] = written;
+}
+
+static void usage(const char *name) {
+    printf("%s [-t threads] [-m RAM MB] [-n log2 entries] [-o table] [-s spill dir]\n", name);
+    printf("  -t  number of threads, defaults to the number of cores\n");
+    printf("  -m  RAM to use in MB, default 1024\n");
+    printf("  -n  table size as power of 2, default 37, smaller tables are for testing only\n");
+    printf("  -o  table file, default %s\n", HT2TABLE_DEFAULT);
+    printf("  -s  directory for the unsorted spill files, default table\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    int c;
+
+    while ((c = getopt(argc, argv, "t:m:n:o:s:h")) != -1) {
+        switch (c) {
+            case 't':
+                nthreads = atoi(optarg);
+                break;
+            case 'm':
+                ramlimit = strtoull(optarg, NULL, 10) * 1024UL * 1024UL;
+                break;
+            case 'n':
+                log2entries = atoi(optarg);
+                break;
+            case 'o':
+                outfile = optarg;
+                break;
+            case 's':
+                spilldir = optarg;
+                break;
+            default:
+                usage(argv[0]);
         }
     }
 
-    // dump the memory
-    free_tables(t);
-    free(t);
+    if (nthreads <= 0)
+        nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads <= 0)
+        nthreads = 1;
 
+    if (log2entries < 8 || log2entries > 37 || ramlimit == 0)
+        usage(argv[0]);
 
+    printf("building 2^%d entries with %d threads in %" PRIu64 " MB\n", log2entries, nthreads, ramlimit >> 20);
 
-    // now for the sorting
+    // create the spill files
+    create_spills();
 
+    // build the jump table for incremental steps
+    builddi(2048 * nthreads, 1);
 
-    // start the threads
-    for (long i = 0; i < NUM_SORT_THREADS; i++) {
-        int ret = pthread_create(&(threads[i]), NULL, sorttable, (void *)(i));
-        if (ret) {
-            printf("cannot start sorttable thread %ld\n", i);
-            exit(1);
-        }
-    }
+    // build the jump table for setting the offset
+    builddi(2048, 2);
 
-    if (debug) printf("main, started sorttable threads\n");
+    runthreads(buildtable);
 
-    // wait for threads to finish
-    for (long i = 0; i < NUM_SORT_THREADS; i++) {
-        int ret = pthread_join(threads[i], &status);
-        if (ret) {
-            printf("cannot join sorttable thread %ld\n", i);
-            exit(1);
-        }
-        printf("sorttable thread %ld finished\n", i);
+    printf("buildtable finished\n");
+
+    // now for the sorting
+    int fdout = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fdout < 0) {
+        printf("cannot create table %s\n", outfile);
+        exit(1);
+    }
+
+    uint64_t *index = (uint64_t *)calloc(FANOUT + 1, sizeof(uint64_t));
+    if (!index) {
+        printf("cannot calloc index\n");
+        exit(1);
     }
 
-    pthread_exit(NULL);
+    // header and index are written once the entries are in place
+    if (lseek(fdout, HT2TABLE_DATA_OFFSET, SEEK_SET) < 0) {
+        printf("cannot seek in %s\n", outfile);
+        exit(1);
+    }
 
-    return 0;
-}
+    sorttable(fdout, index);
 
+    ht2table_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, HT2TABLE_MAGIC, sizeof(hdr.magic));
+    hdr.entries = index[FANOUT];
+    hdr.entrysize = DATASIZE;
+    hdr.log2entries = log2entries;
 
+    if (lseek(fdout, 0, SEEK_SET) < 0) {
+        printf("cannot seek in %s\n", outfile);
+        exit(1);
+    }
+    writeall(fdout, (unsigned char *)&hdr, sizeof(hdr), outfile);
+    writeall(fdout, (unsigned char *)index, (FANOUT + 1) * sizeof(uint64_t), outfile);
+    close(fdout);
+    free(index);
 
+    rmdir(spilldir);
 
+    printf("sorttable finished, %" PRIu64 " entries in %s\n", hdr.entries, outfile);
+    return 0;
+}
@@ -1,9 +1,13 @@
 /*
  * ht2crack2gentests.c
  * this uses the RFIDler hitag2 PRNG code to generate test cases to test the tables
+ *
+ * With -n the keystreams start inside the part of the PRNG sequence covered by a
+ * table built with the same -n, so the search is expected to recover the key.
  */
 
 #include "ht2crackutils.h"
+#include "ht2crack2table.h"
 
 static int makerandom(char *hex, unsigned int len, int fd) {
     unsigned char raw[32];
@@ -32,6 +36,52 @@ static int makerandom(char *hex, unsigned int len, int fd) {
 }
 
 
+// pick a key that puts the keystream of uid / nR next to a random entry of a 2^log2entries table
+static void makeintable(char *key, char *uid, char *nR, int log2entries, int fd) {
+    Hitag_State hstate;
+    uint64_t entry;
+    uint64_t steps;
+    uint64_t keyrev;
+    uint32_t nRxork;
+    uint32_t uidtmp;
+    uint32_t b = 0;
+    int i;
+
+    if (read(fd, &entry, sizeof(entry)) != sizeof(entry)) {
+        printf("makeintable: cannot read random bytes\n");
+        exit(1);
+    }
+    entry = 1 + entry % ((1ULL << log2entries) - 1);
+
+    // the keystream starts half way between two entries, the search finds the later one
+    hstate.shiftreg = HT2TABLE_START_STATE;
+    buildlfsr(&hstate);
+    for (steps = entry * 2048 - 1024; steps >= 32; steps -= 32) {
+        hitag2_nstep(&hstate, 32);
+    }
+    hitag2_nstep(&hstate, steps);
+
+    // rollback through auth (aR, p3) to the state after initialisation
+    rollback(&hstate, 64);
+
+    // same as recoverkey() in ht2crack2search
+    keyrev = hstate.shiftreg & 0xffff;
+    nRxork = (hstate.shiftreg >> 16) & 0xffffffff;
+    uidtmp = rev32(hexreversetoulong(uid));
+    for (i = 0; i < 32; i++) {
+        hstate.shiftreg = ((hstate.shiftreg) << 1) | ((uidtmp >> 31) & 0x1);
+        uidtmp = uidtmp << 1;
+        b = (b << 1) | fnf(hstate.shiftreg);
+    }
+    keyrev |= (uint64_t)(nRxork ^ rev32(hexreversetoulong(nR)) ^ b) << 16;
+
+    uint64_t k = rev64(keyrev);
+    for (i = 0; i < 6; i++) {
+        sprintf(key + (2 * i), "%02X", (int)(k & 0xff));
+        k = k >> 8;
+    }
+}
+
 int main(int argc, char *argv[]) {
     Hitag_State hstate;
     char key[32];
@@ -41,13 +91,26 @@ int main(int argc, char *argv[]) {
     int i, j;
     int numtests;
     int urandomfd;
+    int log2entries = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:h")) != -1) {
+        switch (c) {
+            case 'n':
+                log2entries = atoi(optarg);
+                break;
+            default:
+                argc = 0;
+        }
+    }
 
-    if (argc < 2) {
-        printf("%s number\n", argv[0]);
+    if (argc - optind < 1 || log2entries < 0 || log2entries > 37) {
+        printf("%s [-n log2entries] number\n", argv[0]);
+        printf("  -n  make the keys findable in a table built with the same -n\n");
         exit(1);
     }
 
-    numtests = atoi(argv[1]);
+    numtests = atoi(argv[optind]);
     if (numtests <= 0) {
         printf("need positive number of tests\n");
         exit(1);
@@ -62,9 +125,13 @@ int main(int argc, char *argv[]) {
 
     for (i = 0; i < numtests; i++) {
 
-        makerandom(key, 6, urandomfd);
         makerandom(uid, 4, urandomfd);
         makerandom(nR, 4, urandomfd);
+        if (log2entries) {
+            makeintable(key, uid, nR, log2entries, urandomfd);
+        } else {
+            makerandom(key, 6, urandomfd);
+        }
         sprintf(filename, "keystream.key-%s.uid-%s.nR-%s", key, uid, nR);
 
         FILE *fp = fopen(filename, "w");
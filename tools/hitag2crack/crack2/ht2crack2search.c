@@ -1,24 +1,107 @@
 /*
  * ht2crack2search.c
- * this searches the sorted tables for the given RNG data, retrieves the matching
+ * this searches the sorted table for the given RNG data, retrieves the matching
  * PRNG state, checks it is correct, and then rolls back the PRNG to recover the key
  */
 
 #include "ht2crackutils.h"
-
-#define INPUTFILE "sorted/%02x/%02x.bin"
-#define DATASIZE 10
+#include "ht2crack2table.h"
+#include <inttypes.h>
 
 struct rngdata {
     unsigned char *data;
     int len;
 };
 
-static int datacmp(const void *p1, const void *p2) {
-    unsigned char *d1 = (unsigned char *)p1;
-    unsigned char *d2 = (unsigned char *)p2;
+// the table, mapped once for all searches
+struct table {
+    const uint64_t *index;
+    const unsigned char *data;
+    uint64_t entries;
+    void *map;
+    size_t size;
+};
+
+static struct table tbl;
+
+static void opentable(const char *file) {
+    int fd = open(file, O_RDONLY);
+    if (fd < 0) {
+        printf("cannot open table file %s\n", file);
+        exit(1);
+    }
+
+    struct stat filestat;
+    if (fstat(fd, &filestat)) {
+        printf("cannot stat file %s\n", file);
+        exit(1);
+    }
+
+    if (filestat.st_size < (off_t)HT2TABLE_DATA_OFFSET) {
+        printf("table file %s is too small\n", file);
+        exit(1);
+    }
+
+    tbl.map = mmap((caddr_t)0, filestat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (tbl.map == MAP_FAILED) {
+        printf("cannot mmap file %s\n", file);
+        exit(1);
+    }
+    close(fd);
+    tbl.size = filestat.st_size;
+
+    // lookups jump all over the file
+    madvise(tbl.map, tbl.size, MADV_RANDOM);
+
+    const ht2table_header_t *hdr = (const ht2table_header_t *)tbl.map;
+    if (memcmp(hdr->magic, HT2TABLE_MAGIC, sizeof(hdr->magic)) || hdr->entrysize != DATASIZE
+            || HT2TABLE_DATA_OFFSET + hdr->entries * DATASIZE > (uint64_t)filestat.st_size) {
+        printf("%s is not a valid table, rebuild it with ht2crack2buildtable\n", file);
+        exit(1);
+    }
 
-    return memcmp(d1, d2, DATASIZE - 6);
+    tbl.entries = hdr->entries;
+    tbl.index = (const uint64_t *)((const unsigned char *)tbl.map + HT2TABLE_INDEX_OFFSET);
+    tbl.data = (const unsigned char *)tbl.map + HT2TABLE_DATA_OFFSET;
+
+    printf("table %s: 2^%u states, %" PRIu64 " entries\n", file, hdr->log2entries, tbl.entries);
+}
+
+static inline uint32_t entrykey(uint64_t i) {
+    const unsigned char *e = tbl.data + i * DATASIZE;
+    return ((uint32_t)e[0] << 24) | ((uint32_t)e[1] << 16) | ((uint32_t)e[2] << 8) | e[3];
+}
+
+// first entry with <key> in [lo, hi), -1 if there is none.
+// keystream is uniformly distributed, so interpolation lands next to the entry
+// within a probe or two.  If it doesn't, fall back to halving.
+static int64_t findfirst(uint64_t lo, uint64_t hi, uint32_t key) {
+    int probes = 0;
+
+    while (lo < hi) {
+        uint32_t klo = entrykey(lo);
+        uint32_t khi = entrykey(hi - 1);
+        if (key < klo || key > khi)
+            return -1;
+
+        uint64_t mid;
+        if (probes++ < 8 && khi != klo)
+            mid = lo + ((uint64_t)(key - klo) * (hi - 1 - lo)) / (khi - klo);
+        else
+            mid = lo + (hi - lo) / 2;
+
+        uint32_t k = entrykey(mid);
+        if (k < key) {
+            lo = mid + 1;
+        } else if (k > key) {
+            hi = mid;
+        } else {
+            while (mid > lo && entrykey(mid - 1) == key)
+                mid--;
+            return mid;
+        }
+    }
+    return -1;
 }
 
 static int loadrngdata(struct rngdata *r, char *file) {
@@ -153,88 +236,62 @@ static int testcand(const unsigned char *f, unsigned char *rt, int fwd) {
 }
 
 static int searchcand(unsigned char *c, unsigned char *rt, int fwd, unsigned char *m, unsigned char *s) {
-    int fd;
-    struct stat filestat;
-    char file[64];
-    unsigned char *data;
-    unsigned char item[10];
-    unsigned char *found = NULL;
-
 
     if (!c || !rt || !m || !s) {
         printf("searchcand: invalid params\n");
         return 0;
     }
 
-    sprintf(file, INPUTFILE, c[0], c[1]);
-
-    fd = open(file, O_RDONLY);
-    if (fd <= 0) {
-        printf("cannot open table file %s\n", file);
-        exit(1);
-    }
-
-    if (fstat(fd, &filestat)) {
-        printf("cannot stat file %s\n", file);
-        exit(1);
-    }
-
-    data = mmap((caddr_t)0, filestat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    if (data == MAP_FAILED) {
-        printf("cannot mmap file %s\n", file);
-        exit(1);
-    }
-
-    memcpy(item, c + 2, 4);
-
-    found = (unsigned char *)bsearch(item, data, filestat.st_size / DATASIZE, DATASIZE, datacmp);
+    // the first two bytes select the bucket in the fanout index
+    int prefix = (c[0] << 8) | c[1];
+    uint64_t hi = tbl.index[prefix + 1];
+    uint32_t key = ((uint32_t)c[2] << 24) | ((uint32_t)c[3] << 16) | ((uint32_t)c[4] << 8) | c[5];
 
-    if (found) {
-
-        // our candidate is in the table
-        // go backwards and see if there are other matches
-        while (((found - data) >= DATASIZE) && (!memcmp(found - DATASIZE, item, 4))) {
-            found = found - DATASIZE;
-        }
-
-        // now test all matches
-        while (((found - data) <= (filestat.st_size - DATASIZE)) && (!memcmp(found, item, 4))) {
-            if (testcand(found, rt, fwd)) {
-                memcpy(m, c, 2);
-                memcpy(m + 2, found, 4);
-                memcpy(s, found + 4, 6);
-
-                munmap(data, filestat.st_size);
-                close(fd);
-                return 1;
-            }
+    int64_t found = findfirst(tbl.index[prefix], hi, key);
+    if (found < 0)
+        return 0;
 
-            found = found + DATASIZE;
+    // our candidate is in the table, test all matches
+    for (uint64_t i = found; i < hi && entrykey(i) == key; i++) {
+        const unsigned char *e = tbl.data + i * DATASIZE;
+        if (testcand(e, rt, fwd)) {
+            memcpy(m, c, 2);
+            memcpy(m + 2, e, 4);
+            memcpy(s, e + 4, 6);
+            return 1;
         }
     }
 
-    munmap(data, filestat.st_size);
-    close(fd);
-
     return 0;
-
 }
 
-static int findmatch(struct rngdata *r, unsigned char *outmatch, unsigned char *outstate, int *bitoffset) {
-    int i;
-    int bitlen;
+// keystream windows are searched by all threads, each claims the next bit offset
+struct search {
+    struct rngdata *r;
+    int next;
+    int best;
+    unsigned char match[6];
+    unsigned char state[6];
+    pthread_mutex_t mutex;
+};
+
+static void *searchthread(void *arg) {
+    struct search *sr = (struct search *)arg;
+    struct rngdata *r = sr->r;
+    int bitlen = r->len * 8;
     unsigned char cand[6];
     unsigned char rngtest[6];
+    unsigned char m[6];
+    unsigned char st[6];
     int fwd;
 
-    if (!r || !outmatch || !outstate || !bitoffset) {
-        printf("findmatch: invalid params\n");
-        return 0;
-    }
+    for (;;) {
+        int i = __atomic_fetch_add(&sr->next, 1, __ATOMIC_RELAXED);
 
-    bitlen = r->len * 8;
+        // windows are claimed in order, nothing after a hit can be better
+        if (i > bitlen - 48 || i >= __atomic_load_n(&sr->best, __ATOMIC_RELAXED))
+            break;
 
-    for (i = 0; i <= bitlen - 48; i++) {
         // print progress
         if ((i % 100) == 0) {
             printf("searching on bit %d\n", i);
@@ -242,33 +299,76 @@ static int findmatch(struct rngdata *r, unsigned char *outmatch, unsigned char *
 
         if (!makecand(cand, r, i)) {
             printf("cannot makecand, %d\n", i);
-            return 0;
+            break;
         }
-//        printf("cand: %02x %02x %02x %02x %02x %02x : ", cand[0], cand[1], cand[2], cand[3], cand[4], cand[5]);
-//        printbin(cand);
 
         /* make following or preceding RNG test data to confirm match */
         if (i < (bitlen - 96)) {
             if (!makecand(rngtest, r, i + 48)) {
                 printf("cannot makecand rngtest %d + 48\n", i);
-                return 0;
+                break;
             }
             fwd = 1;
         } else {
             if (!makecand(rngtest, r, i - 48)) {
                 printf("cannot makecand rngtest %d - 48\n", i);
-                return 0;
+                break;
             }
             fwd = 0;
         }
 
-        if (searchcand(cand, rngtest, fwd, outmatch, outstate)) {
-            *bitoffset = i;
-            return 1;
+        if (searchcand(cand, rngtest, fwd, m, st)) {
+            pthread_mutex_lock(&sr->mutex);
+            if (i < sr->best) {
+                memcpy(sr->match, m, 6);
+                memcpy(sr->state, st, 6);
+                __atomic_store_n(&sr->best, i, __ATOMIC_RELAXED);
+            }
+            pthread_mutex_unlock(&sr->mutex);
+            break;
         }
     }
+    return NULL;
+}
 
-    return 0;
+static int findmatch(struct rngdata *r, unsigned char *outmatch, unsigned char *outstate, int *bitoffset, int nthreads) {
+
+    if (!r || !outmatch || !outstate || !bitoffset) {
+        printf("findmatch: invalid params\n");
+        return 0;
+    }
+
+    struct search sr;
+    memset(&sr, 0, sizeof(sr));
+    sr.r = r;
+    sr.best = INT32_MAX;
+    pthread_mutex_init(&sr.mutex, NULL);
+
+    pthread_t *threads = (pthread_t *)calloc(nthreads, sizeof(pthread_t));
+    if (!threads) {
+        printf("findmatch: cannot calloc threads\n");
+        return 0;
+    }
+
+    for (int i = 0; i < nthreads; i++) {
+        if (pthread_create(&threads[i], NULL, searchthread, &sr)) {
+            printf("cannot start search thread %d\n", i);
+            exit(1);
+        }
+    }
+    for (int i = 0; i < nthreads; i++)
+        pthread_join(threads[i], NULL);
+
+    free(threads);
+    pthread_mutex_destroy(&sr.mutex);
+
+    if (sr.best == INT32_MAX)
+        return 0;
+
+    memcpy(outmatch, sr.match, 6);
+    memcpy(outstate, sr.state, 6);
+    *bitoffset = sr.best;
+    return 1;
 }
 
 static void rollbackrng(Hitag_State *hstate, const unsigned char *s, int offset) {
@@ -361,31 +461,53 @@ int main(int argc, char *argv[]) {
     uint64_t keyrev;
     uint64_t key;
     int i;
+    int c;
+    int nthreads = 0;
+    const char *tablefile = HT2TABLE_DEFAULT;
+
+    while ((c = getopt(argc, argv, "f:t:h")) != -1) {
+        switch (c) {
+            case 'f':
+                tablefile = optarg;
+                break;
+            case 't':
+                nthreads = atoi(optarg);
+                break;
+            default:
+                argc = 0;
+        }
+    }
 
-    if (argc < 4) {
-        printf("%s rngdatafile UID nR\n", argv[0]);
+    if (argc - optind < 3) {
+        printf("%s [-f table] [-t threads] rngdatafile UID nR\n", argv[0]);
         exit(1);
     }
 
-    if (!loadrngdata(&rng, argv[1])) {
+    if (nthreads <= 0)
+        nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads <= 0)
+        nthreads = 1;
+
+    if (!loadrngdata(&rng, argv[optind])) {
         printf("loadrngdata failed\n");
         exit(1);
     }
 
-    if (!strncmp(argv[2], "0x", 2)) {
-        uidstr = argv[2] + 2;
+    if (!strncmp(argv[optind + 1], "0x", 2)) {
+        uidstr = argv[optind + 1] + 2;
     } else {
-        uidstr = argv[2];
+        uidstr = argv[optind + 1];
     }
 
-    if (!strncmp(argv[3], "0x", 2)) {
-        nRstr = argv[3] + 2;
+    if (!strncmp(argv[optind + 2], "0x", 2)) {
+        nRstr = argv[optind + 2] + 2;
     } else {
-        nRstr = argv[3];
+        nRstr = argv[optind + 2];
     }
 
+    opentable(tablefile);
 
-    if (!findmatch(&rng, rngmatch, rngstate, &bitoffset)) {
+    if (!findmatch(&rng, rngmatch, rngstate, &bitoffset, nthreads)) {
         printf("couldn't find a match\n");
         exit(1);
     }
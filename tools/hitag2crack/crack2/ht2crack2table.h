@@ -0,0 +1,42 @@
+/*
+ * ht2crack2table.h
+ * single file table format shared by ht2crack2buildtable and ht2crack2search
+ *
+ * layout:
+ *   header
+ *   fanout index, 65537 x uint64_t: entry number of the first entry for each
+ *                 16 bit keystream prefix, plus the total at the end
+ *   entries, 10 bytes each: keystream bytes 2-5 + 6 bytes of PRNG state,
+ *                 sorted on the keystream bytes within each prefix
+ */
+
+#ifndef HT2CRACK2TABLE_H
+#define HT2CRACK2TABLE_H
+
+#include <stdint.h>
+
+#define HT2TABLE_MAGIC      "HT2TBL01"
+#define HT2TABLE_DEFAULT    "ht2crack2.table"
+
+// the table walks the PRNG sequence from this state on
+#define HT2TABLE_START_STATE    0x123456789abcULL
+
+// DATASIZE is the number of bytes in an entry.  This is 10; 4 bytes of keystream (2 are in the index) +
+// 6 bytes of PRNG state.
+#define DATASIZE            10
+#define KEYSIZE             4
+
+#define FANOUT              0x10000
+
+typedef struct {
+    char magic[8];
+    uint64_t entries;
+    uint32_t entrysize;
+    uint32_t log2entries;   // table holds 2^n PRNG states, 2048 steps apart
+    uint64_t reserved[6];
+} ht2table_header_t;
+
+#define HT2TABLE_INDEX_OFFSET   (sizeof(ht2table_header_t))
+#define HT2TABLE_DATA_OFFSET    (HT2TABLE_INDEX_OFFSET + (FANOUT + 1) * sizeof(uint64_t))
+
+#endif /* HT2CRACK2TABLE_H */
@@ -9,6 +9,7 @@
 #include <unistd.h>
 #include <ctype.h>
 #include "crapto1/crapto1.h"
+#include "crapto1/crypto1_bs.h"
 #include "protocol.h"
 #include "iso14443crc.h"
 #include "util_posix.h"
@@ -460,50 +461,76 @@ static void *brute_thread(void *arguments) {
     return NULL;
 }
 
+static bool try_key(const struct thread_key_args *args, const uint8_t *local_enc, uint64_t key) {
+
+    // Init cipher with key
+    struct Crypto1State *pcs = crypto1_create(key);
+
+    // NESTED decrypt nt with help of new key
+    crypto1_word(pcs, args->nt_enc ^ args->uid, 1);
+    crypto1_word(pcs, args->nr_enc, 1);
+    crypto1_word(pcs, 0, 0);
+    crypto1_word(pcs, 0, 0);
+
+    // decrypt 22 bytes
+    uint8_t dec[args->enc_len];
+    for (int i = 0; i < args->enc_len; i++)
+        dec[i] = crypto1_byte(pcs, 0x00, 0) ^ local_enc[i];
+
+    crypto1_destroy(pcs);
+
+    // check if cmd exists
+    if (checkValidCmdByte(dec, args->enc_len) == false) {
+        return false;
+    }
+    __sync_fetch_and_add(&global_found, 1);
+
+    // lock this section to avoid interlacing prints from different threats
+    pthread_mutex_lock(&print_lock);
+    printf("\nenc:  %s\n", sprint_hex_inrow_ex(local_enc, args->enc_len, 0));
+    printf("dec:  %s\n", sprint_hex_inrow_ex(dec, args->enc_len, 0));
+    printf("\nValid Key found [ " _GREEN_("%012" PRIx64) " ]\n\n", key);
+    pthread_mutex_unlock(&print_lock);
+    return true;
+}
+
+// Keys are tried CRYPTO1_BS_LANES at a time with the bitsliced cipher. Only lanes
+// where the first decrypted byte is a known command get the full check.
 static void *brute_key_thread(void *arguments) {
 
     struct thread_key_args *args = (struct thread_key_args *) arguments;
-    uint64_t key;
     uint8_t local_enc[args->enc_len];
     memcpy(local_enc, args->enc, args->enc_len);
 
-    for (uint64_t count = args->idx; count <= 0xFFFF; count += thread_count) {
+    crypto1_bs_state_t bs;
+    uint64_t keys[CRYPTO1_BS_LANES];
+
+    for (uint64_t base = args->idx * CRYPTO1_BS_LANES; base <= 0xFFFF; base += thread_count * CRYPTO1_BS_LANES) {
 
         if (__atomic_load_n(&global_found, __ATOMIC_ACQUIRE) == 1) {
             break;
         }
 
-        key = args->part_key | (count << 32);
+        for (int l = 0; l < CRYPTO1_BS_LANES; l++)
+            keys[l] = args->part_key | ((base + l) << 32);
 
-        // Init cipher with key
-        struct Crypto1State *pcs = crypto1_create(key);
+        crypto1_bs_load_keys(&bs, keys, CRYPTO1_BS_LANES);
+        crypto1_bs_word(&bs, args->nt_enc ^ args->uid, true, NULL);
+        crypto1_bs_word(&bs, args->nr_enc, true, NULL);
+        crypto1_bs_word(&bs, 0, false, NULL);
+        crypto1_bs_word(&bs, 0, false, NULL);
 
-        // NESTED decrypt nt with help of new key
-        crypto1_word(pcs, args->nt_enc ^ args->uid, 1);
-        crypto1_word(pcs, args->nr_enc, 1);
-        crypto1_word(pcs, 0, 0);
-        crypto1_word(pcs, 0, 0);
+        crypto1_bs_t ks[8];
+        crypto1_bs_byte(&bs, 0, false, ks);
 
-        // decrypt 22 bytes
-        uint8_t dec[args->enc_len];
-        for (int i = 0; i < args->enc_len; i++)
-            dec[i] = crypto1_byte(pcs, 0x00, 0) ^ local_enc[i];
+        crypto1_bs_t lanes = 0;
+        for (int i = 0; i < 8; i++)
+            lanes |= crypto1_bs_match(ks, cmds[i][0] ^ local_enc[0], 8);
 
-        crypto1_destroy(pcs);
-
-        // check if cmd exists
-        if (checkValidCmdByte(dec, args->enc_len) == false) {
-            continue;
+        for (; lanes; lanes &= lanes - 1) {
+            if (try_key(args, local_enc, keys[__builtin_ctzll(lanes)]))
+                break;
         }
-        __sync_fetch_and_add(&global_found, 1);
-
-        // lock this section to avoid interlacing prints from different threats
-        pthread_mutex_lock(&print_lock);
-        printf("\nenc:  %s\n", sprint_hex_inrow_ex(local_enc, args->enc_len, 0));
-        printf("dec:  %s\n", sprint_hex_inrow_ex(dec, args->enc_len, 0));
-        printf("\nValid Key found [ " _GREEN_("%012" PRIx64) " ]\n\n", key);
-        pthread_mutex_unlock(&print_lock);
-        break;
     }
     free(args);
     return NULL;
@@ -511,7 +538,8 @@ static void *brute_key_thread(void *arguments) {
 
 static int usage(void) {
     printf("\n");
-    printf("syntax:  mf_nonce_brute <uid> <nt> <nt_par_err> <nr> <ar> <ar_par_err> <at> <at_par_err> [<next_command>]\n\n");
+    printf("syntax:  mf_nonce_brute [-t <threads>] <uid> <nt> <nt_par_err> <nr> <ar> <ar_par_err> <at> <at_par_err> [<next_command>]\n\n");
+    printf("     -t <threads>  number of threads, at least 2 (def: number of cpus)\n\n");
     printf("how to convert trace data to needed input:\n");
     printf("    nt in trace = 8c! 42 e6! 4e!\n");
     printf("             nt = 8c42e64e\n");
@@ -535,6 +563,13 @@ static int usage(void) {
 int main(int argc, char *argv[]) {
     printf("\nMifare classic nested auth key recovery\n\n");
 
+    int user_threads = 0;
+    if (argc > 2 && strcmp(argv[1], "-t") == 0) {
+        user_threads = atoi(argv[2]);
+        argv += 2;
+        argc -= 2;
+    }
+
     if (argc < 9) return usage();
 
     sscanf(argv[1], "%x", &uid);
@@ -578,9 +613,11 @@ int main(int argc, char *argv[]) {
 
 #if !defined(_WIN32) || !defined(__WIN32__)
     thread_count = sysconf(_SC_NPROCESSORS_CONF);
+#endif  /* _WIN32 */
+    if (user_threads)
+        thread_count = user_threads;
     if (thread_count < 2)
         thread_count = 2;
-#endif  /* _WIN32 */
 
     printf("\nBruteforce using " _YELLOW_("%d") " threads\n", thread_count);
     printf("looking for the last bytes of the encrypted tagnonce\n");
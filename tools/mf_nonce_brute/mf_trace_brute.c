@@ -18,6 +18,7 @@
 #include <unistd.h>
 #include "ctype.h"
 #include "crapto1/crapto1.h"
+#include "crapto1/crypto1_bs.h"
 #include "protocol.h"
 #include "iso14443crc.h"
 #include <util_posix.h>
@@ -192,49 +193,75 @@ static bool checkValidCmdByte(uint8_t *cmd, uint16_t n) {
     return false;
 }
 
+static bool try_key(const struct thread_args *args, const uint8_t *local_enc, uint64_t key) {
+
+    // Init cipher with key
+    struct Crypto1State *pcs = crypto1_create(key);
+
+    // NESTED decrypt nt with help of new key
+    crypto1_word(pcs, args->nt_enc ^ args->uid, 1);
+    crypto1_word(pcs, args->nr_enc, 1);
+    crypto1_word(pcs, 0, 0);
+    crypto1_word(pcs, 0, 0);
+
+    // decrypt 22 bytes
+    uint8_t dec[args->enc_len];
+    for (int i = 0; i < args->enc_len; i++)
+        dec[i] = crypto1_byte(pcs, 0x00, 0) ^ local_enc[i];
+
+    crypto1_destroy(pcs);
+
+    if (checkValidCmdByte(dec, args->enc_len) == false) {
+        return false;
+    }
+    __sync_fetch_and_add(&global_found, 1);
+
+    // lock this section to avoid interlacing prints from different threats
+    pthread_mutex_lock(&print_lock);
+    printf("\nenc:  %s\n", sprint_hex_inrow_ex(local_enc, args->enc_len, 0));
+    printf("dec:  %s\n", sprint_hex_inrow_ex(dec, args->enc_len, 0));
+    printf("\nValid Key found [ " _GREEN_("%012" PRIx64) " ]\n\n", key);
+    pthread_mutex_unlock(&print_lock);
+    return true;
+}
+
+// Keys are tried CRYPTO1_BS_LANES at a time with the bitsliced cipher. Only lanes
+// where the first decrypted byte is a known command get the full check.
 static void *brute_thread(void *arguments) {
 
     struct thread_args *args = (struct thread_args *) arguments;
-    uint64_t key = args->part_key;
     uint8_t local_enc[args->enc_len];
     memcpy(local_enc, args->enc, args->enc_len);
 
-    for (uint64_t count = args->idx; count < 0xFFFF; count += thread_count) {
+    crypto1_bs_state_t bs;
+    uint64_t keys[CRYPTO1_BS_LANES];
+
+    for (uint64_t base = args->idx * CRYPTO1_BS_LANES; base <= 0xFFFF; base += thread_count * CRYPTO1_BS_LANES) {
 
         if (__atomic_load_n(&global_found, __ATOMIC_ACQUIRE) == 1) {
             break;
         }
 
-        key |= count << 32;
+        for (int l = 0; l < CRYPTO1_BS_LANES; l++)
+            keys[l] = args->part_key | ((base + l) << 32);
 
-        // Init cipher with key
-        struct Crypto1State *pcs = crypto1_create(key);
+        crypto1_bs_load_keys(&bs, keys, CRYPTO1_BS_LANES);
+        crypto1_bs_word(&bs, args->nt_enc ^ args->uid, true, NULL);
+        crypto1_bs_word(&bs, args->nr_enc, true, NULL);
+        crypto1_bs_word(&bs, 0, false, NULL);
+        crypto1_bs_word(&bs, 0, false, NULL);
 
-        // NESTED decrypt nt with help of new key
-        crypto1_word(pcs, args->nt_enc ^ args->uid, 1);
-        crypto1_word(pcs, args->nr_enc, 1);
-        crypto1_word(pcs, 0, 0);
-        crypto1_word(pcs, 0, 0);
+        crypto1_bs_t ks[8];
+        crypto1_bs_byte(&bs, 0, false, ks);
 
-        // decrypt 22 bytes
-        uint8_t dec[args->enc_len];
-        for (int i = 0; i < args->enc_len; i++)
-            dec[i] = crypto1_byte(pcs, 0x00, 0) ^ local_enc[i];
+        crypto1_bs_t lanes = 0;
+        for (int i = 0; i < 8; i++)
+            lanes |= crypto1_bs_match(ks, cmds[i][0] ^ local_enc[0], 8);
 
-        crypto1_destroy(pcs);
-
-        if (checkValidCmdByte(dec, args->enc_len) == false) {
-            continue;
+        for (; lanes; lanes &= lanes - 1) {
+            if (try_key(args, local_enc, keys[__builtin_ctzll(lanes)]))
+                break;
         }
-        __sync_fetch_and_add(&global_found, 1);
-
-        // lock this section to avoid interlacing prints from different threats
-        pthread_mutex_lock(&print_lock);
-        printf("\nenc:  %s\n", sprint_hex_inrow_ex(local_enc, args->enc_len, 0));
-        printf("dec:  %s\n", sprint_hex_inrow_ex(dec, args->enc_len, 0));
-        printf("\nValid Key found [ " _GREEN_("%012" PRIx64) " ]\n\n", key);
-        pthread_mutex_unlock(&print_lock);
-        break;
     }
 
     free(args);
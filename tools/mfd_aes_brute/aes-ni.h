@@ -1,157 +1,107 @@
 #ifndef __AES_NI_H__
 #define __AES_NI_H__
 
-#include "aes-ni.h"
-// #include <stdint.h>     //for int8_t
-// #include <string.h>     //for memcmp
-// #include <wmmintrin.h>  //for intrinsics for AES-NI
-//compile using gcc and following arguments: -g;-O0;-Wall;-msse2;-msse;-march=native;-maes
-
-/*
-static void AES_CBC_decrypt(const uint8_t *in,  uint8_t *out,  uint8_t iv[],  uint8_t len, uint8_t *key) {
-
-    __m128i data, last_in;
-    __m128i feedback = _mm_loadu_si128 ((__m128i*)iv);
-
-    uint j;
-    for (uint8_t i = 0; i < len; i++){
-        last_in =_mm_loadu_si128 (&((__m128i*)in)[i]);
-        data = _mm_xor_si128 (last_in, ((__m128i*)key)[0]);
-
-        for (j = 1; j < 10; j++){
-            data = _mm_aesdec_si128 (data, ((__m128i*)key)[j]);
-        }
-        data = _mm_aesdeclast_si128 (data,((__m128i*)key)[j]);
-        data = _mm_xor_si128 (data, feedback);
-        _mm_storeu_si128 (&((__m128i*)out)[i], data);
-        feedback = last_in;
-    }
-}
-*/
-
-/*
-INLINE static __m128i AES_128_ASSIST (__m128i temp1, __m128i temp2) {
-    __m128i temp3;
-    temp2 = _mm_shuffle_epi32 (temp2 ,0xff);
-    temp3 = _mm_slli_si128 (temp1, 0x4);
-    temp1 = _mm_xor_si128 (temp1, temp3);
-    temp3 = _mm_slli_si128 (temp3, 0x4);
-    temp1 = _mm_xor_si128 (temp1, temp3);
-    temp3 = _mm_slli_si128 (temp3, 0x4);
-    temp1 = _mm_xor_si128 (temp1, temp3);
-    temp1 = _mm_xor_si128 (temp1, temp2);
-    return temp1;
-}
-
-static void AES_128_Key_Expansion (uint8_t *userkey, __m128i *key) {
-    __m128i temp1, temp2;
-    temp1 = _mm_loadu_si128((__m128i*)userkey);
-    key[0] = temp1;
-    temp2 = _mm_aeskeygenassist_si128 (temp1 ,0x1);
-    temp1 = AES_128_ASSIST(temp1, temp2);
-    key[1] = temp1;
-    temp2 = _mm_aeskeygenassist_si128 (temp1,0x2);
-    temp1 = AES_128_ASSIST(temp1, temp2);
-    key[2] = temp1;
-    temp2 = _mm_aeskeygenassist_si128 (temp1,0x4);
-    temp1 = AES_128_ASSIST(temp1, temp2);
-    key[3] = temp1;
-    temp2 = _mm_aeskeygenassist_si128 (temp1,0x8);
-    temp1 = AES_128_ASSIST(temp1, temp2);
-    key[4] = temp1;
-    temp2 = _mm_aeskeygenassist_si128 (temp1,0x10);
-    temp1 = AES_128_ASSIST(temp1, temp2);
-    key[5] = temp1;
-    temp2 = _mm_aeskeygenassist_si128 (temp1,0x20);
-    temp1 = AES_128_ASSIST(temp1, temp2);
-    key[6] = temp1;
-    temp2 = _mm_aeskeygenassist_si128 (temp1,0x40);
-    temp1 = AES_128_ASSIST(temp1, temp2);
-    key[7] = temp1;
-    temp2 = _mm_aeskeygenassist_si128 (temp1,0x80);
-    temp1 = AES_128_ASSIST(temp1, temp2);
-    key[8] = temp1;
-    temp2 = _mm_aeskeygenassist_si128 (temp1,0x1b);
-    temp1 = AES_128_ASSIST(temp1, temp2);
-    key[9] = temp1;
-    temp2 = _mm_aeskeygenassist_si128 (temp1,0x36);
-    temp1 = AES_128_ASSIST(temp1, temp2);
-    key[10] = temp1;
-}
-
-static void aes_inv_key_10(AESContext * ctx) {
-
-    __m128i* keysched = (__m128i*)ctx->keysched;
-    __m128i* invkeysched = (__m128i*)ctx->invkeysched;
-
-    *(invkeysched + 10) = *(keysched + 0);
-    *(invkeysched + 9) = _mm_aesimc_si128(*(keysched + 1));
-    *(invkeysched + 8) = _mm_aesimc_si128(*(keysched + 2));
-    *(invkeysched + 7) = _mm_aesimc_si128(*(keysched + 3));
-    *(invkeysched + 6) = _mm_aesimc_si128(*(keysched + 4));
-    *(invkeysched + 5) = _mm_aesimc_si128(*(keysched + 5));
-    *(invkeysched + 4) = _mm_aesimc_si128(*(keysched + 6));
-    *(invkeysched + 3) = _mm_aesimc_si128(*(keysched + 7));
-    *(invkeysched + 2) = _mm_aesimc_si128(*(keysched + 8));
-    *(invkeysched + 1) = _mm_aesimc_si128(*(keysched + 9));
-    *(invkeysched + 0) = *(keysched + 10);
+// AES-128 key schedule + decrypt kernels using the x86 AES instructions.
+//
+// Bruteforcing spends almost all of its time expanding a fresh key for every
+// candidate. aesenclast / aesdec have a latency of several cycles but can
+// start a new one every cycle, so AES_NI_LANES independent keys are expanded
+// and decrypted side by side to keep the unit busy.
+//
+// The functions are compiled for AES + SSE4.1 regardless of the -march used for
+// the rest of the file, callers must check platform_aes_hw_available() first.
+
+#include <stdint.h>
+
+#define AES_NI_LANES    8
+
+#if (defined(__x86_64__) || defined(__i386)) && (defined(__clang__) || defined(__GNUC__))
+
+#define AES_NI_AVAILABLE 1
+
+#include <wmmintrin.h>  // AES-NI
+#include <tmmintrin.h>  // _mm_shuffle_epi8, _mm_alignr_epi8
+
+#define AES_NI_TARGET __attribute__((target("aes,sse4.1")))
+
+// aeskeygenassist is microcoded and slow on most cores. With all four columns
+// holding RotWord(w3), ShiftRows is a no-op and aesenclast does SubWord + rcon.
+AES_NI_TARGET
+static inline __m128i aes_ni_expand_round(__m128i key, __m128i rcon) {
+    const __m128i rotword = _mm_set1_epi32(0x0c0f0e0d);
+    __m128i t = _mm_aesenclast_si128(_mm_shuffle_epi8(key, rotword), rcon);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 8));
+    return _mm_xor_si128(key, t);
 }
 
-static void aes_decrypt_cbc_ni(const uint8_t *in,  uint8_t *out,  uint8_t iv[],  uint8_t len, uint8_t *key) {
-
-    __m128i dec = _mm_setzero_si128();
-    __m128i* block = (__m128i*)in;
-    const __m128i* finish = (__m128i*)(in + len);
-
-    // Load IV
-    __m128i iv = _mm_loadu_si128((__m128i*)iv);
-
-    while (block < finish) {
-
-        // Key schedule ptr
-        __m128i* keysched = (__m128i*)ctx->invkeysched;
-        __m128i last = _mm_loadu_si128(block);
+// Expand AES_NI_LANES keys into decryption round keys, in the order aesdec uses them
+AES_NI_TARGET
+static inline void aes_ni_dec_keys(const uint8_t keys[AES_NI_LANES][16], __m128i dk[AES_NI_LANES][11]) {
+    static const uint8_t rcons[10] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
+    __m128i ks[AES_NI_LANES][11];
 
-        dec  = _mm_xor_si128(last, *keysched);
+    for (int l = 0; l < AES_NI_LANES; l++)
+        ks[l][0] = _mm_loadu_si128((const __m128i *)keys[l]);
 
-        dec = _mm_aesdec_si128(dec, *(++keysched));
-        dec = _mm_aesdec_si128(dec, *(++keysched));
-        dec = _mm_aesdec_si128(dec, *(++keysched));
-        dec = _mm_aesdec_si128(dec, *(++keysched));
-        dec = _mm_aesdec_si128(dec, *(++keysched));
-        dec = _mm_aesdec_si128(dec, *(++keysched));
-        dec = _mm_aesdec_si128(dec, *(++keysched));
-        dec = _mm_aesdec_si128(dec, *(++keysched));
-        dec = _mm_aesdec_si128(dec, *(++keysched));
-        dec = _mm_aesdeclast_si128(dec, *(++keysched));
-
-        /// Xor data with IV
-        dec  = _mm_xor_si128(iv, dec);
-
-        // Store data
-        _mm_storeu_si128(block, dec);
-        iv = last;
-
-        // Go to next block
-        ++block;
+    for (int r = 1; r < 11; r++) {
+        __m128i rcon = _mm_set1_epi32(rcons[r - 1]);
+        for (int l = 0; l < AES_NI_LANES; l++)
+            ks[l][r] = aes_ni_expand_round(ks[l][r - 1], rcon);
     }
 
-    // Update IV
-    _mm_storeu_si128((__m128i*)iv, dec);
+    // equivalent inverse cipher
+    for (int l = 0; l < AES_NI_LANES; l++) {
+        dk[l][0] = ks[l][10];
+        for (int r = 1; r < 10; r++)
+            dk[l][r] = _mm_aesimc_si128(ks[l][10 - r]);
+        dk[l][10] = ks[l][0];
+    }
 }
 
-static void aes_setup_ni(AESContext * ctx, uint8_t *key) {
-
-    __m128i *keysched = (__m128i*)ctx->keysched;
+// Decrypt one block <in> under AES_NI_LANES keys
+AES_NI_TARGET
+static inline void aes_ni_decrypt_block(__m128i dk[AES_NI_LANES][11], __m128i in, __m128i out[AES_NI_LANES]) {
+    for (int l = 0; l < AES_NI_LANES; l++)
+        out[l] = _mm_xor_si128(in, dk[l][0]);
 
-    ctx->decrypt_cbc = aes_decrypt_cbc_ni;
+    for (int r = 1; r < 10; r++)
+        for (int l = 0; l < AES_NI_LANES; l++)
+            out[l] = _mm_aesdec_si128(out[l], dk[l][r]);
 
-    // Now do the key setup itself.
-    AES_128_Key_Expansion (key, keysched);
+    for (int l = 0; l < AES_NI_LANES; l++)
+        out[l] = _mm_aesdeclast_si128(out[l], dk[l][10]);
+}
 
-    // Now prepare the modified keys for the inverse cipher.
-    aes_inv_key_10(ctx);
+// DESFire AES authentication check for AES_NI_LANES candidate keys.
+//
+// The tag sends ek(RndB), the reader answers with ek(RndA || RndB <<< 8) in CBC
+// mode, chained on the tag challenge. A key is right if the second reader block
+// decrypts to the tag challenge rotated by one byte.
+// Returns a bitmask of the lanes which matched.
+AES_NI_TARGET
+static inline uint32_t aes_ni_check_auth(const uint8_t keys[AES_NI_LANES][16], const uint8_t tag[16], const uint8_t rdr[32]) {
+    __m128i dk[AES_NI_LANES][11];
+    __m128i rndb[AES_NI_LANES];
+    __m128i rndb_rot[AES_NI_LANES];
+
+    aes_ni_dec_keys(keys, dk);
+
+    aes_ni_decrypt_block(dk, _mm_loadu_si128((const __m128i *)tag), rndb);
+    aes_ni_decrypt_block(dk, _mm_loadu_si128((const __m128i *)(rdr + 16)), rndb_rot);
+
+    __m128i chain = _mm_loadu_si128((const __m128i *)rdr);
+    uint32_t found = 0;
+    for (int l = 0; l < AES_NI_LANES; l++) {
+        // iv for the tag block is zero, the reader block chains on the previous one
+        __m128i rot = _mm_alignr_epi8(rndb[l], rndb[l], 1);
+        __m128i rdr_b = _mm_xor_si128(rndb_rot[l], chain);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(rot, rdr_b)) == 0xFFFF)
+            found |= (1U << l);
+    }
+    return found;
 }
-*/
+
+#endif
 
 #endif
@@ -35,6 +35,12 @@
 #include <unistd.h>
 #include "util_posix.h"
 
+#include "aes-ni.h"
+
+#if defined(AES_NI_AVAILABLE) && !defined(__APPLE__) && !defined(__MACH__)
+#include "detectaes.h"
+#endif
+
 #define AEND  "\x1b[0m"
 #define _RED_(s) "\x1b[31m" s AEND
 #define _GREEN_(s) "\x1b[32m" s AEND
@@ -46,6 +52,7 @@ pthread_mutex_t print_lock;
 
 static int global_found = 0;
 static int thread_count = 2;
+static bool use_aesni = false;
 
 typedef struct thread_args {
     int thread;
@@ -74,30 +81,31 @@ static void handleErrors(void) {
     abort();
 }
 
-// source https://wiki.openssl.org/index.php/EVP_Symmetric_Encryption_and_Decryption#Decrypting_the_Message
-static int decrypt_aes(uint8_t ciphertext[], int ciphertext_len, uint8_t key[], uint8_t iv[], uint8_t plaintext[]) {
-    EVP_CIPHER_CTX *ctx;
-    if (!(ctx = EVP_CIPHER_CTX_new()))
-        handleErrors();
-
-    if (1 != EVP_DecryptInit_ex(ctx, EVP_aes_128_cbc(), NULL, key, iv))
-        handleErrors();
-
-    EVP_CIPHER_CTX_set_padding(ctx, 0);
-
-    int len = 0;
-    if (1 != EVP_DecryptUpdate(ctx, plaintext, &len, ciphertext, ciphertext_len))
-        handleErrors();
-
-    int plaintext_len = len;
-
-    if (1 != EVP_DecryptFinal_ex(ctx, plaintext + len, &len))
-        handleErrors();
-
-    plaintext_len += len;
+// Portable path, one OpenSSL context per thread which is only rekeyed per candidate.
+// Only the two blocks the check needs are decrypted, the CBC chaining is done by hand.
+// <in> holds the tag challenge followed by the second reader block.
+static uint32_t check_auth_evp(EVP_CIPHER_CTX *ctx, const uint8_t keys[AES_NI_LANES][16], const uint8_t in[32], const uint8_t rdr[32]) {
+    uint32_t found = 0;
+
+    for (int l = 0; l < AES_NI_LANES; l++) {
+        if (1 != EVP_DecryptInit_ex(ctx, NULL, NULL, keys[l], NULL))
+            handleErrors();
+
+        uint8_t out[32];
+        int len = 0;
+        if (1 != EVP_DecryptUpdate(ctx, out, &len, in, 32))
+            handleErrors();
+
+        // second reader block must be the tag challenge rotated left by one byte
+        bool ok = ((out[31] ^ rdr[15]) == out[0]);
+        for (int i = 0; ok && i < 15; i++) {
+            ok = ((out[16 + i] ^ rdr[i]) == out[1 + i]);
+        }
 
-    EVP_CIPHER_CTX_free(ctx);
-    return plaintext_len;
+        if (ok)
+            found |= (1U << l);
+    }
+    return found;
 }
 
 static int hexstr_to_byte_array(char hexstr[], uint8_t bytes[], size_t byte_len) {
@@ -157,41 +165,49 @@ static void *brute_thread(void *arguments) {
     memcpy(local_tag, args->tag, 16);
     memcpy(local_rdr, args->rdr, 32);
 
-    for (uint64_t i = starttime + args->idx; i < stoptime; i += thread_count) {
+    EVP_CIPHER_CTX *ctx = NULL;
+    uint8_t evp_in[32];
+    if (use_aesni == false) {
+        if (!(ctx = EVP_CIPHER_CTX_new()))
+            handleErrors();
+
+        if (1 != EVP_DecryptInit_ex(ctx, EVP_aes_128_ecb(), NULL, NULL, NULL))
+            handleErrors();
+
+        EVP_CIPHER_CTX_set_padding(ctx, 0);
+
+        memcpy(evp_in, local_tag, 16);
+        memcpy(evp_in + 16, local_rdr + 16, 16);
+    }
+
+    uint8_t keys[AES_NI_LANES][16] = {{0x00}};
+    uint64_t stamps[AES_NI_LANES] = {0};
+
+    for (uint64_t i = starttime + args->idx; i < stoptime;) {
 
         if (__atomic_load_n(&global_found, __ATOMIC_ACQUIRE) == 1) {
             break;
         }
 
-        uint8_t key[16] = {0x00};
-        make_key(i, key);
-
-        uint8_t iv[16] = {0x00};
-        uint8_t dec_tag[16] = {0x00};
-        decrypt_aes(local_tag, 16, key, iv, dec_tag);
-
-        uint8_t dec_rdr[32] = {0x00};
-        decrypt_aes(local_rdr, 32, key, local_tag, dec_rdr);
-
-        // check rol byte first
-        if (dec_tag[0] != dec_rdr[31]) continue;
-
-        // compare rest
-        if (dec_tag[1] != dec_rdr[16]) continue;
-        if (dec_tag[2] != dec_rdr[17]) continue;
-        if (dec_tag[3] != dec_rdr[18]) continue;
-        if (dec_tag[4] != dec_rdr[19]) continue;
-        if (dec_tag[5] != dec_rdr[20]) continue;
-        if (dec_tag[6] != dec_rdr[21]) continue;
-        if (dec_tag[7] != dec_rdr[22]) continue;
-        if (dec_tag[8] != dec_rdr[23]) continue;
-        if (dec_tag[9] != dec_rdr[24]) continue;
-        if (dec_tag[10] != dec_rdr[25]) continue;
-        if (dec_tag[11] != dec_rdr[26]) continue;
-        if (dec_tag[12] != dec_rdr[27]) continue;
-        if (dec_tag[13] != dec_rdr[28]) continue;
-        if (dec_tag[14] != dec_rdr[29]) continue;
-        if (dec_tag[15] != dec_rdr[30]) continue;
+        // fill the lanes, a short last batch just rechecks stale keys
+        int n = 0;
+        for (; n < AES_NI_LANES && i < stoptime; n++, i += thread_count) {
+            stamps[n] = i;
+            make_key(i, keys[n]);
+        }
+
+        uint32_t found;
+#ifdef AES_NI_AVAILABLE
+        if (use_aesni)
+            found = aes_ni_check_auth(keys, local_tag, local_rdr);
+        else
+#endif
+            found = check_auth_evp(ctx, keys, evp_in, local_rdr);
+
+        found &= (1U << n) - 1;
+        if (found == 0) continue;
+
+        int l = __builtin_ctz(found);
 
         __sync_fetch_and_add(&global_found, 1);
 
@@ -199,23 +215,77 @@ static void *brute_thread(void *arguments) {
         pthread_mutex_lock(&print_lock);
 
         printf("Found timestamp........ ");
-        print_time(i);
+        print_time(stamps[l]);
 
         printf("key.................... \x1b[32m");
-        print_hex(key, sizeof(key));
+        print_hex(keys[l], sizeof(keys[l]));
         printf(AEND);
 
         pthread_mutex_unlock(&print_lock);
         break;
     }
 
+    EVP_CIPHER_CTX_free(ctx);
     free(args);
     return NULL;
 }
 
+static void run_threads(uint64_t start_time, uint64_t stop_time, const uint8_t *tag_challenge, const uint8_t *rdr_resp_challenge) {
+
+    pthread_t threads[thread_count];
+
+    for (int i = 0; i < thread_count; ++i) {
+        struct thread_args *a = calloc(1, sizeof(struct thread_args));
+        a->thread = i;
+        a->idx = i;
+        a->starttime = start_time;
+        a->stoptime = stop_time;
+        memcpy(a->tag, tag_challenge, 16);
+        memcpy(a->rdr, rdr_resp_challenge, 32);
+        pthread_create(&threads[i], NULL, brute_thread, (void *)a);
+    }
+
+    // wait for threads to terminate:
+    for (int i = 0; i < thread_count; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+// Keys per second of each available engine over a range which never matches
+static int bench(bool support_aesni) {
+
+#define BENCH_KEYS (1 << 23)
+
+    uint8_t tag_challenge[16] = {0x00};
+    uint8_t rdr_resp_challenge[32] = {0x00};
+
+    for (int engine = 0; engine < 2; engine++) {
+
+        if (engine == 1 && support_aesni == false)
+            break;
+
+        use_aesni = (engine == 1);
+
+        uint64_t t1 = msclock();
+        run_threads(0, BENCH_KEYS, tag_challenge, rdr_resp_challenge);
+        t1 = msclock() - t1;
+        if (t1 == 0)
+            t1 = 1;
+
+        printf("%-8s " _YELLOW_("%8.2f") " Mkeys/s  ( %u keys in %.2f sec )\n"
+               , (use_aesni) ? "AES-NI" : "OpenSSL"
+               , (double)BENCH_KEYS / t1 / 1000.0
+               , BENCH_KEYS
+               , (float)t1 / 1000.0
+              );
+    }
+    return 0;
+}
+
 static int usage(const char *s) {
     printf(_YELLOW_("syntax:") "\n");
     printf("    %s <unix timestamp> <16 byte tag challenge> <32 byte reader response challenge>\n", s);
+    printf("    %s --bench\n", s);
     printf("\n");
     printf(_YELLOW_("example:") "\n");
     printf("    ./mfd_aes_brute 1605394800 bb6aea729414a5b1eff7b16328ce37fd 82f5f498dbc29f7570102397a2e5ef2b6dc14a864f665b3c54d11765af81e95c\n");
@@ -231,8 +301,27 @@ int main(int argc, char *argv[]) {
     printf("-----------------------------------------------------\n");
     printf("\n");
 
+    bool support_aesni = false;
+#if defined(AES_NI_AVAILABLE) && !defined(__APPLE__) && !defined(__MACH__)
+    support_aesni = platform_aes_hw_available();
+#endif
+    printf("AES-NI detected........ " _GREEN_("%s") "\n", (support_aesni) ? "yes" : "no");
+
+#if !defined(_WIN32) || !defined(__WIN32__)
+    thread_count = sysconf(_SC_NPROCESSORS_CONF);
+    if (thread_count < 2)
+        thread_count = 2;
+#endif  /* _WIN32 */
+
+    if (argc == 2 && strcmp(argv[1], "--bench") == 0) {
+        printf("\nBenchmark using " _YELLOW_("%d") " threads\n", thread_count);
+        return bench(support_aesni);
+    }
+
     if (argc != 4) return usage(argv[0]);
 
+    use_aesni = support_aesni;
+
     uint64_t start_time = atoi(argv[1]);
 
     uint8_t tag_challenge[16] = {0x00};
@@ -255,36 +344,12 @@ int main(int argc, char *argv[]) {
 
     uint64_t t1 = msclock();
 
-#if !defined(_WIN32) || !defined(__WIN32__)
-    thread_count = sysconf(_SC_NPROCESSORS_CONF);
-    if (thread_count < 2)
-        thread_count = 2;
-#endif  /* _WIN32 */
-
     printf("\nBruteforce using " _YELLOW_("%d") " threads\n", thread_count);
 
-    pthread_t threads[thread_count];
-
     // create a mutex to avoid interlacing print commands from our different threads
     pthread_mutex_init(&print_lock, NULL);
 
-    // threads
-    uint64_t stop_time = time(NULL);
-    for (int i = 0; i < thread_count; ++i) {
-        struct thread_args *a = calloc(1, sizeof(struct thread_args));
-        a->thread = i;
-        a->idx = i;
-        a->starttime = start_time;
-        a->stoptime = stop_time;
-        memcpy(a->tag, tag_challenge, 16);
-        memcpy(a->rdr, rdr_resp_challenge, 32);
-        pthread_create(&threads[i], NULL, brute_thread, (void *)a);
-    }
-
-    // wait for threads to terminate:
-    for (int i = 0; i < thread_count; ++i) {
-        pthread_join(threads[i], NULL);
-    }
+    run_threads(start_time, time(NULL), tag_challenge, rdr_resp_challenge);
 
     if (global_found == false) {
         printf("\n" _RED_("!!!") " failed to find a key\n\n");
@@ -0,0 +1,126 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "crapto1/crapto1.h"
+#include "crapto1/crypto1_bs.h"
+
+// Micro-benchmark of the crapto1 state recovery functions.
+// make -C tools/mfkey crapto1_bench
+
+static double elapsed_ms(clock_t start) {
+    return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+static uint32_t rand32(void) {
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+int main(int argc, char *argv[]) {
+    int rounds = 20;
+
+    if (argc > 1)
+        rounds = atoi(argv[1]);
+
+    if (rounds <= 0) {
+        printf(" syntax: %s [rounds]\n\n", argv[0]);
+        return 1;
+    }
+
+    printf("crapto1 micro-benchmark, %d rounds\n\n", rounds);
+    srand(1);
+
+    uint64_t states = 0;
+    clock_t start = clock();
+    for (int i = 0; i < rounds; i++) {
+        struct Crypto1State *sl = lfsr_recovery32(rand32(), rand32());
+        for (struct Crypto1State *p = sl; p->odd | p->even; p++)
+            states++;
+        free(sl);
+    }
+    printf("lfsr_recovery32     %8.2f ms/call  %8" PRIu64 " states/call\n", elapsed_ms(start) / rounds, states / rounds);
+
+    states = 0;
+    start = clock();
+    for (int i = 0; i < rounds; i++) {
+        struct Crypto1State *sl = lfsr_recovery64(rand32(), rand32());
+        for (struct Crypto1State *p = sl; p->odd | p->even; p++)
+            states++;
+        free(sl);
+    }
+    printf("lfsr_recovery64     %8.2f ms/call  %8" PRIu64 " states/call\n", elapsed_ms(start) / rounds, states / rounds);
+
+    // the common prefix attack spends its time finding the partial states of both halves
+    states = 0;
+    start = clock();
+    for (int i = 0; i < rounds; i++) {
+        uint8_t ks[8];
+        for (int j = 0; j < 8; j++)
+            ks[j] = rand() & 0x0f;
+
+        for (int isodd = 0; isodd < 2; isodd++) {
+            uint32_t *candidates = lfsr_prefix_ks(ks, isodd);
+            for (uint32_t *p = candidates; *p != 0xffffffff; p++)
+                states++;
+            free(candidates);
+        }
+    }
+    printf("lfsr_prefix_ks x2   %8.2f ms/call  %8" PRIu64 " states/call\n", elapsed_ms(start) / rounds, states / rounds);
+
+    // nested auth decryption of the first byte, as done by mf_nonce_brute phase 2
+    const uint32_t nkeys = rounds * 65536;
+    uint32_t in0 = rand32(), in1 = rand32();
+    uint8_t *check = malloc(nkeys);
+    uint8_t *check_bs = malloc(nkeys);
+    if (check == NULL || check_bs == NULL) {
+        printf("cannot allocate %u bytes for the results\n", nkeys);
+        return 1;
+    }
+    start = clock();
+    for (uint32_t i = 0; i < nkeys; i++) {
+        struct Crypto1State st;
+        crypto1_init(&st, ((uint64_t)i << 16) ^ 0x123456789abc);
+        crypto1_word(&st, in0, 1);
+        crypto1_word(&st, in1, 1);
+        crypto1_word(&st, 0, 0);
+        crypto1_word(&st, 0, 0);
+        check[i] = crypto1_byte(&st, 0, 0);
+    }
+    printf("crypto1 scalar      %8.2f ms/Mkey\n", elapsed_ms(start) * 1048576.0 / nkeys);
+
+    start = clock();
+    for (uint32_t i = 0; i < nkeys; i += CRYPTO1_BS_LANES) {
+        uint64_t keys[CRYPTO1_BS_LANES];
+        for (int l = 0; l < CRYPTO1_BS_LANES; l++)
+            keys[l] = ((uint64_t)(i + l) << 16) ^ 0x123456789abc;
+
+        crypto1_bs_state_t bs;
+        crypto1_bs_load_keys(&bs, keys, CRYPTO1_BS_LANES);
+        crypto1_bs_word(&bs, in0, true, NULL);
+        crypto1_bs_word(&bs, in1, true, NULL);
+        crypto1_bs_word(&bs, 0, false, NULL);
+        crypto1_bs_word(&bs, 0, false, NULL);
+
+        crypto1_bs_t ks[8];
+        crypto1_bs_byte(&bs, 0, false, ks);
+        for (int l = 0; l < CRYPTO1_BS_LANES; l++)
+            check_bs[i + l] = crypto1_bs_extract(ks, l, 8);
+    }
+    printf("crypto1 bitsliced   %8.2f ms/Mkey\n", elapsed_ms(start) * 1048576.0 / nkeys);
+
+    // every lane has to give the byte of the scalar cipher for the same key
+    int ret = 0;
+    for (uint32_t i = 0; i < nkeys; i++) {
+        if (check[i] != check_bs[i]) {
+            printf("\nkey %012" PRIx64 " lane %u: scalar %02x bitsliced %02x\n", ((uint64_t)i << 16) ^ 0x123456789abc, i % CRYPTO1_BS_LANES, check[i], check_bs[i]);
+            ret = 1;
+            break;
+        }
+    }
+    free(check);
+    free(check_bs);
+
+    printf("\nbitsliced crypto1 [ %s ]\n", ret ? "fail" : "ok");
+    return ret;
+}
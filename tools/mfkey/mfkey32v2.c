@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "crapto1/crapto1.h"
+#include "crapto1/crypto1_bs.h"
 #include "util_posix.h"
 
 int main(int argc, char *argv[]) {
@@ -59,18 +60,37 @@ int main(int argc, char *argv[]) {
 
     s = lfsr_recovery32(ar0_enc ^ p64, 0);
 
-    for (t = s; t->odd | t->even; ++t) {
-        lfsr_rollback_word(t, 0, 0);
-        lfsr_rollback_word(t, nr0_enc, 1);
-        lfsr_rollback_word(t, uid ^ nt0, 0);
-        crypto1_get_lfsr(t, &key);
+    // check the candidates CRYPTO1_BS_LANES at a time against the second authentication
+    crypto1_bs_state_t bs;
+    for (t = s; t->odd | t->even;) {
+        size_t n = 0;
+        while (n < CRYPTO1_BS_LANES && (t[n].odd | t[n].even))
+            n++;
 
-        crypto1_word(t, uid ^ nt1, 0);
-        crypto1_word(t, nr1_enc, 1);
-        if (ar1_enc == (crypto1_word(t, 0, 0) ^ p64b)) {
+        crypto1_bs_load_states(&bs, t, n);
+        crypto1_bs_rollback_word(&bs, 0, false);
+        crypto1_bs_rollback_word(&bs, nr0_enc, true);
+        crypto1_bs_rollback_word(&bs, uid ^ nt0, false);
+        crypto1_bs_word(&bs, uid ^ nt1, false, NULL);
+        crypto1_bs_word(&bs, nr1_enc, true, NULL);
+
+        crypto1_bs_t ks[32];
+        crypto1_bs_word(&bs, 0, false, ks);
+
+        crypto1_bs_t hit = crypto1_bs_match(ks, ar1_enc ^ p64b, 32);
+        if (n < CRYPTO1_BS_LANES)
+            hit &= ((crypto1_bs_t)1 << n) - 1;
+
+        if (hit) {
+            t += __builtin_ctzll(hit);
+            lfsr_rollback_word(t, 0, 0);
+            lfsr_rollback_word(t, nr0_enc, 1);
+            lfsr_rollback_word(t, uid ^ nt0, 0);
+            crypto1_get_lfsr(t, &key);
             printf("\nFound Key: [%012" PRIx64 "]\n\n", key);
             break;
         }
+        t += n;
     }
     free(s);
     return 0;